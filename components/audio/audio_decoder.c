@@ -0,0 +1,308 @@
+#include "audio_decoder.h"
+#include "audio_format.h"
+#include "kraken/kernel.h"
+#include "esp_audio_dec.h"
+#include "esp_audio_dec_default.h"
+#include "esp_aac_dec.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "audio_decoder";
+
+#define PCM_FRAME_BYTES 4  // 16-bit stereo
+
+static struct {
+    bool open;
+    bool registered;                 // esp_audio_dec default codecs
+    audio_codec_t codec;
+    esp_audio_dec_handle_t handle;   // NULL for PCM pass-through
+    audio_format_t format;           // PCM source layout; codecs report their own
+    audio_format_adts_sync_t adts;
+    size_t internal_free;            // Heap free before the codec was opened
+    size_t psram_free;
+    uint64_t decode_us;              // Time spent in the codec
+    uint64_t audio_us;               // Playback time of what it produced
+    audio_decoder_stats_t stats;
+} s_dec;
+
+esp_err_t audio_decoder_open(const audio_format_t *format)
+{
+    if (s_dec.open) {
+        audio_decoder_close();
+    }
+
+    audio_codec_t codec = format->codec;
+    memset(&s_dec.stats, 0, sizeof(s_dec.stats));
+    s_dec.stats.codec = codec;
+    s_dec.stats.bits = 16;
+    s_dec.format = *format;
+    s_dec.decode_us = 0;
+    s_dec.audio_us = 0;
+    s_dec.handle = NULL;
+    memset(&s_dec.adts, 0, sizeof(s_dec.adts));
+
+    if (codec == AUDIO_CODEC_MP3 || codec == AUDIO_CODEC_AAC) {
+        if (!s_dec.registered) {
+            if (esp_audio_dec_register_default() != ESP_AUDIO_ERR_OK) {
+                ESP_LOGE(TAG, "Failed to register decoders");
+                return ESP_FAIL;
+            }
+            s_dec.registered = true;
+        }
+
+        // Sample rate and channels come from each ADTS header. SBR/PS (HE-AAC v1/v2)
+        // doubles the output rate and costs extra CPU, so it can be turned off.
+        esp_aac_dec_cfg_t aac_cfg = {
+            .no_adts_header = false,
+#if CONFIG_KRAKEN_AUDIO_AAC_PLUS
+            .aac_plus_enable = true,
+#endif
+        };
+        esp_audio_dec_cfg_t cfg = {
+            .type = ESP_AUDIO_TYPE_MP3,
+        };
+        if (codec == AUDIO_CODEC_AAC) {
+            cfg.type = ESP_AUDIO_TYPE_AAC;
+            cfg.cfg = &aac_cfg;
+            cfg.cfg_sz = sizeof(aac_cfg);
+        }
+
+        // The codec allocates on its own heap calls, so its footprint is
+        // measured as the drop in free heap; other tasks' allocations count too
+        s_dec.internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        s_dec.psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+
+        esp_audio_err_t ret = esp_audio_dec_open(&cfg, &s_dec.handle);
+        if (ret != ESP_AUDIO_ERR_OK) {
+            ESP_LOGE(TAG, "Failed to open %s decoder: %d", audio_format_codec_name(codec), ret);
+            return ret == ESP_AUDIO_ERR_MEM_LACK ? ESP_ERR_NO_MEM : ESP_FAIL;
+        }
+    } else if (codec == AUDIO_CODEC_PCM) {
+        if (format->channels == 0 || format->sample_rate == 0 ||
+            (format->bits != 8 && format->bits != 16 && format->bits != 24 && format->bits != 32)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_dec.stats.sample_rate = format->sample_rate;
+        s_dec.stats.channels = format->channels;
+        s_dec.stats.bits = format->bits;
+        s_dec.stats.bitrate = format->sample_rate * format->channels * format->bits;
+    } else {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    s_dec.codec = codec;
+    s_dec.open = true;
+    ESP_LOGI(TAG, "%s decoder open", audio_format_codec_name(codec));
+    return ESP_OK;
+}
+
+void audio_decoder_close(void)
+{
+    if (!s_dec.open) {
+        return;
+    }
+    if (s_dec.handle) {
+        esp_audio_dec_close(s_dec.handle);
+        s_dec.handle = NULL;
+    }
+    s_dec.open = false;
+
+    audio_decoder_stats_t *st = &s_dec.stats;
+    if (st->frames) {
+        ESP_LOGI(TAG, "%s: %lu frames, %lu errors, %lu resyncs, %lu us/frame avg, %lu us max, "
+                 "%lu%% CPU, heap drop %u B internal + %u B PSRAM",
+                 audio_format_codec_name(st->codec), (unsigned long)st->frames,
+                 (unsigned long)st->errors, (unsigned long)st->resyncs,
+                 (unsigned long)st->frame_us_avg, (unsigned long)st->frame_us_max,
+                 (unsigned long)st->cpu_load_pct, (unsigned)st->mem_internal_peak,
+                 (unsigned)st->mem_psram_peak);
+    }
+}
+
+// Heap taken since the codec was opened, sampled after each frame. Both free
+// sizes are running totals kept by the heap, so this is cheap.
+static void audio_decoder_sample_memory(void)
+{
+    size_t internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t internal_used = internal_free < s_dec.internal_free ? s_dec.internal_free - internal_free : 0;
+    size_t psram_used = psram_free < s_dec.psram_free ? s_dec.psram_free - psram_free : 0;
+    audio_decoder_stats_t *st = &s_dec.stats;
+    if (internal_used > st->mem_internal_peak) {
+        st->mem_internal_peak = internal_used;
+    }
+    if (psram_used > st->mem_psram_peak) {
+        st->mem_psram_peak = psram_used;
+    }
+}
+
+// Mono to interleaved stereo in place, back to front so no sample is
+// overwritten before it is read. buf holds 2 * samples int16s.
+static void audio_decoder_mono_to_stereo(int16_t *buf, size_t samples)
+{
+    for (size_t i = samples; i-- > 0;) {
+        buf[2 * i + 1] = buf[i];
+        buf[2 * i] = buf[i];
+    }
+}
+
+// Caller passes the codec's time for the frame and its PCM output size
+static void audio_decoder_account(int64_t decode_us, size_t pcm_bytes)
+{
+    audio_decoder_stats_t *st = &s_dec.stats;
+    st->frames++;
+    s_dec.decode_us += decode_us;
+    if (decode_us > st->frame_us_max) {
+        st->frame_us_max = (uint32_t)decode_us;
+    }
+    if (st->sample_rate) {
+        s_dec.audio_us += (uint64_t)(pcm_bytes / PCM_FRAME_BYTES) * 1000000 / st->sample_rate;
+    }
+    st->frame_us_avg = (uint32_t)(s_dec.decode_us / st->frames);
+    st->cpu_load_pct = s_dec.audio_us ? (uint32_t)(s_dec.decode_us * 100 / s_dec.audio_us) : 0;
+}
+
+// One source sample as 16 bits: 8-bit WAV is unsigned, wider samples keep
+// their top 16 bits (little-endian, so the last two bytes)
+static inline int16_t audio_decoder_pcm_sample(const uint8_t *p, int bytes)
+{
+    if (bytes == 1) {
+        return (int16_t)((p[0] - 128) << 8);
+    }
+    return (int16_t)(p[bytes - 2] | (p[bytes - 1] << 8));
+}
+
+// Raw or WAV PCM to 16-bit stereo. Mono is duplicated; beyond two channels,
+// the first two (front left/right in WAV order) are kept.
+static esp_err_t audio_decoder_passthrough(const uint8_t *in, size_t in_len, size_t *consumed,
+                                           uint8_t *out, size_t out_size, size_t *out_len)
+{
+    int bytes = s_dec.format.bits / 8;
+    int channels = s_dec.format.channels;
+    size_t in_frame = (size_t)bytes * channels;
+    size_t frames = in_len / in_frame;
+    if (frames > out_size / PCM_FRAME_BYTES) {
+        frames = out_size / PCM_FRAME_BYTES;
+    }
+    if (frames == 0) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    if (bytes == 2 && channels == 2) {
+        memcpy(out, in, frames * PCM_FRAME_BYTES);  // The common case, as before
+    } else {
+        int16_t *dst = (int16_t *)out;
+        for (size_t i = 0; i < frames; i++) {
+            const uint8_t *src = in + i * in_frame;
+            int16_t left = audio_decoder_pcm_sample(src, bytes);
+            dst[2 * i] = left;
+            dst[2 * i + 1] = channels == 1 ? left : audio_decoder_pcm_sample(src + bytes, bytes);
+        }
+    }
+
+    *consumed = frames * in_frame;
+    *out_len = frames * PCM_FRAME_BYTES;
+    audio_decoder_account(0, *out_len);
+    return ESP_OK;
+}
+
+esp_err_t audio_decoder_decode(const uint8_t *in, size_t in_len, size_t *consumed,
+                               uint8_t *out, size_t out_size, size_t *out_len)
+{
+    *consumed = 0;
+    *out_len = 0;
+    if (!s_dec.open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_dec.handle) {
+        return audio_decoder_passthrough(in, in_len, consumed, out, out_size, out_len);
+    }
+    if (in_len == 0) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    size_t skip = 0;
+    if (s_dec.codec == AUDIO_CODEC_AAC) {
+        // The codec is handed exactly one frame, so garbage never reaches it
+        size_t frame_len = 0;
+        esp_err_t err = audio_format_adts_sync(&s_dec.adts, in, in_len, &skip, &frame_len);
+        s_dec.stats.resyncs = s_dec.adts.resyncs;
+        if (err != ESP_OK) {
+            *consumed = skip;
+            return err;
+        }
+        in += skip;
+        in_len = frame_len;
+    }
+
+    esp_audio_dec_in_raw_t raw = {
+        .buffer = (uint8_t *)in,
+        .len = in_len,
+    };
+    esp_audio_dec_out_frame_t frame = {
+        .buffer = out,
+        .len = out_size,
+    };
+
+    int64_t start_us = kraken_time_us();
+    esp_audio_err_t ret = esp_audio_dec_process(s_dec.handle, &raw, &frame);
+    int64_t decode_us = kraken_time_us() - start_us;
+    *consumed = skip + raw.consumed;
+
+    if (s_dec.codec == AUDIO_CODEC_AAC && ret != ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+        // A whole frame went in; drop it whatever the codec made of it
+        *consumed = skip + in_len;
+        if (ret == ESP_AUDIO_ERR_DATA_LACK) {
+            ret = ESP_AUDIO_ERR_FAIL;
+        }
+    }
+
+    if (ret == ESP_AUDIO_ERR_DATA_LACK || (ret == ESP_AUDIO_ERR_OK && raw.consumed == 0)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
+        ESP_LOGE(TAG, "Frame needs %lu bytes of PCM, buffer has %u",
+                 (unsigned long)frame.needed_size, (unsigned)out_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (ret != ESP_AUDIO_ERR_OK) {
+        // Skip at least a byte so the codec resynchronises on the next frame
+        s_dec.stats.errors++;
+        if (*consumed == 0) {
+            *consumed = 1;
+        }
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    esp_audio_dec_info_t info;
+    if (esp_audio_dec_get_info(s_dec.handle, &info) == ESP_AUDIO_ERR_OK &&
+        (info.sample_rate != s_dec.stats.sample_rate || info.channel != s_dec.stats.channels)) {
+        ESP_LOGI(TAG, "%s %lu Hz, %d ch, %lu kbps", audio_format_codec_name(s_dec.codec),
+                 (unsigned long)info.sample_rate, info.channel,
+                 (unsigned long)(info.bitrate / 1000));
+        s_dec.stats.sample_rate = info.sample_rate;
+        s_dec.stats.channels = info.channel;
+        s_dec.stats.bitrate = info.bitrate;
+    }
+
+    size_t pcm = frame.decoded_size;
+    if (s_dec.stats.channels == 1) {
+        // A mono frame is at most half the largest stereo one, so it widens in place
+        if (pcm * 2 > out_size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        audio_decoder_mono_to_stereo((int16_t *)out, pcm / sizeof(int16_t));
+        pcm *= 2;
+    }
+    *out_len = pcm;
+    audio_decoder_account(decode_us, pcm);
+    audio_decoder_sample_memory();
+    return ESP_OK;
+}
+
+void audio_decoder_get_stats(audio_decoder_stats_t *stats)
+{
+    *stats = s_dec.stats;
+}
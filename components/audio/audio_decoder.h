@@ -0,0 +1,38 @@
+#pragma once
+
+#include "kraken/audio_service.h"
+#include "audio_format.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest PCM output of one frame after stereo expansion: 2048 samples
+// (HE-AAC) x 2 channels x 16 bit
+#define AUDIO_DECODER_MAX_FRAME_BYTES (2048 * 2 * sizeof(int16_t))
+// Input the caller should be able to hold: an MP3 frame is at most 1441 bytes,
+// and ADTS headers claiming more than this are treated as false syncs
+#define AUDIO_DECODER_MAX_INPUT AUDIO_FORMAT_SNIFF_BYTES
+
+// One decoder stage at a time, used only by the decode task. Output is always
+// interleaved 16-bit stereo at the stream's own sample rate. format comes from
+// audio_format_detect(); its container header must already be skipped.
+esp_err_t audio_decoder_open(const audio_format_t *format);
+void audio_decoder_close(void);
+
+// Decodes at most one frame from in. *consumed is always valid.
+//   ESP_OK                   *out_len bytes of PCM (may be 0 while the codec primes)
+//   ESP_ERR_NOT_FINISHED     no complete frame in in; call again with more data
+//   ESP_ERR_INVALID_RESPONSE corrupt data skipped, keep going
+//   other                    the stream cannot be decoded
+esp_err_t audio_decoder_decode(const uint8_t *in, size_t in_len, size_t *consumed,
+                               uint8_t *out, size_t out_size, size_t *out_len);
+
+// Kept after close, so the last stream can still be inspected
+void audio_decoder_get_stats(audio_decoder_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
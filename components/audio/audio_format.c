@@ -0,0 +1,313 @@
+#include "audio_format.h"
+#include "esp_log.h"
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "audio_format";
+
+#define ADTS_HEADER_SIZE 7   // 9 with CRC; the frame length covers either
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// kbps by bitrate index 1-14; [MPEG-1 / MPEG-2 and 2.5][layer I, II, III]
+static const uint16_t s_mpeg_kbps[2][3][14] = {
+    {
+        { 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    {
+        { 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+static const uint32_t s_mpeg1_rates[3] = { 44100, 48000, 32000 };
+
+static uint16_t audio_format_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t audio_format_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const char *audio_format_codec_name(audio_codec_t codec)
+{
+    switch (codec) {
+        case AUDIO_CODEC_PCM:
+            return "PCM";
+        case AUDIO_CODEC_MP3:
+            return "MP3";
+        case AUDIO_CODEC_AAC:
+            return "AAC";
+        case AUDIO_CODEC_FLAC:
+            return "FLAC";
+        case AUDIO_CODEC_OGG:
+            return "Ogg";
+        default:
+            return "none";
+    }
+}
+
+audio_codec_t audio_format_from_content_type(const char *content_type)
+{
+    static const struct {
+        const char *type;
+        audio_codec_t codec;
+    } s_types[] = {
+        { "audio/mpeg", AUDIO_CODEC_MP3 },
+        { "audio/mp3", AUDIO_CODEC_MP3 },
+        { "audio/x-mpeg", AUDIO_CODEC_MP3 },
+        { "audio/aac", AUDIO_CODEC_AAC },    // Also audio/aacp (HE-AAC)
+        { "audio/x-aac", AUDIO_CODEC_AAC },
+        { "audio/wav", AUDIO_CODEC_PCM },
+        { "audio/x-wav", AUDIO_CODEC_PCM },
+        { "audio/wave", AUDIO_CODEC_PCM },
+        { "audio/flac", AUDIO_CODEC_FLAC },
+        { "audio/x-flac", AUDIO_CODEC_FLAC },
+        { "audio/ogg", AUDIO_CODEC_OGG },
+        { "audio/opus", AUDIO_CODEC_OGG },
+        { "application/ogg", AUDIO_CODEC_OGG },
+    };
+
+    if (!content_type) {
+        return AUDIO_CODEC_NONE;
+    }
+    for (size_t i = 0; i < sizeof(s_types) / sizeof(s_types[0]); i++) {
+        if (strncasecmp(content_type, s_types[i].type, strlen(s_types[i].type)) == 0) {
+            return s_types[i].codec;
+        }
+    }
+    return AUDIO_CODEC_NONE;
+}
+
+size_t audio_format_adts_frame_len(const uint8_t *p, size_t max_len)
+{
+    // 12-bit syncword, layer 0
+    if (p[0] != 0xFF || (p[1] & 0xF6) != 0xF0) {
+        return 0;
+    }
+    // Sampling frequency index 13-15 is reserved
+    if (((p[2] >> 2) & 0x0F) > 12) {
+        return 0;
+    }
+    size_t len = ((size_t)(p[3] & 0x03) << 11) | ((size_t)p[4] << 3) | (p[5] >> 5);
+    size_t header = (p[1] & 0x01) ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2;
+    if (len <= header || len > max_len) {
+        return 0;
+    }
+    return len;
+}
+
+size_t audio_format_mpeg_frame_len(const uint8_t *p)
+{
+    // 11-bit sync; version 01 and layer 00 (ADTS) are reserved
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) {
+        return 0;
+    }
+    int version = (p[1] >> 3) & 0x03;  // 0: 2.5, 2: 2, 3: 1
+    int layer = 4 - ((p[1] >> 1) & 0x03);
+    int bitrate_index = p[2] >> 4;
+    int rate_index = (p[2] >> 2) & 0x03;
+    if (version == 1 || layer == 4 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+        return 0;  // Free-format streams are rare enough not to be worth the search
+    }
+
+    bool mpeg1 = version == 3;
+    uint32_t rate = s_mpeg1_rates[rate_index] >> (mpeg1 ? 0 : version == 2 ? 1 : 2);
+    uint32_t bps = s_mpeg_kbps[mpeg1 ? 0 : 1][layer - 1][bitrate_index - 1] * 1000;
+    size_t padding = (p[2] >> 1) & 0x01;
+
+    if (layer == 1) {
+        return (12 * bps / rate + padding) * 4;
+    }
+    // Layer III of MPEG-2/2.5 has half the samples per frame
+    uint32_t factor = (layer == 3 && !mpeg1) ? 72 : 144;
+    return factor * bps / rate + padding;
+}
+
+static size_t audio_format_adts_len(const uint8_t *p)
+{
+    return audio_format_adts_frame_len(p, AUDIO_FORMAT_SNIFF_BYTES);
+}
+
+// Offset of the first frame whose successor starts exactly where it ends. A
+// single syncword proves nothing: 0xFFF/0xFFE occur inside audio data.
+static bool audio_format_find_frames(const uint8_t *data, size_t len,
+                                     size_t (*frame_len)(const uint8_t *), size_t *offset)
+{
+    for (size_t i = 0; i + ADTS_HEADER_SIZE <= len; i++) {
+        size_t n = frame_len(data + i);
+        if (n && i + n + ADTS_HEADER_SIZE <= len && frame_len(data + i + n)) {
+            *offset = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t audio_format_adts_sync(audio_format_adts_sync_t *sync, const uint8_t *in,
+                                 size_t in_len, size_t *skip, size_t *frame_len)
+{
+    *skip = 0;
+    if (sync->synced) {
+        if (in_len < ADTS_HEADER_SIZE) {
+            return ESP_ERR_NOT_FINISHED;
+        }
+        size_t len = audio_format_adts_len(in);
+        if (len) {
+            *frame_len = len;
+            return in_len >= len ? ESP_OK : ESP_ERR_NOT_FINISHED;
+        }
+        ESP_LOGW(TAG, "ADTS sync lost");
+        sync->synced = false;
+        sync->resyncs++;
+    }
+
+    size_t i = 0;
+    for (; i + ADTS_HEADER_SIZE <= in_len; i++) {
+        size_t len = audio_format_adts_len(in + i);
+        if (!len) {
+            continue;
+        }
+        if (i + len + ADTS_HEADER_SIZE > in_len) {
+            // Cannot confirm yet; keep this candidate for the next call
+            *skip = i;
+            return ESP_ERR_NOT_FINISHED;
+        }
+        if (audio_format_adts_len(in + i + len)) {
+            if (i) {
+                ESP_LOGI(TAG, "ADTS sync after %u bytes", (unsigned)i);
+            }
+            sync->synced = true;
+            *skip = i;
+            *frame_len = len;
+            return ESP_OK;
+        }
+    }
+    // No header here; a partial one may still be in the last bytes
+    *skip = i;
+    return ESP_ERR_NOT_FINISHED;
+}
+
+// RIFF/WAVE: chunks of id(4) size(4) data, word aligned. Only "fmt " and
+// "data" matter; LIST and the like are skipped.
+static esp_err_t audio_format_parse_wav(const uint8_t *data, size_t len, bool final,
+                                        audio_format_t *fmt)
+{
+    fmt->codec = AUDIO_CODEC_PCM;
+    bool have_fmt = false;
+    size_t pos = 12;
+    // pos + 8 <= len holds inside the loop, so the bounds below are written as
+    // size against what is left: pos + 8 + size wraps for a 32-bit size_t
+    while (pos + 8 <= len) {
+        uint32_t size = audio_format_le32(data + pos + 4);
+        const uint8_t *body = data + pos + 8;
+
+        if (memcmp(data + pos, "data", 4) == 0) {
+            if (!have_fmt) {
+                ESP_LOGW(TAG, "WAV data before its fmt chunk");
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            // The size is often 0 or 0xFFFFFFFF in a live stream; play to the end
+            fmt->header_bytes = pos + 8;
+            return ESP_OK;
+        }
+
+        if (memcmp(data + pos, "fmt ", 4) == 0) {
+            if (size < 16 || size > len - pos - 8) {
+                break;
+            }
+            uint16_t tag = audio_format_le16(body);
+            if (tag == WAV_FORMAT_EXTENSIBLE && size >= 40) {
+                tag = audio_format_le16(body + 24);  // Sub-format GUID starts with the tag
+            }
+            fmt->channels = (uint8_t)audio_format_le16(body + 2);
+            fmt->sample_rate = audio_format_le32(body + 4);
+            fmt->bits = (uint8_t)audio_format_le16(body + 14);
+            if (tag != WAV_FORMAT_PCM || fmt->channels == 0 || fmt->sample_rate == 0 ||
+                (fmt->bits != 8 && fmt->bits != 16 && fmt->bits != 24 && fmt->bits != 32)) {
+                ESP_LOGW(TAG, "WAV format 0x%04x, %u bit: only integer PCM is played",
+                         tag, fmt->bits);
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            have_fmt = true;
+        }
+
+        if (size > len - pos - 8) {
+            break;  // A chunk that runs past the buffer, and not one that is needed
+        }
+        pos += 8 + size + (size & 1);
+    }
+
+    if (final) {
+        ESP_LOGW(TAG, "No WAV data chunk in the first %u bytes", (unsigned)len);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+esp_err_t audio_format_detect(audio_codec_t hint, const uint8_t *data, size_t len, bool final,
+                              audio_format_t *fmt)
+{
+    memset(fmt, 0, sizeof(*fmt));
+
+    if (len < 12 && !final) {
+        return ESP_ERR_NOT_FINISHED;  // Enough for every magic below
+    }
+    if (len >= 12) {
+        if (memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+            return audio_format_parse_wav(data, len, final, fmt);
+        }
+        if (memcmp(data, "ID3", 3) == 0) {
+            // Tag size is synchsafe (7 bits per byte) and excludes the header and footer
+            fmt->header_bytes = 10 + (((size_t)(data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) |
+                                      ((data[8] & 0x7F) << 7) | (data[9] & 0x7F));
+            if (data[5] & 0x10) {
+                fmt->header_bytes += 10;
+            }
+            return ESP_OK;
+        }
+        if (memcmp(data, "fLaC", 4) == 0) {
+            fmt->codec = AUDIO_CODEC_FLAC;
+            return ESP_OK;
+        }
+        if (memcmp(data, "OggS", 4) == 0) {
+            fmt->codec = AUDIO_CODEC_OGG;
+            return ESP_OK;
+        }
+    }
+
+    // Leading garbage before the first frame is left to the decoder's own sync
+    size_t adts_at = 0;
+    size_t mpeg_at = 0;
+    bool adts = audio_format_find_frames(data, len, audio_format_adts_len, &adts_at);
+    bool mpeg = audio_format_find_frames(data, len, audio_format_mpeg_frame_len, &mpeg_at);
+    if (adts || mpeg) {
+        fmt->codec = (adts && (!mpeg || adts_at < mpeg_at)) ? AUDIO_CODEC_AAC : AUDIO_CODEC_MP3;
+        if (hint != AUDIO_CODEC_NONE && hint != fmt->codec) {
+            ESP_LOGW(TAG, "Content-Type says %s, stream is %s", audio_format_codec_name(hint),
+                     audio_format_codec_name(fmt->codec));
+        }
+        return ESP_OK;
+    }
+    if (!final && len < AUDIO_FORMAT_SNIFF_BYTES) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    // Nothing recognisable: trust the header, or take it as raw PCM as before
+    if (hint != AUDIO_CODEC_NONE && hint != AUDIO_CODEC_PCM) {
+        fmt->codec = hint;
+        return ESP_OK;
+    }
+    ESP_LOGW(TAG, "Unknown stream format, playing as raw 16-bit stereo PCM");
+    fmt->codec = AUDIO_CODEC_PCM;
+    fmt->sample_rate = 44100;
+    fmt->channels = 2;
+    fmt->bits = 16;
+    return ESP_OK;
+}
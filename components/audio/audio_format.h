@@ -0,0 +1,65 @@
+#pragma once
+
+#include "kraken/audio_service.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bytes looked at before falling back to the Content-Type: room for two of
+// the largest MP3 or ADTS frames
+#define AUDIO_FORMAT_SNIFF_BYTES 4096
+
+// What the decode stage needs to know about a stream before its first frame
+typedef struct {
+    audio_codec_t codec;     // AUDIO_CODEC_NONE: skip header_bytes, then detect again
+    uint32_t sample_rate;    // PCM/WAV only; codecs report theirs after a frame
+    uint8_t channels;
+    uint8_t bits;            // PCM sample width: 8 (unsigned), 16, 24 or 32
+    size_t header_bytes;     // Container header before the audio (WAV, ID3 tag)
+} audio_format_t;
+
+// Codec named by a Content-Type header, AUDIO_CODEC_NONE if it names none
+audio_codec_t audio_format_from_content_type(const char *content_type);
+
+// Identifies the stream from its first bytes: RIFF/WAVE (header parsed), ID3,
+// fLaC, OggS, then MP3 or ADTS frame sync confirmed by a second header. The
+// Content-Type is the fallback when the bytes say nothing.
+//   ESP_OK                 *fmt is set; FLAC and Ogg are reported, not decoded
+//   ESP_ERR_NOT_FINISHED   call again with more data (final is false)
+//   ESP_ERR_NOT_SUPPORTED  a WAV encoding other than integer PCM
+// final: no more data will come, or the buffer cannot hold more
+esp_err_t audio_format_detect(audio_codec_t hint, const uint8_t *data, size_t len, bool final,
+                              audio_format_t *fmt);
+
+// Frame length from a frame header at p (at least 7 bytes), 0 if p is not one.
+// ADTS frames longer than max_len are rejected as false syncs.
+size_t audio_format_adts_frame_len(const uint8_t *p, size_t max_len);
+size_t audio_format_mpeg_frame_len(const uint8_t *p);
+
+// ADTS frame boundaries across calls, for a decoder that takes one frame at a
+// time. Zero it at the start of a stream.
+typedef struct {
+    bool synced;        // The last header was where the previous frame ended
+    uint32_t resyncs;   // Times a bad header dropped sync
+} audio_format_adts_sync_t;
+
+// Finds the next ADTS frame in in. Once synced, every frame must start where
+// the previous one ended. Before that (stream start, a join in the middle of a
+// frame, or after corrupt data) a header only counts when a second one follows
+// it exactly, since 0xFFF also shows up inside audio data. Frames longer than
+// AUDIO_FORMAT_SNIFF_BYTES are false syncs.
+//   ESP_OK                 *skip bytes of garbage, then a frame of *frame_len
+//   ESP_ERR_NOT_FINISHED   *skip bytes can be dropped already; call again
+//                          with more data after them
+esp_err_t audio_format_adts_sync(audio_format_adts_sync_t *sync, const uint8_t *in,
+                                 size_t in_len, size_t *skip, size_t *frame_len);
+
+const char *audio_format_codec_name(audio_codec_t codec);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,22 @@
+#include "audio_gain.h"
+
+// round((v / 100)^2 * 32768) for v = 0..100: the curve audio_apply_volume used
+// to compute with powf on every chunk
+static const uint16_t s_volume_gain[101] = {
+    0, 3, 13, 29, 52, 82, 118, 161, 210, 265,
+    328, 396, 472, 554, 642, 737, 839, 947, 1062, 1183,
+    1311, 1445, 1586, 1733, 1887, 2048, 2215, 2389, 2569, 2756,
+    2949, 3149, 3355, 3568, 3788, 4014, 4247, 4486, 4732, 4984,
+    5243, 5508, 5780, 6059, 6344, 6636, 6934, 7238, 7550, 7868,
+    8192, 8523, 8860, 9205, 9555, 9912, 10276, 10646, 11023, 11407,
+    11796, 12193, 12596, 13006, 13422, 13844, 14274, 14710, 15152, 15601,
+    16056, 16518, 16987, 17462, 17944, 18432, 18927, 19428, 19936, 20451,
+    20972, 21499, 22033, 22574, 23121, 23675, 24235, 24802, 25376, 25956,
+    26542, 27135, 27735, 28341, 28954, 29573, 30199, 30831, 31470, 32116,
+    32768,
+};
+
+uint16_t audio_gain_from_volume(uint8_t volume)
+{
+    return s_volume_gain[volume > 100 ? 100 : volume];
+}
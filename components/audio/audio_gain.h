@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define AUDIO_GAIN_HAVE_PIE 1
+#else
+#define AUDIO_GAIN_HAVE_PIE 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Q15 gain: 32768 is unity, so 0..65535 covers mute to just under 2.0
+#define AUDIO_GAIN_UNITY 32768
+
+// The volume curve (0-100 %, quadratic for perceived loudness) as a Q15 gain,
+// from a precomputed table. Values above 100 are treated as 100.
+uint16_t audio_gain_from_volume(uint8_t volume);
+
+// Clamp to int16; every audio loop that sums or scales samples uses this one
+static inline int16_t audio_gain_saturate(int32_t value)
+{
+    if (value > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)value;
+}
+
+// samples[i] * gain, rounded to nearest and saturated to int16, one sample at
+// a time. Inline so it lands in the caller's section (KRAKEN_IRAM_ATTR). No
+// int16 x uint16 product overflows int32, and the clamp maps to CLAMPS on
+// Xtensa; on the host the compiler vectorizes it. The reference for the PIE
+// kernel.
+static inline void audio_gain_apply_scalar(int16_t *samples, size_t count, uint16_t gain)
+{
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = audio_gain_saturate(((int32_t)samples[i] * gain + (1 << 14)) >> 15);
+    }
+}
+
+#if AUDIO_GAIN_HAVE_PIE
+// ESP32-S3 PIE: eight samples per step, same results as the scalar loop.
+// samples 16-byte aligned, count a multiple of 8, gain below unity (the lanes
+// are signed 16-bit). In IRAM with CONFIG_KRAKEN_HOT_PATHS_IN_IRAM.
+void audio_gain_apply_pie(int16_t *samples, size_t count, uint16_t gain);
+#endif
+
+// samples[i] * gain, as audio_gain_apply_scalar. Unity returns at once. On the
+// ESP32-S3 a cut runs on PIE, with the unaligned head and the tail scalar.
+static inline void audio_gain_apply(int16_t *samples, size_t count, uint16_t gain)
+{
+    if (gain == AUDIO_GAIN_UNITY) {
+        return;  // (s * 32768 + 16384) >> 15 == s
+    }
+#if AUDIO_GAIN_HAVE_PIE
+    if (gain < AUDIO_GAIN_UNITY) {
+        size_t head = ((0u - (uintptr_t)samples) & 15) / sizeof(int16_t);
+        if (head > count) {
+            head = count;
+        }
+        audio_gain_apply_scalar(samples, head, gain);
+        size_t bulk = (count - head) & ~(size_t)7;
+        if (bulk) {
+            audio_gain_apply_pie(samples + head, bulk, gain);
+        }
+        samples += head + bulk;
+        count -= head + bulk;
+    }
+#endif
+    audio_gain_apply_scalar(samples, count, gain);
+}
+
+// A linear fade from gain from to gain to (Q15) across frames of interleaved
+// samples, for click-free starts and stops. The last frame is one step short
+// of to.
+static inline void audio_gain_ramp(int16_t *samples, size_t frames, int channels, uint16_t from,
+                                   uint16_t to)
+{
+    if (frames == 0) {
+        return;
+    }
+    // 15 fraction bits: unity (1 << 15) still fits, shifted, in 32 bits
+    int32_t gain = (int32_t)from << 15;
+    int32_t step = ((int32_t)to - from) * (1 << 15) / (int32_t)frames;
+    for (size_t f = 0; f < frames; f++) {
+        int32_t g = gain >> 15;
+        for (int c = 0; c < channels; c++) {
+            int16_t *s = &samples[f * channels + c];
+            *s = audio_gain_saturate(((int32_t)*s * g + (1 << 14)) >> 15);
+        }
+        gain += step;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
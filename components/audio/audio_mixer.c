@@ -0,0 +1,254 @@
+#include "audio_mixer.h"
+#include "audio_gain.h"
+#include "kraken/kernel.h"
+#include <string.h>
+
+void audio_mixer_init(audio_mixer_t *mx)
+{
+    memset(mx, 0, sizeof(*mx));
+    for (int i = 0; i < AUDIO_MIXER_MAX_PORTS; i++) {
+        mx->ports[i].gain = AUDIO_GAIN_UNITY;
+        mx->ports[i].channels = 2;
+    }
+}
+
+void audio_mixer_attach_ring(audio_mixer_t *mx, int port, audio_ringbuf_t *ring, uint8_t channels,
+                             size_t start_bytes, size_t resume_bytes)
+{
+    audio_mixer_port_t *p = &mx->ports[port];
+    p->state = AUDIO_MIXER_PORT_OFF;
+    p->ring = ring;
+    p->render = NULL;
+    p->channels = channels == 1 ? 1 : 2;
+    p->rate = 0;
+    p->resample = false;
+    p->rs_storage = NULL;
+    p->start_bytes = start_bytes;
+    p->resume_bytes = resume_bytes;
+}
+
+// A fresh filter for the port's rate pair, or none
+static void audio_mixer_setup_rate(const audio_mixer_t *mx, audio_mixer_port_t *p)
+{
+    p->resample = p->ring && p->rs_storage && p->rate && mx->rate && p->rate != mx->rate;
+    if (p->resample) {
+        audio_resampler_init(&p->rs, p->rs_storage, p->rs_quality, p->rate, mx->rate);
+    }
+}
+
+void audio_mixer_set_format(audio_mixer_t *mx, int port, uint32_t rate, uint8_t channels,
+                            uint8_t *rs_storage, audio_resampler_quality_t quality)
+{
+    audio_mixer_port_t *p = &mx->ports[port];
+    p->channels = channels == 1 ? 1 : 2;
+    p->rate = rate;
+    p->rs_storage = rs_storage;
+    p->rs_quality = quality;
+    audio_mixer_setup_rate(mx, p);
+}
+
+void audio_mixer_set_rate(audio_mixer_t *mx, uint32_t rate)
+{
+    mx->rate = rate;
+    for (int i = 0; i < AUDIO_MIXER_MAX_PORTS; i++) {
+        audio_mixer_setup_rate(mx, &mx->ports[i]);
+    }
+}
+
+void audio_mixer_attach_render(audio_mixer_t *mx, int port, audio_mixer_render_fn render, void *ctx)
+{
+    audio_mixer_port_t *p = &mx->ports[port];
+    p->state = AUDIO_MIXER_PORT_OFF;
+    p->ring = NULL;
+    p->render = render;
+    p->ctx = ctx;
+    p->channels = 2;
+}
+
+void audio_mixer_set_gain(audio_mixer_t *mx, int port, uint16_t gain)
+{
+    mx->ports[port].gain = gain > AUDIO_GAIN_UNITY ? AUDIO_GAIN_UNITY : gain;
+}
+
+void audio_mixer_set_marks(audio_mixer_t *mx, int port, size_t start_bytes, size_t resume_bytes)
+{
+    audio_mixer_port_t *p = &mx->ports[port];
+    p->mark = p->mark == p->start_bytes ? start_bytes : resume_bytes;
+    p->start_bytes = start_bytes;
+    p->resume_bytes = resume_bytes;
+}
+
+void audio_mixer_start(audio_mixer_t *mx, int port)
+{
+    audio_mixer_port_t *p = &mx->ports[port];
+    p->eof = false;
+    p->mark = p->start_bytes;
+    if (p->resample) {
+        audio_resampler_reset(&p->rs);
+    }
+    p->state = p->ring ? AUDIO_MIXER_PORT_BUFFERING : AUDIO_MIXER_PORT_PLAYING;
+}
+
+void audio_mixer_stop(audio_mixer_t *mx, int port)
+{
+    mx->ports[port].state = AUDIO_MIXER_PORT_OFF;
+}
+
+void audio_mixer_end(audio_mixer_t *mx, int port)
+{
+    mx->ports[port].eof = true;
+}
+
+audio_mixer_port_state_t audio_mixer_port_state(const audio_mixer_t *mx, int port)
+{
+    return mx->ports[port].state;
+}
+
+// Up to frames whole frames from the ring, of fill bytes, as stereo
+static size_t audio_mixer_read(audio_mixer_port_t *p, int16_t *out, size_t frames, size_t fill)
+{
+    size_t frame_bytes = p->channels * sizeof(int16_t);
+    size_t want = frames * frame_bytes;
+    size_t take = fill < want ? fill - fill % frame_bytes : want;
+    // Mono is read into the back half and spread forwards; each write lands
+    // at or before the sample read last
+    int16_t *src = p->channels == 1 ? out + frames : out;
+    size_t got = audio_ringbuf_read(p->ring, src, take) / frame_bytes;
+    if (p->channels == 1) {
+        for (size_t i = 0; i < got; i++) {
+            int16_t s = src[i];
+            out[2 * i] = s;
+            out[2 * i + 1] = s;
+        }
+    }
+    return got;
+}
+
+// Up to frames output frames through the port's resampler. Reads no more than
+// the resampler has room for, so nothing read is dropped; what it holds is
+// played by later blocks. The last half filter of the data before an end
+// stays in it.
+static size_t audio_mixer_read_resampled(audio_mixer_t *mx, audio_mixer_port_t *p, int16_t *out,
+                                         size_t frames, size_t fill)
+{
+    size_t produced = 0;
+    size_t got = 0;
+    for (;;) {
+        size_t used = 0;
+        produced += audio_resampler_process(&p->rs, mx->rs_in, got, &used, out + produced * 2,
+                                            frames - produced);
+        if (produced == frames) {
+            break;
+        }
+        size_t room = p->rs.buf_capacity - p->rs.buf_frames;
+        if (room > AUDIO_MIXER_BLOCK_FRAMES) {
+            room = AUDIO_MIXER_BLOCK_FRAMES;
+        }
+        got = audio_mixer_read(p, mx->rs_in, room, fill);
+        if (got == 0) {
+            break;
+        }
+        fill -= got * p->channels * sizeof(int16_t);
+    }
+    return produced;
+}
+
+// Whole frames from a ring port as stereo, at the output rate. Only a port
+// with a resume mark rebuffers after an underrun; one without plays whatever
+// is there, and an empty ring is just an idle producer.
+static size_t audio_mixer_pull(audio_mixer_t *mx, audio_mixer_port_t *p, int16_t *out, size_t frames)
+{
+    bool eof = p->eof;  // Before the fill, so no final bytes are missed
+    size_t fill = audio_ringbuf_fill(p->ring);
+
+    if (p->state == AUDIO_MIXER_PORT_BUFFERING) {
+        if (fill < p->mark && !eof) {
+            return 0;
+        }
+        p->state = AUDIO_MIXER_PORT_PLAYING;
+    }
+
+    size_t got = p->resample ? audio_mixer_read_resampled(mx, p, out, frames, fill)
+                             : audio_mixer_read(p, out, frames, fill);
+
+    if (got < frames) {
+        if (eof) {
+            if (got == 0) {
+                p->state = AUDIO_MIXER_PORT_DRAINED;
+            }
+        } else if (p->resume_bytes) {
+            p->underruns++;
+            p->state = AUDIO_MIXER_PORT_BUFFERING;
+            p->mark = p->resume_bytes;
+        } else if (got) {
+            p->underruns++;  // The producer fell behind mid-sound
+        }
+    }
+    p->frames += got;
+    return got;
+}
+
+// acc[0..*len) += samples, and copies past the end of what is there
+static inline void audio_mixer_accumulate(int32_t *acc, size_t *len, const int16_t *samples,
+                                          size_t count)
+{
+    size_t common = count < *len ? count : *len;
+    size_t i = 0;
+    for (; i < common; i++) {
+        acc[i] += samples[i];
+    }
+    for (; i < count; i++) {
+        acc[i] = samples[i];
+    }
+    if (count > *len) {
+        *len = count;
+    }
+}
+
+KRAKEN_IRAM_ATTR uint32_t audio_mixer_mix(audio_mixer_t *mx, int16_t *out, size_t frames,
+                                          uint8_t channels)
+{
+    if (frames > AUDIO_MIXER_BLOCK_FRAMES) {
+        frames = AUDIO_MIXER_BLOCK_FRAMES;
+    }
+
+    uint32_t mask = 0;
+    size_t acc_len = 0;  // Samples of acc holding data
+    for (int i = 0; i < AUDIO_MIXER_MAX_PORTS; i++) {
+        audio_mixer_port_t *p = &mx->ports[i];
+        if (p->state != AUDIO_MIXER_PORT_PLAYING && p->state != AUDIO_MIXER_PORT_BUFFERING) {
+            continue;
+        }
+
+        size_t n = 0;
+        if (p->ring) {
+            n = audio_mixer_pull(mx, p, mx->scratch, frames);
+        } else if (p->render) {
+            n = p->render(p->ctx, mx->scratch, frames);
+            p->frames += n;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        if (p->gain != AUDIO_GAIN_UNITY) {
+            audio_gain_apply(mx->scratch, n * 2, p->gain);
+        }
+        // Four full-scale ports cannot overflow the 32-bit sum
+        audio_mixer_accumulate(mx->acc, &acc_len, mx->scratch, n * 2);
+        mask |= 1u << i;
+    }
+
+    if (channels == 1) {
+        acc_len /= 2;
+        for (size_t i = 0; i < acc_len; i++) {
+            out[i] = audio_gain_saturate((mx->acc[2 * i] + mx->acc[2 * i + 1]) >> 1);
+        }
+    } else {
+        for (size_t i = 0; i < acc_len; i++) {
+            out[i] = audio_gain_saturate(mx->acc[i]);
+        }
+    }
+    memset(out + acc_len, 0, (frames * channels - acc_len) * sizeof(int16_t));
+    return mask;
+}
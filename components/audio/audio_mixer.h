@@ -0,0 +1,100 @@
+#pragma once
+
+#include "audio_resampler.h"
+#include "audio_ringbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// N input ports summed into one 16-bit output, stereo or mono. A port is
+// either a ring of 16-bit PCM filled by another task, or a generator run on
+// the mixing task. Each has its own gain and channel count. A ring port may
+// also have its own rate, and is then resampled to the output rate as it is
+// read; the rest run at the output rate. Each port is converted to 16-bit
+// stereo and scaled, the ports are summed in 32 bits, and the sum saturates
+// once (a mono output gets (L + R) / 2).
+#define AUDIO_MIXER_MAX_PORTS 4
+#define AUDIO_MIXER_BLOCK_FRAMES 512  // Largest block per audio_mixer_mix call
+
+// Writes up to frames stereo frames to out; returns how many (0: silent)
+typedef size_t (*audio_mixer_render_fn)(void *ctx, int16_t *out, size_t frames);
+
+typedef enum {
+    AUDIO_MIXER_PORT_OFF = 0,   // Not mixed
+    AUDIO_MIXER_PORT_BUFFERING, // Ring port waiting for its start or resume mark
+    AUDIO_MIXER_PORT_PLAYING,
+    AUDIO_MIXER_PORT_DRAINED,   // Ended and emptied; stays silent until started again
+} audio_mixer_port_state_t;
+
+typedef struct {
+    audio_mixer_port_state_t state;
+    uint16_t gain;              // Q15, AUDIO_GAIN_UNITY or below
+    uint8_t channels;           // Ring ports: 1 (played on both sides) or 2
+    uint32_t rate;              // Ring ports: of the data; 0 plays it at the output rate
+    bool resample;              // rate is not the output rate, and there is a resampler
+    audio_resampler_quality_t rs_quality;
+    uint8_t *rs_storage;        // For rs; NULL: no conversion
+    audio_resampler_t rs;
+    audio_ringbuf_t *ring;      // Ring port; NULL for a generator
+    audio_mixer_render_fn render;
+    void *ctx;
+    size_t start_bytes;         // Fill needed before the first block
+    size_t resume_bytes;        // Fill needed after an underrun; 0 plays what is there
+    size_t mark;                // The one in force while buffering
+    volatile bool eof;          // Set by the producer: drain, no underruns from here on
+    uint32_t underruns;         // Blocks cut short while the producer was still going
+    uint64_t frames;            // Frames taken from the port
+} audio_mixer_port_t;
+
+typedef struct {
+    uint32_t rate;              // Output rate; 0 until set, no port is resampled
+    audio_mixer_port_t ports[AUDIO_MIXER_MAX_PORTS];
+    int32_t acc[AUDIO_MIXER_BLOCK_FRAMES * 2];
+    int16_t scratch[AUDIO_MIXER_BLOCK_FRAMES * 2];
+    int16_t rs_in[AUDIO_MIXER_BLOCK_FRAMES * 2];  // Ring data on its way into a resampler
+} audio_mixer_t;
+
+// All ports off, unity gain, nothing attached
+void audio_mixer_init(audio_mixer_t *mx);
+
+// Port setup; only from the mixing task, or before it runs
+void audio_mixer_attach_ring(audio_mixer_t *mx, int port, audio_ringbuf_t *ring, uint8_t channels,
+                             size_t start_bytes, size_t resume_bytes);
+void audio_mixer_attach_render(audio_mixer_t *mx, int port, audio_mixer_render_fn render, void *ctx);
+// Rate of a ring port's data. Another rate than the output's is converted
+// through rs_storage (audio_resampler_storage_size(quality) bytes, kept until
+// the port is attached or set again); rate 0, or no storage, plays the data at
+// the output rate. Data already in the ring is read in the new format.
+void audio_mixer_set_format(audio_mixer_t *mx, int port, uint32_t rate, uint8_t channels,
+                            uint8_t *rs_storage, audio_resampler_quality_t quality);
+// The output rate. Sets up the filters of ports at other rates (floating
+// point: between blocks, not per sample).
+void audio_mixer_set_rate(audio_mixer_t *mx, uint32_t rate);
+// Any task; takes effect from the next block
+void audio_mixer_set_gain(audio_mixer_t *mx, int port, uint16_t gain);
+// New start and resume marks for a ring port, e.g. after a rate change; a
+// port that is buffering waits for the new one
+void audio_mixer_set_marks(audio_mixer_t *mx, int port, size_t start_bytes, size_t resume_bytes);
+
+// From the mixing task. start (re)arms a port: a ring port buffers up to its
+// start mark first, a generator plays at once. stop drops it from the mix
+// without touching its ring.
+void audio_mixer_start(audio_mixer_t *mx, int port);
+void audio_mixer_stop(audio_mixer_t *mx, int port);
+// From the producer: no more data will come for this run of the port
+void audio_mixer_end(audio_mixer_t *mx, int port);
+
+audio_mixer_port_state_t audio_mixer_port_state(const audio_mixer_t *mx, int port);
+
+// Mixes one block of frames (at most AUDIO_MIXER_BLOCK_FRAMES) into out as
+// channels (1 or 2) samples per frame, silence where no port had data.
+// Returns a bit per port that contributed.
+uint32_t audio_mixer_mix(audio_mixer_t *mx, int16_t *out, size_t frames, uint8_t channels);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,196 @@
+#include "audio_resampler.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RESAMPLER_MAX_TAPS 32
+#define RESAMPLER_ALIGN 16      // PIE vector loads
+#define RESAMPLER_SLACK 16      // Samples a kernel may read past the history
+
+static const struct {
+    int taps;
+    int phases;
+    double cutoff;  // Passband edge as a fraction of the lower Nyquist rate
+} s_quality[AUDIO_RESAMPLER_QUALITY_COUNT] = {
+    [AUDIO_RESAMPLER_LOW] = { 8, 64, 0.80 },
+    [AUDIO_RESAMPLER_MEDIUM] = { 16, 128, 0.88 },
+    [AUDIO_RESAMPLER_HIGH] = { 32, 256, 0.94 },
+};
+
+// Coefficients, then one history plane per channel. Each part is a multiple
+// of 16 bytes, so with the base rounded up all three are vector aligned.
+static size_t audio_resampler_plane_samples(int taps)
+{
+    size_t samples = (size_t)taps + AUDIO_RESAMPLER_BLOCK_FRAMES + RESAMPLER_SLACK;
+    return (samples + RESAMPLER_ALIGN / 2 - 1) & ~(size_t)(RESAMPLER_ALIGN / 2 - 1);
+}
+
+size_t audio_resampler_storage_size(audio_resampler_quality_t quality)
+{
+    int taps = s_quality[quality].taps;
+    size_t coeffs = (size_t)taps * s_quality[quality].phases;
+    size_t bytes = (coeffs + 2 * audio_resampler_plane_samples(taps)) * sizeof(int16_t);
+    return bytes + RESAMPLER_ALIGN;  // Room to align the base; keeps the size a multiple of 16
+}
+
+// Blackman-windowed sinc. Phase p is the filter for an output that lies p/phases
+// of a frame after tap taps/2 - 1. Each phase is scaled to a DC gain of exactly
+// 1.0 in Q15, so silence and DC stay exact.
+static void audio_resampler_design(audio_resampler_t *rs, double cutoff)
+{
+    double ratio = (double)rs->out_rate / rs->in_rate;
+    double fc = 0.5 * cutoff * (ratio < 1.0 ? ratio : 1.0);  // Cycles per input frame
+    double half = rs->taps / 2.0;
+
+    for (int p = 0; p < rs->phases; p++) {
+        int16_t *c = rs->coeffs + (size_t)p * rs->taps;
+        double h[RESAMPLER_MAX_TAPS];
+        double sum = 0.0;
+        for (int k = 0; k < rs->taps; k++) {
+            double t = (half - 1.0 + (double)p / rs->phases) - k;
+            double x = 2.0 * fc * t;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double w = 0.42 + 0.5 * cos(M_PI * t / half) + 0.08 * cos(2.0 * M_PI * t / half);
+            h[k] = fabs(t) >= half ? 0.0 : 2.0 * fc * sinc * w;
+            sum += h[k];
+        }
+
+        int32_t total = 0;
+        int peak = 0;
+        for (int k = 0; k < rs->taps; k++) {
+            double q = h[k] / sum * 32768.0;
+            c[k] = (int16_t)lrint(q > 32767.0 ? 32767.0 : q);
+            total += c[k];
+            if (c[k] > c[peak]) {
+                peak = k;
+            }
+        }
+        // Rounding leftovers go to the largest tap
+        c[peak] = (int16_t)(c[peak] + (32768 - total));
+    }
+}
+
+void audio_resampler_init(audio_resampler_t *rs, uint8_t *storage, audio_resampler_quality_t quality,
+                          uint32_t in_rate, uint32_t out_rate)
+{
+    memset(rs, 0, sizeof(*rs));
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->taps = s_quality[quality].taps;
+    rs->phases = s_quality[quality].phases;
+    uintptr_t base = ((uintptr_t)storage + RESAMPLER_ALIGN - 1) & ~(uintptr_t)(RESAMPLER_ALIGN - 1);
+    size_t plane = audio_resampler_plane_samples(rs->taps);
+    rs->coeffs = (int16_t *)base;
+    rs->buf[0] = rs->coeffs + (size_t)rs->taps * rs->phases;
+    rs->buf[1] = rs->buf[0] + plane;
+    // The slack is never written, but kernels read it; keep it defined
+    memset(rs->buf[0], 0, 2 * plane * sizeof(int16_t));
+    rs->buf_capacity = (size_t)rs->taps + AUDIO_RESAMPLER_BLOCK_FRAMES;
+    rs->step = ((uint64_t)in_rate << 32) / out_rate;
+#if AUDIO_RESAMPLER_HAVE_PIE
+    rs->dot = audio_resampler_dot_pie;
+#else
+    rs->dot = audio_resampler_dot_scalar;
+#endif
+    audio_resampler_design(rs, s_quality[quality].cutoff);
+    audio_resampler_reset(rs);
+}
+
+void audio_resampler_set_dot(audio_resampler_t *rs, audio_resampler_dot_fn dot)
+{
+    rs->dot = dot ? dot : audio_resampler_dot_scalar;
+}
+
+void audio_resampler_reset(audio_resampler_t *rs)
+{
+    // Half a filter of silence in front, so the first output lines up with
+    // the first input frame
+    rs->buf_frames = (size_t)rs->taps / 2 - 1;
+    memset(rs->buf[0], 0, rs->buf_frames * sizeof(int16_t));
+    memset(rs->buf[1], 0, rs->buf_frames * sizeof(int16_t));
+    rs->pos = 0;
+}
+
+// Q15 sum to a sample, rounded to nearest
+static inline int16_t audio_resampler_clip(int32_t sum)
+{
+    int32_t acc = (int32_t)(((int64_t)sum + (1 << 14)) >> 15);
+    if (acc > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (acc < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)acc;
+}
+
+// Four taps per iteration. The sum is 64-bit: a full-scale input that follows
+// the signs of the taps can pass 32 bits, and must clip rather than wrap.
+int32_t audio_resampler_dot_scalar(const int16_t *x, const int16_t *c, int taps)
+{
+    int64_t acc = 0;
+    for (int k = 0; k < taps; k += 4) {
+        acc += x[k] * c[k];
+        acc += x[k + 1] * c[k + 1];
+        acc += x[k + 2] * c[k + 2];
+        acc += x[k + 3] * c[k + 3];
+    }
+    if (acc > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (acc < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)acc;
+}
+
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames,
+                               size_t *in_used, int16_t *out, size_t out_frames)
+{
+    size_t take = rs->buf_capacity - rs->buf_frames;
+    if (take > in_frames) {
+        take = in_frames;
+    }
+    // Split into planes: the vector kernel needs each channel contiguous
+    int16_t *left = rs->buf[0] + rs->buf_frames;
+    int16_t *right = rs->buf[1] + rs->buf_frames;
+    for (size_t i = 0; i < take; i++) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+    rs->buf_frames += take;
+    *in_used = take;
+
+    size_t produced = 0;
+    while (produced < out_frames) {
+        // Nearest phase; rounding up past the last one is phase 0 of the next frame
+        uint64_t at = (rs->pos * rs->phases + (1ULL << 31)) >> 32;
+        size_t first = (size_t)(at / rs->phases);
+        int phase = (int)(at % rs->phases);
+        if (first + rs->taps > rs->buf_frames) {
+            break;  // Needs input that has not arrived
+        }
+        const int16_t *c = rs->coeffs + (size_t)phase * rs->taps;
+        out[produced * 2] = audio_resampler_clip(rs->dot(rs->buf[0] + first, c, rs->taps));
+        out[produced * 2 + 1] = audio_resampler_clip(rs->dot(rs->buf[1] + first, c, rs->taps));
+        produced++;
+        rs->pos += rs->step;
+    }
+
+    // Drop what no later output can reach
+    size_t first = (size_t)(rs->pos >> 32);
+    if (first > rs->buf_frames) {
+        first = rs->buf_frames;
+    }
+    if (first) {
+        for (int ch = 0; ch < 2; ch++) {
+            memmove(rs->buf[ch], rs->buf[ch] + first, (rs->buf_frames - first) * sizeof(int16_t));
+        }
+        rs->buf_frames -= first;
+        rs->pos -= (uint64_t)first << 32;
+    }
+    return produced;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define AUDIO_RESAMPLER_HAVE_PIE 1
+#else
+#define AUDIO_RESAMPLER_HAVE_PIE 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Polyphase windowed-sinc sample-rate converter for interleaved 16-bit stereo.
+// Q15 coefficients, 32-bit accumulators: the output depends only on the input,
+// never on the block sizes it arrives in, nor on the dot-product kernel.
+typedef enum {
+    AUDIO_RESAMPLER_LOW = 0,   // 8 taps x 64 phases: speech, low CPU
+    AUDIO_RESAMPLER_MEDIUM,    // 16 taps x 128 phases
+    AUDIO_RESAMPLER_HIGH,      // 32 taps x 256 phases: music
+    AUDIO_RESAMPLER_QUALITY_COUNT,
+} audio_resampler_quality_t;
+
+// Input frames buffered per call; bounds the storage
+#define AUDIO_RESAMPLER_BLOCK_FRAMES 1024
+
+// Filter kernel: the sum of x[k] * c[k] over taps (a multiple of 8). x is
+// 2-byte aligned, c 16-byte aligned, and both may be read up to 32 bytes past
+// taps. The sum saturates to 32 bits.
+typedef int32_t (*audio_resampler_dot_fn)(const int16_t *x, const int16_t *c, int taps);
+
+// Portable kernel, and the reference for the others
+int32_t audio_resampler_dot_scalar(const int16_t *x, const int16_t *c, int taps);
+#if AUDIO_RESAMPLER_HAVE_PIE
+// ESP32-S3 PIE: eight 16-bit MACs per instruction into the 40-bit ACCX
+int32_t audio_resampler_dot_pie(const int16_t *x, const int16_t *c, int taps);
+#endif
+
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    int taps;                // Per phase, even
+    int phases;
+    int16_t *coeffs;         // phases x taps, phase-major, 16-byte aligned
+    int16_t *buf[2];         // Input history, one plane per channel
+    size_t buf_frames;       // Frames held in buf
+    size_t buf_capacity;
+    uint64_t pos;            // Next output position in buf, 32.32 frames
+    uint64_t step;           // in_rate / out_rate, 32.32
+    audio_resampler_dot_fn dot;
+} audio_resampler_t;
+
+// Bytes of storage audio_resampler_init needs for a quality level
+size_t audio_resampler_storage_size(audio_resampler_quality_t quality);
+
+// storage must stay valid, 2-byte aligned, until the resampler is dropped.
+// Computes the filter (floating point; call outside the sample path). Picks
+// the PIE kernel where there is one.
+void audio_resampler_init(audio_resampler_t *rs, uint8_t *storage, audio_resampler_quality_t quality,
+                          uint32_t in_rate, uint32_t out_rate);
+// Forget the history, e.g. between streams
+void audio_resampler_reset(audio_resampler_t *rs);
+// Another kernel, for tests and benchmarks; output is bit-identical
+void audio_resampler_set_dot(audio_resampler_t *rs, audio_resampler_dot_fn dot);
+
+// Takes up to in_frames frames (*in_used reports how many) and writes up to
+// out_frames; returns the frames written. Call again with the rest of the
+// input until all of it is used.
+size_t audio_resampler_process(audio_resampler_t *rs, const int16_t *in, size_t in_frames,
+                               size_t *in_used, int16_t *out, size_t out_frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+#include "audio_ringbuf.h"
+#include <string.h>
+
+size_t audio_ringbuf_init(audio_ringbuf_t *rb, uint8_t *storage, size_t size)
+{
+    // Largest power of two <= size, so indices are a mask of the counters
+    size_t pow2 = 1;
+    while (pow2 <= size / 2) {
+        pow2 <<= 1;
+    }
+
+    rb->buf = storage;
+    rb->size = size ? pow2 : 0;
+    rb->head = 0;
+    rb->tail = 0;
+    return rb->size;
+}
+
+void audio_ringbuf_reset(audio_ringbuf_t *rb)
+{
+    __atomic_store_n(&rb->head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&rb->tail, 0, __ATOMIC_RELEASE);
+}
+
+size_t audio_ringbuf_fill(const audio_ringbuf_t *rb)
+{
+    size_t head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+size_t audio_ringbuf_space(const audio_ringbuf_t *rb)
+{
+    return rb->size - audio_ringbuf_fill(rb);
+}
+
+size_t audio_ringbuf_write(audio_ringbuf_t *rb, const void *data, size_t len)
+{
+    size_t head = rb->head;  // Own counter, no ordering needed
+    size_t tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+    size_t space = rb->size - (head - tail);
+    if (len > space) {
+        len = space;
+    }
+
+    // At most two copies: up to the end of the storage, then from the start
+    size_t pos = head & (rb->size - 1);
+    size_t first = rb->size - pos < len ? rb->size - pos : len;
+    memcpy(rb->buf + pos, data, first);
+    memcpy(rb->buf, (const uint8_t *)data + first, len - first);
+
+    // Publish the bytes only after they are in place
+    __atomic_store_n(&rb->head, head + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+size_t audio_ringbuf_read(audio_ringbuf_t *rb, void *data, size_t len)
+{
+    size_t tail = rb->tail;
+    size_t head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+    size_t fill = head - tail;
+    if (len > fill) {
+        len = fill;
+    }
+
+    size_t pos = tail & (rb->size - 1);
+    size_t first = rb->size - pos < len ? rb->size - pos : len;
+    memcpy(data, rb->buf + pos, first);
+    memcpy((uint8_t *)data + first, rb->buf, len - first);
+
+    // Hand the space back only after the copy is done
+    __atomic_store_n(&rb->tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
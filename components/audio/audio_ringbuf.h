@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single-producer/single-consumer byte ring. Lock-free: the producer only
+// stores head, the consumer only stores tail, so one task may write while
+// another reads.
+typedef struct {
+    uint8_t *buf;
+    size_t size;   // Power of two
+    size_t head;   // Total bytes written (wraps; differences stay exact)
+    size_t tail;   // Total bytes read
+} audio_ringbuf_t;
+
+// size is rounded down to a power of two; returns the usable size
+size_t audio_ringbuf_init(audio_ringbuf_t *rb, uint8_t *storage, size_t size);
+// Only while neither side is using the ring
+void audio_ringbuf_reset(audio_ringbuf_t *rb);
+
+size_t audio_ringbuf_fill(const audio_ringbuf_t *rb);
+size_t audio_ringbuf_space(const audio_ringbuf_t *rb);
+
+// Copy as much as fits / is available; return the bytes moved
+size_t audio_ringbuf_write(audio_ringbuf_t *rb, const void *data, size_t len);
+size_t audio_ringbuf_read(audio_ringbuf_t *rb, void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
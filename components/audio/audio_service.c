@@ -1,36 +1,275 @@
 #include "kraken/audio_service.h"
 #include "kraken/bsp.h"
+#include "kraken/kernel.h"
+#include "kraken/power_service.h"
 #include "driver/i2s_std.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
+#include "audio_ringbuf.h"
+#include "audio_decoder.h"
+#include "audio_format.h"
+#include "audio_resampler.h"
+#include "audio_gain.h"
+#include "audio_synth.h"
+#include "audio_mixer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include <string.h>
-#include <math.h>
+#include <strings.h>
 
 static const char *TAG = "audio_service";
 
-// I2S Configuration
+// I2S Configuration: the output format until a stream or
+// audio_set_output_format() asks for another
 #define I2S_SAMPLE_RATE 44100
 #define I2S_BITS_PER_SAMPLE 16
+#define AUDIO_OUTPUT_RATE_MIN 8000
+#define AUDIO_OUTPUT_RATE_MAX 96000
 #define TEST_TONE_FREQUENCY 440  // A4 note (440 Hz)
+#define TEST_TONE_AMPLITUDE 26214  // 80% of full scale, to avoid clipping
+#define TEST_TONE_FADE_MS 5        // Attack and release, so start and stop do not click
+#define AUDIO_BEEP_AMPLITUDE 16384 // Half scale: sits on top of a stream without much clipping
+#define AUDIO_BEEP_FADE_MS 3
+#define AUDIO_BEEP_QUEUE_LEN 8
 #define HTTP_BUFFER_SIZE 4096
+// Encoded data between the network and decode stages; the PCM ring after the
+// decoder is the jitter buffer
+#define AUDIO_IN_RING_SIZE (32 * 1024)
+#define AUDIO_DEC_IN_SIZE AUDIO_DECODER_MAX_INPUT
+// audio_write() data: short, since the writer paces itself against the output
+#define AUDIO_PCM_RING_SIZE (16 * 1024)
+#define AUDIO_FRAME_BYTES 4  // 16-bit stereo, as in the stream ring
+#define AUDIO_MS_TO_BYTES(ms, rate) ((size_t)(ms) * (rate) / 1000 * AUDIO_FRAME_BYTES)
+#define AUDIO_BYTES_TO_MS(b, rate) ((uint32_t)((uint64_t)(b) * 1000 / AUDIO_FRAME_BYTES / (rate)))
+#define AUDIO_WARM_KEY "audio"
+#define AUDIO_DEFAULT_VOLUME 50
+// Bounded so a stalled I2S DMA surfaces as an error instead of a hung task
+#define AUDIO_WRITE_TIMEOUT_MS 1000
+// The mixer writes straight into the I2S DMA buffers, one block per buffer.
+// Mix-to-speaker latency is up to AUDIO_DMA_DESC_NUM blocks (46 ms).
+#define AUDIO_DMA_DESC_NUM 4
+#define AUDIO_DMA_FRAME_NUM AUDIO_MIXER_BLOCK_FRAMES
+// Above the HTTP read timeout, so a slow server is not taken for a hang
+#define AUDIO_HEARTBEAT_TIMEOUT_MS 8000
+// How long deinit waits for the tasks to leave a read or write and exit
+#define AUDIO_TASK_EXIT_TIMEOUT_MS 7000
+// Resampled frames handed to the ring per call
+#define AUDIO_RESAMPLE_CHUNK_FRAMES 1024
+
+#if CONFIG_KRAKEN_AUDIO_OUTPUT_MONO
+#define AUDIO_OUTPUT_CHANNELS 1
+#else
+#define AUDIO_OUTPUT_CHANNELS 2
+#endif
+
+// Gain ramp over one block, for click-free starts and format switches
+enum {
+    AUDIO_RAMP_NONE = 0,
+    AUDIO_RAMP_IN,
+    AUDIO_RAMP_OUT,
+};
+
+#if CONFIG_KRAKEN_AUDIO_RESAMPLER_LOW
+#define AUDIO_RESAMPLER_QUALITY AUDIO_RESAMPLER_LOW
+#elif CONFIG_KRAKEN_AUDIO_RESAMPLER_HIGH
+#define AUDIO_RESAMPLER_QUALITY AUDIO_RESAMPLER_HIGH
+#else
+#define AUDIO_RESAMPLER_QUALITY AUDIO_RESAMPLER_MEDIUM
+#endif
+
+// A DMA buffer handed back by the I2S ISR
+typedef struct {
+    void *buf;
+    size_t size;
+} audio_dma_block_t;
+
+// Restored on a warm boot (kraken_warm_load)
+typedef struct {
+    uint8_t volume;
+} audio_warm_state_t;
 
 static struct {
     bool initialized;
     bool is_playing;
+    bool output_active;      // I2S channel enabled and CPU lock held; owned by audio_task
+    bool amp_on;             // SD pin high; owned by audio_task
+    audio_output_format_t out_fmt;   // What the I2S runs at; written by audio_task
+    audio_output_format_t base_fmt;  // Asked for by audio_set_output_format()
+    audio_output_format_t base_refused;  // Base format the I2S could not switch to; out_fmt plays instead
+    volatile uint32_t stream_rate;   // Own rate of the current stream when it plays at it, else 0
+    volatile uint32_t format_gen;    // Bumped when streams must set up their rate again
+    uint32_t rate_refused;           // Stream rate the I2S refused; resampled until the next stream
     uint8_t volume;
     audio_mode_t mode;
     char url[256];
     i2s_chan_handle_t tx_handle;
     const board_audio_config_t *config;
     TaskHandle_t audio_task;
+    TaskHandle_t net_task;
+    TaskHandle_t dec_task;
+    volatile bool task_exit;    // Set by deinit; all tasks leave their loops
+    uint8_t notifiers;          // audio_notify() calls holding a task handle
+    SemaphoreHandle_t task_done;
+    SemaphoreHandle_t net_task_done;
+    SemaphoreHandle_t dec_task_done;
+
+    // Stream pipeline: audio_net -> in_ring (encoded) -> audio_dec -> ring (PCM
+    // jitter buffer) -> mixer on audio_task -> I2S
+    audio_ringbuf_t in_ring;
+    uint8_t *in_ring_storage;
+    audio_ringbuf_t ring;
+    uint8_t *ring_storage;
+    audio_codec_t codec_hint;   // From the Content-Type of the current stream, set by audio_net
+    bool stream_active;         // audio_task started the current stream
+    volatile bool net_busy;     // Set by audio_task to start a stream, cleared by audio_net
+    volatile bool dec_busy;     // Set by audio_net once headers are in, cleared by audio_dec
+    volatile bool in_eof;       // No more encoded data for the current stream
+    volatile bool net_waiting;  // audio_net is waiting for in_ring space
+    volatile bool dec_waiting;  // audio_dec is waiting for input or ring space
+
+    // Mixer: one port per audio_source_t. audio_task owns the ports and the
+    // synth; other tasks reach them through the rings and beep_queue.
+    audio_mixer_t mixer;
+    audio_synth_t synth;        // Test tone and beeps
+    int tone_voice;             // Synth voice of the test tone, -1 if none
+    QueueHandle_t beep_queue;   // audio_synth_note_t from audio_beep()
+    audio_ringbuf_t pcm_ring;   // audio_write() data
+    uint8_t *pcm_ring_storage;
+    volatile uint32_t pcm_rate;     // Format of the PCM port; set by audio_task
+    volatile uint8_t pcm_channels;
+    uint32_t pcm_rate_req;          // Asked for by audio_set_pcm_format()
+    uint8_t pcm_channels_req;
+    uint8_t *pcm_rs_storage;        // PCM port resampler, from the first time one is needed
+    SemaphoreHandle_t write_lock;  // One audio_write() at a time: the ring has one producer
+    uint64_t mix_us_total;
+    uint32_t mix_us_max;
+    uint32_t mix_blocks;
+    uint32_t mix_active;        // Sources in the last block
+    uint32_t mix_frames;        // In the last block
+    uint32_t mix_late;          // Blocks mixed after their DMA buffer had started playing again
+    QueueHandle_t dma_queue;    // audio_dma_block_t for each buffer the I2S has just played, from the ISR
+
+    uint32_t output_rate;       // Of the current stream after resampling
+    uint64_t resample_us;       // Time in the resampler, current stream
+    uint64_t resampled_frames;  // Its output
+    uint32_t overruns;
+    uint64_t bytes_in;
+    uint64_t bytes_in_seen;     // bytes_in at audio_task's last heartbeat
+    uint64_t bytes_out;
+    kraken_watch_t *watch;      // Heartbeat for the kernel supervisor
     esp_http_client_handle_t http_client;
+    power_lock_t *play_lock;    // CPU_MAX while the output runs
+    power_lock_t *stream_lock;  // NO_SLEEP while an HTTP stream is open
 } g_audio = {0};
 
-// HTTP streaming task
-static void http_stream_audio(void)
+// Guards out_fmt, base_fmt, base_refused, format_gen and the PCM format
+// request, which other tasks read and set
+static portMUX_TYPE s_format_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE s_task_lock = portMUX_INITIALIZER_UNLOCKED;  // task_exit, notifiers
+
+KRAKEN_CYCLE_STAT_DEFINE(s_volume_cycles, "audio_volume");
+KRAKEN_CYCLE_STAT_DEFINE(s_tone_cycles, "audio_tone");
+KRAKEN_CYCLE_STAT_DEFINE(s_resample_cycles, "audio_resample");
+KRAKEN_CYCLE_STAT_DEFINE(s_mix_cycles, "audio_mix");
+
+// Per-sample hot paths: KRAKEN_IRAM_ATTR keeps them off flash in the IRAM profile
+
+// Scale 16-bit samples in place (quadratic curve for better control). Q15 from
+// a table: no powf per chunk and no float on the stream path.
+static KRAKEN_IRAM_ATTR void audio_apply_volume(int16_t *samples, int num_samples, uint8_t volume)
+{
+    KRAKEN_CYCLE_BEGIN(s_volume_cycles);
+    audio_gain_apply(samples, num_samples, audio_gain_from_volume(volume));
+    KRAKEN_CYCLE_END(s_volume_cycles);
+}
+
+// Mixer generator for AUDIO_SOURCE_TONE: the test tone and beeps. A table
+// oscillator in fixed point, no per-sample sin().
+static KRAKEN_IRAM_ATTR size_t audio_render_synth(void *ctx, int16_t *out, size_t frames)
+{
+    audio_synth_t *synth = ctx;
+    if (!audio_synth_active(synth)) {
+        return 0;
+    }
+    KRAKEN_CYCLE_BEGIN(s_tone_cycles);
+    audio_synth_render(synth, out, frames);
+    KRAKEN_CYCLE_END(s_tone_cycles);
+    return frames;
+}
+
+// 16-bit samples to 32-bit slots in place, from the end so nothing is
+// overwritten before it is read
+static KRAKEN_IRAM_ATTR void audio_output_widen(void *buf, size_t samples)
+{
+    const int16_t *in = buf;
+    int32_t *out = buf;
+    while (samples--) {
+        out[samples] = (int32_t)in[samples] << 16;
+    }
+}
+
+// One output block in the I2S format: every source, the master volume, an
+// optional fade, then widening for 32-bit slots. Timed for
+// audio_get_mixer_stats.
+static KRAKEN_IRAM_ATTR void audio_mix_block(void *out, size_t frames, const audio_output_format_t *fmt,
+                                             uint8_t volume, int ramp)
+{
+    int16_t *pcm = out;
+    size_t samples = frames * fmt->channels;
+    int64_t start_us = kraken_time_us();
+    KRAKEN_CYCLE_BEGIN(s_mix_cycles);
+    uint32_t active = audio_mixer_mix(&g_audio.mixer, pcm, frames, fmt->channels);
+    if (active && volume == 0) {
+        memset(pcm, 0, samples * sizeof(int16_t));  // Sources still drain while muted
+    } else if (active && volume < 100) {
+        audio_apply_volume(pcm, samples, volume);
+    }
+    if (active && ramp != AUDIO_RAMP_NONE) {
+        bool in = ramp == AUDIO_RAMP_IN;
+        audio_gain_ramp(pcm, frames, fmt->channels, in ? 0 : AUDIO_GAIN_UNITY, in ? AUDIO_GAIN_UNITY : 0);
+    }
+    if (fmt->bits == 32) {
+        audio_output_widen(out, samples);
+    }
+    KRAKEN_CYCLE_END(s_mix_cycles);
+
+    uint32_t us = (uint32_t)(kraken_time_us() - start_us);
+    g_audio.mix_us_total += us;
+    if (us > g_audio.mix_us_max) {
+        g_audio.mix_us_max = us;
+    }
+    g_audio.mix_blocks++;
+    g_audio.mix_active = active;
+    g_audio.mix_frames = frames;
+}
+
+// Wake one of the audio tasks. The handle is pinned while it is used: once
+// audio_stop_tasks() sets task_exit no notify starts, and it waits for those in
+// flight before deleting a task. NULL (not started, or joined) is skipped.
+static void audio_notify(TaskHandle_t *task)
+{
+    taskENTER_CRITICAL(&s_task_lock);
+    TaskHandle_t handle = g_audio.task_exit ? NULL : *task;
+    if (handle) {
+        g_audio.notifiers++;
+    }
+    taskEXIT_CRITICAL(&s_task_lock);
+    if (!handle) {
+        return;
+    }
+
+    xTaskNotifyGive(handle);
+    taskENTER_CRITICAL(&s_task_lock);
+    g_audio.notifiers--;
+    taskEXIT_CRITICAL(&s_task_lock);
+}
+
+// Network stage: HTTP body -> in_ring. Runs on audio_net. Returns true if the
+// decode stage was started, which then owns the end of the stream.
+static bool audio_net_fill(void)
 {
     esp_http_client_config_t config = {
         .url = g_audio.url,
@@ -41,7 +280,7 @@ static void http_stream_audio(void)
     g_audio.http_client = esp_http_client_init(&config);
     if (!g_audio.http_client) {
         ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return;
+        return false;
     }
     
     esp_err_t err = esp_http_client_open(g_audio.http_client, 0);
@@ -49,140 +288,814 @@ static void http_stream_audio(void)
         ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
         esp_http_client_cleanup(g_audio.http_client);
         g_audio.http_client = NULL;
-        return;
+        return false;
     }
     
+    // Keep the radio path out of light sleep for the whole stream
+    power_lock_acquire(g_audio.stream_lock);
+
     int content_length = esp_http_client_fetch_headers(g_audio.http_client);
-    ESP_LOGI(TAG, "HTTP stream opened, content_length=%d", content_length);
+    char *content_type = NULL;
+    esp_http_client_get_header(g_audio.http_client, "Content-Type", &content_type);
+    ESP_LOGI(TAG, "HTTP stream opened, content_length=%d, type=%s", content_length,
+             content_type ? content_type : "?");
     
-    uint8_t *buffer = malloc(HTTP_BUFFER_SIZE);
+    // Staging only: samples are scaled on the playback side, after the ring
+    uint8_t *buffer = kraken_malloc(HTTP_BUFFER_SIZE);
     if (!buffer) {
         ESP_LOGE(TAG, "Failed to allocate HTTP buffer");
+        power_lock_release(g_audio.stream_lock);
         esp_http_client_close(g_audio.http_client);
         esp_http_client_cleanup(g_audio.http_client);
         g_audio.http_client = NULL;
-        return;
+        return false;
     }
+
+    // Hand the stream to the decode stage before the first byte arrives. The
+    // header is only a hint; the decode stage looks at the bytes.
+    g_audio.codec_hint = audio_format_from_content_type(content_type);
+    audio_ringbuf_reset(&g_audio.in_ring);
+    g_audio.in_eof = false;
+    g_audio.dec_busy = true;
+    audio_notify(&g_audio.dec_task);
     
-    int total_bytes = 0;
-    while (g_audio.is_playing) {
+    // The decode stage ends early on a format it cannot play; stop downloading then
+    while (g_audio.is_playing && g_audio.dec_busy && !g_audio.task_exit) {
+        // Full: stop reading and let TCP flow control hold the server back
+        if (audio_ringbuf_space(&g_audio.in_ring) < HTTP_BUFFER_SIZE) {
+            g_audio.net_waiting = true;
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            g_audio.net_waiting = false;
+            continue;
+        }
+
         int read_len = esp_http_client_read(g_audio.http_client, (char *)buffer, HTTP_BUFFER_SIZE);
         if (read_len <= 0) {
             ESP_LOGW(TAG, "HTTP stream ended or error");
             break;
         }
-        
-        // Apply volume scaling to streamed data (assume 16-bit samples)
-        if (g_audio.volume == 0) {
-            // Mute: write silence instead
-            memset(buffer, 0, read_len);
-        } else if (g_audio.volume < 100) {
-            // Scale volume (use quadratic curve for better control)
-            float volume_scale = powf(g_audio.volume / 100.0f, 2.0f);
-            int16_t *samples = (int16_t *)buffer;
-            int num_samples = read_len / sizeof(int16_t);
-            for (int i = 0; i < num_samples; i++) {
-                samples[i] = (int16_t)(samples[i] * volume_scale);
-            }
-        }
-        
-        // Write to I2S
-        size_t bytes_written = 0;
-        esp_err_t ret = i2s_channel_write(g_audio.tx_handle, buffer, read_len, &bytes_written, portMAX_DELAY);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "I2S write failed: %s", esp_err_to_name(ret));
-            break;
-        }
-        
-        total_bytes += bytes_written;
-        if (total_bytes % (HTTP_BUFFER_SIZE * 10) == 0) {
-            ESP_LOGI(TAG, "Streamed %d bytes, volume=%d%%", total_bytes, g_audio.volume);
+        audio_ringbuf_write(&g_audio.in_ring, buffer, read_len);
+        g_audio.bytes_in += read_len;
+        if (g_audio.dec_waiting) {
+            audio_notify(&g_audio.dec_task);
         }
     }
+    g_audio.in_eof = true;
+    audio_notify(&g_audio.dec_task);
     
-    free(buffer);
+    kraken_free(buffer);
+    power_lock_release(g_audio.stream_lock);
     esp_http_client_close(g_audio.http_client);
     esp_http_client_cleanup(g_audio.http_client);
     g_audio.http_client = NULL;
-    ESP_LOGI(TAG, "HTTP streaming stopped, total bytes: %d", total_bytes);
+    ESP_LOGI(TAG, "HTTP streaming stopped, received %llu bytes", g_audio.bytes_in);
+    return true;
 }
 
-// Audio playback task
-static void audio_task(void *arg)
+// Producer task: waits for audio_task to start a stream, fills in_ring until
+// the stream ends or playback stops
+static void audio_net_task(void *arg)
 {
-    const int buffer_size = 1024;
-    int16_t audio_buffer[buffer_size];
-    float phase = 0.0f;
-    const float phase_increment = (2.0f * M_PI * TEST_TONE_FREQUENCY) / I2S_SAMPLE_RATE;
-    int buffer_count = 0;
-    
-    ESP_LOGI(TAG, "Audio playback task started");
-    
-    while (1) {
-        if (g_audio.is_playing) {
-            if (g_audio.mode == AUDIO_MODE_HTTP_STREAM) {
-                ESP_LOGI(TAG, "Starting HTTP stream from: %s", g_audio.url);
-                http_stream_audio();
-                g_audio.is_playing = false;  // Stop after stream ends
-                ESP_LOGI(TAG, "HTTP stream finished");
+    while (!g_audio.task_exit) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        if (!g_audio.net_busy) {
+            continue;
+        }
+        if (!audio_net_fill()) {
+            audio_mixer_end(&g_audio.mixer, AUDIO_SOURCE_STREAM);  // Nothing will be decoded
+        }
+        g_audio.net_busy = false;
+    }
+
+    xSemaphoreGive(g_audio.net_task_done);
+    vTaskSuspend(NULL);
+}
+
+// Sleep until audio_net brings input or audio_task frees ring space
+static void audio_dec_wait(void)
+{
+    g_audio.dec_waiting = true;
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    g_audio.dec_waiting = false;
+}
+
+// Copy decoded PCM into the jitter buffer, waiting for room. False if playback
+// stopped meanwhile.
+static bool audio_dec_output(const uint8_t *pcm, size_t len)
+{
+    bool stalled = false;
+    while (len && g_audio.is_playing && !g_audio.task_exit) {
+        size_t n = audio_ringbuf_write(&g_audio.ring, pcm, len);
+        pcm += n;
+        len -= n;
+        if (len) {
+            if (!stalled) {
+                g_audio.overruns++;
+                stalled = true;
+            }
+            audio_dec_wait();
+        }
+    }
+    return len == 0;
+}
+
+// Decoded PCM to the ring through the resampler, one chunk at a time. False
+// if playback stopped meanwhile.
+static bool audio_dec_resample_output(audio_resampler_t *rs, int16_t *chunk, const uint8_t *pcm,
+                                      size_t len)
+{
+    const int16_t *in = (const int16_t *)pcm;
+    size_t frames = len / AUDIO_FRAME_BYTES;
+    while (frames) {
+        size_t used = 0;
+        int64_t start_us = kraken_time_us();
+        KRAKEN_CYCLE_BEGIN(s_resample_cycles);
+        size_t n = audio_resampler_process(rs, in, frames, &used, chunk, AUDIO_RESAMPLE_CHUNK_FRAMES);
+        KRAKEN_CYCLE_END(s_resample_cycles);
+        g_audio.resample_us += kraken_time_us() - start_us;
+        g_audio.resampled_frames += n;
+
+        in += used * 2;
+        frames -= used;
+        if (n && !audio_dec_output((const uint8_t *)chunk, n * AUDIO_FRAME_BYTES)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool audio_output_same(const audio_output_format_t *a, const audio_output_format_t *b)
+{
+    return a->sample_rate == b->sample_rate && a->bits == b->bits && a->channels == b->channels;
+}
+
+// The base format, or the one that plays in its place while the I2S refuses it
+static audio_output_format_t audio_base_format(void)
+{
+    taskENTER_CRITICAL(&s_format_lock);
+    audio_output_format_t fmt = audio_output_same(&g_audio.base_fmt, &g_audio.base_refused)
+                                    ? g_audio.out_fmt
+                                    : g_audio.base_fmt;
+    taskEXIT_CRITICAL(&s_format_lock);
+    return fmt;
+}
+
+// Sets up rate conversion for a stream at rate; *storage holds the filter and
+// the output chunk. Returns the chunk, or NULL when the chain has no resampler.
+// Called again if the rate changes mid-stream.
+static int16_t *audio_dec_resample_setup(audio_resampler_t *rs, uint8_t **storage, uint32_t rate)
+{
+    kraken_free(*storage);
+    *storage = NULL;
+    g_audio.output_rate = rate;
+#if CONFIG_KRAKEN_AUDIO_NATIVE_RATE
+    // Switching the I2S clock costs nothing per sample; audio_task does it
+    // while the stream prebuffers
+    if (rate >= AUDIO_OUTPUT_RATE_MIN && rate <= AUDIO_OUTPUT_RATE_MAX && rate != g_audio.rate_refused) {
+        g_audio.stream_rate = rate;
+        return NULL;
+    }
+    g_audio.stream_rate = 0;
+#endif
+    uint32_t out_rate = audio_base_format().sample_rate;
+    if (rate == out_rate || rate == 0) {
+        return NULL;
+    }
+
+    size_t filter = audio_resampler_storage_size(AUDIO_RESAMPLER_QUALITY);
+    *storage = kraken_malloc_ex(filter + AUDIO_RESAMPLE_CHUNK_FRAMES * AUDIO_FRAME_BYTES,
+                                KRAKEN_MEM_FAST);
+    if (!*storage) {
+        ESP_LOGW(TAG, "No memory for the resampler, %lu Hz plays at the wrong speed",
+                 (unsigned long)rate);
+        return NULL;
+    }
+    audio_resampler_init(rs, *storage, AUDIO_RESAMPLER_QUALITY, rate, out_rate);
+    g_audio.output_rate = out_rate;
+    ESP_LOGI(TAG, "Resampling %lu Hz to %lu Hz", (unsigned long)rate, (unsigned long)out_rate);
+    return (int16_t *)(*storage + filter);
+}
+
+// Picks the decoder from the first bytes of the stream. Returns ESP_OK once
+// it is open, with *skip set to the container header still to drop.
+static esp_err_t audio_dec_select(const uint8_t *in, size_t in_len, bool final, size_t *skip)
+{
+    audio_format_t fmt;
+    esp_err_t ret = audio_format_detect(g_audio.codec_hint, in, in_len, final, &fmt);
+    if (ret == ESP_ERR_NOT_FINISHED) {
+        return ret;
+    }
+    if (ret == ESP_OK) {
+        *skip = fmt.header_bytes;
+        if (fmt.codec == AUDIO_CODEC_NONE) {
+            return ESP_ERR_NOT_FINISHED;  // An ID3 tag: detect again after it
+        }
+        ret = audio_decoder_open(&fmt);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot play %s stream: %s", audio_format_codec_name(fmt.codec),
+                 esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Decode stage: in_ring -> format detection -> decoder -> ring. The input and
+// PCM frame buffers are allocated once per stream and reused for every frame.
+static void audio_dec_stream(void)
+{
+    uint8_t *in = kraken_malloc_ex(AUDIO_DEC_IN_SIZE, KRAKEN_MEM_FAST);
+    uint8_t *out = kraken_malloc_ex(AUDIO_DECODER_MAX_FRAME_BYTES, KRAKEN_MEM_FAST);
+    if (!in || !out) {
+        ESP_LOGE(TAG, "Decode stage not started");
+        kraken_free(in);
+        kraken_free(out);
+        return;
+    }
+
+    bool open = false;
+    uint32_t rate = 0;       // Decoded rate the chain is set up for
+    uint32_t gen = g_audio.format_gen;
+    audio_resampler_t rs;
+    uint8_t *rs_storage = NULL;
+    int16_t *rs_chunk = NULL;    // NULL: no resampler in the chain
+    g_audio.output_rate = 0;
+    g_audio.resample_us = 0;
+    g_audio.resampled_frames = 0;
+    size_t skip = 0;  // Container header bytes still to drop
+    size_t in_len = 0;
+    while (g_audio.is_playing && !g_audio.task_exit) {
+        // Top up: codecs need a whole frame in one contiguous buffer
+        bool eof = g_audio.in_eof;  // Before the read, so no final bytes are missed
+        size_t n = audio_ringbuf_read(&g_audio.in_ring, in + in_len, AUDIO_DEC_IN_SIZE - in_len);
+        in_len += n;
+        if (n && g_audio.net_waiting) {
+            audio_notify(&g_audio.net_task);
+        }
+        bool drained = eof && n == 0;
+
+        if (skip) {
+            size_t drop = skip < in_len ? skip : in_len;
+            memmove(in, in + drop, in_len - drop);
+            in_len -= drop;
+            skip -= drop;
+        }
+        if (skip || !open) {
+            esp_err_t ret = skip ? ESP_ERR_NOT_FINISHED :
+                            audio_dec_select(in, in_len, drained || in_len == AUDIO_DEC_IN_SIZE, &skip);
+            if (ret == ESP_OK) {
+                open = true;
                 continue;
             }
-            
-            // Test tone mode
-            if (buffer_count == 0) {
-                ESP_LOGI(TAG, "Generating %d Hz test tone at sample rate %d, volume %d%%", 
-                         TEST_TONE_FREQUENCY, I2S_SAMPLE_RATE, g_audio.volume);
+            if (ret != ESP_ERR_NOT_FINISHED || drained) {
+                break;  // Unplayable, or the stream ended first
+            }
+            if (n == 0 && (skip == 0 || in_len == 0)) {
+                audio_dec_wait();
             }
-            
-            // Generate sine wave test tone with volume control
-            // If volume is 0, skip generation and write silence
-            if (g_audio.volume == 0) {
-                memset(audio_buffer, 0, buffer_size * sizeof(int16_t));
-            } else {
-                // Use logarithmic volume curve for better perceived control
-                // Human hearing is logarithmic, so linear scaling sounds bad
-                float volume_scale = powf(g_audio.volume / 100.0f, 2.0f);  // Quadratic curve
-                
-                for (int i = 0; i < buffer_size / 2; i++) {  // Stereo, so /2 samples
-                    // Use 80% of full scale (26214 out of 32767) to avoid clipping
-                    int16_t sample = (int16_t)(sin(phase) * 26214.0f * volume_scale);
-                    audio_buffer[i * 2] = sample;      // Left channel
-                    audio_buffer[i * 2 + 1] = sample;  // Right channel
-                    phase += phase_increment;
-                    if (phase >= 2.0f * M_PI) {
-                        phase -= 2.0f * M_PI;
-                    }
-                }
+            continue;
+        }
+
+        size_t consumed = 0;
+        size_t out_len = 0;
+        esp_err_t ret = audio_decoder_decode(in, in_len, &consumed, out,
+                                             AUDIO_DECODER_MAX_FRAME_BYTES, &out_len);
+        memmove(in, in + consumed, in_len - consumed);
+        in_len -= consumed;
+
+        if (ret == ESP_ERR_NOT_FINISHED) {
+            if (drained) {
+                break;  // A trailing partial frame cannot be decoded
             }
-            
-            // Write to I2S
-            size_t bytes_written = 0;
-            esp_err_t ret = i2s_channel_write(g_audio.tx_handle, audio_buffer, 
-                                              buffer_size * sizeof(int16_t), 
-                                              &bytes_written, portMAX_DELAY);
-            if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "I2S write failed: %s", esp_err_to_name(ret));
-                buffer_count = 0;  // Reset on error
-            } else {
-                buffer_count++;
-                if (buffer_count == 1) {
-                    ESP_LOGI(TAG, "First I2S buffer written successfully (%d bytes)", bytes_written);
-                }
-                if (buffer_count % 100 == 0) {  // Log every 100 buffers (~2 seconds)
-                    ESP_LOGI(TAG, "Audio playing: %d buffers written, volume=%d%%, bytes_per_buffer=%d", 
-                             buffer_count, g_audio.volume, bytes_written);
-                }
+            if (in_len == AUDIO_DEC_IN_SIZE) {
+                ESP_LOGW(TAG, "No frame in %d bytes, dropping them", AUDIO_DEC_IN_SIZE);
+                in_len = 0;
             }
+            if (n == 0) {
+                audio_dec_wait();
+            }
+            continue;
+        }
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_RESPONSE) {
+            ESP_LOGE(TAG, "Stream cannot be decoded: %s", esp_err_to_name(ret));
+            break;
+        }
+        if (out_len == 0) {
+            continue;
+        }
+
+        // Codecs only know their rate once a frame is out
+        audio_decoder_stats_t st;
+        audio_decoder_get_stats(&st);
+        if (st.sample_rate != rate || gen != g_audio.format_gen) {
+            rate = st.sample_rate;
+            gen = g_audio.format_gen;
+            rs_chunk = audio_dec_resample_setup(&rs, &rs_storage, rate);
+        }
+        bool ok = rs_chunk ? audio_dec_resample_output(&rs, rs_chunk, out, out_len) :
+                             audio_dec_output(out, out_len);
+        if (!ok) {
+            break;
+        }
+    }
+
+    audio_decoder_close();
+    kraken_free(rs_storage);
+    kraken_free(in);
+    kraken_free(out);
+}
+
+// Decode task: runs each stream started by audio_net, then marks the PCM end
+static void audio_dec_task(void *arg)
+{
+    while (!g_audio.task_exit) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        if (!g_audio.dec_busy) {
+            continue;
+        }
+        audio_dec_stream();
+        audio_mixer_end(&g_audio.mixer, AUDIO_SOURCE_STREAM);
+        g_audio.dec_busy = false;
+        if (g_audio.net_waiting) {
+            audio_notify(&g_audio.net_task);  // Stop downloading if it ended early
+        }
+    }
+
+    xSemaphoreGive(g_audio.dec_task_done);
+    vTaskSuspend(NULL);
+}
+
+// The decoder stops with less than one frame of space left, so a mark above
+// that would never be reached
+static size_t audio_resume_mark(uint32_t ms)
+{
+    size_t mark = AUDIO_MS_TO_BYTES(ms, g_audio.out_fmt.sample_rate);
+    size_t max = g_audio.ring.size - AUDIO_DECODER_MAX_FRAME_BYTES;
+    return mark < max ? mark : max;
+}
+
+// Stream bookkeeping after a mix block, on audio_task: logs the buffering
+// transitions, wakes the decoder once there is room and ends playback when the
+// stream has drained. The mixer writes silence while the port (re)buffers, so
+// the DMA never replays stale data.
+static void audio_stream_check(audio_mixer_port_state_t before, uint32_t underruns_before)
+{
+    const audio_mixer_port_t *port = &g_audio.mixer.ports[AUDIO_SOURCE_STREAM];
+    if (before == AUDIO_MIXER_PORT_BUFFERING && port->state == AUDIO_MIXER_PORT_PLAYING) {
+        ESP_LOGI(TAG, "Buffered, playing (%u ms queued)",
+                 (unsigned)AUDIO_BYTES_TO_MS(audio_ringbuf_fill(&g_audio.ring), g_audio.out_fmt.sample_rate));
+    }
+    if (port->underruns != underruns_before) {
+        ESP_LOGW(TAG, "Buffer underrun (%lu), rebuffering", (unsigned long)port->underruns);
+    }
+    if (port->state == AUDIO_MIXER_PORT_DRAINED) {
+        ESP_LOGI(TAG, "HTTP stream finished");
+        g_audio.is_playing = false;
+    }
+    if (g_audio.dec_waiting && audio_ringbuf_space(&g_audio.ring) >= AUDIO_DECODER_MAX_FRAME_BYTES) {
+        audio_notify(&g_audio.dec_task);
+    }
+}
+
+// Points the PCM port at rate and channels. Data at a rate other than the
+// output's goes through a resampler, allocated the first time one is needed
+// and kept. On audio_task, which owns the port.
+static void audio_pcm_setup(uint32_t rate, uint8_t channels)
+{
+    if (rate != g_audio.out_fmt.sample_rate && !g_audio.pcm_rs_storage) {
+        g_audio.pcm_rs_storage = kraken_malloc_ex(audio_resampler_storage_size(AUDIO_RESAMPLER_QUALITY),
+                                                  KRAKEN_MEM_FAST);
+        if (!g_audio.pcm_rs_storage) {
+            ESP_LOGW(TAG, "No memory for the PCM resampler, %lu Hz plays at the wrong speed",
+                     (unsigned long)rate);
+        }
+    }
+    audio_mixer_set_format(&g_audio.mixer, AUDIO_SOURCE_PCM, rate, channels, g_audio.pcm_rs_storage,
+                           AUDIO_RESAMPLER_QUALITY);
+    g_audio.pcm_rate = rate;
+    g_audio.pcm_channels = channels;
+}
+
+// Applies an audio_set_pcm_format() request once the data queued in the old
+// format has played
+static void audio_pcm_update(void)
+{
+    taskENTER_CRITICAL(&s_format_lock);
+    uint32_t rate = g_audio.pcm_rate_req;
+    uint8_t channels = g_audio.pcm_channels_req;
+    taskEXIT_CRITICAL(&s_format_lock);
+    if (rate == g_audio.pcm_rate && channels == g_audio.pcm_channels) {
+        return;
+    }
+    if (audio_ringbuf_fill(&g_audio.pcm_ring) > 0) {
+        return;
+    }
+    audio_pcm_setup(rate, channels);
+    ESP_LOGI(TAG, "PCM source: %lu Hz, %s", (unsigned long)rate, channels == 1 ? "mono" : "stereo");
+}
+
+// Brings the mixer ports in line with what other tasks asked for: beeps,
+// play/stop, the mode and the PCM format. Runs on audio_task before each block.
+static void audio_sources_update(void)
+{
+    audio_pcm_update();
+
+    audio_synth_note_t note;
+    while (xQueueReceive(g_audio.beep_queue, &note, 0) == pdTRUE) {
+        if (audio_synth_start(&g_audio.synth, &note) < 0) {
+            ESP_LOGW(TAG, "Beep at %u Hz dropped: all voices busy or pitch out of range",
+                     (unsigned)note.freq_hz);
+        }
+    }
+
+    bool tone = g_audio.is_playing && g_audio.mode == AUDIO_MODE_TEST_TONE;
+    if (tone && g_audio.tone_voice < 0) {
+        audio_synth_note_t tone_note = {
+            .freq_hz = TEST_TONE_FREQUENCY,
+            .amplitude = TEST_TONE_AMPLITUDE,
+            .attack_ms = TEST_TONE_FADE_MS,
+            .release_ms = TEST_TONE_FADE_MS,
+        };
+        // Retried next block if beeps hold every voice
+        g_audio.tone_voice = audio_synth_start(&g_audio.synth, &tone_note);
+        if (g_audio.tone_voice >= 0) {
+            ESP_LOGI(TAG, "Generating %d Hz test tone at sample rate %d, volume %d%%",
+                     TEST_TONE_FREQUENCY, (int)g_audio.out_fmt.sample_rate, g_audio.volume);
+        }
+    } else if (!tone && g_audio.tone_voice >= 0) {
+        // Fades out; the output stays on until it has
+        audio_synth_release(&g_audio.synth, g_audio.tone_voice);
+        g_audio.tone_voice = -1;
+    }
+
+    bool stream = g_audio.is_playing && g_audio.mode == AUDIO_MODE_HTTP_STREAM;
+    // Until the previous stream has closed, the ring is not ours
+    if (stream && !g_audio.stream_active && !g_audio.net_busy && !g_audio.dec_busy) {
+        ESP_LOGI(TAG, "Starting HTTP stream from: %s", g_audio.url);
+        audio_ringbuf_reset(&g_audio.ring);
+        g_audio.bytes_in = 0;
+        g_audio.bytes_in_seen = 0;
+        g_audio.bytes_out = 0;
+        audio_mixer_start(&g_audio.mixer, AUDIO_SOURCE_STREAM);
+        g_audio.stream_rate = 0;
+        g_audio.rate_refused = 0;  // Each stream tries its own rate again
+        g_audio.stream_active = true;
+        g_audio.net_busy = true;
+        audio_notify(&g_audio.net_task);
+    } else if (!g_audio.is_playing && g_audio.stream_active) {
+        // audio_net sees is_playing drop and closes the connection
+        audio_mixer_stop(&g_audio.mixer, AUDIO_SOURCE_STREAM);
+        g_audio.stream_active = false;
+        g_audio.stream_rate = 0;  // Back to the base format
+    }
+}
+
+// The I2S channel (and its clocks) runs only while playing, so the CPU can drop
+// to the idle frequency and sleep when audio is stopped. Called from audio_task.
+// I2S ISR: hands each DMA buffer that has just gone out back to audio_task,
+// which mixes the next block into it. The driver has already zeroed it
+// (auto_clear_before_cb), so a block that is not mixed in time plays as
+// silence rather than as the previous audio. The ISR is not IRAM-safe
+// (CONFIG_I2S_ISR_IRAM_SAFE off), so it never runs with the cache disabled.
+static KRAKEN_IRAM_ATTR bool audio_dma_sent(i2s_chan_handle_t handle, i2s_event_data_t *event,
+                                            void *user_ctx)
+{
+    BaseType_t woken = pdFALSE;
+    audio_dma_block_t block = { .buf = event->dma_buf, .size = event->size };
+    xQueueSendFromISR(g_audio.dma_queue, &block, &woken);
+    return woken == pdTRUE;
+}
+
+// Clocks and slots for fmt, in Philips framing (MAX98357A). A mono output
+// sends the same sample in both slots from half the DMA data.
+static void audio_output_i2s_config(const audio_output_format_t *fmt, i2s_std_clk_config_t *clk,
+                                    i2s_std_slot_config_t *slot)
+{
+    i2s_std_clk_config_t clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(fmt->sample_rate);
+    i2s_std_slot_config_t slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(
+        fmt->bits == 32 ? I2S_DATA_BIT_WIDTH_32BIT : I2S_DATA_BIT_WIDTH_16BIT,
+        fmt->channels == 1 ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO);
+    slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
+    *clk = clk_cfg;
+    *slot = slot_cfg;
+}
+
+// The base format, at the stream's own rate while it plays at it
+static void audio_output_wanted(audio_output_format_t *fmt)
+{
+    *fmt = audio_base_format();
+    if (g_audio.stream_active && g_audio.stream_rate) {
+        fmt->sample_rate = g_audio.stream_rate;
+    }
+}
+
+// Moves the disabled channel to fmt; the DMA buffers are resized with the
+// slots. On failure the old format stays, and the request is dropped so it
+// is not retried every block: a stream's own rate is resampled instead, and
+// a refused base format is remembered, not overwritten, until the next
+// audio_set_output_format().
+static void audio_output_switch(const audio_output_format_t *fmt)
+{
+    i2s_std_clk_config_t clk;
+    i2s_std_slot_config_t slot;
+    audio_output_i2s_config(fmt, &clk, &slot);
+    esp_err_t ret = i2s_channel_reconfig_std_slot(g_audio.tx_handle, &slot);
+    if (ret == ESP_OK) {
+        ret = i2s_channel_reconfig_std_clock(g_audio.tx_handle, &clk);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot switch the output to %lu Hz: %s", (unsigned long)fmt->sample_rate,
+                 esp_err_to_name(ret));
+        audio_output_i2s_config(&g_audio.out_fmt, &clk, &slot);
+        i2s_channel_reconfig_std_slot(g_audio.tx_handle, &slot);
+        i2s_channel_reconfig_std_clock(g_audio.tx_handle, &clk);
+        taskENTER_CRITICAL(&s_format_lock);
+        if (g_audio.stream_active && g_audio.stream_rate == fmt->sample_rate) {
+            g_audio.rate_refused = fmt->sample_rate;
         } else {
-            // Not playing, just delay
-            vTaskDelay(pdMS_TO_TICKS(100));
-            phase = 0.0f;  // Reset phase when stopped
-            if (buffer_count > 0) {
-                ESP_LOGI(TAG, "Playback stopped. Total buffers written: %d", buffer_count);
-                buffer_count = 0;
+            g_audio.base_refused = g_audio.base_fmt;
+        }
+        g_audio.stream_rate = 0;
+        g_audio.format_gen++;  // The decoder resamples to the rate in force instead
+        taskEXIT_CRITICAL(&s_format_lock);
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_format_lock);
+    g_audio.out_fmt = *fmt;
+    taskEXIT_CRITICAL(&s_format_lock);
+    // Sources follow: the synth keeps its pitch, the stream its buffer time,
+    // and audio_write() data is resampled to the new rate if it is not at it
+    audio_synth_set_rate(&g_audio.synth, fmt->sample_rate);
+    audio_mixer_set_rate(&g_audio.mixer, fmt->sample_rate);
+    audio_pcm_setup(g_audio.pcm_rate, g_audio.pcm_channels);
+    audio_mixer_set_marks(&g_audio.mixer, AUDIO_SOURCE_STREAM,
+                          audio_resume_mark(CONFIG_KRAKEN_AUDIO_PREBUFFER_MS),
+                          audio_resume_mark(CONFIG_KRAKEN_AUDIO_LOW_WATER_MS));
+    ESP_LOGI(TAG, "Output: %lu Hz, %u-bit, %s", (unsigned long)fmt->sample_rate, fmt->bits,
+             fmt->channels == 1 ? "mono" : "stereo");
+}
+
+// The MAX98357A is on (SD high) only while the output runs and the volume is
+// above 0. On audio_task.
+static void audio_amp_set(bool on)
+{
+    if (g_audio.config->pin_sd >= 0 && on != g_audio.amp_on) {
+        gpio_set_level(g_audio.config->pin_sd, on);
+    }
+    g_audio.amp_on = on;
+}
+
+// The amplifier follows the output, so a beep while stopped is heard too.
+static void audio_output_start(void)
+{
+    xQueueReset(g_audio.dma_queue);  // Buffers from before the last stop
+    power_lock_acquire(g_audio.play_lock);
+    esp_err_t ret = i2s_channel_enable(g_audio.tx_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable I2S channel: %s", esp_err_to_name(ret));
+        power_lock_release(g_audio.play_lock);
+        g_audio.is_playing = false;
+        return;
+    }
+    audio_amp_set(g_audio.volume > 0);
+    g_audio.output_active = true;
+}
+
+static void audio_output_stop(void)
+{
+    audio_amp_set(false);
+    i2s_channel_disable(g_audio.tx_handle);
+    power_lock_release(g_audio.play_lock);
+    g_audio.output_active = false;
+}
+
+// Audio playback task: mixes all sources into the I2S DMA buffers while any
+// of them has something to play. No copy between the mix and the DMA. A
+// format switch fades out, plays silence through the DMA ring, reconfigures
+// the stopped channel and fades back in.
+static void audio_task(void *arg)
+{
+    uint32_t block_count = 0;
+    int idle_blocks = 0;  // Silent blocks queued since the output started draining
+    bool fade_in = false;
+    
+    ESP_LOGI(TAG, "Audio playback task started");
+    
+    while (!g_audio.task_exit) {
+        audio_sources_update();
+        audio_output_format_t want;
+        audio_output_wanted(&want);
+        bool reformat = !audio_output_same(&want, &g_audio.out_fmt);
+        bool busy = g_audio.is_playing || audio_synth_active(&g_audio.synth) ||
+                    audio_ringbuf_fill(&g_audio.pcm_ring) > 0;
+        bool draining = !busy || reformat;
+        if (!draining && idle_blocks) {
+            fade_in = true;  // Back from a fade-out that is no longer needed
+            idle_blocks = 0;
+        }
+
+        if (reformat && !g_audio.output_active) {
+            audio_output_switch(&want);
+        }
+        if (busy && !g_audio.output_active) {
+            audio_output_start();
+            fade_in = true;
+            idle_blocks = 0;
+        } else if (draining && g_audio.output_active && idle_blocks >= AUDIO_DMA_DESC_NUM) {
+            // Every DMA buffer now holds silence: the tail has played, and
+            // nothing stale plays at the next start
+            audio_output_stop();
+            continue;
+        }
+
+        if (!g_audio.output_active) {
+            // Idle: sleep until audio_play(), audio_beep() or audio_write() notifies
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            kraken_service_heartbeat(g_audio.watch);
+            if (block_count > 0) {
+                ESP_LOGI(TAG, "Playback stopped. Total buffers written: %lu", (unsigned long)block_count);
+                block_count = 0;
+            }
+            continue;
+        }
+
+        audio_amp_set(g_audio.volume > 0);  // Follows audio_set_volume()
+
+        audio_dma_block_t block;
+        if (xQueueReceive(g_audio.dma_queue, &block, pdMS_TO_TICKS(AUDIO_WRITE_TIMEOUT_MS)) != pdTRUE) {
+            // No heartbeat: if the output stays stuck the supervisor restarts us
+            ESP_LOGE(TAG, "I2S DMA stalled, no buffer back in %d ms", AUDIO_WRITE_TIMEOUT_MS);
+            continue;
+        }
+        // The buffer plays again once the others have; by the time they all
+        // have come back, this one is already going out
+        if (uxQueueMessagesWaiting(g_audio.dma_queue) >= AUDIO_DMA_DESC_NUM - 1) {
+            g_audio.mix_late++;
+        }
+
+        size_t frames = block.size / (g_audio.out_fmt.channels * (g_audio.out_fmt.bits / 8));
+        if (frames > AUDIO_MIXER_BLOCK_FRAMES) {
+            frames = AUDIO_MIXER_BLOCK_FRAMES;
+        }
+        const audio_mixer_port_t *stream = &g_audio.mixer.ports[AUDIO_SOURCE_STREAM];
+        audio_mixer_port_state_t stream_before = stream->state;
+        uint32_t underruns_before = stream->underruns;
+        if (reformat && idle_blocks > 0) {
+            // Faded out: the sources wait for the new format (the driver zeroed the buffer)
+            idle_blocks++;
+        } else {
+            int ramp = fade_in ? AUDIO_RAMP_IN : reformat ? AUDIO_RAMP_OUT : AUDIO_RAMP_NONE;
+            audio_mix_block(block.buf, frames, &g_audio.out_fmt, g_audio.volume, ramp);
+            fade_in = false;
+            if (draining) {
+                idle_blocks++;
+            }
+        }
+        if (g_audio.stream_active) {
+            audio_stream_check(stream_before, underruns_before);
+            g_audio.bytes_out += block.size;
+        }
+
+        // Stream silence only counts as progress while the network side is still delivering
+        bool stalled = g_audio.stream_active && stream->state == AUDIO_MIXER_PORT_BUFFERING &&
+                       g_audio.bytes_in == g_audio.bytes_in_seen;
+        if (!stalled) {
+            g_audio.bytes_in_seen = g_audio.bytes_in;
+            kraken_service_heartbeat(g_audio.watch);
+        }
+
+        block_count++;
+        if (block_count == 1) {
+            ESP_LOGI(TAG, "First block mixed into I2S DMA (%u bytes)", (unsigned)block.size);
+        }
+        if (block_count % 500 == 0) {  // Log every 500 buffers (~6 seconds at 44.1 kHz)
+            ESP_LOGI(TAG, "Audio playing: %lu buffers written, volume=%d%%, sources=0x%lx",
+                     (unsigned long)block_count, g_audio.volume, (unsigned long)g_audio.mix_active);
+        }
+    }
+
+    // Leave nothing held, then wait for deinit to delete us
+    if (g_audio.output_active) {
+        audio_output_stop();
+    }
+    xSemaphoreGive(g_audio.task_done);
+    vTaskSuspend(NULL);
+}
+
+// Deletes a task once it has left its loop, or at the deadline wherever it is.
+// False in the second case.
+static bool audio_join_task(TaskHandle_t *task, SemaphoreHandle_t done, TickType_t deadline)
+{
+    if (!*task) {
+        return true;
+    }
+    TickType_t now = xTaskGetTickCount();
+    TickType_t wait = (int32_t)(deadline - now) > 0 ? deadline - now : 0;
+    bool clean = xSemaphoreTake(done, wait) == pdTRUE;
+    kraken_task_delete(*task);
+    *task = NULL;
+    return clean;
+}
+
+// Ask the tasks to exit rather than deleting them mid-call: a task deleted
+// inside i2s_channel_write would leave the channel locked. All are signalled
+// first so their exits overlap.
+static void audio_stop_tasks(bool *play_clean, bool *stream_clean)
+{
+    // The tasks' waits time out, so they see the flag without audio_notify()
+    taskENTER_CRITICAL(&s_task_lock);
+    g_audio.task_exit = true;
+    taskEXIT_CRITICAL(&s_task_lock);
+    for (;;) {
+        taskENTER_CRITICAL(&s_task_lock);
+        bool pinned = g_audio.notifiers > 0;
+        taskEXIT_CRITICAL(&s_task_lock);
+        if (!pinned) {
+            break;
+        }
+        vTaskDelay(1);  // A notify in flight returns without blocking
+    }
+
+    TaskHandle_t tasks[] = { g_audio.audio_task, g_audio.net_task, g_audio.dec_task };
+    for (size_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++) {
+        if (tasks[i]) {
+            xTaskNotifyGive(tasks[i]);
+        }
+    }
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(AUDIO_TASK_EXIT_TIMEOUT_MS);
+    *play_clean = audio_join_task(&g_audio.audio_task, g_audio.task_done, deadline);
+    bool net_clean = audio_join_task(&g_audio.net_task, g_audio.net_task_done, deadline);
+    bool dec_clean = audio_join_task(&g_audio.dec_task, g_audio.dec_task_done, deadline);
+    *stream_clean = net_clean && dec_clean;
+}
+
+// Undo a partial init once the channel, power locks and rings may exist
+static void audio_release_init(void)
+{
+    kraken_free(g_audio.ring_storage);
+    kraken_free(g_audio.in_ring_storage);
+    kraken_free(g_audio.pcm_ring_storage);
+    kraken_free(g_audio.pcm_rs_storage);
+    g_audio.ring_storage = NULL;
+    g_audio.in_ring_storage = NULL;
+    g_audio.pcm_ring_storage = NULL;
+    g_audio.pcm_rs_storage = NULL;
+    power_lock_delete(g_audio.stream_lock);
+    power_lock_delete(g_audio.play_lock);
+    g_audio.stream_lock = NULL;
+    g_audio.play_lock = NULL;
+    i2s_del_channel(g_audio.tx_handle);
+    g_audio.tx_handle = NULL;
+}
+
+static esp_err_t audio_start_tasks(void)
+{
+    // Network reader: no flash writes and no timing needs, so its stack is in PSRAM
+    kraken_task_config_t net_cfg = {
+        .name = "audio_net",
+        .fn = audio_net_task,
+        .stack_size = CONFIG_KRAKEN_AUDIO_NET_TASK_STACK_SIZE,
+        .priority = 4,
+        .core = KRAKEN_TASK_CORE_ANY,
+        .kconfig = "CONFIG_KRAKEN_AUDIO_NET_TASK_STACK_SIZE",
+        .psram_stack = true,
+    };
+    // Decoder: CPU-bound, pinned away from the LVGL task (core 1)
+    kraken_task_config_t dec_cfg = {
+        .name = "audio_dec",
+        .fn = audio_dec_task,
+        .stack_size = CONFIG_KRAKEN_AUDIO_DECODE_TASK_STACK_SIZE,
+        .priority = 4,
+        .core = CONFIG_KRAKEN_AUDIO_DECODE_CORE,
+        .kconfig = "CONFIG_KRAKEN_AUDIO_DECODE_TASK_STACK_SIZE",
+    };
+    kraken_task_config_t play_cfg = {
+        .name = "audio_task",
+        .fn = audio_task,
+        .stack_size = CONFIG_KRAKEN_AUDIO_TASK_STACK_SIZE,
+        .priority = 5,
+        .core = KRAKEN_TASK_CORE_ANY,
+        .kconfig = "CONFIG_KRAKEN_AUDIO_TASK_STACK_SIZE",
+    };
+
+    void *handle = NULL;
+    if (kraken_task_create(&net_cfg, &handle) == ESP_OK) {
+        g_audio.net_task = handle;
+        if (kraken_task_create(&dec_cfg, &handle) == ESP_OK) {
+            g_audio.dec_task = handle;
+            if (kraken_task_create(&play_cfg, &handle) == ESP_OK) {
+                g_audio.audio_task = handle;
+                return ESP_OK;
             }
         }
     }
+
+    // The ones that started are idle and exit within one wait
+    ESP_LOGE(TAG, "Failed to create audio tasks");
+    bool play_clean, stream_clean;
+    audio_stop_tasks(&play_clean, &stream_clean);
+    return ESP_FAIL;
 }
 
 esp_err_t audio_service_init(void)
@@ -200,7 +1113,8 @@ esp_err_t audio_service_init(void)
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Configure shutdown pin (SD) - HIGH to enable, LOW to disable
+    // Configure shutdown pin (SD) - HIGH to enable, LOW to disable. Low until
+    // audio_task starts the output.
     if (g_audio.config->pin_sd >= 0) {
         gpio_config_t io_conf = {
             .pin_bit_mask = (1ULL << g_audio.config->pin_sd),
@@ -210,11 +1124,33 @@ esp_err_t audio_service_init(void)
             .intr_type = GPIO_INTR_DISABLE,
         };
         gpio_config(&io_conf);
-        gpio_set_level(g_audio.config->pin_sd, 1);  // Enable MAX98357A
+        gpio_set_level(g_audio.config->pin_sd, 0);
+    }
+    g_audio.amp_on = false;
+
+    // Filled by the I2S ISR from the first enable on
+    static StaticQueue_t s_dma_queue_buf;
+    static uint8_t s_dma_queue_storage[AUDIO_DMA_DESC_NUM * sizeof(audio_dma_block_t)];
+    if (!g_audio.dma_queue) {
+        g_audio.dma_queue = xQueueCreateStatic(AUDIO_DMA_DESC_NUM, sizeof(audio_dma_block_t),
+                                               s_dma_queue_storage, &s_dma_queue_buf);
     }
+    g_audio.out_fmt = (audio_output_format_t){
+        .sample_rate = I2S_SAMPLE_RATE,
+        .bits = I2S_BITS_PER_SAMPLE,
+        .channels = AUDIO_OUTPUT_CHANNELS,
+    };
+    g_audio.base_fmt = g_audio.out_fmt;
+    g_audio.base_refused = (audio_output_format_t){0};
+    g_audio.stream_rate = 0;
 
-    // Configure I2S channel
+    // Configure I2S channel: one mix block per DMA buffer. Nothing calls
+    // i2s_channel_write() during playback; the mixer fills each buffer after
+    // it has been sent, and the driver zeroes it first.
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(g_audio.config->port, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = AUDIO_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_DMA_FRAME_NUM;
+    chan_cfg.auto_clear_before_cb = true;
     ret = i2s_new_channel(&chan_cfg, &g_audio.tx_handle, NULL);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create I2S channel: %s", esp_err_to_name(ret));
@@ -224,8 +1160,6 @@ esp_err_t audio_service_init(void)
     // Configure I2S standard mode (for MAX98357A)
     // MAX98357A works with I2S Philips mode (standard I2S)
     i2s_std_config_t std_cfg = {
-        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(I2S_SAMPLE_RATE),
-        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
         .gpio_cfg = {
             .mclk = I2S_GPIO_UNUSED,  // MAX98357A doesn't need MCLK
             .bclk = g_audio.config->pin_bclk,
@@ -240,7 +1174,10 @@ esp_err_t audio_service_init(void)
         },
     };
     
-    ESP_LOGI(TAG, "Configuring I2S: Sample Rate=%d, 16-bit Stereo, Philips mode", I2S_SAMPLE_RATE);
+    audio_output_i2s_config(&g_audio.out_fmt, &std_cfg.clk_cfg, &std_cfg.slot_cfg);
+    
+    ESP_LOGI(TAG, "Configuring I2S: Sample Rate=%d, 16-bit %s, Philips mode", I2S_SAMPLE_RATE,
+             AUDIO_OUTPUT_CHANNELS == 1 ? "Mono" : "Stereo");
 
     ret = i2s_channel_init_std_mode(g_audio.tx_handle, &std_cfg);
     if (ret != ESP_OK) {
@@ -249,6 +1186,16 @@ esp_err_t audio_service_init(void)
         return ret;
     }
 
+    i2s_event_callbacks_t callbacks = {
+        .on_sent = audio_dma_sent,
+    };
+    ret = i2s_channel_register_event_callback(g_audio.tx_handle, &callbacks, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register I2S callback: %s", esp_err_to_name(ret));
+        i2s_del_channel(g_audio.tx_handle);
+        return ret;
+    }
+
     // Enable the I2S channel
     ret = i2s_channel_enable(g_audio.tx_handle);
     if (ret != ESP_OK) {
@@ -263,23 +1210,108 @@ esp_err_t audio_service_init(void)
     i2s_channel_write(g_audio.tx_handle, silence, sizeof(silence), &bytes_written, 100);
     ESP_LOGI(TAG, "I2S preloaded with %d bytes of silence", bytes_written);
 
-    g_audio.volume = 50;  // Default 50% volume
+    // Idle until the first play; audio_task enables the channel again
+    i2s_channel_disable(g_audio.tx_handle);
+
+    if (power_lock_create(POWER_LOCK_CPU_MAX, "audio_play", &g_audio.play_lock) != ESP_OK ||
+        power_lock_create(POWER_LOCK_NO_SLEEP, "audio_stream", &g_audio.stream_lock) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create power locks");
+        if (g_audio.play_lock) {
+            power_lock_delete(g_audio.play_lock);
+            g_audio.play_lock = NULL;
+        }
+        i2s_del_channel(g_audio.tx_handle);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Keep the volume from before a deep sleep or reset
+    audio_warm_state_t warm;
+    if (kraken_warm_load(AUDIO_WARM_KEY, &warm, sizeof(warm)) == ESP_OK && warm.volume <= 100) {
+        g_audio.volume = warm.volume;
+        ESP_LOGI(TAG, "Warm boot: volume %d%%", g_audio.volume);
+    } else {
+        g_audio.volume = AUDIO_DEFAULT_VOLUME;
+    }
     g_audio.is_playing = false;
     g_audio.mode = AUDIO_MODE_TEST_TONE;  // Default mode
+    audio_synth_init(&g_audio.synth, g_audio.out_fmt.sample_rate);
+    g_audio.tone_voice = -1;
     g_audio.url[0] = '\0';  // Empty URL initially
     g_audio.http_client = NULL;
+    g_audio.task_exit = false;
+
+    g_audio.stream_active = false;
+    g_audio.net_busy = false;
+    g_audio.dec_busy = false;
+    g_audio.overruns = 0;
+    g_audio.mix_us_total = 0;
+    g_audio.mix_us_max = 0;
+    g_audio.mix_blocks = 0;
+    g_audio.mix_active = 0;
+    g_audio.mix_late = 0;
+
+    static StaticSemaphore_t s_task_done_buf;
+    static StaticSemaphore_t s_net_task_done_buf;
+    static StaticSemaphore_t s_dec_task_done_buf;
+    static StaticSemaphore_t s_write_lock_buf;
+    static StaticQueue_t s_beep_queue_buf;
+    static uint8_t s_beep_queue_storage[AUDIO_BEEP_QUEUE_LEN * sizeof(audio_synth_note_t)];
+    if (!g_audio.task_done) {
+        g_audio.task_done = xSemaphoreCreateBinaryStatic(&s_task_done_buf);
+        g_audio.net_task_done = xSemaphoreCreateBinaryStatic(&s_net_task_done_buf);
+        g_audio.dec_task_done = xSemaphoreCreateBinaryStatic(&s_dec_task_done_buf);
+        g_audio.write_lock = xSemaphoreCreateMutexStatic(&s_write_lock_buf);
+        g_audio.beep_queue = xQueueCreateStatic(AUDIO_BEEP_QUEUE_LEN, sizeof(audio_synth_note_t),
+                                                s_beep_queue_storage, &s_beep_queue_buf);
+    }
+    xQueueReset(g_audio.beep_queue);
+
+    // The rings are large and touched once per byte each way, so PSRAM
+    size_t ring_size = (size_t)CONFIG_KRAKEN_AUDIO_RING_SIZE_KB * 1024;
+    g_audio.ring_storage = kraken_malloc_ex(ring_size, KRAKEN_MEM_LARGE);
+    g_audio.in_ring_storage = kraken_malloc_ex(AUDIO_IN_RING_SIZE, KRAKEN_MEM_LARGE);
+    g_audio.pcm_ring_storage = kraken_malloc_ex(AUDIO_PCM_RING_SIZE, KRAKEN_MEM_LARGE);
+    if (!g_audio.ring_storage || !g_audio.in_ring_storage || !g_audio.pcm_ring_storage) {
+        ESP_LOGE(TAG, "Failed to allocate %u KB stream buffers",
+                 (unsigned)((ring_size + AUDIO_IN_RING_SIZE + AUDIO_PCM_RING_SIZE) / 1024));
+        audio_release_init();
+        return ESP_ERR_NO_MEM;
+    }
+    ring_size = audio_ringbuf_init(&g_audio.ring, g_audio.ring_storage, ring_size);
+    audio_ringbuf_init(&g_audio.in_ring, g_audio.in_ring_storage, AUDIO_IN_RING_SIZE);
+    audio_ringbuf_init(&g_audio.pcm_ring, g_audio.pcm_ring_storage, AUDIO_PCM_RING_SIZE);
+
+    // The stream prebuffers and rebuffers; the PCM source plays whatever has
+    // been written, and is always on
+    audio_mixer_init(&g_audio.mixer);
+    audio_mixer_attach_ring(&g_audio.mixer, AUDIO_SOURCE_STREAM, &g_audio.ring, 2,
+                            audio_resume_mark(CONFIG_KRAKEN_AUDIO_PREBUFFER_MS),
+                            audio_resume_mark(CONFIG_KRAKEN_AUDIO_LOW_WATER_MS));
+    audio_mixer_attach_render(&g_audio.mixer, AUDIO_SOURCE_TONE, audio_render_synth, &g_audio.synth);
+    audio_mixer_attach_ring(&g_audio.mixer, AUDIO_SOURCE_PCM, &g_audio.pcm_ring, 2, 0, 0);
+    audio_mixer_set_rate(&g_audio.mixer, g_audio.out_fmt.sample_rate);
+    // audio_write() data is 16-bit stereo at the starting rate until
+    // audio_set_pcm_format() says otherwise
+    g_audio.pcm_rate_req = g_audio.out_fmt.sample_rate;
+    g_audio.pcm_channels_req = 2;
+    audio_pcm_setup(g_audio.pcm_rate_req, g_audio.pcm_channels_req);
+    audio_mixer_start(&g_audio.mixer, AUDIO_SOURCE_TONE);
+    audio_mixer_start(&g_audio.mixer, AUDIO_SOURCE_PCM);
     
     // IMPORTANT: Set initialized flag BEFORE creating task!
     g_audio.initialized = true;
 
-    // Create audio playback task
-    BaseType_t task_ret = xTaskCreate(audio_task, "audio_task", 8192, NULL, 5, &g_audio.audio_task);
-    if (task_ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create audio task");
+    ret = audio_start_tasks();
+    if (ret != ESP_OK) {
         g_audio.initialized = false;
-        i2s_channel_disable(g_audio.tx_handle);
-        i2s_del_channel(g_audio.tx_handle);
-        return ESP_FAIL;
+        audio_release_init();
+        return ret;
+    }
+
+    // Supervised: a hung audio_task gets this service restarted (called from
+    // init, so the service name comes from the kernel's context)
+    if (kraken_service_watch(NULL, AUDIO_HEARTBEAT_TIMEOUT_MS, &g_audio.watch) != ESP_OK) {
+        ESP_LOGW(TAG, "Audio task not supervised");
     }
 
     ESP_LOGI(TAG, "MAX98357A I2S audio initialized (from BSP config)");
@@ -287,6 +1319,9 @@ esp_err_t audio_service_init(void)
              g_audio.config->pin_bclk, g_audio.config->pin_lrclk, 
              g_audio.config->pin_dout, g_audio.config->pin_sd);
     ESP_LOGI(TAG, "Test tone: %d Hz", TEST_TONE_FREQUENCY);
+    ESP_LOGI(TAG, "Stream buffer: %u KB (%u ms), prebuffer %d ms, low-water %d ms",
+             (unsigned)(ring_size / 1024), (unsigned)AUDIO_BYTES_TO_MS(ring_size, I2S_SAMPLE_RATE),
+             CONFIG_KRAKEN_AUDIO_PREBUFFER_MS, CONFIG_KRAKEN_AUDIO_LOW_WATER_MS);
     
     return ESP_OK;
 }
@@ -298,25 +1333,62 @@ esp_err_t audio_service_deinit(void)
     }
 
     audio_stop();
-    
-    // Delete audio task
-    if (g_audio.audio_task) {
-        vTaskDelete(g_audio.audio_task);
-        g_audio.audio_task = NULL;
+    // API calls fail from here on; one already past its check finds the tasks
+    // gone through audio_notify()
+    g_audio.initialized = false;
+
+    bool clean_exit;
+    bool net_clean_exit;
+    audio_stop_tasks(&clean_exit, &net_clean_exit);
+
+    if (clean_exit) {
+        if (g_audio.tx_handle) {
+            i2s_del_channel(g_audio.tx_handle);
+        }
+    } else {
+        // Stuck inside the driver: the channel cannot be disabled safely, so it is
+        // abandoned and a restart will fail to claim the port until reboot
+        ESP_LOGE(TAG, "Audio task did not exit, I2S channel abandoned");
+        if (g_audio.output_active) {
+            power_lock_release(g_audio.play_lock);
+            g_audio.output_active = false;
+        }
     }
-    
-    if (g_audio.tx_handle) {
-        i2s_channel_disable(g_audio.tx_handle);
-        i2s_del_channel(g_audio.tx_handle);
-        g_audio.tx_handle = NULL;
+    g_audio.tx_handle = NULL;
+
+    if (net_clean_exit) {
+        kraken_free(g_audio.ring_storage);
+        kraken_free(g_audio.in_ring_storage);
+    }
+    if (clean_exit) {
+        // A writer gives up within AUDIO_WRITE_TIMEOUT_MS; none starts once it is freed
+        xSemaphoreTake(g_audio.write_lock, portMAX_DELAY);
+        kraken_free(g_audio.pcm_ring_storage);
+        kraken_free(g_audio.pcm_rs_storage);
+        g_audio.pcm_ring_storage = NULL;
+        g_audio.pcm_rs_storage = NULL;
+        xSemaphoreGive(g_audio.write_lock);
+    } else {
+        // Deleted inside the HTTP client or decoder: their buffers, which may
+        // still point into the rings, are lost
+        ESP_LOGE(TAG, "Audio stream tasks did not exit, HTTP client abandoned");
+        if (g_audio.http_client) {
+            power_lock_release(g_audio.stream_lock);
+            g_audio.http_client = NULL;
+        }
     }
+    g_audio.ring_storage = NULL;
+    g_audio.in_ring_storage = NULL;
+    power_lock_delete(g_audio.stream_lock);
+    power_lock_delete(g_audio.play_lock);
+    g_audio.stream_lock = NULL;
+    g_audio.play_lock = NULL;
 
     // Shutdown MAX98357A
     if (g_audio.config && g_audio.config->pin_sd >= 0) {
         gpio_set_level(g_audio.config->pin_sd, 0);
     }
 
-    g_audio.initialized = false;
     ESP_LOGI(TAG, "Audio service deinitialized");
     
     return ESP_OK;
@@ -329,18 +1401,15 @@ esp_err_t audio_set_volume(uint8_t volume)
     }
     
     g_audio.volume = volume;
+    audio_warm_state_t warm = { .volume = volume };
+    kraken_warm_save(AUDIO_WARM_KEY, &warm, sizeof(warm));
     
-    // MAX98357A volume control via SD (shutdown) pin
-    // SD pin LOW = mute, SD pin HIGH = unmute
-    // When volume is 0, we mute the amplifier
-    if (g_audio.config && g_audio.config->pin_sd >= 0) {
-        if (volume == 0) {
-            gpio_set_level(g_audio.config->pin_sd, 0);  // Mute
-            ESP_LOGI(TAG, "Volume set to 0%% (MUTED via SD pin)");
-        } else {
-            gpio_set_level(g_audio.config->pin_sd, 1);  // Unmute
-            ESP_LOGI(TAG, "Volume set to %d%% (software scaling)", volume);
-        }
+    // audio_task mutes the MAX98357A (SD pin low) at 0 from the next block.
+    // While the output is stopped the pin stays low whatever the volume.
+    if (g_audio.config && g_audio.config->pin_sd >= 0 && volume == 0) {
+        ESP_LOGI(TAG, "Volume set to 0%% (muted via SD pin)");
+    } else if (g_audio.config && g_audio.config->pin_sd >= 0) {
+        ESP_LOGI(TAG, "Volume set to %d%% (software scaling)", volume);
     } else {
         ESP_LOGI(TAG, "Volume set to %d%% (software scaling only)", volume);
     }
@@ -359,12 +1428,9 @@ esp_err_t audio_play(void)
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Enable MAX98357A
-    if (g_audio.config && g_audio.config->pin_sd >= 0) {
-        gpio_set_level(g_audio.config->pin_sd, 1);
-        ESP_LOGI(TAG, "SD pin (GPIO %d) set HIGH", g_audio.config->pin_sd);
-    }
+    // audio_task enables the MAX98357A (SD pin) with the output
     g_audio.is_playing = true;
+    audio_notify(&g_audio.audio_task);
     
     ESP_LOGI(TAG, "Audio playback started (volume=%d%%)", g_audio.volume);
     return ESP_OK;
@@ -376,11 +1442,10 @@ esp_err_t audio_pause(void)
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Mute MAX98357A (SD pin LOW)
-    if (g_audio.config && g_audio.config->pin_sd >= 0) {
-        gpio_set_level(g_audio.config->pin_sd, 0);
-    }
+    // The tone fades out; the SD pin drops when the output stops, unless a
+    // beep or audio_write() still plays
     g_audio.is_playing = false;
+    audio_notify(&g_audio.audio_task);
     
     ESP_LOGI(TAG, "Audio playback paused");
     return ESP_OK;
@@ -392,11 +1457,9 @@ esp_err_t audio_stop(void)
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Mute MAX98357A
-    if (g_audio.config && g_audio.config->pin_sd >= 0) {
-        gpio_set_level(g_audio.config->pin_sd, 0);
-    }
+    // Like pause: the MAX98357A is muted when the output stops
     g_audio.is_playing = false;
+    audio_notify(&g_audio.audio_task);
     
     ESP_LOGI(TAG, "Audio playback stopped");
     return ESP_OK;
@@ -407,6 +1470,150 @@ bool audio_is_playing(void)
     return g_audio.is_playing;
 }
 
+esp_err_t audio_get_decoder_stats(audio_decoder_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;  // No base format to measure the load against
+    }
+    audio_decoder_get_stats(stats);
+    stats->output_rate = g_audio.output_rate;
+    // Load relative to the audio it produced, like the decoder's; the
+    // resampler only ever converts to the base rate
+    uint64_t audio_us = g_audio.resampled_frames * 1000000 / audio_base_format().sample_rate;
+    stats->resample_load_pct = audio_us ? (uint32_t)(g_audio.resample_us * 100 / audio_us) : 0;
+    return ESP_OK;
+}
+
+esp_err_t audio_get_buffer_stats(audio_buffer_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Counters have a single writer each; a snapshot may mix adjacent updates
+    stats->capacity = g_audio.ring.size;
+    stats->fill_bytes = audio_ringbuf_fill(&g_audio.ring);
+    stats->fill_ms = AUDIO_BYTES_TO_MS(stats->fill_bytes, g_audio.out_fmt.sample_rate);
+    stats->underruns = g_audio.mixer.ports[AUDIO_SOURCE_STREAM].underruns;
+    stats->overruns = g_audio.overruns;
+    stats->bytes_in = g_audio.bytes_in;
+    stats->bytes_out = g_audio.bytes_out;
+    stats->buffering = g_audio.stream_active &&
+                       g_audio.mixer.ports[AUDIO_SOURCE_STREAM].state == AUDIO_MIXER_PORT_BUFFERING;
+    return ESP_OK;
+}
+
+esp_err_t audio_get_mixer_stats(audio_mixer_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Written by audio_task only; a snapshot may mix adjacent blocks
+    uint32_t blocks = g_audio.mix_blocks;
+    uint32_t frames = g_audio.mix_frames ? g_audio.mix_frames : AUDIO_MIXER_BLOCK_FRAMES;
+    stats->block_frames = frames;
+    stats->blocks = blocks;
+    stats->mix_us_avg = blocks ? (uint32_t)(g_audio.mix_us_total / blocks) : 0;
+    stats->mix_us_max = g_audio.mix_us_max;
+    uint32_t block_us = (uint32_t)((uint64_t)frames * 1000000 / g_audio.out_fmt.sample_rate);
+    stats->load_pct = stats->mix_us_avg * 100 / block_us;
+    stats->active = g_audio.mix_active;
+    stats->late = g_audio.mix_late;
+    for (int i = 0; i < AUDIO_SOURCE_COUNT; i++) {
+        stats->underruns[i] = g_audio.mixer.ports[i].underruns;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_set_source_volume(audio_source_t source, uint8_t volume)
+{
+    if (source >= AUDIO_SOURCE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    audio_mixer_set_gain(&g_audio.mixer, source, audio_gain_from_volume(volume));
+    ESP_LOGI(TAG, "Source %d volume set to %d%%", source, volume > 100 ? 100 : volume);
+    return ESP_OK;
+}
+
+esp_err_t audio_set_output_format(const audio_output_format_t *fmt)
+{
+    if (!fmt || fmt->sample_rate < AUDIO_OUTPUT_RATE_MIN || fmt->sample_rate > AUDIO_OUTPUT_RATE_MAX ||
+        (fmt->channels != 1 && fmt->channels != 2)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fmt->bits != 16 && fmt->bits != 32) {
+        return ESP_ERR_NOT_SUPPORTED;  // 24-bit DACs take the 32-bit slot
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // audio_task owns the channel: it fades out and switches
+    taskENTER_CRITICAL(&s_format_lock);
+    g_audio.base_fmt = *fmt;
+    g_audio.base_refused = (audio_output_format_t){0};  // Tried afresh
+    g_audio.format_gen++;  // A resampling stream converts to the new rate
+    taskEXIT_CRITICAL(&s_format_lock);
+    ESP_LOGI(TAG, "Output format set to %lu Hz, %u-bit, %s", (unsigned long)fmt->sample_rate,
+             fmt->bits, fmt->channels == 1 ? "mono" : "stereo");
+    audio_notify(&g_audio.audio_task);
+    return ESP_OK;
+}
+
+esp_err_t audio_get_output_format(audio_output_format_t *fmt)
+{
+    if (!fmt) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    taskENTER_CRITICAL(&s_format_lock);
+    *fmt = g_audio.out_fmt;
+    taskEXIT_CRITICAL(&s_format_lock);
+    return ESP_OK;
+}
+
+esp_err_t audio_beep(uint16_t freq_hz, uint16_t duration_ms)
+{
+    if (!g_audio.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (freq_hz == 0 || duration_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    audio_synth_note_t note = {
+        .freq_hz = freq_hz,
+        .amplitude = AUDIO_BEEP_AMPLITUDE,
+        .attack_ms = AUDIO_BEEP_FADE_MS,
+        .duration_ms = duration_ms,
+        .release_ms = AUDIO_BEEP_FADE_MS,
+    };
+    // The synth is not thread-safe: audio_task starts the note
+    if (xQueueSend(g_audio.beep_queue, &note, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Beep queue full");
+        return ESP_ERR_NO_MEM;
+    }
+    audio_notify(&g_audio.audio_task);
+    return ESP_OK;
+}
+
 esp_err_t audio_set_mode(audio_mode_t mode)
 {
     if (!g_audio.initialized) {
@@ -438,17 +1645,75 @@ esp_err_t audio_write(const uint8_t *data, size_t len)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (!g_audio.is_playing) {
-        return ESP_ERR_INVALID_STATE;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(AUDIO_WRITE_TIMEOUT_MS);
+    if (xSemaphoreTake(g_audio.write_lock, timeout) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (!g_audio.pcm_ring_storage) {
+        xSemaphoreGive(g_audio.write_lock);
+        return ESP_ERR_INVALID_STATE;  // Deinit under way
     }
 
-    size_t bytes_written = 0;
-    esp_err_t ret = i2s_channel_write(g_audio.tx_handle, data, len, &bytes_written, portMAX_DELAY);
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2S write failed: %s", esp_err_to_name(ret));
-        return ret;
+    // The mixer drains the ring one block (~12 ms) at a time
+    while (len) {
+        size_t n = audio_ringbuf_write(&g_audio.pcm_ring, data, len);
+        data += n;
+        len -= n;
+        if (n && !g_audio.output_active) {
+            audio_notify(&g_audio.audio_task);
+        }
+        if (len) {
+            if (xTaskGetTickCount() - start >= timeout) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(5));
+        }
     }
+    xSemaphoreGive(g_audio.write_lock);
 
+    if (len) {
+        // A stalled I2S DMA stops the mixer, so the ring stays full
+        ESP_LOGE(TAG, "PCM write timed out, %u bytes not queued", (unsigned)len);
+        return ESP_ERR_TIMEOUT;
+    }
     return ESP_OK;
 }
+
+esp_err_t audio_set_pcm_format(uint32_t sample_rate, uint8_t channels)
+{
+    if (!g_audio.initialized || sample_rate < AUDIO_OUTPUT_RATE_MIN ||
+        sample_rate > AUDIO_OUTPUT_RATE_MAX || (channels != 1 && channels != 2)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Held throughout, so no audio_write() lands between the old format's
+    // data and the switch
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(AUDIO_WRITE_TIMEOUT_MS);
+    if (xSemaphoreTake(g_audio.write_lock, timeout) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (!g_audio.pcm_ring_storage) {
+        xSemaphoreGive(g_audio.write_lock);
+        return ESP_ERR_INVALID_STATE;  // Deinit under way
+    }
+    taskENTER_CRITICAL(&s_format_lock);
+    g_audio.pcm_rate_req = sample_rate;
+    g_audio.pcm_channels_req = channels;
+    taskEXIT_CRITICAL(&s_format_lock);
+    audio_notify(&g_audio.audio_task);
+
+    // audio_task switches once the queued data has played
+    esp_err_t ret = ESP_OK;
+    while (g_audio.pcm_rate != sample_rate || g_audio.pcm_channels != channels) {
+        if (xTaskGetTickCount() - start >= timeout) {
+            ESP_LOGE(TAG, "PCM format switch timed out, old data still queued");
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    xSemaphoreGive(g_audio.write_lock);
+    return ret;
+}
@@ -0,0 +1,213 @@
+#include "audio_synth.h"
+#include "audio_gain.h"
+#include "kraken/kernel.h"
+#include <string.h>
+
+#define SYNTH_LEVEL_FULL (1 << 30)
+
+enum {
+    SYNTH_OFF = 0,
+    SYNTH_ATTACK,
+    SYNTH_HOLD,
+    SYNTH_RELEASE,
+};
+
+// round(32767 * sin(2 pi i / 256)); entry 256 repeats entry 0 so the
+// interpolation never wraps
+static const int16_t s_sine[257] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739,
+    9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+    25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+    32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+    32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571, 30273, 29956, 29621, 29268,
+    28898, 28510, 28105, 27683, 27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+    23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151,
+    15446, 14732, 14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+    6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804, -1608, -2410,
+    -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+    -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+    -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+    -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+    -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+    -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285, -32137, -31971, -31785, -31580,
+    -31356, -31113, -30852, -30571, -30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+    -27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403,
+    -20787, -20159, -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+    -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179, -6393, -5602, -4808, -4011,
+    -3212, -2410, -1608, -804, 0,
+};
+
+static uint32_t audio_synth_frames(const audio_synth_t *synth, uint32_t ms)
+{
+    return (uint32_t)((uint64_t)ms * synth->sample_rate / 1000);
+}
+
+void audio_synth_init(audio_synth_t *synth, uint32_t sample_rate)
+{
+    memset(synth, 0, sizeof(*synth));
+    synth->sample_rate = sample_rate;
+}
+
+// A frame count at another rate; a count that was not 0 stays at least 1
+static uint32_t audio_synth_rescale(uint32_t frames, uint32_t from, uint32_t to)
+{
+    uint32_t scaled = (uint32_t)((uint64_t)frames * to / from);
+    return (frames && !scaled) ? 1 : scaled;
+}
+
+static void audio_synth_enter(audio_synth_voice_t *v, int stage)
+{
+    v->stage = (uint8_t)stage;
+    switch (stage) {
+        case SYNTH_ATTACK:
+            v->level = 0;
+            v->step = SYNTH_LEVEL_FULL / (int32_t)v->remaining;
+            break;
+        case SYNTH_HOLD:
+            v->level = SYNTH_LEVEL_FULL;
+            v->step = 0;
+            v->remaining = v->hold_frames;
+            break;
+        case SYNTH_RELEASE:
+            v->remaining = v->release_frames;
+            v->step = -(v->level / (int32_t)v->remaining);
+            break;
+        default:
+            v->level = 0;
+            v->step = 0;
+            break;
+    }
+}
+
+// Called when the current stage has run out
+static void audio_synth_advance(audio_synth_voice_t *v)
+{
+    if (v->stage == SYNTH_ATTACK) {
+        audio_synth_enter(v, SYNTH_HOLD);
+    } else if (v->stage == SYNTH_HOLD && v->release_frames) {
+        audio_synth_enter(v, SYNTH_RELEASE);
+    } else {
+        audio_synth_enter(v, SYNTH_OFF);
+    }
+}
+
+void audio_synth_set_rate(audio_synth_t *synth, uint32_t sample_rate)
+{
+    uint32_t old = synth->sample_rate;
+    synth->sample_rate = sample_rate;
+    if (old == sample_rate || old == 0) {
+        return;
+    }
+
+    for (int i = 0; i < AUDIO_SYNTH_MAX_VOICES; i++) {
+        audio_synth_voice_t *v = &synth->voices[i];
+        if (v->stage == SYNTH_OFF) {
+            continue;
+        }
+        uint64_t inc = (uint64_t)v->phase_inc * old / sample_rate;
+        if (inc >= (1ULL << 31)) {
+            audio_synth_enter(v, SYNTH_OFF);
+            continue;
+        }
+        v->phase_inc = (uint32_t)inc;
+        v->remaining = audio_synth_rescale(v->remaining, old, sample_rate);
+        v->hold_frames = audio_synth_rescale(v->hold_frames, old, sample_rate);
+        v->release_frames = audio_synth_rescale(v->release_frames, old, sample_rate);
+        // Same ramp end point, reached over the rescaled time
+        if (v->stage == SYNTH_ATTACK) {
+            v->step = (SYNTH_LEVEL_FULL - v->level) / (int32_t)v->remaining;
+        } else if (v->stage == SYNTH_RELEASE) {
+            v->step = -(v->level / (int32_t)v->remaining);
+        }
+    }
+}
+
+int audio_synth_start(audio_synth_t *synth, const audio_synth_note_t *note)
+{
+    if (note->freq_hz <= 0.0f || note->freq_hz >= synth->sample_rate / 2.0f) {
+        return -1;
+    }
+
+    for (int i = 0; i < AUDIO_SYNTH_MAX_VOICES; i++) {
+        audio_synth_voice_t *v = &synth->voices[i];
+        if (v->stage != SYNTH_OFF) {
+            continue;
+        }
+        memset(v, 0, sizeof(*v));
+        v->phase_inc = (uint32_t)((double)note->freq_hz / synth->sample_rate * 4294967296.0);
+        v->amplitude = note->amplitude;
+        v->hold_frames = audio_synth_frames(synth, note->duration_ms);
+        if (note->duration_ms && v->hold_frames == 0) {
+            v->hold_frames = 1;  // Shorter than a frame, but not "sustain"
+        }
+        v->release_frames = audio_synth_frames(synth, note->release_ms);
+        v->remaining = audio_synth_frames(synth, note->attack_ms);
+        audio_synth_enter(v, v->remaining ? SYNTH_ATTACK : SYNTH_HOLD);
+        return i;
+    }
+    return -1;
+}
+
+void audio_synth_release(audio_synth_t *synth, int voice)
+{
+    if (voice < 0 || voice >= AUDIO_SYNTH_MAX_VOICES) {
+        return;
+    }
+    audio_synth_voice_t *v = &synth->voices[voice];
+    if (v->stage == SYNTH_OFF || v->stage == SYNTH_RELEASE) {
+        return;
+    }
+    audio_synth_enter(v, v->release_frames ? SYNTH_RELEASE : SYNTH_OFF);
+}
+
+void audio_synth_stop_all(audio_synth_t *synth)
+{
+    for (int i = 0; i < AUDIO_SYNTH_MAX_VOICES; i++) {
+        audio_synth_enter(&synth->voices[i], SYNTH_OFF);
+    }
+}
+
+bool audio_synth_active(const audio_synth_t *synth)
+{
+    for (int i = 0; i < AUDIO_SYNTH_MAX_VOICES; i++) {
+        if (synth->voices[i].stage != SYNTH_OFF) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Adds one voice into out. Top 8 phase bits pick the table entry, the next 16
+// interpolate to the following one.
+static KRAKEN_IRAM_ATTR void audio_synth_render_voice(audio_synth_voice_t *v, int16_t *out,
+                                                      size_t frames)
+{
+    for (size_t i = 0; i < frames && v->stage != SYNTH_OFF; i++) {
+        uint32_t idx = v->phase >> 24;
+        int32_t frac = (int32_t)((v->phase >> 8) & 0xFFFF);
+        int32_t a = s_sine[idx];
+        int32_t s = a + (((s_sine[idx + 1] - a) * frac) >> 16);
+        v->phase += v->phase_inc;
+
+        int32_t sample = ((s * v->amplitude) >> 15) * (v->level >> 15) >> 15;
+        out[2 * i] = audio_gain_saturate(out[2 * i] + sample);
+        out[2 * i + 1] = audio_gain_saturate(out[2 * i + 1] + sample);
+
+        v->level += v->step;
+        if (v->remaining && --v->remaining == 0) {
+            audio_synth_advance(v);
+        }
+    }
+}
+
+KRAKEN_IRAM_ATTR void audio_synth_render(audio_synth_t *synth, int16_t *out, size_t frames)
+{
+    memset(out, 0, frames * 2 * sizeof(int16_t));
+    for (int i = 0; i < AUDIO_SYNTH_MAX_VOICES; i++) {
+        if (synth->voices[i].stage != SYNTH_OFF) {
+            audio_synth_render_voice(&synth->voices[i], out, frames);
+        }
+    }
+}
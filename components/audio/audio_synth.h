@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Small sine synth for the test tone and UI beeps: a 32-bit phase accumulator
+// per voice, a 256-entry sine table with linear interpolation (at full scale,
+// 4.5 LSB worst-case error and 81 dB SNR) and a linear attack/hold/release
+// envelope. Fixed point throughout.
+#define AUDIO_SYNTH_MAX_VOICES 4
+
+typedef struct {
+    float freq_hz;           // Converted once at start, any value below Nyquist
+    uint16_t amplitude;      // Q15 peak, 32767 = full scale
+    uint16_t attack_ms;      // 0: start at full level
+    uint32_t duration_ms;    // Time at full level; 0 sustains until released
+    uint16_t release_ms;     // Fade to silence at the end; 0 cuts (may click)
+} audio_synth_note_t;
+
+typedef struct {
+    uint8_t stage;           // Envelope stage, 0 = free
+    uint32_t phase;          // One turn = 2^32
+    uint32_t phase_inc;
+    int32_t amplitude;
+    int32_t level;           // Envelope, Q30
+    int32_t step;            // Per frame
+    uint32_t remaining;      // Frames left in this stage; 0 in hold = sustain
+    uint32_t hold_frames;
+    uint32_t release_frames;
+} audio_synth_voice_t;
+
+typedef struct {
+    uint32_t sample_rate;
+    audio_synth_voice_t voices[AUDIO_SYNTH_MAX_VOICES];
+} audio_synth_t;
+
+// Not thread-safe: one task starts notes and renders (or the caller locks)
+void audio_synth_init(audio_synth_t *synth, uint32_t sample_rate);
+
+// For an output that changed rate: voices keep their pitch and the time left
+// in their envelopes; any now above Nyquist stop
+void audio_synth_set_rate(audio_synth_t *synth, uint32_t sample_rate);
+
+// Returns the voice used, or -1 if all are busy
+int audio_synth_start(audio_synth_t *synth, const audio_synth_note_t *note);
+// Moves a voice to its release stage
+void audio_synth_release(audio_synth_t *synth, int voice);
+// Silences everything at once
+void audio_synth_stop_all(audio_synth_t *synth);
+bool audio_synth_active(const audio_synth_t *synth);
+
+// Overwrites frames of interleaved stereo with the sum of all voices, saturated
+void audio_synth_render(audio_synth_t *synth, int16_t *out, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -14,6 +15,76 @@ typedef enum {
     AUDIO_MODE_HTTP_STREAM,  // Stream from HTTP URL
 } audio_mode_t;
 
+// Inputs of the mixer. All play at once, summed into the one I2S output.
+typedef enum {
+    AUDIO_SOURCE_STREAM = 0, // HTTP stream (AUDIO_MODE_HTTP_STREAM)
+    AUDIO_SOURCE_TONE,       // Test tone (AUDIO_MODE_TEST_TONE) and audio_beep()
+    AUDIO_SOURCE_PCM,        // audio_write()
+    AUDIO_SOURCE_COUNT,
+} audio_source_t;
+
+// Stream codec, chosen per stream by the network reader
+typedef enum {
+    AUDIO_CODEC_NONE = 0,    // No stream yet
+    AUDIO_CODEC_PCM,         // Raw or WAV PCM, converted to 16-bit stereo
+    AUDIO_CODEC_MP3,
+    AUDIO_CODEC_AAC,         // AAC-LC / HE-AAC in ADTS frames
+    AUDIO_CODEC_FLAC,        // Detected, not decoded: the stream is stopped
+    AUDIO_CODEC_OGG,         // Vorbis/Opus in Ogg; detected, not decoded
+} audio_codec_t;
+
+// Decode stage of the current or last stream (audio_get_decoder_stats)
+typedef struct {
+    audio_codec_t codec;
+    uint32_t sample_rate;    // 0 until the first frame is decoded
+    uint8_t channels;        // Of the stream, before stereo expansion
+    uint32_t bitrate;        // bps, as reported by the codec
+    uint8_t bits;            // Source sample width: from the WAV header, 16 for codecs
+    uint32_t frames;
+    uint32_t errors;         // Corrupt frames skipped
+    uint32_t resyncs;        // Frame sync lost and found again (ADTS)
+    uint32_t frame_us_avg;   // Decode time per frame
+    uint32_t frame_us_max;
+    uint32_t cpu_load_pct;   // Decode time / decoded audio time, on one core
+    size_t mem_internal_peak;  // Largest drop in system free heap since the codec was
+    size_t mem_psram_peak;     // opened, after a frame; other tasks count too (HTTP_STREAMING.md)
+    uint32_t output_rate;      // After the resampler: the rate the stream plays at
+    uint32_t resample_load_pct;  // Resampler time / resampled audio time; 0 without one
+} audio_decoder_stats_t;
+
+// HTTP stream jitter buffer (audio_get_buffer_stats)
+typedef struct {
+    size_t capacity;      // Ring size in bytes
+    size_t fill_bytes;
+    uint32_t fill_ms;     // fill_bytes as playback time
+    uint32_t underruns;   // Playback ran dry mid-stream and rebuffered (audible gap)
+    uint32_t overruns;    // Network reader found the ring full and paused (no data lost)
+    uint64_t bytes_in;    // Current stream: received from the network
+    uint64_t bytes_out;   // Current stream: written to I2S, silence included
+    bool buffering;       // Waiting for the prebuffer or low-water mark
+} audio_buffer_stats_t;
+
+// Output mixer (audio_get_mixer_stats). Times cover all sources and the
+// master volume for one block.
+typedef struct {
+    uint32_t block_frames;   // Frames per mix block
+    uint32_t blocks;         // Mixed since init
+    uint32_t mix_us_avg;
+    uint32_t mix_us_max;
+    uint32_t load_pct;       // mix_us_avg / block playback time
+    uint32_t active;         // Bit per audio_source_t that played in the last block
+    uint32_t late;           // Blocks mixed after their DMA buffer had started playing (glitch)
+    uint32_t underruns[AUDIO_SOURCE_COUNT];  // Per source: blocks cut short by a slow producer
+} audio_mixer_stats_t;
+
+// I2S output format (audio_set_output_format). Samples are always mixed in
+// 16 bits; a 32-bit slot carries them in its top half (24-bit DACs use it).
+typedef struct {
+    uint32_t sample_rate;    // 8000-96000 Hz
+    uint8_t bits;            // Slot width: 16 or 32
+    uint8_t channels;        // 1: one sample per frame sent to both slots, 2: stereo
+} audio_output_format_t;
+
 // Initialize I2S audio with MAX98357A
 esp_err_t audio_service_init(void);
 esp_err_t audio_service_deinit(void);
@@ -27,13 +98,42 @@ esp_err_t audio_play(void);
 esp_err_t audio_pause(void);
 esp_err_t audio_stop(void);
 bool audio_is_playing(void);
+esp_err_t audio_get_buffer_stats(audio_buffer_stats_t *stats);
+esp_err_t audio_get_decoder_stats(audio_decoder_stats_t *stats);
+esp_err_t audio_get_mixer_stats(audio_mixer_stats_t *stats);
+
+// Per-source level (0-100, same curve as the volume), applied before the
+// master volume. All sources start at 100.
+esp_err_t audio_set_source_volume(audio_source_t source, uint8_t volume);
+
+// A short tone for UI feedback, mixed over whatever is playing; starts the
+// output if it is idle. Any task; returns without waiting. Lasts duration_ms
+// plus a few ms of fade at each end.
+esp_err_t audio_beep(uint16_t freq_hz, uint16_t duration_ms);
+
+// Base output format: what plays when no stream sets its own rate, and the
+// rate other streams are resampled to. Any task; the output fades out,
+// switches and fades back in, from silence if it is idle. If the driver
+// refuses it, the old format keeps playing until the next call.
+esp_err_t audio_set_output_format(const audio_output_format_t *fmt);
+// The format the I2S is running at now
+esp_err_t audio_get_output_format(audio_output_format_t *fmt);
 
 // Set playback mode and URL
 esp_err_t audio_set_mode(audio_mode_t mode);
 esp_err_t audio_set_url(const char *url);
 
-// Write audio data
+// Queue 16-bit PCM, in the format set by audio_set_pcm_format(), for the PCM
+// source; waits for room, up to a second. Plays alongside the other sources,
+// whether or not audio_play() was called, and keeps its pitch when the output
+// rate changes. Calls from several tasks take turns.
 esp_err_t audio_write(const uint8_t *data, size_t len);
+// Format of the audio_write() data: sample_rate 8000-96000 Hz, channels 1 (played
+// on both sides) or 2, interleaved. Data at a rate other than the output's is
+// resampled. Waits, up to a second, for data queued in the old format to play;
+// on ESP_ERR_TIMEOUT the switch still happens once it has. The default is
+// stereo at the starting output rate (44.1 kHz).
+esp_err_t audio_set_pcm_format(uint32_t sample_rate, uint8_t channels);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,21 @@
+#include "unity.h"
+#include "unity_test_runner.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+
+static const char *TAG = "audio_test";
+
+void app_main(void)
+{
+    // The modules under test are plain C; none needs the kernel running
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    int failures = UNITY_END();
+
+    ESP_LOGI(TAG, "%d failure(s)", failures);
+#if CONFIG_IDF_TARGET_LINUX
+    // Exit status for CI
+    exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+#endif
+}
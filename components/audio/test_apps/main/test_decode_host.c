@@ -0,0 +1,70 @@
+#include "audio_format.h"
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_log.h"
+#include <inttypes.h>
+
+// Single-header decoder, not vendored: built only when MINIMP3_DIR is set
+// (see the CMakeLists.txt next to this file)
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+
+static const char *TAG = "test_decode_host";
+
+// The same 5 s, 128 kbps stereo stream as the device benchmark in test_decoder.c
+extern const uint8_t s_mp3_start[] asm("_binary_stream_44k1_128k_mp3_start");
+extern const uint8_t s_mp3_end[] asm("_binary_stream_44k1_128k_mp3_end");
+
+#define MP3_FRAME_SAMPLES 1152
+
+TEST_CASE("benchmark: MP3 decode on the host with minimp3", "[audio][decoder][bench]")
+{
+    size_t len = s_mp3_end - s_mp3_start;
+    audio_format_t fmt;
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, s_mp3_start, len, true, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, fmt.codec);
+
+    static mp3dec_t dec;
+    static int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+    mp3dec_init(&dec);
+
+    size_t pos = fmt.header_bytes;
+    uint32_t frames = 0;
+    uint64_t samples = 0;
+    int64_t frame_us_max = 0;
+    int hz = 0;
+    int channels = 0;
+    int64_t start_us = kraken_time_us();
+    while (pos < len) {
+        // At most what the decode task holds at once
+        size_t in_len = len - pos < AUDIO_FORMAT_SNIFF_BYTES ? len - pos : AUDIO_FORMAT_SNIFF_BYTES;
+        mp3dec_frame_info_t info;
+        int64_t t0 = kraken_time_us();
+        int got = mp3dec_decode_frame(&dec, s_mp3_start + pos, (int)in_len, pcm, &info);
+        int64_t dt = kraken_time_us() - t0;
+        if (info.frame_bytes == 0) {
+            break;  // A partial frame at the end
+        }
+        pos += info.frame_bytes;
+        if (got > 0) {
+            frames++;
+            samples += got;
+            hz = info.hz;
+            channels = info.channels;
+            frame_us_max = dt > frame_us_max ? dt : frame_us_max;
+        }
+    }
+    int64_t wall_us = kraken_time_us() - start_us;
+
+    int64_t audio_us = (int64_t)(samples * 1000000 / 44100);
+    ESP_LOGI(TAG, "%" PRIu32 " MP3 frames, %" PRId64 " us/frame avg, %" PRId64 " us max, "
+             "%" PRId64 " ms of audio in %" PRId64 " ms (%" PRId64 "x)",
+             frames, frames ? wall_us / frames : 0, frame_us_max, audio_us / 1000,
+             wall_us / 1000, wall_us ? audio_us / wall_us : 0);
+
+    TEST_ASSERT_EQUAL(44100, hz);
+    TEST_ASSERT_EQUAL(2, channels);
+    // All of the 5 s came out, give or take the encoder's padding frames
+    TEST_ASSERT_INT_WITHIN(3 * MP3_FRAME_SAMPLES, 5 * 44100, samples);
+    TEST_ASSERT_LESS_THAN(audio_us, wall_us);
+}
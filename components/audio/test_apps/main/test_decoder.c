@@ -0,0 +1,70 @@
+#include "audio_decoder.h"
+#include "audio_format.h"
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <inttypes.h>
+
+static const char *TAG = "test_decoder";
+
+// 5 s of two-tone stereo with noise, 44.1 kHz, 128 kbps CBR, no ID3 or Xing
+// frame. Made with lame through ffmpeg, from an aevalsrc of two tones plus 5 %
+// noise per side: -c:a libmp3lame -b:a 128k -write_xing 0 -id3v2_version 0
+extern const uint8_t s_mp3_start[] asm("_binary_stream_44k1_128k_mp3_start");
+extern const uint8_t s_mp3_end[] asm("_binary_stream_44k1_128k_mp3_end");
+
+#define MP3_FRAME_SAMPLES 1152
+
+TEST_CASE("benchmark: MP3 decode runs faster than real time", "[audio][decoder][bench]")
+{
+    size_t len = s_mp3_end - s_mp3_start;
+    audio_format_t fmt;
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, s_mp3_start, len, true, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, fmt.codec);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_decoder_open(&fmt));
+
+    // The decode task's frame buffer, reused for every frame
+    uint8_t *pcm = heap_caps_malloc(AUDIO_DECODER_MAX_FRAME_BYTES, MALLOC_CAP_INTERNAL);
+    TEST_ASSERT_NOT_NULL(pcm);
+
+    size_t pos = 0;
+    uint64_t pcm_bytes = 0;
+    int64_t start_us = kraken_time_us();
+    while (pos < len) {
+        // At most what the decode task holds at once
+        size_t in_len = len - pos < AUDIO_DECODER_MAX_INPUT ? len - pos : AUDIO_DECODER_MAX_INPUT;
+        size_t consumed = 0;
+        size_t out_len = 0;
+        esp_err_t err = audio_decoder_decode(s_mp3_start + pos, in_len, &consumed, pcm,
+                                             AUDIO_DECODER_MAX_FRAME_BYTES, &out_len);
+        pos += consumed;
+        pcm_bytes += out_len;
+        if (err == ESP_ERR_NOT_FINISHED && consumed == 0) {
+            break;  // A partial frame at the end
+        }
+        TEST_ASSERT_TRUE(err == ESP_OK || err == ESP_ERR_NOT_FINISHED);
+    }
+    int64_t wall_us = kraken_time_us() - start_us;
+
+    audio_decoder_stats_t st;
+    audio_decoder_get_stats(&st);
+    audio_decoder_close();
+    heap_caps_free(pcm);
+
+    uint64_t frames = pcm_bytes / 4;
+    int64_t audio_us = (int64_t)(frames * 1000000 / 44100);
+    ESP_LOGI(TAG, "%" PRIu32 " MP3 frames, %" PRIu32 " us/frame avg, %" PRIu32 " us max, "
+             "%" PRIu32 "%% CPU, %" PRId64 " ms of audio in %" PRId64 " ms (%" PRId64 ".%" PRId64 "x)",
+             st.frames, st.frame_us_avg, st.frame_us_max, st.cpu_load_pct, audio_us / 1000,
+             wall_us / 1000, audio_us / wall_us, audio_us * 10 / wall_us % 10);
+
+    TEST_ASSERT_EQUAL(0, st.errors);
+    TEST_ASSERT_EQUAL(44100, st.sample_rate);
+    TEST_ASSERT_EQUAL(2, st.channels);
+    // All of the 5 s came out, give or take the encoder's padding frames
+    TEST_ASSERT_INT_WITHIN(3 * MP3_FRAME_SAMPLES, 5 * 44100, frames);
+    // Faster than real time, by the decoder's own measure and the wall clock
+    TEST_ASSERT_LESS_THAN(100, st.cpu_load_pct);
+    TEST_ASSERT_LESS_THAN(audio_us, wall_us);
+}
@@ -0,0 +1,352 @@
+#include "audio_format.h"
+#include "unity.h"
+#include <string.h>
+
+#define ADTS_FRAMES 40
+#define ADTS_STREAM_BYTES (ADTS_FRAMES * 700)
+
+// An ADTS stream as a station sends it: frames of varying length, and payload
+// bytes that look like a syncword, so only chained headers can be trusted
+typedef struct {
+    uint8_t data[ADTS_STREAM_BYTES];
+    size_t len;
+    size_t starts[ADTS_FRAMES];
+} adts_stream_t;
+
+static adts_stream_t s_adts;
+
+// AAC-LC, 44.1 kHz, stereo, no CRC
+static void adts_header(uint8_t *p, size_t frame_len)
+{
+    p[0] = 0xFF;
+    p[1] = 0xF1;
+    p[2] = (1 << 6) | (4 << 2);
+    p[3] = (2 << 6) | (uint8_t)(frame_len >> 11);
+    p[4] = (uint8_t)(frame_len >> 3);
+    p[5] = (uint8_t)((frame_len & 0x07) << 5) | 0x1F;
+    p[6] = 0xFC;
+}
+
+static void adts_stream_build(adts_stream_t *st)
+{
+    st->len = 0;
+    for (int i = 0; i < ADTS_FRAMES; i++) {
+        size_t frame_len = 300 + (size_t)(i * 97) % 380;
+        uint8_t *p = st->data + st->len;
+        st->starts[i] = st->len;
+        adts_header(p, frame_len);
+        for (size_t j = 7; j < frame_len; j++) {
+            p[j] = (uint8_t)(j * 31 + i);
+        }
+        // A false header inside the payload, claiming a frame that ends nowhere
+        adts_header(p + 50, 123);
+        st->len += frame_len;
+    }
+}
+
+// The decode task's loop: a window of AUDIO_FORMAT_SNIFF_BYTES topped up in
+// chunk-byte reads, sync called on what it holds. Records each frame's offset
+// in the stream; returns how many were found.
+static int adts_scan(const adts_stream_t *st, size_t from, size_t chunk,
+                     audio_format_adts_sync_t *sync, size_t *found, int max_found)
+{
+    static uint8_t win[AUDIO_FORMAT_SNIFF_BYTES];
+    size_t win_len = 0;
+    size_t win_pos = from;   // Stream offset of win[0]
+    size_t read_pos = from;
+    int n = 0;
+
+    memset(sync, 0, sizeof(*sync));
+    while (1) {
+        size_t take = st->len - read_pos;
+        take = take < chunk ? take : chunk;
+        take = take < sizeof(win) - win_len ? take : sizeof(win) - win_len;
+        memcpy(win + win_len, st->data + read_pos, take);
+        win_len += take;
+        read_pos += take;
+
+        size_t skip = 0;
+        size_t frame_len = 0;
+        esp_err_t err = audio_format_adts_sync(sync, win, win_len, &skip, &frame_len);
+        size_t used = skip;
+        if (err == ESP_OK) {
+            TEST_ASSERT_LESS_THAN(max_found, n);
+            found[n++] = win_pos + skip;
+            used += frame_len;
+        } else {
+            TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, err);
+            if (take == 0 && used == 0) {
+                break;  // End of stream, and nothing left to drop
+            }
+        }
+        memmove(win, win + used, win_len - used);
+        win_len -= used;
+        win_pos += used;
+    }
+    return n;
+}
+
+// Index of the first frame starting at or after pos
+static int adts_first_frame(const adts_stream_t *st, size_t pos)
+{
+    int i = 0;
+    while (i < ADTS_FRAMES && st->starts[i] < pos) {
+        i++;
+    }
+    return i;
+}
+
+TEST_CASE("format ADTS sync joins a stream at any byte offset", "[audio][format]")
+{
+    adts_stream_build(&s_adts);
+    static const size_t offsets[] = { 0, 1, 3, 7, 50, 51, 53, 299, 1001, 4097 };
+    static const size_t chunks[] = { 1, 37, 512, AUDIO_FORMAT_SNIFF_BYTES };
+    size_t found[ADTS_FRAMES];
+
+    for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            audio_format_adts_sync_t sync;
+            int n = adts_scan(&s_adts, offsets[o], chunks[c], &sync, found, ADTS_FRAMES);
+
+            // Every frame from the first whole one on, never a false header; the
+            // last frame has no successor to confirm it before sync, but once
+            // synced it needs none
+            int first = adts_first_frame(&s_adts, offsets[o]);
+            TEST_ASSERT_EQUAL(ADTS_FRAMES - first, n);
+            for (int i = 0; i < n; i++) {
+                TEST_ASSERT_EQUAL(s_adts.starts[first + i], found[i]);
+            }
+            TEST_ASSERT_EQUAL_UINT32(0, sync.resyncs);
+        }
+    }
+}
+
+TEST_CASE("format ADTS sync recovers from a corrupt header", "[audio][format]")
+{
+    adts_stream_build(&s_adts);
+    const int bad = 17;
+    s_adts.data[s_adts.starts[bad]] = 0x00;
+    size_t found[ADTS_FRAMES];
+
+    audio_format_adts_sync_t sync;
+    int n = adts_scan(&s_adts, 0, 512, &sync, found, ADTS_FRAMES);
+
+    // Only the frame behind the broken header is lost
+    TEST_ASSERT_EQUAL(ADTS_FRAMES - 1, n);
+    for (int i = 0, f = 0; i < n; i++, f++) {
+        f += f == bad;
+        TEST_ASSERT_EQUAL(s_adts.starts[f], found[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, sync.resyncs);
+    TEST_ASSERT_TRUE(sync.synced);
+}
+
+TEST_CASE("format ADTS sync rejects a header whose frame is too long", "[audio][format]")
+{
+    // 0x1FFF bytes is a valid ADTS length, but more than any real frame
+    uint8_t buf[64] = { 0 };
+    adts_header(buf, 0x1FFF);
+    TEST_ASSERT_EQUAL(0, audio_format_adts_frame_len(buf, AUDIO_FORMAT_SNIFF_BYTES));
+
+    audio_format_adts_sync_t sync = { 0 };
+    size_t skip = 0;
+    size_t frame_len = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_adts_sync(&sync, buf, sizeof(buf), &skip, &frame_len));
+    // All but the last 6 bytes, which could still start a header
+    TEST_ASSERT_EQUAL(sizeof(buf) - 6, skip);
+    TEST_ASSERT_FALSE(sync.synced);
+}
+
+// A RIFF/WAVE header: fmt, an odd-sized LIST chunk with its pad byte, then data
+static size_t wav_header(uint8_t *p, uint16_t tag, uint16_t channels, uint32_t rate, uint16_t bits)
+{
+    static const uint8_t head[] = {
+        'R', 'I', 'F', 'F', 0xFF, 0xFF, 0xFF, 0xFF, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0,
+    };
+    uint32_t block = channels * (bits / 8);
+    uint32_t bytes_per_sec = rate * block;
+    size_t n = sizeof(head);
+
+    memcpy(p, head, n);
+    uint8_t *f = p + n;
+    f[0] = (uint8_t)tag;
+    f[1] = (uint8_t)(tag >> 8);
+    f[2] = (uint8_t)channels;
+    f[3] = 0;
+    memcpy(f + 4, (uint8_t[]){ rate, rate >> 8, rate >> 16, rate >> 24 }, 4);
+    memcpy(f + 8, (uint8_t[]){ bytes_per_sec, bytes_per_sec >> 8, bytes_per_sec >> 16,
+                               bytes_per_sec >> 24 }, 4);
+    f[12] = (uint8_t)block;
+    f[13] = 0;
+    f[14] = (uint8_t)bits;
+    f[15] = 0;
+    n += 16;
+
+    memcpy(p + n, "LIST\x05\x00\x00\x00INFO\x00\x00", 14);
+    n += 14;
+    memcpy(p + n, "data\xFF\xFF\xFF\xFF", 8);
+    return n + 8;
+}
+
+// MPEG-1 Layer III, 128 kbit/s, 44.1 kHz, no padding: 417 bytes a frame
+#define MP3_FRAME_BYTES 417
+
+static void mp3_header(uint8_t *p)
+{
+    p[0] = 0xFF;
+    p[1] = 0xFB;
+    p[2] = 0x90;
+    p[3] = 0x00;
+}
+
+TEST_CASE("format detect parses the WAV fmt chunk", "[audio][format]")
+{
+    uint8_t buf[128] = { 0 };
+    size_t n = wav_header(buf, 1, 1, 22050, 24);
+    audio_format_t fmt;
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, buf, n + 16, false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_PCM, fmt.codec);
+    TEST_ASSERT_EQUAL_UINT32(22050, fmt.sample_rate);
+    TEST_ASSERT_EQUAL(1, fmt.channels);
+    TEST_ASSERT_EQUAL(24, fmt.bits);
+    TEST_ASSERT_EQUAL(n, fmt.header_bytes);
+
+    // The header arriving in pieces: more is asked for until data is in
+    for (size_t len = 0; len < n; len++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                          audio_format_detect(AUDIO_CODEC_NONE, buf, len, false, &fmt));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n - 1, true, &fmt));
+
+    // IEEE float, and integer PCM of a width there is no converter for
+    n = wav_header(buf, 3, 2, 48000, 32);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n, false, &fmt));
+    n = wav_header(buf, 1, 2, 48000, 12);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n, false, &fmt));
+}
+
+TEST_CASE("format detect stops at a WAV chunk that runs past the buffer", "[audio][format]")
+{
+    uint8_t buf[128] = { 0 };
+    size_t n = wav_header(buf, 1, 2, 44100, 16);
+    audio_format_t fmt;
+
+    // A LIST chunk claiming nearly 4 GB: on a 32-bit size_t, pos + 8 + size
+    // wraps to a small number and the walk would jump back into the header
+    static const uint8_t huge[] = { 0xF0, 0xFF, 0xFF, 0xFF };
+    memcpy(buf + 40, huge, sizeof(huge));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n, false, &fmt));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n, true, &fmt));
+
+    // The same for the fmt chunk itself, and one cut short by the buffer
+    n = wav_header(buf, 1, 2, 44100, 16);
+    memcpy(buf + 16, huge, sizeof(huge));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, n, false, &fmt));
+    n = wav_header(buf, 1, 2, 44100, 16);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, 30, false, &fmt));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, 30, true, &fmt));
+}
+
+TEST_CASE("format detect skips an ID3 tag", "[audio][format]")
+{
+    // v2.4, 0x01 0x7F synchsafe = 255 bytes of tag
+    uint8_t buf[16] = { 'I', 'D', '3', 4, 0, 0x00, 0, 0, 0x01, 0x7F };
+    audio_format_t fmt;
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_MP3, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_NONE, fmt.codec);
+    TEST_ASSERT_EQUAL(10 + 255, fmt.header_bytes);
+
+    // With a footer
+    buf[5] = 0x10;
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_MP3, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(10 + 255 + 10, fmt.header_bytes);
+}
+
+TEST_CASE("format detect takes MP3 and ADTS only on two chained headers", "[audio][format]")
+{
+    static uint8_t buf[AUDIO_FORMAT_SNIFF_BYTES];
+    audio_format_t fmt;
+
+    // One MP3 header in noise proves nothing; with its successor it does, and
+    // beats the Content-Type
+    memset(buf, 0x11, sizeof(buf));
+    mp3_header(buf + 100);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, 1024, false, &fmt));
+    mp3_header(buf + 100 + MP3_FRAME_BYTES);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_AAC, buf, 1024, false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, fmt.codec);
+    TEST_ASSERT_EQUAL(0, fmt.header_bytes);
+
+    // The same for ADTS
+    memset(buf, 0x11, sizeof(buf));
+    adts_header(buf + 33, 400);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, 1024, false, &fmt));
+    adts_header(buf + 33 + 400, 400);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, buf, 1024, false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_AAC, fmt.codec);
+
+    // Both chains present: the earlier one wins
+    mp3_header(buf + 10);
+    mp3_header(buf + 10 + MP3_FRAME_BYTES);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, buf, 1024, false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, fmt.codec);
+}
+
+TEST_CASE("format detect knows FLAC and Ogg by their magic", "[audio][format]")
+{
+    uint8_t buf[16] = { 'f', 'L', 'a', 'C' };
+    audio_format_t fmt;
+
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_MP3, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_FLAC, fmt.codec);
+    memcpy(buf, "OggS", 4);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_OGG, fmt.codec);
+
+    // Too short to tell, unless nothing more is coming
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_NONE, buf, 4, false, &fmt));
+}
+
+TEST_CASE("format detect falls back to the Content-Type", "[audio][format]")
+{
+    static uint8_t buf[AUDIO_FORMAT_SNIFF_BYTES];
+    memset(buf, 0x11, sizeof(buf));
+    audio_format_t fmt;
+
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, audio_format_from_content_type("audio/mpeg"));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_AAC, audio_format_from_content_type("audio/aacp"));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_OGG, audio_format_from_content_type("Application/Ogg"));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_PCM, audio_format_from_content_type("audio/wav; codec=1"));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_NONE, audio_format_from_content_type("text/html"));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_NONE, audio_format_from_content_type(NULL));
+
+    // Nothing in the bytes: wait for the sniff window, then take the header
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED,
+                      audio_format_detect(AUDIO_CODEC_AAC, buf, sizeof(buf) - 1, false, &fmt));
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_AAC, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_AAC, fmt.codec);
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_MP3, buf, 100, true, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_MP3, fmt.codec);
+
+    // No header either: raw 16-bit stereo
+    TEST_ASSERT_EQUAL(ESP_OK, audio_format_detect(AUDIO_CODEC_NONE, buf, sizeof(buf), false, &fmt));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_PCM, fmt.codec);
+    TEST_ASSERT_EQUAL_UINT32(44100, fmt.sample_rate);
+    TEST_ASSERT_EQUAL(2, fmt.channels);
+    TEST_ASSERT_EQUAL(16, fmt.bits);
+}
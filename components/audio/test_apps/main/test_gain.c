@@ -0,0 +1,144 @@
+#include "audio_gain.h"
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "test_gain";
+
+#define GUARD 16
+#define MAX_SAMPLES 256
+
+static int16_t fill_sample(uint32_t *seed, size_t i)
+{
+    *seed = *seed * 1664525 + 1013904223;
+    switch (i % 16) {
+    case 0:
+        return INT16_MAX;
+    case 1:
+        return INT16_MIN;
+    case 2:
+        return 0;
+    default:
+        return (int16_t)(*seed >> 16);
+    }
+}
+
+TEST_CASE("gain matches the scalar loop at every gain, alignment and length", "[audio][gain]")
+{
+    // Guard samples on both sides; starts at every offset from 16-byte aligned
+    static int16_t src[GUARD + MAX_SAMPLES + GUARD] __attribute__((aligned(16)));
+    static int16_t ref[GUARD + MAX_SAMPLES + GUARD] __attribute__((aligned(16)));
+    static int16_t got[GUARD + MAX_SAMPLES + GUARD] __attribute__((aligned(16)));
+    static const size_t lengths[] = { 0, 1, 7, 8, 9, 15, 16, 17, 100, 231, MAX_SAMPLES - 8 };
+    uint32_t seed = 99;
+    for (size_t i = 0; i < sizeof(src) / sizeof(src[0]); i++) {
+        src[i] = fill_sample(&seed, i);
+    }
+
+    uint32_t checked = 0;
+    for (uint32_t gain = 0; gain <= 65535; gain += gain < 64 || gain > 32700 ? 1 : 97) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+                memcpy(ref, src, sizeof(src));
+                memcpy(got, src, sizeof(src));
+                audio_gain_apply_scalar(ref + GUARD + offset, lengths[l], (uint16_t)gain);
+                audio_gain_apply(got + GUARD + offset, lengths[l], (uint16_t)gain);
+                // Includes the guards: nothing outside the range is touched
+                TEST_ASSERT_EQUAL_INT16_ARRAY(ref, got, sizeof(ref) / sizeof(ref[0]));
+                checked++;
+            }
+        }
+    }
+    // Unity is skipped, and must still be exact
+    memcpy(got, src, sizeof(src));
+    audio_gain_apply_scalar(got, sizeof(got) / sizeof(got[0]), AUDIO_GAIN_UNITY);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(src, got, sizeof(src) / sizeof(src[0]));
+    ESP_LOGI(TAG, "%" PRIu32 " cases, %s kernel", checked, AUDIO_GAIN_HAVE_PIE ? "pie" : "scalar");
+}
+
+// The volume pass before Q15: powf per chunk, a float multiply and a
+// truncating cast per sample
+static __attribute__((noinline)) void volume_float(int16_t *samples, int num_samples, uint8_t volume)
+{
+    float volume_scale = powf(volume / 100.0f, 2.0f);
+    for (int i = 0; i < num_samples; i++) {
+        samples[i] = (int16_t)(samples[i] * volume_scale);
+    }
+}
+
+static __attribute__((noinline)) void volume_q15(int16_t *samples, int num_samples, uint8_t volume)
+{
+    audio_gain_apply(samples, num_samples, audio_gain_from_volume(volume));
+}
+
+#if AUDIO_GAIN_HAVE_PIE
+static __attribute__((noinline)) void volume_q15_scalar(int16_t *samples, int num_samples,
+                                                        uint8_t volume)
+{
+    audio_gain_apply_scalar(samples, num_samples, audio_gain_from_volume(volume));
+}
+#endif
+
+TEST_CASE("gain from the volume curve is within 1 LSB of the float path", "[audio][gain]")
+{
+    int16_t a[MAX_SAMPLES];
+    int16_t b[MAX_SAMPLES];
+    uint32_t seed = 3;
+    for (int volume = 0; volume <= 100; volume++) {
+        for (size_t i = 0; i < MAX_SAMPLES; i++) {
+            a[i] = b[i] = fill_sample(&seed, i);
+        }
+        volume_float(a, MAX_SAMPLES, volume);
+        volume_q15(b, MAX_SAMPLES, volume);
+        for (size_t i = 0; i < MAX_SAMPLES; i++) {
+            TEST_ASSERT_INT_WITHIN(1, a[i], b[i]);
+        }
+    }
+}
+
+typedef void (*volume_fn)(int16_t *samples, int num_samples, uint8_t volume);
+
+// Samples per second through fn, in the 1024-sample chunks of the stream path
+static uint32_t bench_volume(volume_fn fn, int16_t *buf, size_t count)
+{
+    const int passes = 100;
+    int64_t start = kraken_time_us();
+    for (int p = 0; p < passes; p++) {
+        for (size_t pos = 0; pos < count; pos += 1024) {
+            fn(buf + pos, 1024, 50);
+        }
+    }
+    int64_t elapsed = kraken_time_us() - start;
+    return (uint32_t)((uint64_t)passes * count * 1000000 / (elapsed ? elapsed : 1));
+}
+
+TEST_CASE("benchmark: volume samples/s, Q15 against float", "[audio][gain][bench]")
+{
+    static int16_t buf[8 * 1024] __attribute__((aligned(16)));
+    const size_t count = sizeof(buf) / sizeof(buf[0]);
+    uint32_t seed = 1;
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = fill_sample(&seed, i);
+    }
+
+    // Real time for 44.1 kHz stereo is 88200 samples/s
+    uint32_t flt = bench_volume(volume_float, buf, count);
+    uint32_t q15 = bench_volume(volume_q15, buf, count);
+#if AUDIO_GAIN_HAVE_PIE
+    uint32_t scalar = bench_volume(volume_q15_scalar, buf, count);
+    ESP_LOGI(TAG, "float %" PRIu32 " ksamples/s, Q15 scalar %" PRIu32 " ksamples/s, "
+             "Q15 pie %" PRIu32 " ksamples/s (%" PRIu32 ".%" PRIu32 "x float)", flt / 1000,
+             scalar / 1000, q15 / 1000, q15 / flt, (uint32_t)(q15 * 10ULL / flt % 10));
+    TEST_ASSERT_GREATER_THAN(scalar, q15);
+    TEST_ASSERT_GREATER_THAN(flt, q15);
+#else
+    // The compiler vectorizes both loops here, so the ratio says little
+    ESP_LOGI(TAG, "float %" PRIu32 " ksamples/s, Q15 %" PRIu32 " ksamples/s", flt / 1000,
+             q15 / 1000);
+#endif
+    TEST_ASSERT_GREATER_THAN(88200, flt);
+    TEST_ASSERT_GREATER_THAN(88200, q15);
+}
@@ -0,0 +1,280 @@
+#include "test_rig.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The stream path of audio_service.c without the hardware: a synthetic network
+// source fills the PCM ring in HTTP-sized chunks and the mixer drains it one
+// block per block period, with the service's default marks. Time is simulated,
+// so stalls are exact and a 5 s stream runs in milliseconds.
+#define RATE 44100
+#define FRAME_BYTES 4             // 16-bit stereo
+#define BLOCK_US ((int64_t)AUDIO_MIXER_BLOCK_FRAMES * 1000000 / RATE)
+#define CHUNK_BYTES 4096          // HTTP_BUFFER_SIZE in audio_service.c
+#define RING_BYTES (128 * 1024)   // CONFIG_KRAKEN_AUDIO_RING_SIZE_KB default
+#define PREBUFFER_MS 400          // CONFIG_KRAKEN_AUDIO_PREBUFFER_MS default
+#define LOW_WATER_MS 150          // CONFIG_KRAKEN_AUDIO_LOW_WATER_MS default
+#define MS_TO_BYTES(ms) ((size_t)(ms) * RATE / 1000 * FRAME_BYTES)
+
+typedef struct {
+    // Source: frame n is (n, ~n), so a lost, repeated or reordered frame shows
+    double speed;             // Delivery rate relative to real time
+    int64_t stall_from_us;    // No bytes arrive in [from, until)
+    int64_t stall_until_us;
+    uint32_t total_frames;    // 0: endless
+    uint32_t next_frame;
+    double credit;            // Bytes delivered by the network, not yet in the ring
+    uint32_t overruns;        // Blocks in which a full ring held the source back
+
+    // Sink
+    uint32_t expect_frame;
+    uint32_t gaps;            // Blocks cut short once playing, before the end
+    int64_t first_audio_us;   // -1 until the first frame plays
+    size_t fill_at_first;
+    size_t fill_at_resume;    // At the end of the last rebuffering
+    bool broken;              // A frame out of sequence
+
+    test_rig_t *rig;          // The stream on port 0
+    audio_ringbuf_t *ring;
+} sim_t;
+
+static sim_t *sim_create(double speed)
+{
+    sim_t *s = calloc(1, sizeof(*s));
+    TEST_ASSERT_NOT_NULL(s);
+    s->speed = speed;
+    s->first_audio_us = -1;
+    s->rig = test_rig_create(0);
+    s->ring = test_rig_add_ring(s->rig, 0, RING_BYTES, 2, MS_TO_BYTES(PREBUFFER_MS),
+                                MS_TO_BYTES(LOW_WATER_MS));
+    return s;
+}
+
+static void sim_destroy(sim_t *s)
+{
+    test_rig_destroy(s->rig);
+    free(s);
+}
+
+// One block period of the network side, like audio_net: whole chunks only,
+// and nothing read while the ring lacks room for one (TCP holds the server)
+static void sim_source(sim_t *s, int64_t now_us)
+{
+    if (now_us >= s->stall_from_us && now_us < s->stall_until_us) {
+        return;
+    }
+    if (s->total_frames && s->next_frame >= s->total_frames) {
+        return;
+    }
+
+    // The TCP window bounds what can arrive while the reader is held back
+    s->credit += s->speed * AUDIO_MIXER_BLOCK_FRAMES * FRAME_BYTES;
+    if (s->credit > 2 * CHUNK_BYTES) {
+        s->credit = 2 * CHUNK_BYTES;
+    }
+
+    int16_t chunk[CHUNK_BYTES / sizeof(int16_t)];
+    while (s->credit >= CHUNK_BYTES) {
+        if (audio_ringbuf_space(s->ring) < CHUNK_BYTES) {
+            s->overruns++;
+            break;
+        }
+        size_t frames = CHUNK_BYTES / FRAME_BYTES;
+        if (s->total_frames && s->total_frames - s->next_frame < frames) {
+            frames = s->total_frames - s->next_frame;
+        }
+        for (size_t i = 0; i < frames; i++) {
+            uint32_t n = s->next_frame++;
+            chunk[2 * i] = (int16_t)n;
+            chunk[2 * i + 1] = (int16_t)~n;
+        }
+        audio_ringbuf_write(s->ring, chunk, frames * FRAME_BYTES);
+        s->credit -= CHUNK_BYTES;
+        if (s->total_frames && s->next_frame == s->total_frames) {
+            audio_mixer_end(&s->rig->mixer, 0);
+            break;
+        }
+    }
+}
+
+// One block of the playback side, like audio_task
+static void sim_sink(sim_t *s, int64_t now_us)
+{
+    audio_mixer_port_t *port = &s->rig->mixer.ports[0];
+    bool buffering = port->state == AUDIO_MIXER_PORT_BUFFERING;
+    size_t fill = audio_ringbuf_fill(s->ring);
+    uint64_t before = port->frames;
+
+    audio_mixer_mix(&s->rig->mixer, s->rig->out, AUDIO_MIXER_BLOCK_FRAMES, 2);
+    size_t got = (size_t)(port->frames - before);
+
+    for (size_t i = 0; i < got; i++) {
+        uint32_t n = s->expect_frame++;
+        if (s->rig->out[2 * i] != (int16_t)n || s->rig->out[2 * i + 1] != (int16_t)~n) {
+            s->broken = true;
+        }
+    }
+    if (got && s->first_audio_us < 0) {
+        s->first_audio_us = now_us;
+        s->fill_at_first = fill;
+    } else if (got && buffering) {
+        s->fill_at_resume = fill;
+    }
+    if (s->first_audio_us >= 0 && got < AUDIO_MIXER_BLOCK_FRAMES && !port->eof) {
+        s->gaps++;
+    }
+}
+
+static void sim_run(sim_t *s, int64_t duration_us)
+{
+    for (int64_t now = 0; now < duration_us; now += BLOCK_US) {
+        sim_source(s, now);
+        sim_sink(s, now);
+    }
+}
+
+TEST_CASE("jitter buffer prebuffers, then holds the source back when full", "[audio][jitter]")
+{
+    sim_t *s = sim_create(1.5);
+    sim_run(s, 3000000);
+
+    // Nothing plays before the prebuffer mark; at 1.5x that is ~270 ms in
+    TEST_ASSERT_GREATER_OR_EQUAL(MS_TO_BYTES(PREBUFFER_MS), s->fill_at_first);
+    TEST_ASSERT_GREATER_OR_EQUAL(PREBUFFER_MS * 1000 / 1.5 - BLOCK_US, s->first_audio_us);
+    TEST_ASSERT_FALSE(s->broken);
+    TEST_ASSERT_EQUAL(0, s->gaps);
+    TEST_ASSERT_EQUAL(0, s->rig->mixer.ports[0].underruns);
+    // A faster source fills the ring and is then paced by it: less than a chunk
+    // free when it stopped, and one block drained since
+    TEST_ASSERT_GREATER_THAN(0, s->overruns);
+    TEST_ASSERT_GREATER_THAN(RING_BYTES - CHUNK_BYTES - AUDIO_MIXER_BLOCK_FRAMES * FRAME_BYTES,
+                             audio_ringbuf_fill(s->ring));
+    sim_destroy(s);
+}
+
+TEST_CASE("jitter buffer rides out a stall shorter than its fill", "[audio][jitter]")
+{
+    // The full ring holds ~740 ms
+    sim_t *s = sim_create(1.5);
+    s->stall_from_us = 2000000;
+    s->stall_until_us = 2500000;
+    sim_run(s, 4000000);
+
+    TEST_ASSERT_FALSE(s->broken);
+    TEST_ASSERT_EQUAL(0, s->gaps);
+    TEST_ASSERT_EQUAL(0, s->rig->mixer.ports[0].underruns);
+    // Every block since the first played in full
+    uint32_t blocks = (uint32_t)((4000000 - s->first_audio_us + BLOCK_US - 1) / BLOCK_US);
+    TEST_ASSERT_EQUAL(blocks * AUDIO_MIXER_BLOCK_FRAMES, s->expect_frame);
+    sim_destroy(s);
+}
+
+TEST_CASE("jitter buffer underruns once on a long stall and resumes at the low-water mark",
+          "[audio][jitter]")
+{
+    sim_t *s = sim_create(1.5);
+    s->stall_from_us = 2000000;
+    s->stall_until_us = 3500000;
+    sim_run(s, 5000000);
+
+    TEST_ASSERT_EQUAL(1, s->rig->mixer.ports[0].underruns);
+    TEST_ASSERT_GREATER_THAN(0, s->gaps);
+    // Resumes at the low-water mark, not the (longer) prebuffer
+    TEST_ASSERT_GREATER_OR_EQUAL(MS_TO_BYTES(LOW_WATER_MS), s->fill_at_resume);
+    TEST_ASSERT_LESS_THAN(MS_TO_BYTES(LOW_WATER_MS) + 2 * CHUNK_BYTES, s->fill_at_resume);
+    // Silence was inserted, but no frame was lost or repeated across the gap
+    TEST_ASSERT_FALSE(s->broken);
+    sim_destroy(s);
+}
+
+TEST_CASE("jitter buffer drains the end of a stream without an underrun", "[audio][jitter]")
+{
+    // Shorter than the prebuffer: the end of the stream starts playback
+    sim_t *s = sim_create(1.5);
+    s->total_frames = RATE / 4 + 123;
+    sim_run(s, 1000000);
+
+    TEST_ASSERT_FALSE(s->broken);
+    TEST_ASSERT_EQUAL(s->total_frames, s->expect_frame);
+    TEST_ASSERT_EQUAL(0, s->rig->mixer.ports[0].underruns);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_DRAINED, audio_mixer_port_state(&s->rig->mixer, 0));
+    sim_destroy(s);
+}
+
+// The same ring between two real tasks, as audio_net and audio_dec use it
+#define SPSC_RING_BYTES 4096
+#define SPSC_TOTAL_BYTES (4 * 1024 * 1024)
+
+typedef struct {
+    audio_ringbuf_t ring;
+    uint8_t storage[SPSC_RING_BYTES];
+    SemaphoreHandle_t done;
+} spsc_t;
+
+static inline uint8_t spsc_byte(uint32_t pos)
+{
+    return (uint8_t)(pos * 7 + (pos >> 11));
+}
+
+static void spsc_producer(void *arg)
+{
+    spsc_t *t = arg;
+    uint8_t chunk[1500];
+    uint32_t pos = 0;
+    uint32_t seed = 1;
+    while (pos < SPSC_TOTAL_BYTES) {
+        seed = seed * 1103515245 + 12345;
+        size_t len = 1 + (seed >> 16) % sizeof(chunk);
+        if (len > SPSC_TOTAL_BYTES - pos) {
+            len = SPSC_TOTAL_BYTES - pos;
+        }
+        for (size_t i = 0; i < len; i++) {
+            chunk[i] = spsc_byte(pos + i);
+        }
+        size_t sent = 0;
+        while (sent < len) {
+            size_t n = audio_ringbuf_write(&t->ring, chunk + sent, len - sent);
+            sent += n;
+            if (!n) {
+                taskYIELD();
+            }
+        }
+        pos += len;
+    }
+    xSemaphoreGive(t->done);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("ring carries a stream between two tasks intact", "[audio][jitter]")
+{
+    spsc_t *t = calloc(1, sizeof(*t));
+    TEST_ASSERT_NOT_NULL(t);
+    audio_ringbuf_init(&t->ring, t->storage, sizeof(t->storage));
+    t->done = xSemaphoreCreateBinary();
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(spsc_producer, "spsc", 4096, t, uxTaskPriorityGet(NULL), NULL));
+
+    uint8_t buf[1000];
+    uint32_t pos = 0;
+    uint32_t seed = 7;
+    uint32_t bad = 0;
+    while (pos < SPSC_TOTAL_BYTES) {
+        seed = seed * 1103515245 + 12345;
+        size_t n = audio_ringbuf_read(&t->ring, buf, 1 + (seed >> 16) % sizeof(buf));
+        for (size_t i = 0; i < n; i++) {
+            bad += buf[i] != spsc_byte(pos + i);
+        }
+        pos += n;
+        if (!n) {
+            taskYIELD();
+        }
+    }
+
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(t->done, pdMS_TO_TICKS(1000)));
+    TEST_ASSERT_EQUAL(0, bad);
+    TEST_ASSERT_EQUAL(0, audio_ringbuf_fill(&t->ring));
+    vSemaphoreDelete(t->done);
+    free(t);
+}
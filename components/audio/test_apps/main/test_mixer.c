@@ -0,0 +1,350 @@
+#include "audio_gain.h"
+#include "test_rig.h"
+#include "unity.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TONE_HZ 1000
+#define RING_BYTES (16 * 1024)
+
+// One ring port, like the audio_write() source: no marks, plays what is
+// there. A tone generator keeps the ring topped up before every block.
+typedef struct {
+    test_rig_t *rig;
+    audio_mixer_t *mixer;
+    audio_ringbuf_t *ring;
+    int16_t *out;
+    uint32_t port_rate;
+    uint8_t channels;
+    uint32_t written;          // Tone frames queued so far
+    uint32_t total;            // And in all
+    uint64_t frames;           // Output frames seen
+    uint32_t crossings;        // Rising zero crossings of the left channel
+    int16_t last;
+} tone_t;
+
+static tone_t *tone_create(uint32_t out_rate, uint32_t port_rate, uint8_t channels, double seconds)
+{
+    tone_t *t = calloc(1, sizeof(*t));
+    TEST_ASSERT_NOT_NULL(t);
+    t->port_rate = port_rate;
+    t->channels = channels;
+    t->total = (uint32_t)(port_rate * seconds);
+    t->rig = test_rig_create(out_rate);
+    t->mixer = &t->rig->mixer;
+    t->ring = test_rig_add_ring(t->rig, 0, RING_BYTES, channels, 0, 0);
+    t->out = t->rig->out;
+    test_rig_set_port_rate(t->rig, 0, port_rate, channels);
+    return t;
+}
+
+static void tone_destroy(tone_t *t)
+{
+    test_rig_destroy(t->rig);
+    free(t);
+}
+
+// Tops up the ring, then mixes one block; returns the mix mask
+static uint32_t tone_mix(tone_t *t)
+{
+    int16_t frame[2];
+    size_t frame_bytes = t->channels * sizeof(int16_t);
+    while (t->written < t->total && audio_ringbuf_space(t->ring) >= frame_bytes) {
+        double at = (double)t->written++ / t->port_rate;
+        frame[0] = (int16_t)lrint(16000.0 * sin(2.0 * M_PI * TONE_HZ * at));
+        frame[1] = (int16_t)-frame[0];
+        audio_ringbuf_write(t->ring, frame, frame_bytes);
+    }
+
+    uint64_t before = t->mixer->ports[0].frames;
+    uint32_t mask = audio_mixer_mix(t->mixer, t->out, AUDIO_MIXER_BLOCK_FRAMES, 2);
+    size_t got = (size_t)(t->mixer->ports[0].frames - before);
+    for (size_t i = 0; i < got; i++) {
+        int16_t s = t->out[2 * i];
+        t->crossings += t->last < 0 && s >= 0;
+        t->last = s;
+    }
+    t->frames += got;
+    return mask;
+}
+
+TEST_CASE("mixer resamples a ring port at its own rate to the output rate", "[audio][mixer]")
+{
+    static const struct {
+        uint32_t port_rate;
+        uint8_t channels;
+    } cases[] = {
+        { 48000, 2 },
+        { 22050, 1 },
+        { 8000, 2 },
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        tone_t *t = tone_create(44100, cases[c].port_rate, cases[c].channels, 2.0);
+        while (tone_mix(t)) {
+        }
+
+        // 2 s at the output rate, less what stays in the filter, and the tone
+        // keeps its pitch (played raw, 48 kHz data would come out at 919 Hz)
+        TEST_ASSERT_UINT32_WITHIN(64, 2 * 44100, t->frames);
+        TEST_ASSERT_UINT32_WITHIN(2, 2 * TONE_HZ, t->crossings);
+        TEST_ASSERT_TRUE(t->mixer->ports[0].resample);
+        tone_destroy(t);
+    }
+}
+
+TEST_CASE("mixer passes a ring port at the output rate through unchanged", "[audio][mixer]")
+{
+    tone_t *t = tone_create(48000, 48000, 2, 0);
+    TEST_ASSERT_FALSE(t->mixer->ports[0].resample);
+    int16_t in[AUDIO_MIXER_BLOCK_FRAMES * 2];
+    for (size_t i = 0; i < sizeof(in) / sizeof(in[0]); i++) {
+        in[i] = (int16_t)(i * 37);
+    }
+    audio_ringbuf_write(t->ring, in, sizeof(in));
+    audio_mixer_mix(t->mixer, t->out, AUDIO_MIXER_BLOCK_FRAMES, 2);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(in, t->out, AUDIO_MIXER_BLOCK_FRAMES * 2);
+    tone_destroy(t);
+}
+
+TEST_CASE("mixer keeps a port's pitch across an output rate change", "[audio][mixer]")
+{
+    // 44.1 kHz data; the output moves to 48 kHz (a stream at its own rate)
+    // and back, as audio_output_switch does between blocks
+    tone_t *t = tone_create(44100, 44100, 2, 3.0);
+    for (int b = 0; b < 44100 / AUDIO_MIXER_BLOCK_FRAMES; b++) {
+        tone_mix(t);
+    }
+    TEST_ASSERT_FALSE(t->mixer->ports[0].resample);
+
+    audio_mixer_set_rate(t->mixer, 48000);
+    TEST_ASSERT_TRUE(t->mixer->ports[0].resample);
+    t->frames = 0;
+    t->crossings = 0;
+    for (int b = 0; b < 48000 / AUDIO_MIXER_BLOCK_FRAMES; b++) {
+        TEST_ASSERT_EQUAL(1, tone_mix(t));
+    }
+    // ~1 s at 48 kHz still holds ~1000 cycles
+    TEST_ASSERT_UINT32_WITHIN(2, (uint32_t)(t->frames * TONE_HZ / 48000), t->crossings);
+
+    audio_mixer_set_rate(t->mixer, 44100);
+    TEST_ASSERT_FALSE(t->mixer->ports[0].resample);
+    tone_destroy(t);
+}
+
+// Frame-varying samples over the full int16 range, different per port and side
+static int16_t pattern(int port, size_t i)
+{
+    return (int16_t)((i * 7919 + port * 12345) * (port + 1));
+}
+
+static void queue_pattern(audio_ringbuf_t *ring, int port, uint8_t channels, size_t frames)
+{
+    int16_t buf[AUDIO_MIXER_BLOCK_FRAMES * 2];
+    for (size_t i = 0; i < frames * channels; i++) {
+        buf[i] = pattern(port, i);
+    }
+    TEST_ASSERT_EQUAL(frames * channels * sizeof(int16_t),
+                      audio_ringbuf_write(ring, buf, frames * channels * sizeof(int16_t)));
+}
+
+// What the mixer should make of port's pattern at output sample i, stereo
+static int32_t pattern_out(int port, uint8_t channels, size_t frames, size_t i)
+{
+    if (i >= frames * 2) {
+        return 0;
+    }
+    return channels == 1 ? pattern(port, i / 2) : pattern(port, i);
+}
+
+TEST_CASE("mixer sums ring ports and saturates once", "[audio][mixer]")
+{
+    // Stereo, mono, and a stereo port short of a full block
+    static const uint8_t channels[] = { 2, 1, 2 };
+    static const size_t frames[] = { AUDIO_MIXER_BLOCK_FRAMES, AUDIO_MIXER_BLOCK_FRAMES, 100 };
+    test_rig_t *r = test_rig_create(44100);
+    for (int p = 0; p < 3; p++) {
+        queue_pattern(test_rig_add_ring(r, p, RING_BYTES, channels[p], 0, 0), p, channels[p],
+                      frames[p]);
+    }
+
+    TEST_ASSERT_EQUAL(0x7, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    uint32_t clipped = 0;
+    for (size_t i = 0; i < AUDIO_MIXER_BLOCK_FRAMES * 2; i++) {
+        int32_t sum = 0;
+        for (int p = 0; p < 3; p++) {
+            sum += pattern_out(p, channels[p], frames[p], i);
+        }
+        clipped += sum != audio_gain_saturate(sum);
+        TEST_ASSERT_EQUAL_INT16(audio_gain_saturate(sum), r->out[i]);
+    }
+    // The sum went past int16 often enough for the clamp to be tested
+    TEST_ASSERT_GREATER_THAN(AUDIO_MIXER_BLOCK_FRAMES / 4, clipped);
+    TEST_ASSERT_EQUAL(1, r->mixer.ports[2].underruns);
+    test_rig_destroy(r);
+}
+
+TEST_CASE("mixer rebuffers only the ports with a resume mark", "[audio][mixer]")
+{
+    const size_t block_bytes = AUDIO_MIXER_BLOCK_FRAMES * 4;
+    const size_t resume = 2 * block_bytes;
+    test_rig_t *r = test_rig_create(44100);
+    audio_ringbuf_t *stream = test_rig_add_ring(r, 0, RING_BYTES, 2, 0, resume);
+    audio_ringbuf_t *direct = test_rig_add_ring(r, 1, RING_BYTES, 2, 0, 0);
+
+    // A block and a half each: the second block runs short on both
+    queue_pattern(stream, 0, 2, AUDIO_MIXER_BLOCK_FRAMES);
+    queue_pattern(stream, 0, 2, AUDIO_MIXER_BLOCK_FRAMES / 2);
+    queue_pattern(direct, 1, 2, AUDIO_MIXER_BLOCK_FRAMES);
+    queue_pattern(direct, 1, 2, AUDIO_MIXER_BLOCK_FRAMES / 2);
+    TEST_ASSERT_EQUAL(0x3, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    TEST_ASSERT_EQUAL(0x3, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    TEST_ASSERT_EQUAL_UINT32(1, r->mixer.ports[0].underruns);
+    TEST_ASSERT_EQUAL_UINT32(1, r->mixer.ports[1].underruns);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_BUFFERING, audio_mixer_port_state(&r->mixer, 0));
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_PLAYING, audio_mixer_port_state(&r->mixer, 1));
+
+    // A trickle: the stream waits for its mark, the other plays what came
+    queue_pattern(stream, 0, 2, 64);
+    queue_pattern(direct, 1, 2, 64);
+    TEST_ASSERT_EQUAL(0x2, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    TEST_ASSERT_EQUAL_UINT32(1, r->mixer.ports[0].underruns);
+    TEST_ASSERT_EQUAL_UINT32(2, r->mixer.ports[1].underruns);
+
+    // An empty ring is an idle producer, not an underrun
+    TEST_ASSERT_EQUAL(0, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    TEST_ASSERT_EQUAL_UINT32(2, r->mixer.ports[1].underruns);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_PLAYING, audio_mixer_port_state(&r->mixer, 1));
+
+    // At the resume mark the stream plays again, from the frame it stopped at
+    while (audio_ringbuf_fill(stream) < resume) {
+        queue_pattern(stream, 0, 2, 64);
+    }
+    TEST_ASSERT_EQUAL(0x1, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_PLAYING, audio_mixer_port_state(&r->mixer, 0));
+    for (size_t i = 0; i < 64 * 2; i++) {
+        TEST_ASSERT_EQUAL_INT16(pattern(0, i), r->out[i]);
+    }
+    test_rig_destroy(r);
+}
+
+TEST_CASE("mixer mono output is the mean of left and right", "[audio][mixer]")
+{
+    test_rig_t *r = test_rig_create(44100);
+    queue_pattern(test_rig_add_ring(r, 0, RING_BYTES, 2, 0, 0), 0, 2, AUDIO_MIXER_BLOCK_FRAMES);
+    queue_pattern(test_rig_add_ring(r, 1, RING_BYTES, 2, 0, 0), 1, 2, AUDIO_MIXER_BLOCK_FRAMES / 2);
+
+    // Both sides of both ports summed in 32 bits, halved, then saturated
+    memset(r->out, 0x55, sizeof(r->out));
+    TEST_ASSERT_EQUAL(0x3, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 1));
+    for (size_t i = 0; i < AUDIO_MIXER_BLOCK_FRAMES; i++) {
+        int32_t left = pattern_out(0, 2, AUDIO_MIXER_BLOCK_FRAMES, 2 * i) +
+                       pattern_out(1, 2, AUDIO_MIXER_BLOCK_FRAMES / 2, 2 * i);
+        int32_t right = pattern_out(0, 2, AUDIO_MIXER_BLOCK_FRAMES, 2 * i + 1) +
+                        pattern_out(1, 2, AUDIO_MIXER_BLOCK_FRAMES / 2, 2 * i + 1);
+        TEST_ASSERT_EQUAL_INT16(audio_gain_saturate((left + right) >> 1), r->out[i]);
+    }
+    // One sample per frame: the second half of the buffer is not written
+    TEST_ASSERT_EQUAL_INT16((int16_t)0x5555, r->out[AUDIO_MIXER_BLOCK_FRAMES]);
+    test_rig_destroy(r);
+}
+
+TEST_CASE("mixer scales each port by its own gain", "[audio][mixer]")
+{
+    static const uint16_t gains[] = { AUDIO_GAIN_UNITY / 4, AUDIO_GAIN_UNITY, 1000 };
+    test_rig_t *r = test_rig_create(44100);
+    for (int p = 0; p < 3; p++) {
+        queue_pattern(test_rig_add_ring(r, p, RING_BYTES, 2, 0, 0), p, 2, AUDIO_MIXER_BLOCK_FRAMES);
+        audio_mixer_set_gain(&r->mixer, p, gains[p]);
+    }
+    // Above unity is capped: ports only ever cut
+    audio_mixer_set_gain(&r->mixer, 3, 50000);
+    TEST_ASSERT_EQUAL(AUDIO_GAIN_UNITY, r->mixer.ports[3].gain);
+
+    TEST_ASSERT_EQUAL(0x7, audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2));
+    for (size_t i = 0; i < AUDIO_MIXER_BLOCK_FRAMES * 2; i++) {
+        int32_t sum = 0;
+        for (int p = 0; p < 3; p++) {
+            int16_t s = pattern(p, i);
+            audio_gain_apply_scalar(&s, 1, gains[p]);
+            sum += s;
+        }
+        TEST_ASSERT_EQUAL_INT16(audio_gain_saturate(sum), r->out[i]);
+    }
+
+    // Muted, the port still consumes its data but adds nothing
+    queue_pattern(&r->rings[0], 0, 2, AUDIO_MIXER_BLOCK_FRAMES);
+    for (int p = 0; p < 3; p++) {
+        audio_mixer_set_gain(&r->mixer, p, p == 0 ? 0 : gains[p]);
+    }
+    uint64_t before = r->mixer.ports[0].frames;
+    audio_mixer_mix(&r->mixer, r->out, AUDIO_MIXER_BLOCK_FRAMES, 2);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_BLOCK_FRAMES, r->mixer.ports[0].frames - before);
+    for (size_t i = 0; i < AUDIO_MIXER_BLOCK_FRAMES * 2; i++) {
+        TEST_ASSERT_EQUAL_INT16(0, r->out[i]);
+    }
+    test_rig_destroy(r);
+}
+
+// A generator port: a ramp, frames_left of it, handed out in short pieces
+typedef struct {
+    size_t frames_left;
+    int16_t next;
+    uint32_t calls;
+} ramp_t;
+
+static size_t ramp_render(void *ctx, int16_t *out, size_t frames)
+{
+    ramp_t *g = ctx;
+    g->calls++;
+    size_t n = frames < 100 ? frames : 100;
+    n = n < g->frames_left ? n : g->frames_left;
+    for (size_t i = 0; i < n; i++) {
+        out[2 * i] = g->next;
+        out[2 * i + 1] = (int16_t)-g->next;
+        g->next++;
+    }
+    g->frames_left -= n;
+    return n;
+}
+
+TEST_CASE("mixer plays a render port alongside a ring port", "[audio][mixer]")
+{
+    test_rig_t *r = test_rig_create(44100);
+    queue_pattern(test_rig_add_ring(r, 0, RING_BYTES, 2, 0, 0), 0, 2, AUDIO_MIXER_BLOCK_FRAMES);
+    ramp_t ramp = { .frames_left = 150, .next = 1000 };
+    audio_mixer_attach_render(&r->mixer, 2, ramp_render, &ramp);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_OFF, audio_mixer_port_state(&r->mixer, 2));
+
+    // Off until started; once started it plays at once, with no marks
+    TEST_ASSERT_EQUAL(0x1, audio_mixer_mix(&r->mixer, r->out, 64, 2));
+    TEST_ASSERT_EQUAL_UINT32(0, ramp.calls);
+    audio_mixer_start(&r->mixer, 2);
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_PLAYING, audio_mixer_port_state(&r->mixer, 2));
+
+    TEST_ASSERT_EQUAL(0x5, audio_mixer_mix(&r->mixer, r->out, 128, 2));
+    TEST_ASSERT_EQUAL_UINT32(1, ramp.calls);
+    TEST_ASSERT_EQUAL(100, r->mixer.ports[2].frames);
+    for (size_t i = 0; i < 128 * 2; i++) {
+        int32_t ring = pattern(0, 64 * 2 + i);
+        int32_t gen = i < 200 ? ((i & 1) ? -(1000 + (int32_t)i / 2) : 1000 + (int32_t)i / 2) : 0;
+        TEST_ASSERT_EQUAL_INT16(audio_gain_saturate(ring + gen), r->out[i]);
+    }
+
+    // The rest of the ramp, then nothing: the port stays on but adds no bit
+    TEST_ASSERT_EQUAL(0x5, audio_mixer_mix(&r->mixer, r->out, 128, 2));
+    TEST_ASSERT_EQUAL(150, r->mixer.ports[2].frames);
+    TEST_ASSERT_EQUAL(0x1, audio_mixer_mix(&r->mixer, r->out, 128, 2));
+    TEST_ASSERT_EQUAL(AUDIO_MIXER_PORT_PLAYING, audio_mixer_port_state(&r->mixer, 2));
+
+    // Stopped, it is not called at all
+    audio_mixer_stop(&r->mixer, 2);
+    uint32_t calls = ramp.calls;
+    audio_mixer_mix(&r->mixer, r->out, 128, 2);
+    TEST_ASSERT_EQUAL_UINT32(calls, ramp.calls);
+    test_rig_destroy(r);
+}
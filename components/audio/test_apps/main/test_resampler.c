@@ -0,0 +1,243 @@
+#include "audio_resampler.h"
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "test_resampler";
+
+static const struct {
+    uint32_t in;
+    uint32_t out;
+} s_rates[] = {
+    { 48000, 44100 },  // Down, the common case
+    { 96000, 44100 },
+    { 22050, 44100 },  // Up by 2 (HE-AAC core)
+    { 8000, 44100 },
+    { 44100, 48000 },
+};
+
+#define RESAMPLER_TEST_MAX_TAPS 32
+
+static const char *s_quality_names[] = { "low", "medium", "high" };
+
+#if AUDIO_RESAMPLER_HAVE_PIE
+#define SIMD_DOT audio_resampler_dot_pie
+#define SIMD_NAME "pie"
+#else
+// What the PIE kernel does, lane by lane: aligned quadwords shifted into place
+// by the byte offset of x, eight products per step into a 40-bit accumulator,
+// and the same read-ahead. On the host this checks the layout and slack the
+// assembly relies on; on the ESP32-S3 the assembly itself is tested.
+static int32_t dot_lanes(const int16_t *x, const int16_t *c, int taps)
+{
+    TEST_ASSERT_EQUAL(0, (uintptr_t)c % 16);
+    const uint8_t *q = (const uint8_t *)((uintptr_t)x & ~(uintptr_t)15);
+    size_t sar = (uintptr_t)x & 15;
+    uint8_t pair[32];
+    int16_t xv[8];
+    int16_t cv[8];
+
+    memcpy(pair, q, 16);
+    memcpy(pair + 16, q + 16, 16);
+    q += 32;
+    memcpy(cv, c, 16);
+    c += 8;
+    int64_t accx = 0;
+    for (int i = 0; i < taps / 8; i++) {
+        memcpy(xv, pair + sar, 16);
+        memmove(pair, pair + 16, 16);
+        memcpy(pair + 16, q, 16);
+        q += 16;
+        for (int lane = 0; lane < 8; lane++) {
+            accx += xv[lane] * cv[lane];
+        }
+        memcpy(cv, c, 16);
+        c += 8;
+    }
+    // ACCX_0, saturated using ACCX_1
+    if (accx > INT32_MAX) {
+        return INT32_MAX;
+    }
+    if (accx < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (int32_t)accx;
+}
+#define SIMD_DOT dot_lanes
+#define SIMD_NAME "lane model"
+#endif
+
+// Noise, full-scale square bursts and silence: every tap sees extremes
+static int16_t *make_input(size_t frames)
+{
+    int16_t *in = malloc(frames * 2 * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(in);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < frames * 2; i++) {
+        seed = seed * 1664525 + 1013904223;
+        size_t frame = i / 2;
+        if (frame % 1000 < 200) {
+            in[i] = (frame / 3) % 2 ? INT16_MAX : INT16_MIN;
+        } else if (frame % 1000 < 250) {
+            in[i] = 0;
+        } else {
+            in[i] = (int16_t)(seed >> 16);
+        }
+    }
+    return in;
+}
+
+// Feeds in through rs in random block sizes; returns the frames produced
+static size_t run(audio_resampler_t *rs, const int16_t *in, size_t frames, int16_t *out,
+                  size_t out_cap, uint32_t seed)
+{
+    size_t produced = 0;
+    size_t pos = 0;
+    while (pos < frames) {
+        seed = seed * 1664525 + 1013904223;
+        // Up to twice the history, so it is filled to the end and the kernels
+        // read into the slack
+        size_t block = 1 + (seed >> 16) % (2 * AUDIO_RESAMPLER_BLOCK_FRAMES);
+        if (block > frames - pos) {
+            block = frames - pos;
+        }
+        size_t used = 0;
+        produced += audio_resampler_process(rs, in + pos * 2, block, &used, out + produced * 2,
+                                            out_cap - produced);
+        pos += used;
+    }
+    return produced;
+}
+
+TEST_CASE("resampler kernels saturate a full-scale input that follows the taps",
+          "[audio][resampler]")
+{
+    // The worst case for every phase: the sum can pass 32 bits, and both
+    // kernels must saturate it rather than wrap
+    int16_t x[RESAMPLER_TEST_MAX_TAPS + 32] __attribute__((aligned(16)));
+    int wide = 0;
+    for (int q = 0; q < AUDIO_RESAMPLER_QUALITY_COUNT; q++) {
+        uint8_t *storage = malloc(audio_resampler_storage_size(q));
+        TEST_ASSERT_NOT_NULL(storage);
+        for (size_t r = 0; r < sizeof(s_rates) / sizeof(s_rates[0]); r++) {
+            audio_resampler_t rs;
+            audio_resampler_init(&rs, storage, q, s_rates[r].in, s_rates[r].out);
+            for (int p = 0; p < rs.phases; p++) {
+                const int16_t *c = rs.coeffs + p * rs.taps;
+                for (int sign = -1; sign <= 1; sign += 2) {
+                    int64_t sum = 0;
+                    memset(x, 0, sizeof(x));
+                    for (int k = 0; k < rs.taps; k++) {
+                        x[k + 1] = (c[k] < 0) == (sign > 0) ? INT16_MIN : INT16_MAX;
+                        sum += x[k + 1] * c[k];
+                    }
+                    int32_t expect = sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : (int32_t)sum;
+                    wide += expect != sum;
+                    // Unaligned x, as most outputs see
+                    TEST_ASSERT_EQUAL_INT32(expect, audio_resampler_dot_scalar(x + 1, c, rs.taps));
+                    TEST_ASSERT_EQUAL_INT32(expect, SIMD_DOT(x + 1, c, rs.taps));
+                }
+            }
+        }
+        free(storage);
+    }
+    // The case is real for these filters, not just in principle
+    TEST_ASSERT_GREATER_THAN(0, wide);
+}
+
+TEST_CASE("resampler SIMD and scalar kernels are bit-exact", "[audio][resampler]")
+{
+    const size_t frames = 6000;
+    int16_t *in = make_input(frames);
+    size_t cap = frames * 6 + 64;  // 8 -> 44.1 kHz
+    int16_t *ref = malloc(cap * 2 * sizeof(int16_t));
+    int16_t *simd = malloc(cap * 2 * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(ref);
+    TEST_ASSERT_NOT_NULL(simd);
+
+    for (int q = 0; q < AUDIO_RESAMPLER_QUALITY_COUNT; q++) {
+        // Separate storage, so any read-ahead past it is caught by the heap checks
+        size_t size = audio_resampler_storage_size(q);
+        uint8_t *storage_ref = malloc(size);
+        uint8_t *storage_simd = malloc(size);
+        TEST_ASSERT_NOT_NULL(storage_ref);
+        TEST_ASSERT_NOT_NULL(storage_simd);
+
+        for (size_t r = 0; r < sizeof(s_rates) / sizeof(s_rates[0]); r++) {
+            audio_resampler_t rs_ref;
+            audio_resampler_t rs_simd;
+            audio_resampler_init(&rs_ref, storage_ref, q, s_rates[r].in, s_rates[r].out);
+            audio_resampler_init(&rs_simd, storage_simd, q, s_rates[r].in, s_rates[r].out);
+            audio_resampler_set_dot(&rs_ref, audio_resampler_dot_scalar);
+            audio_resampler_set_dot(&rs_simd, SIMD_DOT);
+
+            // Different block sizes too: the output must not depend on them
+            size_t n_ref = run(&rs_ref, in, frames, ref, cap, 1);
+            size_t n_simd = run(&rs_simd, in, frames, simd, cap, 2);
+            TEST_ASSERT_EQUAL(n_ref, n_simd);
+            // All of it, less what is still inside the filter
+            TEST_ASSERT_INT_WITHIN(rs_ref.taps * s_rates[r].out / s_rates[r].in + 2,
+                                   (uint64_t)frames * s_rates[r].out / s_rates[r].in, n_ref);
+            TEST_ASSERT_EQUAL_INT16_ARRAY(ref, simd, n_ref * 2);
+        }
+        free(storage_ref);
+        free(storage_simd);
+    }
+    ESP_LOGI(TAG, "Scalar and %s kernels agree", SIMD_NAME);
+    free(ref);
+    free(simd);
+    free(in);
+}
+
+// Output samples (frames x 2) per second through one resampler, 48 -> 44.1 kHz
+static uint32_t bench_rate(audio_resampler_quality_t q, audio_resampler_dot_fn dot,
+                           const int16_t *in, size_t frames, int16_t *out, size_t cap)
+{
+    uint8_t *storage = malloc(audio_resampler_storage_size(q));
+    TEST_ASSERT_NOT_NULL(storage);
+    audio_resampler_t rs;
+    audio_resampler_init(&rs, storage, q, 48000, 44100);
+    audio_resampler_set_dot(&rs, dot);
+
+    // 1024-frame chunks, like the decode task
+    int64_t start = kraken_time_us();
+    size_t produced = 0;
+    for (size_t pos = 0; pos < frames;) {
+        size_t used = 0;
+        size_t n = frames - pos < 1024 ? frames - pos : 1024;
+        produced += audio_resampler_process(&rs, in + pos * 2, n, &used, out, cap);
+        pos += used;
+    }
+    int64_t elapsed = kraken_time_us() - start;
+    free(storage);
+    return (uint32_t)((uint64_t)produced * 2 * 1000000 / (elapsed ? elapsed : 1));
+}
+
+TEST_CASE("benchmark: resampler samples/s per quality", "[audio][resampler][bench]")
+{
+    const size_t frames = 48000;  // 1 s of input
+    int16_t *in = make_input(frames);
+    int16_t *out = malloc(2048 * 2 * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(out);
+
+    // Real time at 44.1 kHz stereo is 88200 samples/s
+    for (int q = 0; q < AUDIO_RESAMPLER_QUALITY_COUNT; q++) {
+        uint32_t scalar = bench_rate(q, audio_resampler_dot_scalar, in, frames, out, 2048);
+#if AUDIO_RESAMPLER_HAVE_PIE
+        uint32_t pie = bench_rate(q, audio_resampler_dot_pie, in, frames, out, 2048);
+        ESP_LOGI(TAG, "%-6s scalar %7" PRIu32 " ksamples/s (%3" PRIu32 "x real time), "
+                 "pie %7" PRIu32 " ksamples/s (%3" PRIu32 "x)", s_quality_names[q],
+                 scalar / 1000, scalar / 88200, pie / 1000, pie / 88200);
+        TEST_ASSERT_GREATER_THAN(88200, pie);
+#else
+        ESP_LOGI(TAG, "%-6s scalar %7" PRIu32 " ksamples/s (%3" PRIu32 "x real time)",
+                 s_quality_names[q], scalar / 1000, scalar / 88200);
+#endif
+        TEST_ASSERT_GREATER_THAN(88200, scalar);
+    }
+    free(out);
+    free(in);
+}
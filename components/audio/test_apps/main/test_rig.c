@@ -0,0 +1,43 @@
+#include "test_rig.h"
+#include "unity.h"
+#include <stdlib.h>
+
+test_rig_t *test_rig_create(uint32_t rate)
+{
+    test_rig_t *r = calloc(1, sizeof(*r));
+    TEST_ASSERT_NOT_NULL(r);
+    audio_mixer_init(&r->mixer);
+    audio_mixer_set_rate(&r->mixer, rate);
+    return r;
+}
+
+void test_rig_destroy(test_rig_t *r)
+{
+    for (int i = 0; i < AUDIO_MIXER_MAX_PORTS; i++) {
+        free(r->storage[i]);
+        free(r->rs_storage[i]);
+    }
+    free(r);
+}
+
+audio_ringbuf_t *test_rig_add_ring(test_rig_t *r, int port, size_t ring_bytes, uint8_t channels,
+                                   size_t start_bytes, size_t resume_bytes)
+{
+    TEST_ASSERT_NULL(r->storage[port]);
+    r->storage[port] = malloc(ring_bytes);
+    TEST_ASSERT_NOT_NULL(r->storage[port]);
+    audio_ringbuf_init(&r->rings[port], r->storage[port], ring_bytes);
+    audio_mixer_attach_ring(&r->mixer, port, &r->rings[port], channels, start_bytes, resume_bytes);
+    audio_mixer_start(&r->mixer, port);
+    return &r->rings[port];
+}
+
+void test_rig_set_port_rate(test_rig_t *r, int port, uint32_t rate, uint8_t channels)
+{
+    if (!r->rs_storage[port]) {
+        r->rs_storage[port] = malloc(audio_resampler_storage_size(AUDIO_RESAMPLER_MEDIUM));
+        TEST_ASSERT_NOT_NULL(r->rs_storage[port]);
+    }
+    audio_mixer_set_format(&r->mixer, port, rate, channels, r->rs_storage[port],
+                           AUDIO_RESAMPLER_MEDIUM);
+}
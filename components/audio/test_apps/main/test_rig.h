@@ -0,0 +1,27 @@
+#pragma once
+
+#include "audio_mixer.h"
+#include "audio_ringbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A mixer with ring ports as audio_service.c sets them up, for the mixer and
+// jitter buffer tests. Rings and resampler storage are on the heap, so a test
+// can size them as the case needs.
+typedef struct {
+    audio_mixer_t mixer;
+    audio_ringbuf_t rings[AUDIO_MIXER_MAX_PORTS];
+    uint8_t *storage[AUDIO_MIXER_MAX_PORTS];
+    uint8_t *rs_storage[AUDIO_MIXER_MAX_PORTS];
+    int16_t out[AUDIO_MIXER_BLOCK_FRAMES * 2];
+} test_rig_t;
+
+// No ports yet; rate 0 leaves the output rate unset
+test_rig_t *test_rig_create(uint32_t rate);
+void test_rig_destroy(test_rig_t *r);
+
+// A ring of ring_bytes on port, attached with the marks and started
+audio_ringbuf_t *test_rig_add_ring(test_rig_t *r, int port, size_t ring_bytes, uint8_t channels,
+                                   size_t start_bytes, size_t resume_bytes);
+// Data on port at its own rate, through a medium-quality resampler
+void test_rig_set_port_rate(test_rig_t *r, int port, uint32_t rate, uint8_t channels);
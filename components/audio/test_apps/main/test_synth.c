@@ -0,0 +1,148 @@
+#include "audio_synth.h"
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_log.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+
+static const char *TAG = "test_synth";
+
+#define RATE 44100
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Error of one sustained voice against the exact sine at the same phase steps
+typedef struct {
+    double max_err;   // LSB
+    double snr_db;
+} synth_accuracy_t;
+
+static synth_accuracy_t measure(float freq_hz, uint16_t amplitude)
+{
+    audio_synth_t synth;
+    audio_synth_init(&synth, RATE);
+    audio_synth_note_t note = { .freq_hz = freq_hz, .amplitude = amplitude };
+    int voice = audio_synth_start(&synth, &note);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, voice);
+    uint32_t inc = synth.voices[voice].phase_inc;
+
+    // One second, rendered in mixer-sized blocks
+    int16_t block[512 * 2];
+    uint32_t phase = 0;
+    double signal = 0;
+    double noise = 0;
+    double max_err = 0;
+    for (int b = 0; b < RATE / 512; b++) {
+        audio_synth_render(&synth, block, 512);
+        for (int i = 0; i < 512; i++) {
+            double exact = amplitude * sin(2.0 * M_PI * phase / 4294967296.0);
+            double err = fabs(block[2 * i] - exact);
+            TEST_ASSERT_EQUAL_INT16(block[2 * i], block[2 * i + 1]);
+            signal += exact * exact;
+            noise += err * err;
+            max_err = err > max_err ? err : max_err;
+            phase += inc;
+        }
+    }
+    synth_accuracy_t acc = { max_err, 10.0 * log10(signal / noise) };
+    return acc;
+}
+
+TEST_CASE("synth sine keeps its quoted accuracy: 4.5 LSB, 81 dB SNR", "[audio][synth]")
+{
+    static const float freqs[] = { 50.0f, 440.0f, 1000.0f, 3520.0f, 12000.0f };
+    double worst_err = 0;
+    double worst_snr = 1000;
+    for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+        synth_accuracy_t acc = measure(freqs[f], 32767);
+        ESP_LOGI(TAG, "%5.0f Hz: max error %.2f LSB, SNR %.1f dB", freqs[f], acc.max_err,
+                 acc.snr_db);
+        worst_err = acc.max_err > worst_err ? acc.max_err : worst_err;
+        worst_snr = acc.snr_db < worst_snr ? acc.snr_db : worst_snr;
+    }
+    // The figures in audio_synth.h, rounded from 4.53 LSB and 81.2 dB. Unity
+    // compares integers, so the doubles are compared here.
+    TEST_ASSERT_TRUE(worst_err < 4.6);
+    TEST_ASSERT_TRUE(worst_snr >= 81.0);
+}
+
+TEST_CASE("synth beep lasts exactly its attack, hold and release", "[audio][synth]")
+{
+    audio_synth_t synth;
+    audio_synth_init(&synth, RATE);
+    audio_synth_note_t note = { .freq_hz = 1000.0f, .amplitude = 16384, .attack_ms = 5,
+                                .duration_ms = 100, .release_ms = 20 };
+    TEST_ASSERT_EQUAL(0, audio_synth_start(&synth, &note));
+
+    // Each stage is a whole number of frames: 220 + 4410 + 882
+    const int total = RATE * 5 / 1000 + RATE * 100 / 1000 + RATE * 20 / 1000;
+    int16_t frame[2];
+    int frames = 0;
+    int last_sound = -1;
+    while (audio_synth_active(&synth)) {
+        TEST_ASSERT_LESS_THAN(total + 1, frames);
+        audio_synth_render(&synth, frame, 1);
+        if (frame[0] != 0) {
+            last_sound = frames;
+        }
+        frames++;
+    }
+    TEST_ASSERT_EQUAL(total, frames);
+    // The release ramps to nothing, not cut off: sound until its last few frames
+    TEST_ASSERT_GREATER_THAN(total - RATE / 1000, last_sound);
+}
+
+// The test tone before the synth: powf per chunk, sin() per sample
+static __attribute__((noinline)) void tone_sin(int16_t *buffer, int frames, float *phase,
+                                               float phase_increment, uint8_t volume)
+{
+    float volume_scale = powf(volume / 100.0f, 2.0f);
+    float p = *phase;
+    for (int i = 0; i < frames; i++) {
+        int16_t sample = (int16_t)(sin(p) * 26214.0f * volume_scale);
+        buffer[i * 2] = sample;
+        buffer[i * 2 + 1] = sample;
+        p += phase_increment;
+        if (p >= 2.0f * (float)M_PI) {
+            p -= 2.0f * (float)M_PI;
+        }
+    }
+    *phase = p;
+}
+
+TEST_CASE("benchmark: synth frames/s against sin()", "[audio][synth][bench]")
+{
+    const int seconds = 5;
+    int16_t *block = malloc(512 * 2 * sizeof(int16_t));
+    TEST_ASSERT_NOT_NULL(block);
+
+    audio_synth_t synth;
+    audio_synth_init(&synth, RATE);
+    audio_synth_note_t note = { .freq_hz = 440.0f, .amplitude = 26214 };
+    TEST_ASSERT_EQUAL(0, audio_synth_start(&synth, &note));
+    int64_t start = kraken_time_us();
+    for (int b = 0; b < seconds * RATE / 512; b++) {
+        audio_synth_render(&synth, block, 512);
+    }
+    int64_t synth_us = kraken_time_us() - start;
+
+    float phase = 0;
+    start = kraken_time_us();
+    for (int b = 0; b < seconds * RATE / 512; b++) {
+        tone_sin(block, 512, &phase, 2.0f * (float)M_PI * 440.0f / RATE, 100);
+    }
+    int64_t sin_us = kraken_time_us() - start;
+    free(block);
+
+    uint64_t frames = (uint64_t)seconds * RATE / 512 * 512;
+    uint32_t synth_fps = (uint32_t)(frames * 1000000 / (synth_us ? synth_us : 1));
+    uint32_t sin_fps = (uint32_t)(frames * 1000000 / (sin_us ? sin_us : 1));
+    ESP_LOGI(TAG, "one voice %" PRIu32 " kframes/s (%" PRIu32 "x real time), sin() %" PRIu32
+             " kframes/s: %" PRIu32 ".%" PRIu32 "x faster", synth_fps / 1000, synth_fps / RATE,
+             sin_fps / 1000, synth_fps / sin_fps, (uint32_t)(synth_fps * 10ULL / sin_fps % 10));
+    TEST_ASSERT_GREATER_THAN(RATE, synth_fps);
+    TEST_ASSERT_GREATER_THAN(sin_fps, synth_fps);
+}
@@ -1,6 +1,7 @@
 #include "kraken/bt_service.h"
 #include "kraken/bt_profiles.h"
 #include "kraken/kernel.h"
+#include "kraken/power_service.h"
 #include "esp_log.h"
 #include <string.h>
 
@@ -28,8 +29,22 @@ static struct {
     esp_gatt_if_t gattc_if;
     uint16_t conn_id;
     uint16_t mtu;
+    power_lock_t *link_lock;   // NO_SLEEP while a BLE link is up
+    bool link_lock_held;
 } g_bt = {0};
 
+// A connected link needs the controller serviced on time; no light sleep meanwhile
+static void bt_link_lock_update(bool connected)
+{
+    if (connected && !g_bt.link_lock_held) {
+        power_lock_acquire(g_bt.link_lock);
+        g_bt.link_lock_held = true;
+    } else if (!connected && g_bt.link_lock_held) {
+        power_lock_release(g_bt.link_lock);
+        g_bt.link_lock_held = false;
+    }
+}
+
 static void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
 {
     switch (event) {
@@ -45,6 +60,7 @@ static void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_
                 g_bt.conn_id = param->open.conn_id;
                 g_bt.connected = true;
                 g_bt.connecting = false;
+                bt_link_lock_update(true);
                 memcpy(g_bt.remote_bda, param->open.remote_bda, BT_MAC_ADDR_LEN);
                 ESP_LOGI(TAG, "BLE GATT connected, conn_id=%d, MTU=%d", g_bt.conn_id, param->open.mtu);
                 
@@ -64,6 +80,7 @@ static void gattc_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_
             ESP_LOGI(TAG, "BLE GATT disconnected, reason=%d", param->close.reason);
             g_bt.connected = false;
             g_bt.connecting = false;
+            bt_link_lock_update(false);
             g_bt.conn_id = 0;
             memset(g_bt.remote_bda, 0, BT_MAC_ADDR_LEN);
             kraken_event_post(KRAKEN_EVENT_BT_DISCONNECTED, NULL, 0);
@@ -257,6 +274,7 @@ esp_err_t bt_service_init(void)
 
     esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_bt_controller_init(&bt_cfg));
+    ESP_ERROR_CHECK(power_lock_create(POWER_LOCK_NO_SLEEP, "ble_link", &g_bt.link_lock));
 
     g_bt.initialized = true;
     ESP_LOGI(TAG, "BT service initialized");
@@ -279,6 +297,8 @@ esp_err_t bt_service_deinit(void)
     }
 
     esp_bt_controller_deinit();
+    power_lock_delete(g_bt.link_lock);
+    g_bt.link_lock = NULL;
 
     g_bt.initialized = false;
     ESP_LOGI(TAG, "BT service deinitialized");
@@ -342,6 +362,7 @@ esp_err_t bt_service_disable(void)
     g_bt.enabled = false;
     g_bt.connected = false;
     g_bt.connecting = false;
+    bt_link_lock_update(false);
     memset(g_bt.remote_bda, 0, BT_MAC_ADDR_LEN);
     
     ESP_LOGI(TAG, "BLE disabled");
@@ -1,6 +1,7 @@
 #include "kraken/display_service.h"
 #include "kraken/kernel.h"
 #include "kraken/bsp.h"
+#include "kraken/power_service.h"
 #include "ui_internal.h"
 #include "esp_lvgl_port.h"
 #include "esp_lcd_panel_io.h"
@@ -8,24 +9,53 @@
 #include "esp_lcd_panel_ops.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
-#include "esp_timer.h"
 #include <string.h>
 
 static const char *TAG = "display_service";
 
 #define UI_UPDATE_PERIOD_MS 1000  // Update UI every second
+#define UI_UPDATE_SLACK_MS 50     // Clock/status refresh can share a wakeup
 
 static struct {
     bool initialized;
     lv_display_t *disp;
     esp_lcd_panel_handle_t panel_handle;
     lv_obj_t *screen;
-    esp_timer_handle_t update_timer;
+    void *update_timer;
+    power_lock_t *refresh_lock;  // CPU_MAX from LVGL refresh start until flushed
 } g_display = {0};
 
 static void ui_update_timer_callback(void *arg);
 
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+KRAKEN_CYCLE_STAT_DEFINE(s_refresh_cycles, "display_refresh");
+static uint32_t s_refresh_start;
+static int s_refresh_core;
+#endif
+
+// LVGL refresh (render + flush) on the LVGL task. The flush callback itself
+// belongs to esp_lvgl_port, so the refresh is bracketed by the display events
+// around it: full CPU clock while drawing, idle frequency in between.
+static KRAKEN_IRAM_ATTR void display_refresh_event_cb(lv_event_t *e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_REFR_START) {
+        power_lock_acquire(g_display.refresh_lock);
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+        s_refresh_start = esp_cpu_get_cycle_count();
+        s_refresh_core = esp_cpu_get_core_id();
+#endif
+    } else {
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+        kraken_cycle_stat_record(&s_refresh_cycles, s_refresh_core,
+                                 esp_cpu_get_cycle_count() - s_refresh_start);
+#endif
+        power_lock_release(g_display.refresh_lock);
+    }
+}
+
 esp_err_t display_service_init(void)
 {
     if (g_display.initialized) {
@@ -72,12 +102,19 @@ esp_err_t display_service_init(void)
 
     const lvgl_port_cfg_t lvgl_cfg = {
         .task_priority = configMAX_PRIORITIES - 3,
-        .task_stack = 6144,
+        .task_stack = CONFIG_KRAKEN_LVGL_TASK_STACK_SIZE,
         .task_affinity = 1,
         .timer_period_ms = 5,
     };
     ESP_ERROR_CHECK(lvgl_port_init(&lvgl_cfg));
 
+    // esp_lvgl_port owns the task; register it so its stack shows in the report
+    void *lvgl_task = xTaskGetHandle("taskLVGL");
+    if (lvgl_task) {
+        kraken_task_register(lvgl_task, CONFIG_KRAKEN_LVGL_TASK_STACK_SIZE,
+                             "CONFIG_KRAKEN_LVGL_TASK_STACK_SIZE");
+    }
+
     const lvgl_port_display_cfg_t disp_cfg = {
         .io_handle = io_handle,
         .panel_handle = g_display.panel_handle,
@@ -88,10 +125,14 @@ esp_err_t display_service_init(void)
         .monochrome = false,
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
+            .buff_dma = 1,    // Render buffers are hot: keep them in internal DMA RAM, not PSRAM
             .swap_bytes = 1,  // Critical for correct colors!
         },
     };
     g_display.disp = lvgl_port_add_disp(&disp_cfg);
+    ESP_ERROR_CHECK(power_lock_create(POWER_LOCK_CPU_MAX, "display_refr", &g_display.refresh_lock));
+    lv_display_add_event_cb(g_display.disp, display_refresh_event_cb, LV_EVENT_REFR_START, NULL);
+    lv_display_add_event_cb(g_display.disp, display_refresh_event_cb, LV_EVENT_REFR_READY, NULL);
 
     // Lock LVGL for thread-safe operations
     lvgl_port_lock(0);
@@ -118,13 +159,18 @@ esp_err_t display_service_init(void)
     lvgl_port_unlock();
 
     // Create periodic timer for UI updates
-    esp_timer_create_args_t timer_args = {
-        .callback = ui_update_timer_callback,
+    kraken_timer_config_t timer_cfg = {
         .name = "ui_update",
-        .arg = NULL
+        .period_ms = UI_UPDATE_PERIOD_MS,
+        .auto_reload = true,
+        .slack_ms = UI_UPDATE_SLACK_MS,
+        .callback = ui_update_timer_callback,
+        .arg = NULL,
+        // Waits for the LVGL lock, so keep it off the timer task
+        .executor = kraken_work_executor(KRAKEN_WORK_PRIO_NORMAL, KRAKEN_WORK_CORE_ANY),
     };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &g_display.update_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(g_display.update_timer, UI_UPDATE_PERIOD_MS * 1000));
+    ESP_ERROR_CHECK(kraken_timer_create_ex(&timer_cfg, &g_display.update_timer));
+    ESP_ERROR_CHECK(kraken_timer_start(g_display.update_timer));
 
     g_display.initialized = true;
     ESP_LOGI(TAG, "Display service initialized with modular UI");
@@ -150,15 +196,19 @@ esp_err_t display_service_deinit(void)
 
     // Stop update timer
     if (g_display.update_timer) {
-        esp_timer_stop(g_display.update_timer);
-        esp_timer_delete(g_display.update_timer);
+        kraken_timer_stop(g_display.update_timer);
+        kraken_timer_delete(g_display.update_timer);
+        g_display.update_timer = NULL;
     }
 
     // Deinit UI manager
     ui_manager_deinit();
 
+    kraken_task_unregister(xTaskGetHandle("taskLVGL"));
     lvgl_port_remove_disp(g_display.disp);
     lvgl_port_deinit();
+    power_lock_delete(g_display.refresh_lock);
+    g_display.refresh_lock = NULL;
 
     esp_lcd_panel_del(g_display.panel_handle);
 
@@ -100,13 +100,11 @@ static void update_focus(void)
 
 lv_obj_t *ui_audio_screen_create(lv_obj_t *parent)
 {
-    g_audio.volume = 50; // Default volume 50%
+    // The audio service owns the volume (restored after a warm boot)
+    g_audio.volume = audio_get_volume();
     g_audio.is_playing = false;
     g_audio.focus = FOCUS_BACK_BUTTON;
     
-    // Sync volume with audio service
-    audio_set_volume(g_audio.volume);
-    
     // Create main screen (hidden by default)
     g_audio.screen = lv_obj_create(parent);
     lv_obj_set_size(g_audio.screen, LV_HOR_RES, LV_VER_RES - TOPBAR_HEIGHT);
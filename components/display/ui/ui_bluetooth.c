@@ -7,6 +7,7 @@
 static const char *TAG = "ui_bluetooth";
 
 #define TOPBAR_HEIGHT 30
+#define BT_ARENA_BLOCK_SIZE 2048  // Scan results fit in one block
 #define DEVICE_LIST_HEIGHT 180
 #define DEVICE_ITEM_HEIGHT 40
 
@@ -37,7 +38,8 @@ static struct {
     uint8_t connected_mac[BT_MAC_ADDR_LEN];
     char connected_name[BT_DEVICE_NAME_MAX_LEN];
     uint8_t selected_mac[BT_MAC_ADDR_LEN];
-    bt_scan_result_t scan_results;
+    bt_scan_result_t *scan_results;  // From the arena, NULL until the first scan of a session
+    kraken_arena_t *arena;           // Per-session allocations; exists only while shown
     int selected_device_index;
 } g_bluetooth = {0};
 
@@ -46,6 +48,11 @@ static void create_device_list(void);
 static void update_device_selection(void);
 static void connect_to_device(const bt_device_info_t *device);
 
+static uint16_t scan_result_count(void)
+{
+    return g_bluetooth.scan_results ? g_bluetooth.scan_results->count : 0;
+}
+
 static void notification_timer_cb(lv_timer_t *timer)
 {
     if (g_bluetooth.notification) {
@@ -179,6 +186,14 @@ void ui_bluetooth_screen_show(void)
     g_bluetooth.selected_device_index = 0;
     update_device_selection();
     
+    // What this session allocates goes back in one step on hide. Without it
+    // the screen still works, it just lists no devices.
+    if (!g_bluetooth.arena &&
+        kraken_arena_create("ui_bluetooth", BT_ARENA_BLOCK_SIZE, KRAKEN_MEM_DEFAULT,
+                            &g_bluetooth.arena) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create screen arena");
+    }
+
     g_bluetooth.bt_enabled = bt_service_is_enabled();
     g_bluetooth.bt_connected = bt_service_is_connected();
     
@@ -219,6 +234,15 @@ void ui_bluetooth_screen_hide(void)
         lv_obj_add_flag(g_bluetooth.screen, LV_OBJ_FLAG_HIDDEN);
         ESP_LOGI(TAG, "Bluetooth screen hidden");
     }
+
+    // The list refers to the scan results: drop both, then the session's
+    // memory in one step. The next show scans again.
+    if (g_bluetooth.device_list) {
+        lv_obj_clean(g_bluetooth.device_list);
+    }
+    g_bluetooth.scan_results = NULL;
+    kraken_arena_destroy(g_bluetooth.arena);
+    g_bluetooth.arena = NULL;
 }
 
 static void bt_toggle_event_cb(lv_event_t *e)
@@ -244,36 +268,44 @@ void ui_bluetooth_update_scan_results(void)
         return;
     }
 
-    bt_service_get_scan_results(&g_bluetooth.scan_results);
-    
-    for (int i = 0; i < g_bluetooth.scan_results.count - 1; i++) {
-        for (int j = 0; j < g_bluetooth.scan_results.count - i - 1; j++) {
-            if (g_bluetooth.scan_results.devices[j].rssi < g_bluetooth.scan_results.devices[j + 1].rssi) {
-                bt_device_info_t temp = g_bluetooth.scan_results.devices[j];
-                g_bluetooth.scan_results.devices[j] = g_bluetooth.scan_results.devices[j + 1];
-                g_bluetooth.scan_results.devices[j + 1] = temp;
+    // Taken once per session, refilled on every scan
+    if (!g_bluetooth.scan_results) {
+        g_bluetooth.scan_results = kraken_arena_alloc(g_bluetooth.arena, sizeof(bt_scan_result_t));
+        if (!g_bluetooth.scan_results) {
+            return;  // Hidden, or no arena: nothing to list
+        }
+    }
+    memset(g_bluetooth.scan_results, 0, sizeof(bt_scan_result_t));
+    bt_service_get_scan_results(g_bluetooth.scan_results);
+    
+    for (int i = 0; i < scan_result_count() - 1; i++) {
+        for (int j = 0; j < scan_result_count() - i - 1; j++) {
+            if (g_bluetooth.scan_results->devices[j].rssi < g_bluetooth.scan_results->devices[j + 1].rssi) {
+                bt_device_info_t temp = g_bluetooth.scan_results->devices[j];
+                g_bluetooth.scan_results->devices[j] = g_bluetooth.scan_results->devices[j + 1];
+                g_bluetooth.scan_results->devices[j + 1] = temp;
             }
         }
     }
     
     create_device_list();
     
-    ESP_LOGI(TAG, "Found %d Bluetooth devices", g_bluetooth.scan_results.count);
+    ESP_LOGI(TAG, "Found %d Bluetooth devices", scan_result_count());
 }
 
 static void create_device_list(void)
 {
     lv_obj_clean(g_bluetooth.device_list);
     
-    if (g_bluetooth.scan_results.count == 0) {
+    if (scan_result_count() == 0) {
         lv_obj_t *label = lv_label_create(g_bluetooth.device_list);
         lv_label_set_text(label, "No devices found");
         lv_obj_set_style_text_color(label, lv_color_hex(0x7F7F7F), 0);
         return;
     }
     
-    for (int i = 0; i < g_bluetooth.scan_results.count; i++) {
-        bt_device_info_t *dev = &g_bluetooth.scan_results.devices[i];
+    for (int i = 0; i < scan_result_count(); i++) {
+        bt_device_info_t *dev = &g_bluetooth.scan_results->devices[i];
         
         lv_obj_t *item = lv_obj_create(g_bluetooth.device_list);
         lv_obj_set_width(item, LV_PCT(100));
@@ -420,18 +452,18 @@ void ui_bluetooth_handle_input(kraken_event_type_t input)
             g_bluetooth.focus = FOCUS_DISCONNECT_BUTTON;
             update_device_selection();
             ESP_LOGI(TAG, "Focus: Disconnect button");
-        } else if (g_bluetooth.focus == FOCUS_BT_TOGGLE && g_bluetooth.bt_enabled && g_bluetooth.scan_results.count > 0) {
+        } else if (g_bluetooth.focus == FOCUS_BT_TOGGLE && g_bluetooth.bt_enabled && scan_result_count() > 0) {
             g_bluetooth.focus = FOCUS_DEVICE_LIST;
             g_bluetooth.selected_device_index = 0;
             update_device_selection();
             ESP_LOGI(TAG, "Focus: Device list, index 0");
-        } else if (g_bluetooth.focus == FOCUS_DISCONNECT_BUTTON && g_bluetooth.bt_enabled && g_bluetooth.scan_results.count > 0) {
+        } else if (g_bluetooth.focus == FOCUS_DISCONNECT_BUTTON && g_bluetooth.bt_enabled && scan_result_count() > 0) {
             g_bluetooth.focus = FOCUS_DEVICE_LIST;
             g_bluetooth.selected_device_index = 0;
             update_device_selection();
             ESP_LOGI(TAG, "Focus: Device list, index 0");
         } else if (g_bluetooth.focus == FOCUS_DEVICE_LIST && 
-                   g_bluetooth.selected_device_index < g_bluetooth.scan_results.count - 1) {
+                   g_bluetooth.selected_device_index < scan_result_count() - 1) {
             g_bluetooth.selected_device_index++;
             update_device_selection();
             ESP_LOGI(TAG, "Selected device index: %d", g_bluetooth.selected_device_index);
@@ -459,8 +491,8 @@ void ui_bluetooth_handle_input(kraken_event_type_t input)
             bt_service_disconnect();
             ui_bluetooth_show_notification("Disconnecting...", 2000);
         } else if (g_bluetooth.focus == FOCUS_DEVICE_LIST) {
-            if (g_bluetooth.selected_device_index < g_bluetooth.scan_results.count) {
-                bt_device_info_t *dev = &g_bluetooth.scan_results.devices[g_bluetooth.selected_device_index];
+            if (g_bluetooth.selected_device_index < scan_result_count()) {
+                bt_device_info_t *dev = &g_bluetooth.scan_results->devices[g_bluetooth.selected_device_index];
                 memcpy(g_bluetooth.selected_mac, dev->mac, BT_MAC_ADDR_LEN);
                 
                 char mac_str[18];
@@ -491,9 +523,9 @@ void ui_bluetooth_on_bt_connected(void)
     g_bluetooth.bt_connected = true;
     memcpy(g_bluetooth.connected_mac, g_bluetooth.selected_mac, BT_MAC_ADDR_LEN);
     
-    for (int i = 0; i < g_bluetooth.scan_results.count; i++) {
-        if (memcmp(g_bluetooth.scan_results.devices[i].mac, g_bluetooth.selected_mac, BT_MAC_ADDR_LEN) == 0) {
-            strncpy(g_bluetooth.connected_name, g_bluetooth.scan_results.devices[i].name, 
+    for (int i = 0; i < scan_result_count(); i++) {
+        if (memcmp(g_bluetooth.scan_results->devices[i].mac, g_bluetooth.selected_mac, BT_MAC_ADDR_LEN) == 0) {
+            strncpy(g_bluetooth.connected_name, g_bluetooth.scan_results->devices[i].name, 
                    sizeof(g_bluetooth.connected_name) - 1);
             break;
         }
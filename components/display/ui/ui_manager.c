@@ -29,6 +29,19 @@ static void ui_event_handler(const kraken_event_t *event, void *user_data);
 static void ui_menu_selection_callback(ui_menu_item_t item);
 static void boot_animation_complete(void);
 
+#define UI_WARM_KEY "ui"
+
+// Open submenu, restored on a warm boot
+typedef struct {
+    uint8_t submenu;
+} ui_warm_state_t;
+
+static void ui_save_warm_state(void)
+{
+    ui_warm_state_t warm = { .submenu = g_ui.active_submenu };
+    kraken_warm_save(UI_WARM_KEY, &warm, sizeof(warm));
+}
+
 esp_err_t ui_manager_init(lv_obj_t *screen)
 {
     if (!screen) {
@@ -43,10 +56,18 @@ esp_err_t ui_manager_init(lv_obj_t *screen)
     memset(&g_ui.status, 0, sizeof(g_ui.status));
     g_ui.boot_animation_done = false;
 
+    g_ui.initialized = true;
+
+    // Waking from deep sleep or a reset: straight to the main UI
+    if (kraken_warm_boot()) {
+        ESP_LOGI(TAG, "Warm boot, skipping boot animation");
+        boot_animation_complete();
+        return ESP_OK;
+    }
+
     // Start boot animation first
     ESP_ERROR_CHECK(ui_boot_animation_start(screen, boot_animation_complete));
 
-    g_ui.initialized = true;
     ESP_LOGI(TAG, "UI Manager initialized with boot animation");
     return ESP_OK;
 }
@@ -88,6 +109,32 @@ static void boot_animation_complete(void)
     kraken_event_subscribe(KRAKEN_EVENT_INPUT_CENTER, ui_event_handler, NULL);
 
     g_ui.boot_animation_done = true;
+
+    // The RTC clock survives deep sleep and resets; no need to wait for SNTP
+    time_t now = time(NULL);
+    localtime_r(&now, &g_ui.status.current_time);
+    if (g_ui.status.current_time.tm_year >= (2020 - 1900)) {
+        g_ui.status.time_synced = true;
+        ui_topbar_update_time(&g_ui.status.current_time);
+    }
+
+    ui_warm_state_t warm;
+    if (kraken_warm_load(UI_WARM_KEY, &warm, sizeof(warm)) == ESP_OK) {
+        switch (warm.submenu) {
+            case SUBMENU_NETWORK:
+                ui_menu_selection_callback(UI_MENU_ITEM_NETWORK);
+                break;
+            case SUBMENU_BLUETOOTH:
+                ui_menu_selection_callback(UI_MENU_ITEM_BLUETOOTH);
+                break;
+            case SUBMENU_AUDIO:
+                ui_menu_selection_callback(UI_MENU_ITEM_AUDIO);
+                break;
+            default:
+                break;
+        }
+    }
+
     ESP_LOGI(TAG, "Main UI ready");
 }
 
@@ -279,6 +326,8 @@ static void ui_menu_selection_callback(ui_menu_item_t item)
         default:
             break;
     }
+
+    ui_save_warm_state();
 }
 
 void ui_manager_exit_submenu(void)
@@ -301,6 +350,7 @@ void ui_manager_exit_submenu(void)
         }
         
         g_ui.active_submenu = SUBMENU_NONE;
+        ui_save_warm_state();
         ESP_LOGI(TAG, "Submenu exited, back to main menu");
     }
 }
@@ -7,6 +7,7 @@
 static const char *TAG = "ui_network";
 
 #define TOPBAR_HEIGHT 30
+#define NETWORK_ARENA_BLOCK_SIZE 2048  // Scan results fit in one block
 #define NETWORK_LIST_HEIGHT 180
 #define NETWORK_ITEM_HEIGHT 40
 
@@ -40,7 +41,8 @@ static struct {
     bool wifi_connected;
     char connected_ssid[33];
     char selected_ssid[33];
-    wifi_scan_result_t scan_results;
+    wifi_scan_result_t *scan_results;  // From the arena, NULL until the first scan of a session
+    kraken_arena_t *arena;             // Per-session allocations; exists only while shown
     int selected_network_index;
     
     // Keyboard navigation
@@ -58,6 +60,11 @@ static void show_password_screen(const char *ssid);
 static void hide_password_screen(void);
 static void connect_to_wifi(const char *ssid, const char *password);
 
+static uint16_t scan_result_count(void)
+{
+    return g_network.scan_results ? g_network.scan_results->count : 0;
+}
+
 // Notification timer callback
 static void notification_timer_cb(lv_timer_t *timer)
 {
@@ -200,6 +207,14 @@ void ui_network_screen_show(void)
     }
 
     lv_obj_clear_flag(g_network.screen, LV_OBJ_FLAG_HIDDEN);
+
+    // What this session allocates goes back in one step on hide. Without it
+    // the screen still works, it just lists no networks.
+    if (!g_network.arena &&
+        kraken_arena_create("ui_network", NETWORK_ARENA_BLOCK_SIZE, KRAKEN_MEM_DEFAULT,
+                            &g_network.arena) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create screen arena");
+    }
     
     // Initialize focus to back button (now at top)
     g_network.focus = FOCUS_BACK_BUTTON;
@@ -253,6 +268,15 @@ void ui_network_screen_hide(void)
     
     // Hide password screen if showing
     hide_password_screen();
+
+    // The list refers to the scan results: drop both, then the session's
+    // memory in one step. The next show scans again.
+    if (g_network.network_list) {
+        lv_obj_clean(g_network.network_list);
+    }
+    g_network.scan_results = NULL;
+    kraken_arena_destroy(g_network.arena);
+    g_network.arena = NULL;
 }
 
 static void wifi_toggle_event_cb(lv_event_t *e)
@@ -284,17 +308,24 @@ void ui_network_update_scan_results(void)
         return;
     }
 
-    // Get scan results
-    wifi_service_get_scan_results(&g_network.scan_results);
+    // Get scan results; taken once per session, refilled on every scan
+    if (!g_network.scan_results) {
+        g_network.scan_results = kraken_arena_alloc(g_network.arena, sizeof(wifi_scan_result_t));
+        if (!g_network.scan_results) {
+            return;  // Hidden, or no arena: nothing to list
+        }
+    }
+    memset(g_network.scan_results, 0, sizeof(wifi_scan_result_t));
+    wifi_service_get_scan_results(g_network.scan_results);
     
     // Sort by signal strength (RSSI) - bubble sort for simplicity
-    for (int i = 0; i < g_network.scan_results.count - 1; i++) {
-        for (int j = 0; j < g_network.scan_results.count - i - 1; j++) {
-            if (g_network.scan_results.aps[j].rssi < g_network.scan_results.aps[j + 1].rssi) {
+    for (int i = 0; i < scan_result_count() - 1; i++) {
+        for (int j = 0; j < scan_result_count() - i - 1; j++) {
+            if (g_network.scan_results->aps[j].rssi < g_network.scan_results->aps[j + 1].rssi) {
                 // Swap
-                wifi_ap_info_t temp = g_network.scan_results.aps[j];
-                g_network.scan_results.aps[j] = g_network.scan_results.aps[j + 1];
-                g_network.scan_results.aps[j + 1] = temp;
+                wifi_ap_info_t temp = g_network.scan_results->aps[j];
+                g_network.scan_results->aps[j] = g_network.scan_results->aps[j + 1];
+                g_network.scan_results->aps[j + 1] = temp;
             }
         }
     }
@@ -302,7 +333,7 @@ void ui_network_update_scan_results(void)
     // Create network list UI
     create_network_list();
     
-    ESP_LOGI(TAG, "Found %d networks", g_network.scan_results.count);
+    ESP_LOGI(TAG, "Found %d networks", scan_result_count());
 }
 
 static void create_network_list(void)
@@ -310,7 +341,7 @@ static void create_network_list(void)
     // Clear existing list
     lv_obj_clean(g_network.network_list);
     
-    if (g_network.scan_results.count == 0) {
+    if (scan_result_count() == 0) {
         lv_obj_t *label = lv_label_create(g_network.network_list);
         lv_label_set_text(label, "No networks found");
         lv_obj_set_style_text_color(label, lv_color_hex(0x7F7F7F), 0);  // Gray
@@ -318,8 +349,8 @@ static void create_network_list(void)
     }
     
     // Create list items
-    for (int i = 0; i < g_network.scan_results.count; i++) {
-        wifi_ap_info_t *net = &g_network.scan_results.aps[i];
+    for (int i = 0; i < scan_result_count(); i++) {
+        wifi_ap_info_t *net = &g_network.scan_results->aps[i];
         
         // Create container for each network - full width
         lv_obj_t *item = lv_obj_create(g_network.network_list);
@@ -425,9 +456,9 @@ static void network_item_clicked(lv_event_t *e)
 {
     int index = (int)(intptr_t)lv_event_get_user_data(e);
     
-    if (index >= 0 && index < g_network.scan_results.count) {
+    if (index >= 0 && index < scan_result_count()) {
         g_network.selected_network_index = index;
-        strncpy(g_network.selected_ssid, g_network.scan_results.aps[index].ssid, sizeof(g_network.selected_ssid) - 1);
+        strncpy(g_network.selected_ssid, g_network.scan_results->aps[index].ssid, sizeof(g_network.selected_ssid) - 1);
         
         ESP_LOGI(TAG, "Selected network: %s", g_network.selected_ssid);
         
@@ -582,20 +613,20 @@ void ui_network_handle_input(kraken_event_type_t input)
             g_network.focus = FOCUS_DISCONNECT_BUTTON;
             update_network_selection();
             ESP_LOGI(TAG, "Focus: Disconnect button");
-        } else if (g_network.focus == FOCUS_WIFI_TOGGLE && g_network.wifi_enabled && g_network.scan_results.count > 0) {
+        } else if (g_network.focus == FOCUS_WIFI_TOGGLE && g_network.wifi_enabled && scan_result_count() > 0) {
             // Move focus to network list
             g_network.focus = FOCUS_NETWORK_LIST;
             g_network.selected_network_index = 0;
             update_network_selection();
             ESP_LOGI(TAG, "Focus: Network list, index 0");
-        } else if (g_network.focus == FOCUS_DISCONNECT_BUTTON && g_network.wifi_enabled && g_network.scan_results.count > 0) {
+        } else if (g_network.focus == FOCUS_DISCONNECT_BUTTON && g_network.wifi_enabled && scan_result_count() > 0) {
             // Move from disconnect to network list
             g_network.focus = FOCUS_NETWORK_LIST;
             g_network.selected_network_index = 0;
             update_network_selection();
             ESP_LOGI(TAG, "Focus: Network list, index 0");
         } else if (g_network.focus == FOCUS_NETWORK_LIST && 
-                   g_network.selected_network_index < g_network.scan_results.count - 1) {
+                   g_network.selected_network_index < scan_result_count() - 1) {
             // Move down in network list
             g_network.selected_network_index++;
             update_network_selection();
@@ -627,9 +658,9 @@ void ui_network_handle_input(kraken_event_type_t input)
             ui_network_show_notification("Disconnecting...", 2000);
         } else if (g_network.focus == FOCUS_NETWORK_LIST) {
             // Connect to selected network
-            if (g_network.selected_network_index < g_network.scan_results.count) {
+            if (g_network.selected_network_index < scan_result_count()) {
                 strncpy(g_network.selected_ssid, 
-                        g_network.scan_results.aps[g_network.selected_network_index].ssid,
+                        g_network.scan_results->aps[g_network.selected_network_index].ssid,
                         sizeof(g_network.selected_ssid) - 1);
                 ESP_LOGI(TAG, "Connecting to: %s", g_network.selected_ssid);
                 show_password_screen(g_network.selected_ssid);
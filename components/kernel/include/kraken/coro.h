@@ -0,0 +1,111 @@
+#pragma once
+
+#include "kraken/kernel.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stackless coroutines (protothread style) driven by the kernel event bus and
+// timers. All coroutines share the "kraken_coro" runner task, so a service
+// state machine costs a kraken_coro_t instead of a task stack.
+//
+// Locals do not survive an await: keep state in the context struct. Only one
+// KRAKEN_CORO_* / KRAKEN_AWAIT_* macro per source line, and no awaits inside
+// a switch statement of your own.
+
+typedef enum {
+    KRAKEN_CORO_WAITING = 0,
+    KRAKEN_CORO_YIELDED,
+    KRAKEN_CORO_DONE,
+} kraken_coro_status_t;
+
+typedef enum {
+    KRAKEN_CORO_WAKE_NONE = 0,
+    KRAKEN_CORO_WAKE_EVENT,
+    KRAKEN_CORO_WAKE_TIMEOUT,
+    KRAKEN_CORO_WAKE_IO,
+} kraken_coro_wake_t;
+
+typedef struct kraken_coro kraken_coro_t;
+typedef kraken_coro_status_t (*kraken_coro_fn_t)(kraken_coro_t *co);
+typedef bool (*kraken_coro_ready_fn_t)(void *arg);
+
+struct kraken_coro {
+    // Public while the coroutine runs
+    void *ctx;
+    kraken_event_t event;           // Copy of the event that resumed an event await
+    kraken_coro_wake_t wake_reason;
+
+    // Owned by the runner
+    const char *name;
+    kraken_coro_fn_t fn;
+    uint16_t lc;                    // Resume point (source line)
+    uint8_t state;
+    bool woken;                     // Wake arrived while the coroutine was running
+    bool cancelled;
+    kraken_event_type_t wait_event; // KRAKEN_EVENT_NONE: not waiting for an event
+    int64_t deadline_us;            // 0: no timeout
+    kraken_coro_ready_fn_t ready_fn;
+    void *ready_arg;
+    kraken_coro_t *next;
+};
+
+#define KRAKEN_CORO_NO_TIMEOUT 0
+
+// Caller owns the storage (usually static); it must stay valid until the
+// coroutine returns KRAKEN_CORO_DONE or kraken_coro_cancel() returns ESP_OK.
+esp_err_t kraken_coro_start(kraken_coro_t *co, const char *name, kraken_coro_fn_t fn, void *ctx);
+// ESP_OK: unlinked, the storage is free. ESP_ERR_NOT_FINISHED: a step or its
+// ready_fn is running right now; it will not resume, but the runner still uses
+// the storage until that call returns. Call again until ESP_OK before reusing it.
+esp_err_t kraken_coro_cancel(kraken_coro_t *co);
+// Re-check an I/O await now. Safe from ISRs and driver callbacks.
+void kraken_coro_wake(kraken_coro_t *co);
+
+// Used by the await macros
+void kraken_coro_wait_event(kraken_coro_t *co, kraken_event_type_t type, uint32_t timeout_ms);
+void kraken_coro_wait_timeout(kraken_coro_t *co, uint32_t timeout_ms);
+void kraken_coro_wait_io(kraken_coro_t *co, kraken_coro_ready_fn_t ready_fn, void *arg,
+                         uint32_t timeout_ms);
+
+#define KRAKEN_CORO_BEGIN(co) switch ((co)->lc) { case 0:
+
+#define KRAKEN_CORO_END(co) } (co)->lc = 0; return KRAKEN_CORO_DONE
+
+// Give other coroutines a turn; resumes on the next runner pass
+#define KRAKEN_CORO_YIELD(co) \
+    do { (co)->lc = __LINE__; return KRAKEN_CORO_YIELDED; case __LINE__:; } while (0)
+
+#define KRAKEN_CORO_EXIT(co) \
+    do { (co)->lc = 0; return KRAKEN_CORO_DONE; } while (0)
+
+// Resume when 'type' is posted (copied into co->event) or after timeout_ms
+#define KRAKEN_AWAIT_EVENT(co, type, timeout_ms) \
+    do { \
+        kraken_coro_wait_event((co), (type), (timeout_ms)); \
+        (co)->lc = __LINE__; return KRAKEN_CORO_WAITING; case __LINE__:; \
+    } while (0)
+
+#define KRAKEN_AWAIT_TIMEOUT(co, timeout_ms) \
+    do { \
+        kraken_coro_wait_timeout((co), (timeout_ms)); \
+        (co)->lc = __LINE__; return KRAKEN_CORO_WAITING; case __LINE__:; \
+    } while (0)
+
+// Resume once ready_fn(arg) is true or after timeout_ms. ready_fn is checked
+// by the runner after kraken_coro_wake() and every CONFIG_KRAKEN_CORO_IO_POLL_MS.
+#define KRAKEN_AWAIT_IO(co, ready_fn, arg, timeout_ms) \
+    do { \
+        kraken_coro_wait_io((co), (ready_fn), (arg), (timeout_ms)); \
+        (co)->lc = __LINE__; __attribute__((fallthrough)); case __LINE__: \
+        if (!KRAKEN_CORO_TIMED_OUT(co) && !(ready_fn)(arg)) { \
+            return KRAKEN_CORO_WAITING; \
+        } \
+    } while (0)
+
+#define KRAKEN_CORO_TIMED_OUT(co) ((co)->wake_reason == KRAKEN_CORO_WAKE_TIMEOUT)
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,14 +3,29 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+#include "esp_cpu.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define KRAKEN_SERVICE_NAME_MAX_LEN 32
-#define KRAKEN_MAX_SERVICES 16
-#define KRAKEN_MAX_EVENT_LISTENERS 32
+#define KRAKEN_MAX_SERVICES CONFIG_KRAKEN_MAX_SERVICES
+#define KRAKEN_MAX_EVENT_LISTENERS CONFIG_KRAKEN_MAX_EVENT_LISTENERS
+#define KRAKEN_WARM_KEY_MAX_LEN 12
+
+// Hot-path placement. Functions on per-event, per-sample or per-flush paths are
+// marked KRAKEN_IRAM_ATTR; the IRAM profile (CONFIG_KRAKEN_HOT_PATHS_IN_IRAM)
+// moves them out of flash so a cache miss cannot stall them.
+#if CONFIG_KRAKEN_HOT_PATHS_IN_IRAM
+#define KRAKEN_IRAM_ATTR IRAM_ATTR
+#else
+#define KRAKEN_IRAM_ATTR
+#endif
 
 typedef enum {
     KRAKEN_OK = 0,
@@ -76,13 +91,162 @@ typedef struct {
     kraken_event_type_t type;
     void *data;
     uint32_t data_len;
-    uint32_t timestamp;
+    uint64_t timestamp_us;  // kraken_time_us() when the event was posted
 } kraken_event_t;
 
+// Memory placement hints for kraken_malloc_ex()
+typedef enum {
+    KRAKEN_MEM_DEFAULT = 0,         // Let heap_caps decide (same as kraken_malloc)
+    KRAKEN_MEM_FAST = (1 << 0),     // Internal RAM - hot audio/render buffers
+    KRAKEN_MEM_LARGE = (1 << 1),    // PSRAM preferred - big, cold data
+    KRAKEN_MEM_DMA = (1 << 2),      // DMA-capable internal RAM (no fallback)
+} kraken_mem_flags_t;
+
+// Statistics are kept per placement class (the class that was requested)
+typedef enum {
+    KRAKEN_MEM_CLASS_DEFAULT = 0,
+    KRAKEN_MEM_CLASS_FAST,
+    KRAKEN_MEM_CLASS_LARGE,
+    KRAKEN_MEM_CLASS_DMA,
+    KRAKEN_MEM_CLASS_COUNT,
+} kraken_mem_class_t;
+
+typedef struct {
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t fail_count;
+    uint32_t fallback_count;  // Served from the other region than requested
+    size_t bytes_in_use;
+    size_t peak_bytes;
+} kraken_mem_stats_t;
+
+typedef enum {
+    KRAKEN_HEAP_REGION_INTERNAL = 0,
+    KRAKEN_HEAP_REGION_PSRAM,
+    KRAKEN_HEAP_REGION_COUNT,
+} kraken_heap_region_t;
+
+// Latest heap monitor sample; also the payload of KRAKEN_EVENT_SYSTEM_LOW_MEMORY
+typedef struct {
+    kraken_heap_region_t region;
+    size_t free_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;   // Low-water mark since boot
+    uint8_t fragmentation_pct;   // 100 - largest_free_block * 100 / free_bytes
+    bool low_free;               // free_bytes below the configured low-water mark
+    bool low_block;              // largest_free_block below the configured minimum
+    bool fragmented;             // fragmentation_pct above the configured threshold
+} kraken_heap_report_t;
+
+// Allocation profiler (CONFIG_KRAKEN_MEM_PROFILER)
+typedef uint32_t kraken_mem_checkpoint_t;
+
+typedef struct {
+    uint32_t leaked_count;   // Allocations made between the checkpoints still alive
+    size_t leaked_bytes;
+    uint32_t dropped_count;  // Allocations the tracking table had no room for
+} kraken_mem_leak_report_t;
+
 typedef void (*kraken_event_handler_t)(const kraken_event_t *event, void *user_data);
 
+// Runs fn(arg) somewhere other than the caller; returns ESP_OK once accepted
+typedef struct {
+    esp_err_t (*submit)(void (*fn)(void *), void *arg, void *ctx);
+    void *ctx;
+} kraken_executor_t;
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    bool auto_reload;
+    uint32_t slack_ms;                    // May fire up to this late, to share a wakeup
+    void (*callback)(void *);
+    void *arg;
+    const kraken_executor_t *executor;    // NULL: run on the timer task
+} kraken_timer_config_t;
+
+typedef struct {
+    uint32_t active_timers;
+    uint32_t wakeups;                 // Timer task wakeups
+    uint32_t fired;                   // Callbacks dispatched
+    uint32_t max_fired_per_wakeup;
+    uint32_t max_jitter_us;           // Dispatch delay past the (slack-adjusted) fire time
+    uint64_t total_jitter_us;         // Divide by fired for the mean
+} kraken_timer_stats_t;
+
+// Worker pool (kraken_work_submit)
+typedef enum {
+    KRAKEN_WORK_PRIO_LOW = 0,
+    KRAKEN_WORK_PRIO_NORMAL,
+    KRAKEN_WORK_PRIO_HIGH,
+    KRAKEN_WORK_PRIO_COUNT,
+} kraken_work_priority_t;
+
+#define KRAKEN_WORK_CORE_ANY (-1)
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t stolen;      // Jobs run by a worker on the other core
+    uint32_t rejected;    // Queue was full
+} kraken_work_stats_t;
+
+// Task registry (kraken_task_create / kraken_task_register)
+#define KRAKEN_TASK_CORE_ANY (-1)
+
+typedef struct {
+    const char *name;
+    void (*fn)(void *);
+    void *arg;
+    uint32_t stack_size;     // Bytes
+    uint32_t priority;
+    int core;                // 0, 1 or KRAKEN_TASK_CORE_ANY
+    const char *kconfig;     // Kconfig symbol that sizes the stack, named in the report
+    bool psram_stack;        // Stack in PSRAM; only for tasks that never run with the
+                             // flash cache disabled (no flash/NVS writes, no IRAM-only paths)
+} kraken_task_config_t;
+
+typedef struct {
+    uint32_t stack_size;
+    uint32_t min_free;        // Lowest high-water mark seen since registration
+    uint32_t last_free;       // Most recent sample
+    uint32_t suggested_size;  // Peak use plus the configured margins
+    uint32_t samples;
+} kraken_task_stack_info_t;
+
+// Cycle-count statistics for one hot path (KRAKEN_CYCLE_STAT_DEFINE)
+typedef struct kraken_cycle_stat {
+    const char *name;
+    uint32_t count;
+    uint32_t migrated;        // Samples dropped because the task changed core
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    bool registered;
+    struct kraken_cycle_stat *next;
+} kraken_cycle_stat_t;
+
+// Service supervisor (kraken_service_watch). Payload of KRAKEN_EVENT_SYSTEM_WATCHDOG.
+typedef enum {
+    KRAKEN_WATCHDOG_MISSED = 0,       // Heartbeat overdue, restart scheduled
+    KRAKEN_WATCHDOG_RESTARTED,        // Service stopped and started again
+    KRAKEN_WATCHDOG_RESTART_FAILED,   // Stop or start failed, retry scheduled with a longer backoff
+    KRAKEN_WATCHDOG_GAVE_UP,          // Restart limit reached, service left stopped
+} kraken_watchdog_action_t;
+
+typedef struct {
+    char service[KRAKEN_SERVICE_NAME_MAX_LEN];
+    kraken_watchdog_action_t action;
+    uint32_t overdue_ms;      // Time since the last heartbeat when the miss was detected
+    uint32_t restarts;        // Restarts since the service was last stable
+    uint32_t backoff_ms;      // Delay before the next restart attempt
+} kraken_watchdog_event_t;
+
+typedef struct kraken_watch kraken_watch_t;
+
 // Forward declaration - internal structure not exposed
 typedef struct kraken_service_t kraken_service_t;
+typedef struct kraken_arena_t kraken_arena_t;
 
 esp_err_t kraken_kernel_init(void);
 esp_err_t kraken_kernel_deinit(void);
@@ -95,6 +259,17 @@ esp_err_t kraken_service_unregister(const char *name);
 esp_err_t kraken_service_start(const char *name);
 esp_err_t kraken_service_stop(const char *name);
 
+// Supervision: a watched service must call kraken_service_heartbeat() at least
+// every timeout_ms while running. A miss posts KRAKEN_EVENT_SYSTEM_WATCHDOG and
+// restarts only that service (stop + start) with exponential backoff. name NULL
+// means the calling service (from its init). Watching again, e.g. from init after
+// a restart, returns the same handle and keeps the restart history.
+esp_err_t kraken_service_watch(const char *name, uint32_t timeout_ms, kraken_watch_t **watch);
+esp_err_t kraken_service_unwatch(const char *name);
+// A timestamp store; cheap enough for every loop iteration, safe from ISRs
+void kraken_service_heartbeat(kraken_watch_t *watch);
+void kraken_service_dump_watches(void);
+
 // Permission checking
 bool kraken_service_has_permission(const char *name, kraken_permission_t perm);
 esp_err_t kraken_check_caller_permission(kraken_permission_t required_perm);
@@ -120,19 +295,118 @@ esp_err_t kraken_event_post_from_isr(kraken_event_type_t event_type,
                                       void *data, uint32_t data_len);
 
 void *kraken_malloc(size_t size);
+void *kraken_malloc_ex(size_t size, uint32_t flags);
 void *kraken_calloc(size_t nmemb, size_t size);
 void *kraken_realloc(void *ptr, size_t size);
 void kraken_free(void *ptr);
 size_t kraken_get_free_heap_size(void);
 size_t kraken_get_minimum_free_heap_size(void);
+esp_err_t kraken_mem_get_stats(kraken_mem_class_t mem_class, kraken_mem_stats_t *stats);
+void kraken_mem_dump_stats(void);
+kraken_mem_checkpoint_t kraken_mem_checkpoint(void);
+esp_err_t kraken_mem_leak_check(kraken_mem_checkpoint_t from, kraken_mem_checkpoint_t to,
+                                 kraken_mem_leak_report_t *report);
+void kraken_mem_profile_dump(void);
+esp_err_t kraken_heap_monitor_get_report(kraken_heap_region_t region, kraken_heap_report_t *report);
+
+// Region (arena) allocator: bump allocation, released in one step by reset.
+// While a task is inside kraken_arena_enter()/kraken_arena_leave(), its
+// kraken_malloc/calloc calls are served from the arena and kraken_free is a no-op.
+// Only enter a scope around code whose allocations all die with the reset;
+// kernel objects (timers) are never taken from it.
+esp_err_t kraken_arena_create(const char *name, size_t block_size, uint32_t mem_flags,
+                               kraken_arena_t **arena);
+void kraken_arena_destroy(kraken_arena_t *arena);
+void *kraken_arena_alloc(kraken_arena_t *arena, size_t size);
+void kraken_arena_reset(kraken_arena_t *arena);
+size_t kraken_arena_get_used(const kraken_arena_t *arena);
+esp_err_t kraken_arena_enter(kraken_arena_t *arena);
+void kraken_arena_leave(void);
 
+// Shared worker pool: run short jobs without owning a task. Jobs with core
+// KRAKEN_WORK_CORE_ANY may be stolen by an idle worker on the other core.
+// Jobs must not block for long; a blocked job holds a worker.
+esp_err_t kraken_work_submit(void (*fn)(void *), void *arg,
+                              kraken_work_priority_t priority, int core);
+esp_err_t kraken_work_get_stats(kraken_work_stats_t *stats);
+// Executor for kraken_timer_config_t.executor that submits to the pool
+const kraken_executor_t *kraken_work_executor(kraken_work_priority_t priority, int core);
+
+// Kraken tasks are registered for stack high-water-mark sampling. Tasks created
+// elsewhere (e.g. by esp_lvgl_port) can be registered by handle. A registered
+// task must be unregistered (or deleted with kraken_task_delete) before it dies;
+// unregister blocks while a stack sample is in progress, so it is task-context only.
+esp_err_t kraken_task_create(const kraken_task_config_t *config, void **handle);
+esp_err_t kraken_task_delete(void *handle);
+esp_err_t kraken_task_register(void *handle, uint32_t stack_size, const char *kconfig);
+esp_err_t kraken_task_unregister(void *handle);
+esp_err_t kraken_task_get_stack_info(const char *name, kraken_task_stack_info_t *info);
+void kraken_task_dump_stack_report(void);
+bool kraken_task_stack_is_internal(void);
+
+// Guard for code that may run with the flash cache disabled (flash/NVS writes):
+// PSRAM is unreachable then, so the caller's stack must be in internal RAM.
+#define KRAKEN_REQUIRE_INTERNAL_STACK() \
+    do { \
+        if (!kraken_task_stack_is_internal()) { \
+            ESP_LOGE("STACK", "%s needs an internal-RAM stack", __func__); \
+            return ESP_ERR_INVALID_STATE; \
+        } \
+    } while(0)
+
+// Hot-path cycle counts (CONFIG_KRAKEN_HOT_PATH_STATS). Counts include any
+// preemption inside the measured section; compare min/avg between a flash build
+// and an IRAM-profile build. Without the option the macros compile to nothing.
+#define KRAKEN_CYCLE_STAT_DEFINE(var, stat_name) \
+    static __attribute__((unused)) kraken_cycle_stat_t var = { .name = (stat_name), .min_cycles = UINT32_MAX }
+
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+#define KRAKEN_CYCLE_BEGIN(stat) \
+    uint32_t _cyc_start_##stat = esp_cpu_get_cycle_count(); \
+    int _cyc_core_##stat = esp_cpu_get_core_id()
+#define KRAKEN_CYCLE_END(stat) \
+    kraken_cycle_stat_record(&(stat), _cyc_core_##stat, \
+                             esp_cpu_get_cycle_count() - _cyc_start_##stat)
+#else
+#define KRAKEN_CYCLE_BEGIN(stat) do { } while (0)
+#define KRAKEN_CYCLE_END(stat) do { } while (0)
+#endif
+
+// Safe from ISRs. start_core is the core the measurement began on.
+void kraken_cycle_stat_record(kraken_cycle_stat_t *stat, int start_core, uint32_t cycles);
+void kraken_cycle_stats_dump(void);
+void kraken_cycle_stats_reset(void);
+
+// Warm-boot state in RTC slow memory. Survives deep sleep and software, panic and
+// watchdog resets of the same firmware image; power-on, brownout and a new image
+// start cold. Records are small, keyed by name (< KRAKEN_WARM_KEY_MAX_LEN) and
+// must be loaded with the exact size they were saved with. Save on change; there
+// is no shutdown hook on a crash.
+bool kraken_warm_boot(void);
+esp_err_t kraken_warm_save(const char *key, const void *data, size_t len);
+esp_err_t kraken_warm_load(const char *key, void *data, size_t len);
+esp_err_t kraken_warm_erase(const char *key);
+void kraken_warm_clear(void);
+
+// Timers run on the kernel timer service (hierarchical timing wheel, 1 ms
+// resolution). Callbacks run on the "kraken_tmr" task unless an executor is given.
 esp_err_t kraken_timer_create(const char *name, uint32_t period_ms,
                                bool auto_reload, void (*callback)(void*),
                                void *arg, void **handle);
+esp_err_t kraken_timer_create_ex(const kraken_timer_config_t *config, void **handle);
 esp_err_t kraken_timer_start(void *handle);
 esp_err_t kraken_timer_stop(void *handle);
+esp_err_t kraken_timer_set_period(void *handle, uint32_t period_ms);
 esp_err_t kraken_timer_delete(void *handle);
+esp_err_t kraken_timer_get_stats(kraken_timer_stats_t *stats);
+
+// Monotonic time since boot, backed by esp_timer. 64-bit, so it does not wrap in
+// the lifetime of a device; safe to call from ISRs. The ns variant has 1 us resolution.
+int64_t kraken_time_us(void);
+int64_t kraken_time_ns(void);
 
+// Milliseconds since boot truncated to 32 bits (wraps after ~49 days); compare with
+// unsigned subtraction. Use kraken_time_us() for timestamps and latency measurement.
 uint32_t kraken_get_tick_count(void);
 void kraken_delay_ms(uint32_t ms);
 
@@ -14,7 +14,13 @@ esp_err_t kraken_kernel_init(void)
 
     memset(&g_kernel, 0, sizeof(g_kernel));
 
-    esp_err_t ret = kernel_service_init();
+    // First, so services can check kraken_warm_boot() from their init
+    esp_err_t ret = kernel_warm_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = kernel_service_init();
     if (ret != ESP_OK) {
         return ret;
     }
@@ -25,7 +31,45 @@ esp_err_t kraken_kernel_init(void)
         return ret;
     }
 
+    ret = kernel_work_init();
+    if (ret != ESP_OK) {
+        kernel_event_cleanup();
+        kernel_service_cleanup();
+        return ret;
+    }
+
+    ret = kernel_timer_init();
+    if (ret != ESP_OK) {
+        kernel_work_cleanup();
+        kernel_event_cleanup();
+        kernel_service_cleanup();
+        return ret;
+    }
+
+    ret = kernel_coro_init();
+    if (ret != ESP_OK) {
+        kernel_timer_cleanup();
+        kernel_work_cleanup();
+        kernel_event_cleanup();
+        kernel_service_cleanup();
+        return ret;
+    }
+
     g_kernel.initialized = true;
+
+    // Needs the event bus to post LOW_MEMORY; not fatal if it cannot start
+    if (kernel_heap_monitor_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Heap monitor not started");
+    }
+
+    if (kernel_task_monitor_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Stack monitor not started");
+    }
+
+    if (kernel_supervisor_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Service supervisor not started");
+    }
+
     ESP_LOGI(TAG, "Kernel initialized");
     return ESP_OK;
 }
@@ -36,6 +80,12 @@ esp_err_t kraken_kernel_deinit(void)
         return ESP_OK;
     }
 
+    kernel_supervisor_cleanup();
+    kernel_task_monitor_cleanup();
+    kernel_heap_monitor_cleanup();
+    kernel_coro_cleanup();
+    kernel_timer_cleanup();
+    kernel_work_cleanup();
     kernel_event_cleanup();
     kernel_service_cleanup();
 
@@ -0,0 +1,212 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#if CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS <= KRAKEN_TLS_ARENA_INDEX
+#error "Arena scopes need CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS >= 2"
+#endif
+
+static const char *TAG = "kernel_arena";
+
+#define ARENA_ALIGN 8
+#define ARENA_ALIGN_UP(x) (((x) + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_NAME_MAX_LEN 16
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    uint8_t data[] __attribute__((aligned(ARENA_ALIGN)));
+} arena_block_t;
+
+struct kraken_arena_t {
+    char name[ARENA_NAME_MAX_LEN];
+    kraken_mem_class_t mem_class;
+    size_t block_size;
+    arena_block_t *first;    // Kept across resets
+    arena_block_t *current;  // Block currently being filled
+    size_t used;
+    size_t peak;
+    portMUX_TYPE lock;
+};
+
+static kraken_mem_class_t arena_class_from_flags(uint32_t flags)
+{
+    if (flags & KRAKEN_MEM_DMA) {
+        return KRAKEN_MEM_CLASS_DMA;
+    }
+    if (flags & KRAKEN_MEM_FAST) {
+        return KRAKEN_MEM_CLASS_FAST;
+    }
+    if (flags & KRAKEN_MEM_LARGE) {
+        return KRAKEN_MEM_CLASS_LARGE;
+    }
+    return KRAKEN_MEM_CLASS_DEFAULT;
+}
+
+static arena_block_t *arena_new_block(kraken_arena_t *arena, size_t min_size)
+{
+    size_t size = min_size > arena->block_size ? min_size : arena->block_size;
+    arena_block_t *block = kernel_mem_alloc_unscoped(sizeof(arena_block_t) + size, arena->mem_class);
+    if (!block) {
+        return NULL;
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+esp_err_t kraken_arena_create(const char *name, size_t block_size, uint32_t mem_flags,
+                               kraken_arena_t **arena)
+{
+    if (!name || block_size == 0 || !arena) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    kraken_arena_t *a = kernel_mem_alloc_unscoped(sizeof(kraken_arena_t), KRAKEN_MEM_CLASS_DEFAULT);
+    if (!a) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(a, 0, sizeof(*a));
+    strncpy(a->name, name, ARENA_NAME_MAX_LEN - 1);
+    a->mem_class = arena_class_from_flags(mem_flags);
+    a->block_size = ARENA_ALIGN_UP(block_size);
+    portMUX_INITIALIZE(&a->lock);
+
+    a->first = arena_new_block(a, a->block_size);
+    if (!a->first) {
+        kraken_free(a);
+        return ESP_ERR_NO_MEM;
+    }
+    a->current = a->first;
+
+    *arena = a;
+    ESP_LOGD(TAG, "Arena '%s' created (block=%u)", a->name, (unsigned)a->block_size);
+    return ESP_OK;
+}
+
+void kraken_arena_destroy(kraken_arena_t *arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    arena_block_t *block = arena->first;
+    while (block) {
+        arena_block_t *next = block->next;
+        kraken_free(block);
+        block = next;
+    }
+    kraken_free(arena);
+}
+
+void *kraken_arena_alloc(kraken_arena_t *arena, size_t size)
+{
+    if (!arena || size == 0 || size > UINT32_MAX - sizeof(kernel_mem_header_t) - ARENA_ALIGN) {
+        return NULL;
+    }
+
+    // Arena blocks carry the same header as heap blocks, so kraken_free() and
+    // kraken_realloc() can tell them apart
+    size_t need = ARENA_ALIGN_UP(sizeof(kernel_mem_header_t) + size);
+
+    kernel_mem_header_t *hdr = NULL;
+    while (!hdr) {
+        portENTER_CRITICAL(&arena->lock);
+        arena_block_t *block = arena->current;
+        if (block->size - block->used < need && block->next && block->next->size >= need) {
+            // Reuse a block kept from before the last reset
+            block = block->next;
+            block->used = 0;
+            arena->current = block;
+        }
+        if (block->size - block->used >= need) {
+            hdr = (kernel_mem_header_t *)(block->data + block->used);
+            block->used += need;
+            arena->used += need;
+            if (arena->used > arena->peak) {
+                arena->peak = arena->used;
+            }
+        }
+        portEXIT_CRITICAL(&arena->lock);
+
+        if (!hdr) {
+            // Grow outside the critical section - heap_caps may block
+            arena_block_t *new_block = arena_new_block(arena, need);
+            if (!new_block) {
+                ESP_LOGW(TAG, "Arena '%s' exhausted (%u bytes)", arena->name, (unsigned)size);
+                return NULL;
+            }
+            portENTER_CRITICAL(&arena->lock);
+            new_block->next = arena->current->next;
+            arena->current->next = new_block;
+            arena->current = new_block;
+            portEXIT_CRITICAL(&arena->lock);
+        }
+    }
+
+    hdr->size = (uint32_t)size;
+    hdr->magic = KERNEL_MEM_HEADER_MAGIC;
+    hdr->mem_class = (uint8_t)arena->mem_class;
+    hdr->flags = KERNEL_MEM_FLAG_ARENA;
+    return hdr + 1;
+}
+
+void kraken_arena_reset(kraken_arena_t *arena)
+{
+    if (!arena) {
+        return;
+    }
+
+    // Rewind only: the first block and any overflow blocks are kept so the
+    // next screen session does not go back to the heap
+    portENTER_CRITICAL(&arena->lock);
+    arena->first->used = 0;
+    arena->current = arena->first;
+    arena->used = 0;
+    portEXIT_CRITICAL(&arena->lock);
+
+    ESP_LOGD(TAG, "Arena '%s' reset (peak=%u)", arena->name, (unsigned)arena->peak);
+}
+
+size_t kraken_arena_get_used(const kraken_arena_t *arena)
+{
+    return arena ? arena->used : 0;
+}
+
+esp_err_t kraken_arena_enter(kraken_arena_t *arena)
+{
+    if (!arena) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (pvTaskGetThreadLocalStoragePointer(NULL, KRAKEN_TLS_ARENA_INDEX)) {
+        ESP_LOGE(TAG, "Nested arena scopes are not supported");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    vTaskSetThreadLocalStoragePointer(NULL, KRAKEN_TLS_ARENA_INDEX, arena);
+    return ESP_OK;
+}
+
+void kraken_arena_leave(void)
+{
+    vTaskSetThreadLocalStoragePointer(NULL, KRAKEN_TLS_ARENA_INDEX, NULL);
+}
+
+void *kernel_arena_scoped_alloc(size_t size, kraken_mem_class_t mem_class)
+{
+    kraken_arena_t *arena = pvTaskGetThreadLocalStoragePointer(NULL, KRAKEN_TLS_ARENA_INDEX);
+    if (!arena) {
+        return NULL;
+    }
+
+    // Explicit placement requests the arena cannot honour go to the heap
+    if (mem_class != KRAKEN_MEM_CLASS_DEFAULT && mem_class != arena->mem_class) {
+        return NULL;
+    }
+
+    return kraken_arena_alloc(arena, size);
+}
@@ -0,0 +1,443 @@
+#include "kernel_internal.h"
+#include "kraken/coro.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "kernel_coro";
+
+#if CONFIG_KRAKEN_CORO
+
+#if CONFIG_KRAKEN_CORO_TASK_CORE < 0
+#define CORO_TASK_CORE tskNO_AFFINITY
+#else
+#define CORO_TASK_CORE CONFIG_KRAKEN_CORO_TASK_CORE
+#endif
+
+#define CORO_IO_POLL_US ((int64_t)CONFIG_KRAKEN_CORO_IO_POLL_MS * 1000)
+
+enum {
+    CORO_IDLE = 0,   // Not on the run list
+    CORO_READY,
+    CORO_RUNNING,
+    CORO_WAITING,
+};
+
+static struct {
+    portMUX_TYPE lock;
+    kraken_coro_t *head;
+    kraken_coro_t *tail;
+    TaskHandle_t task;
+    void *timer;     // One-shot, armed for the nearest deadline
+} s_coro = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static StaticTask_t s_coro_task_buf;
+#if CONFIG_KRAKEN_CORO_STACK_IN_PSRAM
+// Coroutine steps are service logic, not realtime; the stack can live in PSRAM
+static EXT_RAM_BSS_ATTR StackType_t s_coro_task_stack[CONFIG_KRAKEN_CORO_TASK_STACK_SIZE];
+#else
+static StackType_t s_coro_task_stack[CONFIG_KRAKEN_CORO_TASK_STACK_SIZE];
+#endif
+
+static void coro_notify_runner(void)
+{
+    if (!s_coro.task) {
+        return;
+    }
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_coro.task, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    } else {
+        xTaskNotifyGive(s_coro.task);
+    }
+}
+
+// Must be called with the lock held
+static void coro_unlink(kraken_coro_t *co)
+{
+    kraken_coro_t **pp = &s_coro.head;
+    kraken_coro_t *prev = NULL;
+    while (*pp && *pp != co) {
+        prev = *pp;
+        pp = &(*pp)->next;
+    }
+    if (*pp) {
+        *pp = co->next;
+        if (s_coro.tail == co) {
+            s_coro.tail = prev;
+        }
+    }
+    co->next = NULL;
+    co->state = CORO_IDLE;
+}
+
+// Must be called with the lock held. A wake that lands while the coroutine is
+// still running (between registering the wait and returning) is kept in 'woken'.
+static bool coro_wake_locked(kraken_coro_t *co, kraken_coro_wake_t reason)
+{
+    co->wake_reason = reason;
+    if (co->state == CORO_WAITING) {
+        co->state = CORO_READY;
+        return true;
+    }
+    if (co->state == CORO_RUNNING) {
+        co->woken = true;
+    }
+    return false;
+}
+
+static void coro_timer_cb(void *arg)
+{
+    (void)arg;
+    coro_notify_runner();
+}
+
+static void coro_reset_wait(kraken_coro_t *co)
+{
+    co->wait_event = KRAKEN_EVENT_NONE;
+    co->ready_fn = NULL;
+    co->ready_arg = NULL;
+    co->deadline_us = 0;
+    co->wake_reason = KRAKEN_CORO_WAKE_NONE;
+    co->woken = false;
+}
+
+static int64_t coro_deadline(uint32_t timeout_ms)
+{
+    return timeout_ms == KRAKEN_CORO_NO_TIMEOUT ? 0 : kraken_time_us() + (int64_t)timeout_ms * 1000;
+}
+
+void kraken_coro_wait_event(kraken_coro_t *co, kraken_event_type_t type, uint32_t timeout_ms)
+{
+    portENTER_CRITICAL(&s_coro.lock);
+    coro_reset_wait(co);
+    co->wait_event = type;
+    co->deadline_us = coro_deadline(timeout_ms);
+    portEXIT_CRITICAL(&s_coro.lock);
+}
+
+void kraken_coro_wait_timeout(kraken_coro_t *co, uint32_t timeout_ms)
+{
+    portENTER_CRITICAL(&s_coro.lock);
+    coro_reset_wait(co);
+    // A zero sleep still goes through the runner, like a yield
+    co->deadline_us = kraken_time_us() + (int64_t)timeout_ms * 1000;
+    portEXIT_CRITICAL(&s_coro.lock);
+}
+
+void kraken_coro_wait_io(kraken_coro_t *co, kraken_coro_ready_fn_t ready_fn, void *arg,
+                         uint32_t timeout_ms)
+{
+    portENTER_CRITICAL(&s_coro.lock);
+    coro_reset_wait(co);
+    co->ready_fn = ready_fn;
+    co->ready_arg = arg;
+    co->deadline_us = coro_deadline(timeout_ms);
+    portEXIT_CRITICAL(&s_coro.lock);
+}
+
+void kraken_coro_wake(kraken_coro_t *co)
+{
+    if (!co) {
+        return;
+    }
+
+    bool notify = false;
+    portENTER_CRITICAL_SAFE(&s_coro.lock);
+    if (co->ready_fn) {
+        // The runner re-checks ready_fn before resuming
+        co->woken = true;
+        notify = co->state == CORO_WAITING;
+    }
+    portEXIT_CRITICAL_SAFE(&s_coro.lock);
+
+    if (notify) {
+        coro_notify_runner();
+    }
+}
+
+void kernel_coro_on_event(const kraken_event_t *evt)
+{
+    bool notify = false;
+
+    portENTER_CRITICAL(&s_coro.lock);
+    for (kraken_coro_t *co = s_coro.head; co; co = co->next) {
+        if (co->wait_event != KRAKEN_EVENT_NONE && co->wait_event == evt->type &&
+            (co->state == CORO_WAITING || co->state == CORO_RUNNING)) {
+            // The payload pointer is only as valid as the poster guarantees
+            co->event = *evt;
+            co->wait_event = KRAKEN_EVENT_NONE;
+            notify |= coro_wake_locked(co, KRAKEN_CORO_WAKE_EVENT);
+        }
+    }
+    portEXIT_CRITICAL(&s_coro.lock);
+
+    if (notify) {
+        coro_notify_runner();
+    }
+}
+
+// Expire deadlines and poll I/O waiters; returns the time the runner should
+// next wake on its own (0: no deadline pending)
+static int64_t coro_check_waiters(void)
+{
+    int64_t now = kraken_time_us();
+    int64_t next_wake = 0;
+
+    portENTER_CRITICAL(&s_coro.lock);
+    for (kraken_coro_t *co = s_coro.head; co; co = co->next) {
+        if (co->state != CORO_WAITING) {
+            continue;
+        }
+        if (co->deadline_us && now >= co->deadline_us) {
+            co->wait_event = KRAKEN_EVENT_NONE;
+            coro_wake_locked(co, KRAKEN_CORO_WAKE_TIMEOUT);
+            continue;
+        }
+
+        int64_t wake = co->deadline_us;
+        if (co->ready_fn) {
+            int64_t poll = now + CORO_IO_POLL_US;
+            wake = (!wake || poll < wake) ? poll : wake;
+        }
+        if (wake && (!next_wake || wake < next_wake)) {
+            next_wake = wake;
+        }
+    }
+    portEXIT_CRITICAL(&s_coro.lock);
+
+    // ready_fn is user code and must run outside the critical section. While it
+    // runs the coroutine is marked RUNNING: a cancel only flags it (and says so)
+    // and a restart is refused, so it stays linked and its next pointer stays valid.
+    portENTER_CRITICAL(&s_coro.lock);
+    kraken_coro_t *co = s_coro.head;
+    while (co) {
+        if (co->state != CORO_WAITING || !co->ready_fn) {
+            co = co->next;
+            continue;
+        }
+
+        kraken_coro_ready_fn_t ready_fn = co->ready_fn;
+        void *ready_arg = co->ready_arg;
+        co->state = CORO_RUNNING;
+        co->woken = false;
+        portEXIT_CRITICAL(&s_coro.lock);
+
+        bool ready = ready_fn(ready_arg);
+
+        portENTER_CRITICAL(&s_coro.lock);
+        kraken_coro_t *next = co->next;
+        if (co->cancelled) {
+            coro_unlink(co);
+        } else {
+            co->state = CORO_WAITING;
+            // A kraken_coro_wake() during the poll resumes it too; the await re-checks
+            if (ready || co->woken) {
+                coro_wake_locked(co, KRAKEN_CORO_WAKE_IO);
+            }
+        }
+        co = next;
+    }
+    portEXIT_CRITICAL(&s_coro.lock);
+
+    return next_wake;
+}
+
+// Runs every READY coroutine once; returns true if any asked to run again
+static bool coro_run_ready(void)
+{
+    bool again = false;
+
+    portENTER_CRITICAL(&s_coro.lock);
+    kraken_coro_t *co = s_coro.head;
+    while (co) {
+        if (co->state != CORO_READY) {
+            co = co->next;
+            continue;
+        }
+
+        co->state = CORO_RUNNING;
+        co->woken = false;
+        portEXIT_CRITICAL(&s_coro.lock);
+
+        kraken_coro_status_t status = co->fn(co);
+
+        portENTER_CRITICAL(&s_coro.lock);
+        kraken_coro_t *next = co->next;
+        if (status == KRAKEN_CORO_DONE || co->cancelled) {
+            coro_unlink(co);
+        } else if (status == KRAKEN_CORO_YIELDED || co->woken) {
+            co->state = CORO_READY;
+            again = true;
+        } else {
+            co->state = CORO_WAITING;
+        }
+        co = next;
+    }
+    portEXIT_CRITICAL(&s_coro.lock);
+
+    return again;
+}
+
+static void coro_runner_task(void *arg)
+{
+    (void)arg;
+
+    while (1) {
+        bool again = coro_run_ready();
+        int64_t next_wake = coro_check_waiters();
+
+        // Deadlines or I/O that fired during the check are READY now
+        portENTER_CRITICAL(&s_coro.lock);
+        for (kraken_coro_t *co = s_coro.head; co && !again; co = co->next) {
+            again = co->state == CORO_READY;
+        }
+        portEXIT_CRITICAL(&s_coro.lock);
+        if (again) {
+            continue;
+        }
+
+        if (next_wake) {
+            int64_t wait_us = next_wake - kraken_time_us();
+            kraken_timer_set_period(s_coro.timer, wait_us > 1000 ? (uint32_t)((wait_us + 999) / 1000) : 1);
+        } else {
+            kraken_timer_stop(s_coro.timer);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t kernel_coro_init(void)
+{
+    s_coro.head = s_coro.tail = NULL;
+
+    esp_err_t ret = kraken_timer_create("coro_wake", 1, false, coro_timer_cb, NULL, &s_coro.timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create runner timer");
+        return ret;
+    }
+
+    s_coro.task = xTaskCreateStaticPinnedToCore(coro_runner_task, "kraken_coro",
+                                                CONFIG_KRAKEN_CORO_TASK_STACK_SIZE, NULL,
+                                                CONFIG_KRAKEN_CORO_TASK_PRIORITY,
+                                                s_coro_task_stack, &s_coro_task_buf, CORO_TASK_CORE);
+    kraken_task_register(s_coro.task, CONFIG_KRAKEN_CORO_TASK_STACK_SIZE,
+                         "CONFIG_KRAKEN_CORO_TASK_STACK_SIZE");
+    return ESP_OK;
+}
+
+void kernel_coro_cleanup(void)
+{
+    if (s_coro.task) {
+        kraken_task_delete(s_coro.task);
+        s_coro.task = NULL;
+    }
+    if (s_coro.timer) {
+        kraken_timer_delete(s_coro.timer);
+        s_coro.timer = NULL;
+    }
+}
+
+esp_err_t kraken_coro_start(kraken_coro_t *co, const char *name, kraken_coro_fn_t fn, void *ctx)
+{
+    if (!co || !fn) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_coro.task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&s_coro.lock);
+    if (co->state != CORO_IDLE) {
+        portEXIT_CRITICAL(&s_coro.lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(co, 0, sizeof(*co));
+    co->name = name;
+    co->fn = fn;
+    co->ctx = ctx;
+    co->state = CORO_READY;
+    if (s_coro.tail) {
+        s_coro.tail->next = co;
+    } else {
+        s_coro.head = co;
+    }
+    s_coro.tail = co;
+    portEXIT_CRITICAL(&s_coro.lock);
+
+    ESP_LOGD(TAG, "Coroutine '%s' started", name ? name : "?");
+    coro_notify_runner();
+    return ESP_OK;
+}
+
+esp_err_t kraken_coro_cancel(kraken_coro_t *co)
+{
+    if (!co) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_coro.lock);
+    if (co->state == CORO_RUNNING) {
+        // The runner unlinks it when the current step returns; until then the
+        // storage is still in use
+        co->cancelled = true;
+        ret = ESP_ERR_NOT_FINISHED;
+    } else if (co->state != CORO_IDLE) {
+        coro_unlink(co);
+    }
+    portEXIT_CRITICAL(&s_coro.lock);
+    return ret;
+}
+
+#else  // !CONFIG_KRAKEN_CORO
+
+esp_err_t kernel_coro_init(void)
+{
+    ESP_LOGD(TAG, "Coroutines disabled");
+    return ESP_OK;
+}
+
+void kernel_coro_cleanup(void)
+{
+}
+
+void kernel_coro_on_event(const kraken_event_t *evt)
+{
+}
+
+esp_err_t kraken_coro_start(kraken_coro_t *co, const char *name, kraken_coro_fn_t fn, void *ctx)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t kraken_coro_cancel(kraken_coro_t *co)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void kraken_coro_wake(kraken_coro_t *co)
+{
+}
+
+void kraken_coro_wait_event(kraken_coro_t *co, kraken_event_type_t type, uint32_t timeout_ms)
+{
+}
+
+void kraken_coro_wait_timeout(kraken_coro_t *co, uint32_t timeout_ms)
+{
+}
+
+void kraken_coro_wait_io(kraken_coro_t *co, kraken_coro_ready_fn_t ready_fn, void *arg,
+                         uint32_t timeout_ms)
+{
+}
+
+#endif  // CONFIG_KRAKEN_CORO
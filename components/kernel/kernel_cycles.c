@@ -0,0 +1,107 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "kernel_cycles";
+
+#if CONFIG_KRAKEN_HOT_PATH_STATS
+
+#include "esp_rom_sys.h"
+
+#if CONFIG_KRAKEN_HOT_PATHS_IN_IRAM
+#define HOT_PATH_PLACEMENT "IRAM"
+#else
+#define HOT_PATH_PLACEMENT "flash"
+#endif
+
+// Stats are static in the code that owns them and link themselves in on first use
+static struct {
+    portMUX_TYPE lock;
+    kraken_cycle_stat_t *head;
+} s_cycles = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+KRAKEN_IRAM_ATTR void kraken_cycle_stat_record(kraken_cycle_stat_t *stat, int start_core, uint32_t cycles)
+{
+    // The cycle counter is per core, so a sample that spans a migration is meaningless
+    bool migrated = (esp_cpu_get_core_id() != start_core);
+
+    portENTER_CRITICAL_SAFE(&s_cycles.lock);
+    if (!stat->registered) {
+        stat->registered = true;
+        stat->next = s_cycles.head;
+        s_cycles.head = stat;
+    }
+    if (migrated) {
+        stat->migrated++;
+    } else {
+        stat->count++;
+        stat->total_cycles += cycles;
+        if (cycles < stat->min_cycles) {
+            stat->min_cycles = cycles;
+        }
+        if (cycles > stat->max_cycles) {
+            stat->max_cycles = cycles;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_cycles.lock);
+}
+
+void kraken_cycle_stats_dump(void)
+{
+    uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+
+    ESP_LOGI(TAG, "Hot paths (%s build, %lu MHz):", HOT_PATH_PLACEMENT, (unsigned long)ticks_per_us);
+    ESP_LOGI(TAG, "  %-20s %8s %8s %8s %8s %8s", "name", "count", "min", "avg", "max", "avg_us");
+
+    portENTER_CRITICAL(&s_cycles.lock);
+    kraken_cycle_stat_t *stat = s_cycles.head;
+    portEXIT_CRITICAL(&s_cycles.lock);
+
+    // Registered stats are never unlinked, so the list can be walked outside the lock
+    for (; stat; stat = stat->next) {
+        portENTER_CRITICAL(&s_cycles.lock);
+        kraken_cycle_stat_t snap = *stat;
+        portEXIT_CRITICAL(&s_cycles.lock);
+
+        if (snap.count == 0) {
+            ESP_LOGI(TAG, "  %-20s %8s (%lu migrated)", snap.name, "-", (unsigned long)snap.migrated);
+            continue;
+        }
+        uint32_t avg = (uint32_t)(snap.total_cycles / snap.count);
+        ESP_LOGI(TAG, "  %-20s %8lu %8lu %8lu %8lu %8lu", snap.name, (unsigned long)snap.count,
+                 (unsigned long)snap.min_cycles, (unsigned long)avg, (unsigned long)snap.max_cycles,
+                 (unsigned long)(avg / ticks_per_us));
+        if (snap.migrated) {
+            ESP_LOGI(TAG, "  %-20s %lu sample(s) dropped after a core migration", "",
+                     (unsigned long)snap.migrated);
+        }
+    }
+}
+
+void kraken_cycle_stats_reset(void)
+{
+    portENTER_CRITICAL(&s_cycles.lock);
+    for (kraken_cycle_stat_t *stat = s_cycles.head; stat; stat = stat->next) {
+        stat->count = 0;
+        stat->migrated = 0;
+        stat->min_cycles = UINT32_MAX;
+        stat->max_cycles = 0;
+        stat->total_cycles = 0;
+    }
+    portEXIT_CRITICAL(&s_cycles.lock);
+}
+
+#else  // !CONFIG_KRAKEN_HOT_PATH_STATS
+
+void kraken_cycle_stats_dump(void)
+{
+    ESP_LOGW(TAG, "Hot-path stats disabled (CONFIG_KRAKEN_HOT_PATH_STATS)");
+}
+
+void kraken_cycle_stats_reset(void)
+{
+}
+
+#endif  // CONFIG_KRAKEN_HOT_PATH_STATS
@@ -1,42 +1,49 @@
 #include "kernel_internal.h"
 #include "esp_log.h"
-#include "esp_timer.h"
-#include <stdlib.h>
 
 static const char *TAG = "kernel_evt";
 
-esp_err_t kernel_event_init(void)
-{
-    g_kernel.event_mutex = xSemaphoreCreateMutex();
-    if (!g_kernel.event_mutex) {
-        ESP_LOGE(TAG, "Failed to create event mutex");
-        return ESP_ERR_NO_MEM;
-    }
-    ESP_LOGI(TAG, "Created event_mutex: %p", g_kernel.event_mutex);
+#if CONFIG_KRAKEN_EVENT_TASK_CORE < 0
+#define EVENT_TASK_CORE tskNO_AFFINITY
+#else
+#define EVENT_TASK_CORE CONFIG_KRAKEN_EVENT_TASK_CORE
+#endif
 
-    g_kernel.event_queue = xQueueCreate(32, sizeof(kraken_event_t));
-    if (!g_kernel.event_queue) {
-        ESP_LOGE(TAG, "Failed to create event queue");
-        vSemaphoreDelete(g_kernel.event_mutex);
-        return ESP_ERR_NO_MEM;
-    }
-    ESP_LOGI(TAG, "Created event_queue: %p (item_size=%d)", g_kernel.event_queue, sizeof(kraken_event_t));
+// Kernel-owned objects live in .bss so boot does no heap work for the kernel
+static StaticSemaphore_t s_event_mutex_buf;
+static StaticQueue_t s_event_queue_buf;
+static uint8_t s_event_queue_storage[CONFIG_KRAKEN_EVENT_QUEUE_LEN * sizeof(kraken_event_t)];
+static StaticTask_t s_event_task_buf;
+static StackType_t s_event_task_stack[CONFIG_KRAKEN_EVENT_TASK_STACK_SIZE];
+// Listener snapshot used by the single event task while dispatching
+static event_listener_t s_active_listeners[KRAKEN_MAX_EVENT_LISTENERS];
 
-    BaseType_t ret = xTaskCreate(kernel_event_task, "kraken_evt", 4096, NULL, 5, &g_kernel.event_task);
-    if (ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create event task");
-        vQueueDelete(g_kernel.event_queue);
-        vSemaphoreDelete(g_kernel.event_mutex);
-        return ESP_ERR_NO_MEM;
-    }
+KRAKEN_CYCLE_STAT_DEFINE(s_post_cycles, "event_post");
+KRAKEN_CYCLE_STAT_DEFINE(s_dispatch_cycles, "event_dispatch");
 
+esp_err_t kernel_event_init(void)
+{
+    // Static creation cannot fail for lack of memory
+    g_kernel.event_mutex = xSemaphoreCreateMutexStatic(&s_event_mutex_buf);
+    g_kernel.event_queue = xQueueCreateStatic(CONFIG_KRAKEN_EVENT_QUEUE_LEN, sizeof(kraken_event_t),
+                                              s_event_queue_storage, &s_event_queue_buf);
+    g_kernel.event_task = xTaskCreateStaticPinnedToCore(kernel_event_task, "kraken_evt",
+                                                        CONFIG_KRAKEN_EVENT_TASK_STACK_SIZE, NULL,
+                                                        CONFIG_KRAKEN_EVENT_TASK_PRIORITY,
+                                                        s_event_task_stack, &s_event_task_buf,
+                                                        EVENT_TASK_CORE);
+    kraken_task_register(g_kernel.event_task, CONFIG_KRAKEN_EVENT_TASK_STACK_SIZE,
+                         "CONFIG_KRAKEN_EVENT_TASK_STACK_SIZE");
+
+    ESP_LOGI(TAG, "Event bus ready (queue=%d x %zu bytes, stack=%d)",
+             CONFIG_KRAKEN_EVENT_QUEUE_LEN, sizeof(kraken_event_t), CONFIG_KRAKEN_EVENT_TASK_STACK_SIZE);
     return ESP_OK;
 }
 
 void kernel_event_cleanup(void)
 {
     if (g_kernel.event_task) {
-        vTaskDelete(g_kernel.event_task);
+        kraken_task_delete(g_kernel.event_task);
         g_kernel.event_task = NULL;
     }
     if (g_kernel.event_queue) {
@@ -107,28 +114,30 @@ esp_err_t kraken_event_unsubscribe(kraken_event_type_t event_type,
     return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t kraken_event_post(kraken_event_type_t event_type, void *data, uint32_t data_len)
+KRAKEN_IRAM_ATTR esp_err_t kraken_event_post(kraken_event_type_t event_type, void *data, uint32_t data_len)
 {
     if (!g_kernel.initialized) {
         return ESP_ERR_INVALID_STATE;
     }
 
+    KRAKEN_CYCLE_BEGIN(s_post_cycles);
     kraken_event_t evt = {
         .type = event_type,
         .data = data,
         .data_len = data_len,
-        .timestamp = (uint32_t)(esp_timer_get_time() / 1000),
+        .timestamp_us = kraken_time_us(),
     };
 
     if (xQueueSend(g_kernel.event_queue, &evt, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGW(TAG, "Event queue full, event %d dropped", event_type);
         return ESP_ERR_TIMEOUT;
     }
+    KRAKEN_CYCLE_END(s_post_cycles);
 
     return ESP_OK;
 }
 
-esp_err_t kraken_event_post_from_isr(kraken_event_type_t event_type, void *data, uint32_t data_len)
+KRAKEN_IRAM_ATTR esp_err_t kraken_event_post_from_isr(kraken_event_type_t event_type, void *data, uint32_t data_len)
 {
     if (!g_kernel.initialized) {
         return ESP_ERR_INVALID_STATE;
@@ -138,7 +147,7 @@ esp_err_t kraken_event_post_from_isr(kraken_event_type_t event_type, void *data,
         .type = event_type,
         .data = data,
         .data_len = data_len,
-        .timestamp = (uint32_t)(esp_timer_get_time() / 1000),
+        .timestamp_us = kraken_time_us(),
     };
 
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
@@ -153,6 +162,42 @@ esp_err_t kraken_event_post_from_isr(kraken_event_type_t event_type, void *data,
     return ESP_OK;
 }
 
+// Runs a single event through the matching listeners and coroutine waiters
+static KRAKEN_IRAM_ATTR void kernel_event_dispatch(const kraken_event_t *evt)
+{
+    // Measures the kernel's share (lock, listener lookup); handlers are not included
+    KRAKEN_CYCLE_BEGIN(s_dispatch_cycles);
+
+    if (xSemaphoreTake(g_kernel.event_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGW(TAG, "Failed to take event mutex");
+        return;
+    }
+
+    // Static snapshot: only this task dispatches, and it keeps the stack small
+    event_listener_t *active_listeners = s_active_listeners;
+
+    // Copy listeners to avoid holding mutex during callbacks
+    uint8_t active_count = 0;
+    for (uint8_t i = 0; i < g_kernel.listener_count; i++) {
+        if (g_kernel.listeners[i].event_type == evt->type ||
+            g_kernel.listeners[i].event_type == KRAKEN_EVENT_NONE) {
+            active_listeners[active_count++] = g_kernel.listeners[i];
+        }
+    }
+
+    // Release mutex BEFORE calling handlers to avoid deadlock with LVGL
+    xSemaphoreGive(g_kernel.event_mutex);
+    KRAKEN_CYCLE_END(s_dispatch_cycles);
+
+    // Now call handlers without holding the mutex
+    for (uint8_t i = 0; i < active_count; i++) {
+        active_listeners[i].handler(evt, active_listeners[i].user_data);
+    }
+
+    // Coroutines awaiting this event resume on the coroutine runner
+    kernel_coro_on_event(evt);
+}
+
 void kernel_event_task(void *arg)
 {
     kraken_event_t evt;
@@ -165,38 +210,7 @@ void kernel_event_task(void *arg)
                 ESP_LOGE(TAG, "Event mutex is NULL!");
                 continue;
             }
-            
-            if (xSemaphoreTake(g_kernel.event_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-                // Allocate on heap to avoid stack overflow
-                event_listener_t *active_listeners = malloc(KRAKEN_MAX_EVENT_LISTENERS * sizeof(event_listener_t));
-                if (!active_listeners) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for listeners!");
-                    xSemaphoreGive(g_kernel.event_mutex);
-                    continue;
-                }
-                
-                // Copy listeners to avoid holding mutex during callbacks
-                uint8_t active_count = 0;
-                for (uint8_t i = 0; i < g_kernel.listener_count; i++) {
-                    if (g_kernel.listeners[i].event_type == evt.type ||
-                        g_kernel.listeners[i].event_type == KRAKEN_EVENT_NONE) {
-                        active_listeners[active_count++] = g_kernel.listeners[i];
-                    }
-                }
-                
-                // Release mutex BEFORE calling handlers to avoid deadlock with LVGL
-                xSemaphoreGive(g_kernel.event_mutex);
-                
-                // Now call handlers without holding the mutex
-                for (uint8_t i = 0; i < active_count; i++) {
-                    active_listeners[i].handler(&evt, active_listeners[i].user_data);
-                }
-                
-                // Free allocated memory
-                free(active_listeners);
-            } else {
-                ESP_LOGW(TAG, "Failed to take event mutex");
-            }
+            kernel_event_dispatch(&evt);
         }
     }
 }
@@ -0,0 +1,185 @@
+#include "kernel_internal.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "kernel_heapmon";
+
+#if CONFIG_KRAKEN_HEAP_MONITOR
+
+#ifndef CONFIG_KRAKEN_HEAP_MONITOR_PSRAM_MIN_FREE
+#define CONFIG_KRAKEN_HEAP_MONITOR_PSRAM_MIN_FREE 0
+#endif
+
+// A region must recover this far above its thresholds before LOW_MEMORY re-arms
+#define HEAP_MONITOR_HYSTERESIS_PCT 10
+
+// Posted payloads rotate through this many slots. Events are dispatched in order
+// and at most QUEUE_LEN can be queued with one more in dispatch, so a slot comes
+// round again only after the event that carried it has been handled
+#define HEAP_MONITOR_PAYLOAD_SLOTS (CONFIG_KRAKEN_EVENT_QUEUE_LEN + 2)
+
+typedef struct {
+    uint32_t caps;
+    size_t min_free;
+    size_t min_block;
+    bool alarmed;
+    kraken_heap_report_t report;  // Latest sample, for kraken_heap_monitor_get_report()
+} heap_region_state_t;
+
+static struct {
+    void *timer;
+    portMUX_TYPE lock;
+    heap_region_state_t regions[KRAKEN_HEAP_REGION_COUNT];
+    // Only the monitor timer posts, so the slot index needs no lock
+    kraken_heap_report_t payload[HEAP_MONITOR_PAYLOAD_SLOTS];
+    uint16_t payload_next;
+} s_monitor = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .regions = {
+        [KRAKEN_HEAP_REGION_INTERNAL] = {
+            .caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+            .min_free = CONFIG_KRAKEN_HEAP_MONITOR_INTERNAL_MIN_FREE,
+            .min_block = CONFIG_KRAKEN_HEAP_MONITOR_INTERNAL_MIN_BLOCK,
+        },
+        [KRAKEN_HEAP_REGION_PSRAM] = {
+            .caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+            .min_free = CONFIG_KRAKEN_HEAP_MONITOR_PSRAM_MIN_FREE,
+            .min_block = 0,
+        },
+    },
+};
+
+static void heap_monitor_sample_region(kraken_heap_region_t region)
+{
+    heap_region_state_t *st = &s_monitor.regions[region];
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, st->caps);
+
+    size_t total = info.total_free_bytes + info.total_allocated_bytes;
+    if (total == 0) {
+        return;  // Region not present (e.g. no PSRAM fitted)
+    }
+
+    kraken_heap_report_t report = {
+        .region = region,
+        .free_bytes = info.total_free_bytes,
+        .largest_free_block = info.largest_free_block,
+        .minimum_free_bytes = info.minimum_free_bytes,
+        .fragmentation_pct = info.total_free_bytes ?
+            (uint8_t)(100 - (info.largest_free_block * 100) / info.total_free_bytes) : 100,
+    };
+    report.low_free = report.free_bytes < st->min_free;
+    report.low_block = st->min_block && report.largest_free_block < st->min_block;
+    report.fragmented = report.fragmentation_pct > CONFIG_KRAKEN_HEAP_MONITOR_FRAG_PERCENT;
+
+    bool crossed = report.low_free || report.low_block || report.fragmented;
+    bool recovered =
+        report.free_bytes > st->min_free + st->min_free * HEAP_MONITOR_HYSTERESIS_PCT / 100 &&
+        report.largest_free_block > st->min_block + st->min_block * HEAP_MONITOR_HYSTERESIS_PCT / 100 &&
+        report.fragmentation_pct + HEAP_MONITOR_HYSTERESIS_PCT <= CONFIG_KRAKEN_HEAP_MONITOR_FRAG_PERCENT;
+
+    bool post = false;
+    portENTER_CRITICAL(&s_monitor.lock);
+    st->report = report;
+    if (crossed && !st->alarmed) {
+        st->alarmed = true;
+        post = true;
+    } else if (st->alarmed && recovered) {
+        st->alarmed = false;
+    }
+    portEXIT_CRITICAL(&s_monitor.lock);
+
+    if (post) {
+        ESP_LOGW(TAG, "%s heap low: free=%u largest=%u min_ever=%u frag=%u%%",
+                 region == KRAKEN_HEAP_REGION_INTERNAL ? "Internal" : "PSRAM",
+                 (unsigned)report.free_bytes, (unsigned)report.largest_free_block,
+                 (unsigned)report.minimum_free_bytes, report.fragmentation_pct);
+        kraken_mem_dump_stats();
+        kraken_heap_report_t *payload = &s_monitor.payload[s_monitor.payload_next];
+        s_monitor.payload_next = (s_monitor.payload_next + 1) % HEAP_MONITOR_PAYLOAD_SLOTS;
+        *payload = report;
+        kraken_event_post(KRAKEN_EVENT_SYSTEM_LOW_MEMORY, payload, sizeof(kraken_heap_report_t));
+    }
+}
+
+static void heap_monitor_timer_cb(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < KRAKEN_HEAP_REGION_COUNT; i++) {
+        heap_monitor_sample_region((kraken_heap_region_t)i);
+    }
+}
+
+esp_err_t kernel_heap_monitor_init(void)
+{
+    // Walking the heap and dumping stats is pool work, not timer-task work
+    kraken_timer_config_t cfg = {
+        .name = "heap_mon",
+        .period_ms = CONFIG_KRAKEN_HEAP_MONITOR_PERIOD_MS,
+        .auto_reload = true,
+        .slack_ms = CONFIG_KRAKEN_HEAP_MONITOR_PERIOD_MS / 10,
+        .callback = heap_monitor_timer_cb,
+        .executor = kraken_work_executor(KRAKEN_WORK_PRIO_LOW, KRAKEN_WORK_CORE_ANY),
+    };
+    esp_err_t ret = kraken_timer_create_ex(&cfg, &s_monitor.timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create heap monitor timer");
+        return ret;
+    }
+
+    ret = kraken_timer_start(s_monitor.timer);
+    if (ret != ESP_OK) {
+        kraken_timer_delete(s_monitor.timer);
+        s_monitor.timer = NULL;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Heap monitor started (period=%dms)", CONFIG_KRAKEN_HEAP_MONITOR_PERIOD_MS);
+    return ESP_OK;
+}
+
+void kernel_heap_monitor_cleanup(void)
+{
+    if (s_monitor.timer) {
+        kraken_timer_stop(s_monitor.timer);
+        kraken_timer_delete(s_monitor.timer);
+        s_monitor.timer = NULL;
+    }
+    for (int i = 0; i < KRAKEN_HEAP_REGION_COUNT; i++) {
+        s_monitor.regions[i].alarmed = false;
+    }
+}
+
+esp_err_t kraken_heap_monitor_get_report(kraken_heap_region_t region, kraken_heap_report_t *report)
+{
+    if (region >= KRAKEN_HEAP_REGION_COUNT || !report) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_monitor.lock);
+    *report = s_monitor.regions[region].report;
+    portEXIT_CRITICAL(&s_monitor.lock);
+    return ESP_OK;
+}
+
+#else  // !CONFIG_KRAKEN_HEAP_MONITOR
+
+esp_err_t kernel_heap_monitor_init(void)
+{
+    ESP_LOGD(TAG, "Heap monitor disabled");
+    return ESP_OK;
+}
+
+void kernel_heap_monitor_cleanup(void)
+{
+}
+
+esp_err_t kraken_heap_monitor_get_report(kraken_heap_region_t region, kraken_heap_report_t *report)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif  // CONFIG_KRAKEN_HEAP_MONITOR
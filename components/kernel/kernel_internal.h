@@ -7,6 +7,18 @@
 #include "freertos/task.h"
 
 #define KRAKEN_TLS_INDEX 0  // Thread-local storage index for current service
+#define KRAKEN_TLS_ARENA_INDEX 1  // Thread-local storage index for the active arena scope
+
+// Header placed in front of every Kraken allocation (8 bytes keeps 4-byte alignment)
+#define KERNEL_MEM_HEADER_MAGIC 0x4B4D  // "KM"
+#define KERNEL_MEM_FLAG_ARENA (1 << 0)   // Served from an arena, released on reset
+
+typedef struct {
+    uint32_t size;
+    uint16_t magic;
+    uint8_t mem_class;
+    uint8_t flags;
+} kernel_mem_header_t;
 
 // Full service structure - kept internal to prevent permission tampering
 struct kraken_service_t {
@@ -50,6 +62,43 @@ kraken_service_t* kernel_find_service(const char *name);
 uint32_t kernel_calculate_perm_checksum(const char *name, uint32_t permissions);
 bool kernel_verify_permissions(kraken_service_t *svc);
 
+// Supervisor functions
+esp_err_t kernel_supervisor_init(void);
+void kernel_supervisor_cleanup(void);
+void kernel_supervisor_on_service_start(const char *name);
+void kernel_supervisor_on_service_stop(const char *name);
+
+// Memory functions
+void *kernel_mem_alloc_unscoped(size_t size, kraken_mem_class_t mem_class);
+void *kernel_arena_scoped_alloc(size_t size, kraken_mem_class_t mem_class);
+// Zeroed, from the heap even inside an arena scope: for kernel objects that
+// outlive the caller's scope. Released with kraken_free().
+void *kernel_mem_calloc(size_t size);
+void kernel_mem_profiler_record_alloc(void *ptr, size_t size, void *caller);
+void kernel_mem_profiler_record_free(void *ptr);
+esp_err_t kernel_heap_monitor_init(void);
+void kernel_heap_monitor_cleanup(void);
+
+// Task registry functions
+esp_err_t kernel_task_monitor_init(void);
+void kernel_task_monitor_cleanup(void);
+
+// Worker pool functions
+esp_err_t kernel_work_init(void);
+void kernel_work_cleanup(void);
+
+// Timer service functions
+esp_err_t kernel_timer_init(void);
+void kernel_timer_cleanup(void);
+
+// Warm-boot snapshot functions
+esp_err_t kernel_warm_init(void);
+
+// Coroutine runner functions
+esp_err_t kernel_coro_init(void);
+void kernel_coro_cleanup(void);
+void kernel_coro_on_event(const kraken_event_t *evt);
+
 // Event system functions  
 esp_err_t kernel_event_init(void);
 void kernel_event_cleanup(void);
@@ -0,0 +1,250 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "kernel_memprof";
+
+#if CONFIG_KRAKEN_MEM_PROFILER
+
+#define PROFILER_TABLE_SIZE CONFIG_KRAKEN_MEM_PROFILER_TABLE_SIZE
+#define PROFILER_TABLE_MASK (PROFILER_TABLE_SIZE - 1)
+#define PROFILER_MAX_SITES CONFIG_KRAKEN_MEM_PROFILER_MAX_SITES
+#define PROFILER_MAX_LEAK_LOGS 16
+#define PROFILER_HISTOGRAM_WIDTH 32
+
+_Static_assert((PROFILER_TABLE_SIZE & PROFILER_TABLE_MASK) == 0,
+               "CONFIG_KRAKEN_MEM_PROFILER_TABLE_SIZE must be a power of two");
+
+// One live allocation; ptr == NULL marks an empty slot
+typedef struct {
+    void *ptr;
+    void *caller;
+    uint32_t size;
+    uint32_t seq;           // Allocation sequence number, ordered against checkpoints
+    uint32_t timestamp_ms;
+} profile_entry_t;
+
+typedef struct {
+    void *caller;
+    uint32_t live_count;
+    size_t live_bytes;
+    uint32_t oldest_ms;
+} profile_site_t;
+
+static struct {
+    portMUX_TYPE lock;
+    profile_entry_t table[PROFILER_TABLE_SIZE];
+    uint32_t live_count;
+    uint32_t next_seq;
+    uint32_t dropped_count;
+    profile_site_t sites[PROFILER_MAX_SITES];  // Scratch for dumps, avoids stack use
+} s_prof = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static inline uint32_t profiler_hash(const void *ptr)
+{
+    // Fibonacci hashing; low bits of heap pointers carry no information
+    return ((uint32_t)(uintptr_t)ptr >> 3) * 2654435761u;
+}
+
+void kernel_mem_profiler_record_alloc(void *ptr, size_t size, void *caller)
+{
+    uint32_t now = kraken_get_tick_count();
+
+    portENTER_CRITICAL(&s_prof.lock);
+    uint32_t seq = s_prof.next_seq++;
+
+    // Keep the load factor under 3/4 so probe chains stay short
+    if (s_prof.live_count >= PROFILER_TABLE_SIZE - PROFILER_TABLE_SIZE / 4) {
+        s_prof.dropped_count++;
+        portEXIT_CRITICAL(&s_prof.lock);
+        return;
+    }
+
+    uint32_t i = profiler_hash(ptr) & PROFILER_TABLE_MASK;
+    while (s_prof.table[i].ptr) {
+        i = (i + 1) & PROFILER_TABLE_MASK;
+    }
+
+    s_prof.table[i] = (profile_entry_t){
+        .ptr = ptr,
+        .caller = caller,
+        .size = (uint32_t)size,
+        .seq = seq,
+        .timestamp_ms = now,
+    };
+    s_prof.live_count++;
+    portEXIT_CRITICAL(&s_prof.lock);
+}
+
+void kernel_mem_profiler_record_free(void *ptr)
+{
+    portENTER_CRITICAL(&s_prof.lock);
+
+    uint32_t i = profiler_hash(ptr) & PROFILER_TABLE_MASK;
+    while (s_prof.table[i].ptr && s_prof.table[i].ptr != ptr) {
+        i = (i + 1) & PROFILER_TABLE_MASK;
+    }
+    if (!s_prof.table[i].ptr) {
+        // Not tracked (table was full, or allocated before profiling)
+        portEXIT_CRITICAL(&s_prof.lock);
+        return;
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & PROFILER_TABLE_MASK;
+        if (!s_prof.table[j].ptr) {
+            break;
+        }
+        uint32_t home = profiler_hash(s_prof.table[j].ptr) & PROFILER_TABLE_MASK;
+        bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+        if (movable) {
+            s_prof.table[i] = s_prof.table[j];
+            i = j;
+        }
+    }
+    s_prof.table[i].ptr = NULL;
+    s_prof.live_count--;
+
+    portEXIT_CRITICAL(&s_prof.lock);
+}
+
+kraken_mem_checkpoint_t kraken_mem_checkpoint(void)
+{
+    portENTER_CRITICAL(&s_prof.lock);
+    kraken_mem_checkpoint_t cp = s_prof.next_seq;
+    portEXIT_CRITICAL(&s_prof.lock);
+    return cp;
+}
+
+esp_err_t kraken_mem_leak_check(kraken_mem_checkpoint_t from, kraken_mem_checkpoint_t to,
+                                 kraken_mem_leak_report_t *report)
+{
+    if (!report || to < from) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(report, 0, sizeof(*report));
+    uint32_t now = kraken_get_tick_count();
+    profile_entry_t leaks[PROFILER_MAX_LEAK_LOGS];
+    int logged = 0;
+
+    portENTER_CRITICAL(&s_prof.lock);
+    report->dropped_count = s_prof.dropped_count;
+    for (uint32_t i = 0; i < PROFILER_TABLE_SIZE; i++) {
+        profile_entry_t *e = &s_prof.table[i];
+        if (!e->ptr || e->seq < from || e->seq >= to) {
+            continue;
+        }
+        report->leaked_count++;
+        report->leaked_bytes += e->size;
+
+        if (logged < PROFILER_MAX_LEAK_LOGS) {
+            leaks[logged++] = *e;
+        }
+    }
+    portEXIT_CRITICAL(&s_prof.lock);
+
+    // Logging must not run inside the critical section
+    for (int i = 0; i < logged; i++) {
+        ESP_LOGW(TAG, "Leak: %p size=%" PRIu32 " caller=%p age=%" PRIu32 "ms",
+                 leaks[i].ptr, leaks[i].size, leaks[i].caller, now - leaks[i].timestamp_ms);
+    }
+
+    if (report->leaked_count) {
+        ESP_LOGW(TAG, "%" PRIu32 " allocation(s), %zu bytes leaked between checkpoints %" PRIu32
+                 " and %" PRIu32, report->leaked_count, report->leaked_bytes, from, to);
+    }
+    return ESP_OK;
+}
+
+void kraken_mem_profile_dump(void)
+{
+    uint32_t now = kraken_get_tick_count();
+    int site_count = 0;
+    uint32_t untracked_sites = 0;
+
+    // Aggregate live allocations per call site
+    portENTER_CRITICAL(&s_prof.lock);
+    for (uint32_t i = 0; i < PROFILER_TABLE_SIZE; i++) {
+        profile_entry_t *e = &s_prof.table[i];
+        if (!e->ptr) {
+            continue;
+        }
+
+        int s = 0;
+        while (s < site_count && s_prof.sites[s].caller != e->caller) {
+            s++;
+        }
+        if (s == site_count) {
+            if (site_count == PROFILER_MAX_SITES) {
+                untracked_sites++;
+                continue;
+            }
+            s_prof.sites[s] = (profile_site_t){ .caller = e->caller, .oldest_ms = e->timestamp_ms };
+            site_count++;
+        }
+
+        s_prof.sites[s].live_count++;
+        s_prof.sites[s].live_bytes += e->size;
+        // Compare ages, not timestamps, so the 32-bit ms clock may wrap
+        if (now - e->timestamp_ms > now - s_prof.sites[s].oldest_ms) {
+            s_prof.sites[s].oldest_ms = e->timestamp_ms;
+        }
+    }
+    uint32_t live_count = s_prof.live_count;
+    uint32_t dropped_count = s_prof.dropped_count;
+    portEXIT_CRITICAL(&s_prof.lock);
+
+    // Largest consumers first
+    for (int i = 1; i < site_count; i++) {
+        profile_site_t site = s_prof.sites[i];
+        int j = i - 1;
+        while (j >= 0 && s_prof.sites[j].live_bytes < site.live_bytes) {
+            s_prof.sites[j + 1] = s_prof.sites[j];
+            j--;
+        }
+        s_prof.sites[j + 1] = site;
+    }
+
+    ESP_LOGI(TAG, "Live allocations: %" PRIu32 " across %d call sites (dropped=%" PRIu32
+             ", sites over limit=%" PRIu32 ")",
+             live_count, site_count, dropped_count, untracked_sites);
+
+    size_t max_bytes = site_count ? s_prof.sites[0].live_bytes : 0;
+    for (int i = 0; i < site_count; i++) {
+        profile_site_t *site = &s_prof.sites[i];
+        char bar[PROFILER_HISTOGRAM_WIDTH + 1];
+        int len = max_bytes ? (int)(site->live_bytes * PROFILER_HISTOGRAM_WIDTH / max_bytes) : 0;
+        memset(bar, '#', len);
+        bar[len] = '\0';
+        ESP_LOGI(TAG, "%p %7zu B %4" PRIu32 " blk oldest=%6" PRIu32 "ms |%s",
+                 site->caller, site->live_bytes, site->live_count,
+                 now - site->oldest_ms, bar);
+    }
+}
+
+#else  // !CONFIG_KRAKEN_MEM_PROFILER
+
+kraken_mem_checkpoint_t kraken_mem_checkpoint(void)
+{
+    return 0;
+}
+
+esp_err_t kraken_mem_leak_check(kraken_mem_checkpoint_t from, kraken_mem_checkpoint_t to,
+                                 kraken_mem_leak_report_t *report)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void kraken_mem_profile_dump(void)
+{
+    ESP_LOGW(TAG, "Memory profiler disabled (CONFIG_KRAKEN_MEM_PROFILER)");
+}
+
+#endif  // CONFIG_KRAKEN_MEM_PROFILER
@@ -1,24 +1,244 @@
-#include "kraken/kernel.h"
+#include "kernel_internal.h"
 #include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "kernel_mem";
+
+
+static kraken_mem_stats_t s_stats[KRAKEN_MEM_CLASS_COUNT];
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *s_class_names[KRAKEN_MEM_CLASS_COUNT] = {
+    "default", "fast", "large", "dma",
+};
+
+static kraken_mem_class_t mem_class_from_flags(uint32_t flags)
+{
+    // DMA is a hard requirement, so it wins over any preference
+    if (flags & KRAKEN_MEM_DMA) {
+        return KRAKEN_MEM_CLASS_DMA;
+    }
+    if (flags & KRAKEN_MEM_FAST) {
+        return KRAKEN_MEM_CLASS_FAST;
+    }
+    if (flags & KRAKEN_MEM_LARGE) {
+        return KRAKEN_MEM_CLASS_LARGE;
+    }
+    return KRAKEN_MEM_CLASS_DEFAULT;
+}
+
+// Allocate from the preferred region first, then fall back where allowed
+static void *mem_alloc_region(kraken_mem_class_t mem_class, size_t size, bool *fallback)
+{
+    void *ptr = NULL;
+    *fallback = false;
+
+    switch (mem_class) {
+        case KRAKEN_MEM_CLASS_DMA:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            break;
+
+        case KRAKEN_MEM_CLASS_FAST:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#if CONFIG_SPIRAM
+            if (!ptr) {
+                ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                *fallback = (ptr != NULL);
+            }
+#endif
+            break;
+
+        case KRAKEN_MEM_CLASS_LARGE:
+#if CONFIG_SPIRAM
+            ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (!ptr) {
+                ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+                *fallback = (ptr != NULL);
+            }
+#else
+            ptr = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+#endif
+            break;
+
+        default:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+            break;
+    }
+
+    return ptr;
+}
+
+static void mem_account_alloc(kraken_mem_class_t mem_class, size_t size, bool fallback)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    kraken_mem_stats_t *st = &s_stats[mem_class];
+    st->alloc_count++;
+    if (fallback) {
+        st->fallback_count++;
+    }
+    st->bytes_in_use += size;
+    if (st->bytes_in_use > st->peak_bytes) {
+        st->peak_bytes = st->bytes_in_use;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void mem_account_free(kraken_mem_class_t mem_class, size_t size)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    kraken_mem_stats_t *st = &s_stats[mem_class];
+    st->free_count++;
+    st->bytes_in_use -= (size <= st->bytes_in_use) ? size : st->bytes_in_use;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void mem_account_fail(kraken_mem_class_t mem_class)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats[mem_class].fail_count++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static kernel_mem_header_t *mem_get_header(void *ptr)
+{
+    kernel_mem_header_t *hdr = (kernel_mem_header_t *)ptr - 1;
+    if (hdr->magic != KERNEL_MEM_HEADER_MAGIC || hdr->mem_class >= KRAKEN_MEM_CLASS_COUNT) {
+        ESP_LOGE(TAG, "Corrupted or foreign pointer passed to kraken_free: %p", ptr);
+        return NULL;
+    }
+    return hdr;
+}
+
+void *kernel_mem_alloc_unscoped(size_t size, kraken_mem_class_t mem_class)
+{
+    if (size == 0 || size > UINT32_MAX - sizeof(kernel_mem_header_t)) {
+        return NULL;
+    }
+
+    bool fallback = false;
+    kernel_mem_header_t *hdr = mem_alloc_region(mem_class, size + sizeof(kernel_mem_header_t), &fallback);
+    if (!hdr) {
+        mem_account_fail(mem_class);
+        ESP_LOGW(TAG, "Allocation of %u bytes (%s) failed", (unsigned)size, s_class_names[mem_class]);
+        return NULL;
+    }
+
+    hdr->size = (uint32_t)size;
+    hdr->magic = KERNEL_MEM_HEADER_MAGIC;
+    hdr->mem_class = (uint8_t)mem_class;
+    hdr->flags = 0;
+
+    mem_account_alloc(mem_class, size, fallback);
+    return hdr + 1;
+}
+
+// From the heap, tracked by the profiler; caller is the return address of the
+// public entry point
+static void *mem_alloc_heap(kraken_mem_class_t mem_class, size_t size, void *caller)
+{
+    void *ptr = kernel_mem_alloc_unscoped(size, mem_class);
+#if CONFIG_KRAKEN_MEM_PROFILER
+    if (ptr) {
+        kernel_mem_profiler_record_alloc(ptr, size, caller);
+    }
+#endif
+    return ptr;
+}
+
+static void *mem_alloc_class(kraken_mem_class_t mem_class, size_t size, void *caller)
+{
+    // Inside a kraken_arena_enter() scope the arena serves the request
+    void *ptr = kernel_arena_scoped_alloc(size, mem_class);
+    if (ptr) {
+        return ptr;
+    }
+    return mem_alloc_heap(mem_class, size, caller);
+}
+
+void *kernel_mem_calloc(size_t size)
+{
+    void *ptr = mem_alloc_heap(KRAKEN_MEM_CLASS_DEFAULT, size, __builtin_return_address(0));
+    if (ptr) {
+        memset(ptr, 0, size);
+    }
+    return ptr;
+}
+
+void *kraken_malloc_ex(size_t size, uint32_t flags)
+{
+    return mem_alloc_class(mem_class_from_flags(flags), size, __builtin_return_address(0));
+}
 
 void *kraken_malloc(size_t size)
 {
-    return heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    return mem_alloc_class(KRAKEN_MEM_CLASS_DEFAULT, size, __builtin_return_address(0));
 }
 
 void *kraken_calloc(size_t nmemb, size_t size)
 {
-    return heap_caps_calloc(nmemb, size, MALLOC_CAP_8BIT);
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    void *ptr = mem_alloc_class(KRAKEN_MEM_CLASS_DEFAULT, nmemb * size, __builtin_return_address(0));
+    if (ptr) {
+        memset(ptr, 0, nmemb * size);
+    }
+    return ptr;
 }
 
 void *kraken_realloc(void *ptr, size_t size)
 {
-    return heap_caps_realloc(ptr, size, MALLOC_CAP_8BIT);
+    if (!ptr) {
+        return mem_alloc_class(KRAKEN_MEM_CLASS_DEFAULT, size, __builtin_return_address(0));
+    }
+    if (size == 0) {
+        kraken_free(ptr);
+        return NULL;
+    }
+
+    kernel_mem_header_t *hdr = mem_get_header(ptr);
+    if (!hdr) {
+        return NULL;
+    }
+
+    // Keep the original placement class so a FAST buffer stays internal
+    void *new_ptr = mem_alloc_class((kraken_mem_class_t)hdr->mem_class, size,
+                                    __builtin_return_address(0));
+    if (!new_ptr) {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, hdr->size < size ? hdr->size : size);
+    kraken_free(ptr);  // No-op for arena blocks
+    return new_ptr;
 }
 
 void kraken_free(void *ptr)
 {
-    heap_caps_free(ptr);
+    if (!ptr) {
+        return;
+    }
+
+    kernel_mem_header_t *hdr = mem_get_header(ptr);
+    if (!hdr) {
+        return;
+    }
+
+    // Arena blocks are released all at once by kraken_arena_reset()
+    if (hdr->flags & KERNEL_MEM_FLAG_ARENA) {
+        return;
+    }
+
+#if CONFIG_KRAKEN_MEM_PROFILER
+    kernel_mem_profiler_record_free(ptr);
+#endif
+    mem_account_free((kraken_mem_class_t)hdr->mem_class, hdr->size);
+    hdr->magic = 0;  // Catch double frees
+    heap_caps_free(hdr);
 }
 
 size_t kraken_get_free_heap_size(void)
@@ -30,3 +250,31 @@ size_t kraken_get_minimum_free_heap_size(void)
 {
     return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
 }
+
+esp_err_t kraken_mem_get_stats(kraken_mem_class_t mem_class, kraken_mem_stats_t *stats)
+{
+    if (mem_class >= KRAKEN_MEM_CLASS_COUNT || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats[mem_class];
+    portEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
+void kraken_mem_dump_stats(void)
+{
+    ESP_LOGI(TAG, "Free: internal=%u psram=%u",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+
+    for (int i = 0; i < KRAKEN_MEM_CLASS_COUNT; i++) {
+        kraken_mem_stats_t st;
+        kraken_mem_get_stats((kraken_mem_class_t)i, &st);
+        ESP_LOGI(TAG, "%-7s: in_use=%u peak=%u allocs=%" PRIu32 " frees=%" PRIu32 " fails=%" PRIu32
+                 " fallbacks=%" PRIu32,
+                 s_class_names[i], (unsigned)st.bytes_in_use, (unsigned)st.peak_bytes,
+                 st.alloc_count, st.free_count, st.fail_count, st.fallback_count);
+    }
+}
@@ -1,5 +1,6 @@
 #include "kernel_internal.h"
 #include "esp_log.h"
+#include <inttypes.h>
 #include <string.h>
 
 static const char *TAG = "kernel_svc";
@@ -34,7 +35,7 @@ bool kernel_verify_permissions(kraken_service_t *svc)
     uint32_t expected = kernel_calculate_perm_checksum(svc->name, svc->permissions);
     if (svc->perm_checksum != expected) {
         ESP_LOGE(TAG, "SECURITY: Permission tampering detected for service '%s'!", svc->name);
-        ESP_LOGE(TAG, "Expected checksum: 0x%08lx, Got: 0x%08lx", expected, svc->perm_checksum);
+        ESP_LOGE(TAG, "Expected checksum: 0x%08" PRIx32 ", Got: 0x%08" PRIx32, expected, svc->perm_checksum);
         return false;
     }
     return true;
@@ -65,11 +66,10 @@ kraken_service_t* kernel_find_service(const char *name)
 
 esp_err_t kernel_service_init(void)
 {
-    g_kernel.service_mutex = xSemaphoreCreateMutex();
-    if (!g_kernel.service_mutex) {
-        ESP_LOGE(TAG, "Failed to create service mutex");
-        return ESP_ERR_NO_MEM;
-    }
+    static StaticSemaphore_t s_service_mutex_buf;
+
+    // Static creation: no heap use, cannot fail
+    g_kernel.service_mutex = xSemaphoreCreateMutexStatic(&s_service_mutex_buf);
     return ESP_OK;
 }
 
@@ -122,7 +122,7 @@ esp_err_t kraken_service_register(const char *name, uint32_t permissions,
     g_kernel.service_count++;
     xSemaphoreGive(g_kernel.service_mutex);
 
-    ESP_LOGI(TAG, "Service '%s' registered with permissions 0x%lx", name, permissions);
+    ESP_LOGI(TAG, "Service '%s' registered with permissions 0x%" PRIx32, name, permissions);
     return ESP_OK;
 }
 
@@ -150,6 +150,7 @@ esp_err_t kraken_service_unregister(const char *name)
             }
             g_kernel.service_count--;
             xSemaphoreGive(g_kernel.service_mutex);
+            kraken_service_unwatch(name);
             ESP_LOGI(TAG, "Service '%s' unregistered", name);
             return ESP_OK;
         }
@@ -194,6 +195,7 @@ esp_err_t kraken_service_start(const char *name)
     }
 
     svc->is_running = true;
+    kernel_supervisor_on_service_start(name);
     xSemaphoreGive(g_kernel.service_mutex);
     ESP_LOGI(TAG, "Service '%s' started", name);
     return ESP_OK;
@@ -232,6 +234,7 @@ esp_err_t kraken_service_stop(const char *name)
     }
 
     svc->is_running = false;
+    kernel_supervisor_on_service_stop(name);
     xSemaphoreGive(g_kernel.service_mutex);
     ESP_LOGI(TAG, "Service '%s' stopped", name);
     return ESP_OK;
@@ -289,7 +292,7 @@ esp_err_t kraken_check_caller_permission(kraken_permission_t required_perm)
 
     // Check if the caller has the required permission
     if ((svc->permissions & required_perm) == 0) {
-        ESP_LOGE(TAG, "Service '%s' denied: missing permission 0x%lx", 
+        ESP_LOGE(TAG, "Service '%s' denied: missing permission 0x%" PRIx32, 
                  caller, (uint32_t)required_perm);
         return ESP_ERR_NOT_ALLOWED;
     }
@@ -0,0 +1,418 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <inttypes.h>
+#include <string.h>
+
+static const char *TAG = "kernel_sup";
+
+typedef enum {
+    WATCH_IDLE = 0,     // Service not running, heartbeats not checked
+    WATCH_OK,
+    WATCH_PENDING,      // Missed, restart due at retry_at_ms
+    WATCH_RESTARTING,   // Restart job is stopping/starting the service
+    WATCH_FAILED,       // Gave up; re-armed by the next start of the service
+} watch_state_t;
+
+static const char *s_state_names[] = {
+    "idle", "ok", "pending", "restarting", "failed",
+};
+
+struct kraken_watch {
+    bool used;
+    char name[KRAKEN_SERVICE_NAME_MAX_LEN];
+    uint32_t timeout_ms;
+    volatile uint32_t last_beat_ms;  // 32-bit so a heartbeat is one store
+    watch_state_t state;
+    uint32_t restarts;               // Since the service was last stable
+    uint32_t total_restarts;
+    uint32_t misses;
+    uint32_t retry_at_ms;
+    uint32_t stable_since_ms;
+    bool give_up;                    // Restart job only stops the service
+    kraken_watchdog_event_t event;   // Payload of the last posted event
+};
+
+static struct {
+    portMUX_TYPE lock;
+    kraken_watch_t watches[CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES];
+    void *timer;
+    bool restart_busy;               // One restart job at a time
+} s_sup = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// Wraps after ~49 days; all comparisons use unsigned differences
+static inline uint32_t supervisor_now_ms(void)
+{
+    return (uint32_t)(kraken_time_us() / 1000);
+}
+
+// The first restart is immediate; each further one waits twice as long
+static uint32_t supervisor_backoff_ms(uint32_t restarts)
+{
+    if (restarts == 0) {
+        return 0;
+    }
+    uint32_t backoff = CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MIN_MS;
+    for (uint32_t i = 1; i < restarts && backoff < CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MAX_MS; i++) {
+        backoff *= 2;
+    }
+    return backoff < CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MAX_MS ?
+        backoff : CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MAX_MS;
+}
+
+// Caller holds s_sup.lock
+static kraken_watch_t *supervisor_find(const char *name)
+{
+    for (int i = 0; i < CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES; i++) {
+        if (s_sup.watches[i].used && strcmp(s_sup.watches[i].name, name) == 0) {
+            return &s_sup.watches[i];
+        }
+    }
+    return NULL;
+}
+
+// Caller holds s_sup.lock. The payload stays valid until the next event for
+// this watch, which is at least one check period later.
+static void supervisor_fill_event(kraken_watch_t *w, kraken_watchdog_action_t action,
+                                  uint32_t overdue_ms, uint32_t backoff_ms)
+{
+    memcpy(w->event.service, w->name, sizeof(w->event.service));
+    w->event.action = action;
+    w->event.overdue_ms = overdue_ms;
+    w->event.restarts = w->restarts;
+    w->event.backoff_ms = backoff_ms;
+}
+
+static void supervisor_post(kraken_watch_t *w)
+{
+    kraken_event_post(KRAKEN_EVENT_SYSTEM_WATCHDOG, &w->event, sizeof(w->event));
+}
+
+// A worker pool job. It holds its worker for as long as the service's deinit
+// and init take, which can be seconds for a stuck task. Restarts run one at a
+// time, and the other workers steal the shared jobs queued behind it.
+static void supervisor_restart_job(void *arg)
+{
+    kraken_watch_t *w = arg;
+
+    // The name cannot change while the watch is RESTARTING (unwatch refuses)
+    if (w->give_up) {
+        ESP_LOGE(TAG, "Service '%s' keeps hanging, stopping it", w->name);
+        esp_err_t ret = kraken_service_stop(w->name);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Service '%s' did not stop: %s", w->name, esp_err_to_name(ret));
+        }
+    } else {
+        ESP_LOGW(TAG, "Restarting service '%s' (attempt %lu)", w->name,
+                 (unsigned long)(w->restarts + 1));
+        int64_t start_us = kraken_time_us();
+
+        // A stop that times out leaves is_running set, and a start would then
+        // return ESP_OK without touching the hung service: a failed restart
+        esp_err_t ret = kraken_service_stop(w->name);
+        if (ret == ESP_OK) {
+            ret = kraken_service_start(w->name);
+        }
+        uint32_t now = supervisor_now_ms();
+
+        portENTER_CRITICAL(&s_sup.lock);
+        w->restarts++;
+        w->total_restarts++;
+        if (ret == ESP_OK) {
+            w->state = WATCH_OK;
+            w->last_beat_ms = now;
+            w->stable_since_ms = now;
+            supervisor_fill_event(w, KRAKEN_WATCHDOG_RESTARTED, 0,
+                                  supervisor_backoff_ms(w->restarts));
+        } else if (CONFIG_KRAKEN_SUPERVISOR_MAX_RESTARTS &&
+                   w->restarts >= CONFIG_KRAKEN_SUPERVISOR_MAX_RESTARTS) {
+            w->state = WATCH_FAILED;
+            supervisor_fill_event(w, KRAKEN_WATCHDOG_GAVE_UP, 0, 0);
+        } else {
+            // Stop or start failed: retried from PENDING, never re-armed by heartbeats
+            w->state = WATCH_PENDING;
+            w->retry_at_ms = now + supervisor_backoff_ms(w->restarts);
+            supervisor_fill_event(w, KRAKEN_WATCHDOG_RESTART_FAILED, 0,
+                                  supervisor_backoff_ms(w->restarts));
+        }
+        portEXIT_CRITICAL(&s_sup.lock);
+
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "Service '%s' restarted in %" PRId64 " ms", w->name,
+                     (kraken_time_us() - start_us) / 1000);
+        } else if (w->event.action == KRAKEN_WATCHDOG_GAVE_UP) {
+            ESP_LOGE(TAG, "Service '%s' failed to restart: %s, giving up", w->name,
+                     esp_err_to_name(ret));
+        } else {
+            ESP_LOGE(TAG, "Service '%s' failed to restart: %s, retry in %lu ms", w->name,
+                     esp_err_to_name(ret), (unsigned long)w->event.backoff_ms);
+        }
+        supervisor_post(w);
+    }
+
+    portENTER_CRITICAL(&s_sup.lock);
+    s_sup.restart_busy = false;
+    portEXIT_CRITICAL(&s_sup.lock);
+}
+
+// Caller holds s_sup.lock; returns false if no restart could be started now
+static bool supervisor_launch_restart_locked(kraken_watch_t *w)
+{
+    if (s_sup.restart_busy) {
+        return false;
+    }
+    s_sup.restart_busy = true;
+    w->state = WATCH_RESTARTING;
+    return true;
+}
+
+static void supervisor_launch_restart(kraken_watch_t *w)
+{
+    if (kraken_work_submit(supervisor_restart_job, w, KRAKEN_WORK_PRIO_LOW,
+                           KRAKEN_WORK_CORE_ANY) != ESP_OK) {
+        ESP_LOGE(TAG, "Worker queue full, retrying '%s' next check", w->name);
+        portENTER_CRITICAL(&s_sup.lock);
+        w->state = WATCH_PENDING;
+        s_sup.restart_busy = false;
+        portEXIT_CRITICAL(&s_sup.lock);
+    }
+}
+
+static void supervisor_check_cb(void *arg)
+{
+    (void)arg;
+    uint32_t now = supervisor_now_ms();
+
+    for (int i = 0; i < CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES; i++) {
+        kraken_watch_t *w = &s_sup.watches[i];
+        bool post = false;
+        bool launch = false;
+        uint32_t overdue = 0;
+
+        portENTER_CRITICAL(&s_sup.lock);
+        if (!w->used) {
+            portEXIT_CRITICAL(&s_sup.lock);
+            continue;
+        }
+
+        switch (w->state) {
+            case WATCH_OK:
+                overdue = now - w->last_beat_ms;
+                if (overdue > w->timeout_ms) {
+                    w->misses++;
+                    post = true;
+                    if (CONFIG_KRAKEN_SUPERVISOR_MAX_RESTARTS &&
+                        w->restarts >= CONFIG_KRAKEN_SUPERVISOR_MAX_RESTARTS) {
+                        w->give_up = true;
+                        w->retry_at_ms = now;
+                        supervisor_fill_event(w, KRAKEN_WATCHDOG_GAVE_UP, overdue, 0);
+                        launch = supervisor_launch_restart_locked(w);
+                        w->state = launch ? WATCH_FAILED : WATCH_PENDING;
+                    } else {
+                        w->state = WATCH_PENDING;
+                        w->retry_at_ms = now + supervisor_backoff_ms(w->restarts);
+                        supervisor_fill_event(w, KRAKEN_WATCHDOG_MISSED, overdue,
+                                              supervisor_backoff_ms(w->restarts));
+                    }
+                } else if (w->restarts &&
+                           now - w->stable_since_ms >= CONFIG_KRAKEN_SUPERVISOR_STABLE_MS) {
+                    // Healthy long enough: the next hang restarts immediately again
+                    w->restarts = 0;
+                }
+                break;
+
+            case WATCH_PENDING:
+                if ((int32_t)(now - w->retry_at_ms) >= 0) {
+                    launch = supervisor_launch_restart_locked(w);
+                    if (launch && w->give_up) {
+                        w->state = WATCH_FAILED;
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+        portEXIT_CRITICAL(&s_sup.lock);
+
+        if (post) {
+            ESP_LOGE(TAG, "Service '%s' missed its heartbeat (%lu ms overdue, timeout %lu ms)",
+                     w->name, (unsigned long)(overdue - w->timeout_ms),
+                     (unsigned long)w->timeout_ms);
+            supervisor_post(w);
+        }
+        if (launch) {
+            supervisor_launch_restart(w);
+        }
+    }
+}
+
+esp_err_t kraken_service_watch(const char *name, uint32_t timeout_ms, kraken_watch_t **watch)
+{
+    if (!g_kernel.initialized || timeout_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!name) {
+        name = kernel_get_current_service();
+        if (!name) {
+            ESP_LOGE(TAG, "No service context; pass the service name");
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    // Lock-free peek: watch is usually called from the service's own init, with
+    // service_mutex held by kraken_service_start. is_running is still false
+    // there; kernel_supervisor_on_service_start arms the watch afterwards.
+    kraken_service_t *svc = kernel_find_service(name);
+    if (!svc) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    bool running = svc->is_running;
+    uint32_t now = supervisor_now_ms();
+
+    portENTER_CRITICAL(&s_sup.lock);
+    kraken_watch_t *w = supervisor_find(name);
+    if (!w) {
+        for (int i = 0; i < CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES; i++) {
+            if (!s_sup.watches[i].used) {
+                w = &s_sup.watches[i];
+                memset(w, 0, sizeof(*w));
+                w->used = true;
+                strncpy(w->name, name, sizeof(w->name) - 1);
+                w->state = running ? WATCH_OK : WATCH_IDLE;
+                break;
+            }
+        }
+    }
+    if (w) {
+        // Restart history is kept when a restarted service watches itself again
+        w->timeout_ms = timeout_ms;
+        w->last_beat_ms = now;
+    }
+    portEXIT_CRITICAL(&s_sup.lock);
+
+    if (!w) {
+        ESP_LOGE(TAG, "No free watch for '%s', raise CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES", name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (watch) {
+        *watch = w;
+    }
+    return ESP_OK;
+}
+
+esp_err_t kraken_service_unwatch(const char *name)
+{
+    if (!name) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&s_sup.lock);
+    kraken_watch_t *w = supervisor_find(name);
+    if (w) {
+        if (w->state == WATCH_RESTARTING) {
+            ret = ESP_ERR_INVALID_STATE;
+        } else {
+            // Handles stay valid: a late heartbeat on a free slot is harmless
+            w->used = false;
+            ret = ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&s_sup.lock);
+    return ret;
+}
+
+void kraken_service_heartbeat(kraken_watch_t *watch)
+{
+    if (watch) {
+        watch->last_beat_ms = supervisor_now_ms();
+    }
+}
+
+void kernel_supervisor_on_service_start(const char *name)
+{
+    portENTER_CRITICAL(&s_sup.lock);
+    kraken_watch_t *w = supervisor_find(name);
+    if (w && (w->state == WATCH_IDLE || w->state == WATCH_FAILED)) {
+        if (w->state == WATCH_FAILED) {
+            // Started by hand after the supervisor gave up: a fresh history
+            w->restarts = 0;
+            w->give_up = false;
+        }
+        w->state = WATCH_OK;
+        w->last_beat_ms = supervisor_now_ms();
+        w->stable_since_ms = w->last_beat_ms;
+    }
+    portEXIT_CRITICAL(&s_sup.lock);
+}
+
+void kernel_supervisor_on_service_stop(const char *name)
+{
+    portENTER_CRITICAL(&s_sup.lock);
+    kraken_watch_t *w = supervisor_find(name);
+    // A stop by the restart job keeps its state; any other stop pauses the watch
+    if (w && w->state != WATCH_RESTARTING && w->state != WATCH_FAILED) {
+        w->state = WATCH_IDLE;
+    }
+    portEXIT_CRITICAL(&s_sup.lock);
+}
+
+void kraken_service_dump_watches(void)
+{
+    uint32_t now = supervisor_now_ms();
+
+    ESP_LOGI(TAG, "Supervised services:");
+    for (int i = 0; i < CONFIG_KRAKEN_SUPERVISOR_MAX_WATCHES; i++) {
+        portENTER_CRITICAL(&s_sup.lock);
+        kraken_watch_t snap = s_sup.watches[i];
+        portEXIT_CRITICAL(&s_sup.lock);
+
+        if (!snap.used) {
+            continue;
+        }
+        ESP_LOGI(TAG, "  %-12s %-10s timeout=%lu ms last_beat=%lu ms ago misses=%lu restarts=%lu",
+                 snap.name, s_state_names[snap.state], (unsigned long)snap.timeout_ms,
+                 (unsigned long)(now - snap.last_beat_ms), (unsigned long)snap.misses,
+                 (unsigned long)snap.total_restarts);
+    }
+}
+
+esp_err_t kernel_supervisor_init(void)
+{
+    // The check is a short scan; restarts are separate jobs on the same pool
+    kraken_timer_config_t cfg = {
+        .name = "supervisor",
+        .period_ms = CONFIG_KRAKEN_SUPERVISOR_CHECK_MS,
+        .auto_reload = true,
+        .slack_ms = CONFIG_KRAKEN_SUPERVISOR_CHECK_MS / 10,
+        .callback = supervisor_check_cb,
+        .executor = kraken_work_executor(KRAKEN_WORK_PRIO_LOW, KRAKEN_WORK_CORE_ANY),
+    };
+    esp_err_t ret = kraken_timer_create_ex(&cfg, &s_sup.timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = kraken_timer_start(s_sup.timer);
+    if (ret != ESP_OK) {
+        kraken_timer_delete(s_sup.timer);
+        s_sup.timer = NULL;
+    }
+    return ret;
+}
+
+void kernel_supervisor_cleanup(void)
+{
+    if (s_sup.timer) {
+        kraken_timer_delete(s_sup.timer);
+        s_sup.timer = NULL;
+    }
+
+    portENTER_CRITICAL(&s_sup.lock);
+    memset(s_sup.watches, 0, sizeof(s_sup.watches));
+    portEXIT_CRITICAL(&s_sup.lock);
+}
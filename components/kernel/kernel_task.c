@@ -0,0 +1,384 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/idf_additions.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_cpu.h"
+#include "esp_memory_utils.h"
+#endif
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "kernel_task";
+
+#define TASK_REGISTRY_SIZE CONFIG_KRAKEN_TASK_REGISTRY_SIZE
+#define TASK_HISTORY_LEN CONFIG_KRAKEN_TASK_STACK_HISTORY
+#define TASK_STACK_ALIGN 256
+
+typedef struct {
+    TaskHandle_t handle;               // NULL: free slot
+    char name[configMAX_TASK_NAME_LEN];
+    const char *kconfig;               // Symbol that sizes this stack, or NULL
+    bool psram_stack;                  // Created by kraken_task_create with a PSRAM stack
+    uint32_t stack_size;
+    uint32_t min_free;                 // Lowest high-water mark seen
+    uint32_t history[TASK_HISTORY_LEN];// Recent samples, oldest overwritten
+    uint8_t history_pos;
+    uint8_t history_count;
+    uint32_t samples;
+} task_entry_t;
+
+static StaticSemaphore_t s_sample_mutex_buf;
+
+static struct {
+    portMUX_TYPE lock;
+    SemaphoreHandle_t sample_mutex;    // Held across a sample; unregister waits on it
+    task_entry_t tasks[TASK_REGISTRY_SIZE];
+    void *sample_timer;
+} s_tasks = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// Peak usage plus a proportional and a fixed margin, rounded up
+static uint32_t task_suggest_stack(uint32_t stack_size, uint32_t min_free)
+{
+    uint32_t used = stack_size > min_free ? stack_size - min_free : 0;
+    uint32_t size = used + used * CONFIG_KRAKEN_TASK_STACK_MARGIN_PCT / 100 +
+                    CONFIG_KRAKEN_TASK_STACK_MARGIN_BYTES;
+    return (size + TASK_STACK_ALIGN - 1) & ~(TASK_STACK_ALIGN - 1);
+}
+
+static void task_fill_info(const task_entry_t *e, kraken_task_stack_info_t *info)
+{
+    info->stack_size = e->stack_size;
+    info->min_free = e->min_free;
+    info->last_free = e->history_count ?
+        e->history[(e->history_pos + TASK_HISTORY_LEN - 1) % TASK_HISTORY_LEN] : e->min_free;
+    info->samples = e->samples;
+    info->suggested_size = e->samples ? task_suggest_stack(e->stack_size, e->min_free) : e->stack_size;
+}
+
+static void task_sample_cb(void *arg)
+{
+    (void)arg;
+    TaskHandle_t handles[TASK_REGISTRY_SIZE];
+    uint32_t free_bytes[TASK_REGISTRY_SIZE];
+
+    // The mutex pins every copied handle: a task cannot leave the registry (and
+    // so cannot be deleted) until the scan below is done with its TCB.
+    xSemaphoreTake(s_tasks.sample_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        handles[i] = s_tasks.tasks[i].handle;
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+
+    // Scanning a stack for the fill pattern is too slow for a critical section.
+    // StackType_t is one byte on ESP-IDF, so the result is in bytes.
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        if (handles[i]) {
+            free_bytes[i] = uxTaskGetStackHighWaterMark(handles[i]);
+        }
+    }
+
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        task_entry_t *e = &s_tasks.tasks[i];
+        if (!handles[i] || e->handle != handles[i]) {
+            continue;
+        }
+
+        if (free_bytes[i] < e->min_free) {
+            e->min_free = free_bytes[i];
+        }
+        e->history[e->history_pos] = free_bytes[i];
+        e->history_pos = (e->history_pos + 1) % TASK_HISTORY_LEN;
+        if (e->history_count < TASK_HISTORY_LEN) {
+            e->history_count++;
+        }
+        e->samples++;
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+    xSemaphoreGive(s_tasks.sample_mutex);
+}
+
+esp_err_t kraken_task_register(void *handle, uint32_t stack_size, const char *kconfig)
+{
+    if (!handle || stack_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        task_entry_t *e = &s_tasks.tasks[i];
+        if (e->handle == handle) {
+            ret = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        if (!e->handle) {
+            memset(e, 0, sizeof(*e));
+            e->handle = handle;
+            strncpy(e->name, pcTaskGetName(handle), sizeof(e->name) - 1);
+            e->kconfig = kconfig;
+            e->stack_size = stack_size;
+            e->min_free = stack_size;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+
+    if (ret == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "Task registry full, %s not tracked", pcTaskGetName(handle));
+    }
+    return ret;
+}
+
+esp_err_t kraken_task_unregister(void *handle)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    // Waits out a sample in progress, so the caller may free the task on return.
+    // Before the monitor starts there is no sampler to wait for.
+    if (s_tasks.sample_mutex) {
+        xSemaphoreTake(s_tasks.sample_mutex, portMAX_DELAY);
+    }
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        if (handle && s_tasks.tasks[i].handle == handle) {
+            s_tasks.tasks[i].handle = NULL;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+    if (s_tasks.sample_mutex) {
+        xSemaphoreGive(s_tasks.sample_mutex);
+    }
+    return ret;
+}
+
+static void task_mark_psram(TaskHandle_t task)
+{
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        if (s_tasks.tasks[i].handle == task) {
+            s_tasks.tasks[i].psram_stack = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+}
+
+static bool task_is_psram(TaskHandle_t task)
+{
+    bool psram = false;
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        if (s_tasks.tasks[i].handle == task) {
+            psram = s_tasks.tasks[i].psram_stack;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+    return psram;
+}
+
+esp_err_t kraken_task_create(const kraken_task_config_t *config, void **handle)
+{
+    if (!config || !config->fn || !config->name || config->stack_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    TaskHandle_t task = NULL;
+    BaseType_t core = config->core == KRAKEN_TASK_CORE_ANY ? tskNO_AFFINITY : config->core;
+    bool psram = false;
+
+#if CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+    if (config->psram_stack) {
+        // Static creation underneath: TCB in internal RAM, stack from the PSRAM heap
+        psram = xTaskCreatePinnedToCoreWithCaps(config->fn, config->name, config->stack_size,
+                                                config->arg, config->priority, &task, core,
+                                                MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) == pdPASS;
+        if (!psram) {
+            ESP_LOGW(TAG, "No PSRAM stack for %s, using internal RAM", config->name);
+        }
+    }
+#else
+    if (config->psram_stack) {
+        ESP_LOGW(TAG, "CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY off, %s stack stays internal",
+                 config->name);
+    }
+#endif
+
+    if (!psram && xTaskCreatePinnedToCore(config->fn, config->name, config->stack_size, config->arg,
+                                          config->priority, &task, core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s (%" PRIu32 " byte stack)", config->name, config->stack_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    kraken_task_register(task, config->stack_size, config->kconfig);
+    if (psram) {
+        task_mark_psram(task);
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return ESP_OK;
+}
+
+esp_err_t kraken_task_delete(void *handle)
+{
+    // NULL deletes the calling task, like vTaskDelete
+    TaskHandle_t task = handle ? handle : xTaskGetCurrentTaskHandle();
+    bool psram = task_is_psram(task);
+
+    if (psram && task == xTaskGetCurrentTaskHandle()) {
+        // The stack cannot be freed while running on it
+        ESP_LOGE(TAG, "%s has a PSRAM stack and must be deleted by another task", pcTaskGetName(task));
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    kraken_task_unregister(task);
+#if CONFIG_SPIRAM_ALLOW_STACK_EXTERNAL_MEMORY
+    if (psram) {
+        vTaskDeleteWithCaps(task);
+        return ESP_OK;
+    }
+#endif
+    vTaskDelete(handle);
+    return ESP_OK;
+}
+
+bool kraken_task_stack_is_internal(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return true;  // Host builds have no PSRAM
+#else
+    return !esp_ptr_external_ram((const void *)esp_cpu_get_sp());
+#endif
+}
+
+esp_err_t kraken_task_get_stack_info(const char *name, kraken_task_stack_info_t *info)
+{
+    if (!name || !info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    portENTER_CRITICAL(&s_tasks.lock);
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        task_entry_t *e = &s_tasks.tasks[i];
+        if (e->handle && strcmp(e->name, name) == 0) {
+            task_fill_info(e, info);
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_tasks.lock);
+    return ret;
+}
+
+void kraken_task_dump_stack_report(void)
+{
+    // Snapshot so logging happens outside the critical section
+    static task_entry_t snapshot[TASK_REGISTRY_SIZE];
+    portENTER_CRITICAL(&s_tasks.lock);
+    memcpy(snapshot, s_tasks.tasks, sizeof(snapshot));
+    portEXIT_CRITICAL(&s_tasks.lock);
+
+    int32_t reclaimable = 0;
+    ESP_LOGI(TAG, "%-16s %6s %6s %6s %6s %s", "task", "size", "min", "last", "suggest", "history (free bytes, newest last)");
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        task_entry_t *e = &snapshot[i];
+        if (!e->handle) {
+            continue;
+        }
+
+        kraken_task_stack_info_t info;
+        task_fill_info(e, &info);
+
+        char history[TASK_HISTORY_LEN * 7 + 1];
+        int len = 0;
+        for (int h = 0; h < e->history_count; h++) {
+            int idx = (e->history_pos + TASK_HISTORY_LEN - e->history_count + h) % TASK_HISTORY_LEN;
+            len += snprintf(history + len, sizeof(history) - len, " %" PRIu32, e->history[idx]);
+        }
+        history[len] = '\0';
+
+        ESP_LOGI(TAG, "%-16s %6" PRIu32 " %6" PRIu32 " %6" PRIu32 " %6" PRIu32 "%s", e->name, info.stack_size, info.min_free,
+                 info.last_free, info.suggested_size, history);
+        if (info.min_free < CONFIG_KRAKEN_TASK_STACK_MARGIN_BYTES) {
+            ESP_LOGW(TAG, "%s is within %d bytes of overflowing its stack", e->name,
+                     CONFIG_KRAKEN_TASK_STACK_MARGIN_BYTES);
+        }
+        if (e->samples) {
+            reclaimable += (int32_t)info.stack_size - (int32_t)info.suggested_size;
+        }
+    }
+    ESP_LOGI(TAG, "Reclaimable with suggested sizes: %" PRId32 " bytes", reclaimable);
+
+    // sdkconfig.defaults lines; tasks sharing a symbol take the largest suggestion
+    ESP_LOGI(TAG, "Suggested Kconfig values:");
+    for (int i = 0; i < TASK_REGISTRY_SIZE; i++) {
+        task_entry_t *e = &snapshot[i];
+        if (!e->handle || !e->kconfig || !e->samples) {
+            continue;
+        }
+
+        uint32_t suggested = 0;
+        bool first = true;
+        for (int j = 0; j < TASK_REGISTRY_SIZE; j++) {
+            task_entry_t *o = &snapshot[j];
+            if (!o->handle || !o->kconfig || !o->samples || strcmp(o->kconfig, e->kconfig) != 0) {
+                continue;
+            }
+            if (j < i) {
+                first = false;  // Already printed with an earlier task
+                break;
+            }
+            uint32_t s = task_suggest_stack(o->stack_size, o->min_free);
+            suggested = s > suggested ? s : suggested;
+        }
+        if (first) {
+            ESP_LOGI(TAG, "  %s=%" PRIu32, e->kconfig, suggested);
+        }
+    }
+}
+
+esp_err_t kernel_task_monitor_init(void)
+{
+    // Kept after cleanup: a sample already handed to a worker may still run
+    if (!s_tasks.sample_mutex) {
+        s_tasks.sample_mutex = xSemaphoreCreateMutexStatic(&s_sample_mutex_buf);
+    }
+
+    // Workers are fine here: sampling is a short scan of the registry
+    kraken_timer_config_t cfg = {
+        .name = "stack_hwm",
+        .period_ms = CONFIG_KRAKEN_TASK_STACK_SAMPLE_MS,
+        .auto_reload = true,
+        .slack_ms = CONFIG_KRAKEN_TASK_STACK_SAMPLE_MS / 10,
+        .callback = task_sample_cb,
+        .executor = kraken_work_executor(KRAKEN_WORK_PRIO_LOW, KRAKEN_WORK_CORE_ANY),
+    };
+    esp_err_t ret = kraken_timer_create_ex(&cfg, &s_tasks.sample_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // First sample right away so early peaks (boot, first connection) are seen
+    task_sample_cb(NULL);
+    return kraken_timer_start(s_tasks.sample_timer);
+}
+
+void kernel_task_monitor_cleanup(void)
+{
+    if (s_tasks.sample_timer) {
+        kraken_timer_delete(s_tasks.sample_timer);
+        s_tasks.sample_timer = NULL;
+    }
+}
@@ -1,49 +1,464 @@
-#include "kraken/kernel.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/timers.h"
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include <string.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
 
-esp_err_t kraken_timer_create(const char *name, uint32_t period_ms,
-                               bool auto_reload, void (*callback)(void*),
-                               void *arg, void **handle)
+static const char *TAG = "kernel_tmr";
+
+// Hierarchical timing wheel: 4 levels x 64 slots at 1 ms resolution covers
+// 64^4 ms (~4.6 hours); longer timers park in the top level and re-cascade.
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_SHIFT(level) ((level) * WHEEL_BITS)
+#define WHEEL_MAX_DELTA ((1ULL << (WHEEL_LEVELS * WHEEL_BITS)) - 1)
+#define WHEEL_NO_EVENT UINT64_MAX
+#define TIMER_NAME_MAX_LEN 16
+
+#if CONFIG_KRAKEN_TIMER_TASK_CORE < 0
+#define TIMER_TASK_CORE tskNO_AFFINITY
+#else
+#define TIMER_TASK_CORE CONFIG_KRAKEN_TIMER_TASK_CORE
+#endif
+
+typedef struct kernel_timer {
+    struct kernel_timer *next;
+    struct kernel_timer *prev;
+    uint64_t expiry;       // Tick (ms) the timer was asked to fire at
+    uint64_t fire_tick;    // expiry moved into the slack window; used for placement
+    uint32_t period_ms;
+    uint32_t slack_ms;
+    bool auto_reload;
+    bool armed;
+    uint8_t level;
+    uint8_t slot;
+    void (*callback)(void *);
+    void *arg;
+    const kraken_executor_t *executor;  // NULL: run on the timer task
+    char name[TIMER_NAME_MAX_LEN];
+} kernel_timer_t;
+
+static struct {
+    SemaphoreHandle_t lock;
+    kernel_timer_t *slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t occupied[WHEEL_LEVELS];  // Bit per non-empty slot
+    uint64_t current;                 // Last processed tick
+    uint64_t scheduled_wake;          // Tick the wake timer is armed for
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_timer_handle_t wake_timer;    // The host has no esp_timer; the task sleeps with a timeout
+#endif
+    TaskHandle_t task;
+    kraken_timer_stats_t stats;
+} s_wheel;
+
+static StaticSemaphore_t s_lock_buf;
+static StaticTask_t s_task_buf;
+static StackType_t s_task_stack[CONFIG_KRAKEN_TIMER_TASK_STACK_SIZE];
+
+static inline uint64_t timer_now_tick(void)
 {
-    if (!name || !callback || !handle) {
+    return (uint64_t)kraken_time_us() / 1000;
+}
+
+static inline uint64_t rotr64(uint64_t v, unsigned n)
+{
+    n &= 63;
+    return n ? (v >> n) | (v << (64 - n)) : v;
+}
+
+// Pick the most aligned tick inside [expiry, expiry + slack], so timers with
+// overlapping slack windows land in the same slot and fire in one wakeup
+static uint64_t timer_coalesce(uint64_t expiry, uint32_t slack_ms)
+{
+    if (slack_ms == 0) {
+        return expiry;
+    }
+    uint64_t step = 1ULL << (31 - __builtin_clz(slack_ms));
+    return (expiry + slack_ms) & ~(step - 1);
+}
+
+// Links the timer at its fire_tick, or at 'earliest' if that has already passed
+static void wheel_link_from(kernel_timer_t *t, uint64_t earliest)
+{
+    uint64_t tick = t->fire_tick > earliest ? t->fire_tick : earliest;
+    uint64_t delta = tick - s_wheel.current;
+    if (delta > WHEEL_MAX_DELTA) {
+        // Parks in the top level; re-placed with the real fire_tick on cascade
+        delta = WHEEL_MAX_DELTA;
+        tick = s_wheel.current + delta;
+    }
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << WHEEL_SHIFT(level + 1))) {
+        level++;
+    }
+    uint8_t slot = (tick >> WHEEL_SHIFT(level)) & WHEEL_MASK;
+
+    t->level = level;
+    t->slot = slot;
+    t->prev = NULL;
+    t->next = s_wheel.slots[level][slot];
+    if (t->next) {
+        t->next->prev = t;
+    }
+    s_wheel.slots[level][slot] = t;
+    s_wheel.occupied[level] |= 1ULL << slot;
+    t->armed = true;
+}
+
+// The slot of 'current' has been served already, so new timers start one tick on
+static void wheel_link(kernel_timer_t *t)
+{
+    wheel_link_from(t, s_wheel.current + 1);
+}
+
+static void wheel_unlink(kernel_timer_t *t)
+{
+    if (!t->armed) {
+        return;
+    }
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        s_wheel.slots[t->level][t->slot] = t->next;
+    }
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    if (!s_wheel.slots[t->level][t->slot]) {
+        s_wheel.occupied[t->level] &= ~(1ULL << t->slot);
+    }
+    t->next = t->prev = NULL;
+    t->armed = false;
+}
+
+// Earliest tick after 'current' at which a level-0 slot fires or an occupied
+// upper-level slot must cascade. Found from the occupancy bitmaps in O(levels).
+static uint64_t wheel_next_event(void)
+{
+    uint64_t best = WHEEL_NO_EVENT;
+    uint64_t cur = s_wheel.current;
+
+    if (s_wheel.occupied[0]) {
+        uint64_t rot = rotr64(s_wheel.occupied[0], (cur + 1) & WHEEL_MASK);
+        best = cur + 1 + __builtin_ctzll(rot);
+    }
+
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if (!s_wheel.occupied[level]) {
+            continue;
+        }
+        uint64_t block = cur >> WHEEL_SHIFT(level);
+        uint64_t rot = rotr64(s_wheel.occupied[level], (block + 1) & WHEEL_MASK);
+        uint64_t tick = (block + 1 + __builtin_ctzll(rot)) << WHEEL_SHIFT(level);
+        if (tick < best) {
+            best = tick;
+        }
+    }
+    return best;
+}
+
+static void wheel_cascade(int level, uint8_t slot)
+{
+    kernel_timer_t *t = s_wheel.slots[level][slot];
+    s_wheel.slots[level][slot] = NULL;
+    s_wheel.occupied[level] &= ~(1ULL << slot);
+
+    // Cascading runs before the level-0 slot of 'current' is served, so timers
+    // due on this very tick go into that slot instead of one tick late
+    while (t) {
+        kernel_timer_t *next = t->next;
+        t->armed = false;
+        wheel_link_from(t, s_wheel.current);
+        t = next;
+    }
+}
+
+// Must be called with the lock held
+static void wheel_schedule_wake(void)
+{
+    uint64_t next = wheel_next_event();
+    if (next == s_wheel.scheduled_wake) {
+        return;
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    bool earlier = next < s_wheel.scheduled_wake;
+    s_wheel.scheduled_wake = next;
+    // The timer task picks the new deadline up when it next blocks
+    if (earlier && xTaskGetCurrentTaskHandle() != s_wheel.task) {
+        xTaskNotifyGive(s_wheel.task);
+    }
+#else
+    esp_timer_stop(s_wheel.wake_timer);
+    s_wheel.scheduled_wake = next;
+    if (next == WHEEL_NO_EVENT) {
+        return;
+    }
+
+    int64_t now_us = kraken_time_us();
+    int64_t wait_us = (int64_t)next * 1000 - now_us;
+    esp_timer_start_once(s_wheel.wake_timer, wait_us > 0 ? wait_us : 1);
+#endif
+}
+
+// How long the timer task may block; must be called with the lock held
+static TickType_t timer_wait_ticks(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    if (s_wheel.scheduled_wake == WHEEL_NO_EVENT) {
+        return portMAX_DELAY;
+    }
+    int64_t wait_us = (int64_t)s_wheel.scheduled_wake * 1000 - kraken_time_us();
+    int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+    // Round up: waking a tick early only finds nothing due and sleeps again
+    return wait_us > 0 ? (TickType_t)((wait_us + tick_us - 1) / tick_us) : 0;
+#else
+    return portMAX_DELAY;  // The wake timer notifies the task
+#endif
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static void timer_wake_cb(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_wheel.task);
+}
+#endif
+
+// The timer itself may be deleted by now; only the copied fields are used
+static void timer_run(void (*callback)(void *), void *arg, const kraken_executor_t *executor)
+{
+    if (executor && executor->submit) {
+        if (executor->submit(callback, arg, executor->ctx) == ESP_OK) {
+            return;
+        }
+        ESP_LOGW(TAG, "Executor rejected timer callback, running inline");
+    }
+    callback(arg);
+}
+
+static void timer_task(void *arg)
+{
+    (void)arg;
+    TickType_t wait = portMAX_DELAY;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+        uint64_t now = timer_now_tick();
+        uint32_t fired_this_wakeup = 0;
+        s_wheel.scheduled_wake = WHEEL_NO_EVENT;
+
+        while (1) {
+            kernel_timer_t *t = s_wheel.slots[0][s_wheel.current & WHEEL_MASK];
+            if (t) {
+                wheel_unlink(t);
+                uint64_t fire_tick = t->fire_tick;
+                if (t->auto_reload) {
+                    // Keep phase; skip periods we could not serve
+                    uint64_t missed = (now - t->expiry) / t->period_ms;
+                    t->expiry += (missed + 1) * t->period_ms;
+                    t->fire_tick = timer_coalesce(t->expiry, t->slack_ms);
+                    wheel_link(t);
+                } else {
+                    s_wheel.stats.active_timers--;
+                }
+
+                void (*callback)(void *) = t->callback;
+                void *cb_arg = t->arg;
+                const kraken_executor_t *executor = t->executor;
+
+                int64_t late_us = kraken_time_us() - (int64_t)fire_tick * 1000;
+                if (late_us < 0) {
+                    late_us = 0;
+                }
+                s_wheel.stats.fired++;
+                s_wheel.stats.total_jitter_us += late_us;
+                if (late_us > s_wheel.stats.max_jitter_us) {
+                    s_wheel.stats.max_jitter_us = late_us;
+                }
+                fired_this_wakeup++;
+
+                // Callbacks run unlocked so they may start/stop/delete timers
+                xSemaphoreGive(s_wheel.lock);
+                timer_run(callback, cb_arg, executor);
+                xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+                continue;
+            }
+
+            uint64_t next = wheel_next_event();
+            if (next > now) {
+                s_wheel.current = now;
+                break;
+            }
+
+            s_wheel.current = next;
+            for (int level = WHEEL_LEVELS - 1; level >= 1; level--) {
+                if ((next & ((1ULL << WHEEL_SHIFT(level)) - 1)) == 0) {
+                    wheel_cascade(level, (next >> WHEEL_SHIFT(level)) & WHEEL_MASK);
+                }
+            }
+        }
+
+        s_wheel.stats.wakeups++;
+        if (fired_this_wakeup > s_wheel.stats.max_fired_per_wakeup) {
+            s_wheel.stats.max_fired_per_wakeup = fired_this_wakeup;
+        }
+        wheel_schedule_wake();
+        wait = timer_wait_ticks();
+        xSemaphoreGive(s_wheel.lock);
+    }
+}
+
+esp_err_t kernel_timer_init(void)
+{
+    memset(&s_wheel, 0, sizeof(s_wheel));
+    s_wheel.lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    s_wheel.current = timer_now_tick();
+    s_wheel.scheduled_wake = WHEEL_NO_EVENT;
+
+#if !CONFIG_IDF_TARGET_LINUX
+    const esp_timer_create_args_t wake_args = {
+        .callback = timer_wake_cb,
+        .name = "kraken_tmr_wake",
+    };
+    esp_err_t ret = esp_timer_create(&wake_args, &s_wheel.wake_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create wake timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+
+    s_wheel.task = xTaskCreateStaticPinnedToCore(timer_task, "kraken_tmr",
+                                                 CONFIG_KRAKEN_TIMER_TASK_STACK_SIZE, NULL,
+                                                 CONFIG_KRAKEN_TIMER_TASK_PRIORITY,
+                                                 s_task_stack, &s_task_buf, TIMER_TASK_CORE);
+    kraken_task_register(s_wheel.task, CONFIG_KRAKEN_TIMER_TASK_STACK_SIZE,
+                         "CONFIG_KRAKEN_TIMER_TASK_STACK_SIZE");
+    return ESP_OK;
+}
+
+void kernel_timer_cleanup(void)
+{
+    if (s_wheel.task) {
+        kraken_task_delete(s_wheel.task);
+        s_wheel.task = NULL;
+    }
+#if !CONFIG_IDF_TARGET_LINUX
+    if (s_wheel.wake_timer) {
+        esp_timer_stop(s_wheel.wake_timer);
+        esp_timer_delete(s_wheel.wake_timer);
+        s_wheel.wake_timer = NULL;
+    }
+#endif
+}
+
+esp_err_t kraken_timer_create_ex(const kraken_timer_config_t *config, void **handle)
+{
+    if (!config || !config->callback || config->period_ms == 0 || !handle) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (!s_wheel.task) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    TimerHandle_t timer = xTimerCreate(name, pdMS_TO_TICKS(period_ms),
-                                        auto_reload ? pdTRUE : pdFALSE,
-                                        arg, (TimerCallbackFunction_t)callback);
-    if (!timer) {
+    // Not from the caller's arena scope: the timer outlives its reset
+    kernel_timer_t *t = kernel_mem_calloc(sizeof(kernel_timer_t));
+    if (!t) {
         return ESP_ERR_NO_MEM;
     }
 
-    *handle = timer;
+    if (config->name) {
+        strncpy(t->name, config->name, TIMER_NAME_MAX_LEN - 1);
+    }
+    t->period_ms = config->period_ms;
+    t->slack_ms = config->slack_ms;
+    t->auto_reload = config->auto_reload;
+    t->callback = config->callback;
+    t->arg = config->arg;
+    t->executor = config->executor;
+
+    *handle = t;
     return ESP_OK;
 }
 
+esp_err_t kraken_timer_create(const char *name, uint32_t period_ms,
+                               bool auto_reload, void (*callback)(void*),
+                               void *arg, void **handle)
+{
+    if (!name || !callback || !handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    kraken_timer_config_t config = {
+        .name = name,
+        .period_ms = period_ms,
+        .auto_reload = auto_reload,
+        .callback = callback,
+        .arg = arg,
+    };
+    return kraken_timer_create_ex(&config, handle);
+}
+
 esp_err_t kraken_timer_start(void *handle)
 {
     if (!handle) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xTimerStart((TimerHandle_t)handle, pdMS_TO_TICKS(100)) != pdPASS) {
-        return ESP_FAIL;
+    kernel_timer_t *t = handle;
+    xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+    if (t->armed) {
+        wheel_unlink(t);
+    } else {
+        s_wheel.stats.active_timers++;
     }
+    // Same semantics as xTimerStart: (re)start counting from now
+    t->expiry = timer_now_tick() + t->period_ms;
+    t->fire_tick = timer_coalesce(t->expiry, t->slack_ms);
+    wheel_link(t);
+    wheel_schedule_wake();
+    xSemaphoreGive(s_wheel.lock);
 
     return ESP_OK;
 }
 
+esp_err_t kraken_timer_set_period(void *handle, uint32_t period_ms)
+{
+    if (!handle || period_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    kernel_timer_t *t = handle;
+    xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+    t->period_ms = period_ms;
+    xSemaphoreGive(s_wheel.lock);
+
+    // Like xTimerChangePeriod: the timer (re)starts with the new period
+    return kraken_timer_start(handle);
+}
+
 esp_err_t kraken_timer_stop(void *handle)
 {
     if (!handle) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xTimerStop((TimerHandle_t)handle, pdMS_TO_TICKS(100)) != pdPASS) {
-        return ESP_FAIL;
+    kernel_timer_t *t = handle;
+    xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+    if (t->armed) {
+        wheel_unlink(t);
+        s_wheel.stats.active_timers--;
+        wheel_schedule_wake();
     }
+    xSemaphoreGive(s_wheel.lock);
 
     return ESP_OK;
 }
@@ -54,16 +469,49 @@ esp_err_t kraken_timer_delete(void *handle)
         return ESP_ERR_INVALID_ARG;
     }
 
-    if (xTimerDelete((TimerHandle_t)handle, pdMS_TO_TICKS(100)) != pdPASS) {
-        return ESP_FAIL;
+    kraken_timer_stop(handle);
+    kraken_free(handle);
+    return ESP_OK;
+}
+
+esp_err_t kraken_timer_get_stats(kraken_timer_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
     }
 
+    xSemaphoreTake(s_wheel.lock, portMAX_DELAY);
+    *stats = s_wheel.stats;
+    xSemaphoreGive(s_wheel.lock);
     return ESP_OK;
 }
 
+int64_t kraken_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+int64_t kraken_time_ns(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return esp_timer_get_time() * 1000;
+#endif
+}
+
 uint32_t kraken_get_tick_count(void)
 {
-    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+    // Derived from the same clock as kraken_time_us(), not the RTOS tick (10 ms at 100 Hz)
+    return (uint32_t)(kraken_time_us() / 1000);
 }
 
 void kraken_delay_ms(uint32_t ms)
@@ -0,0 +1,244 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_app_desc.h"
+#endif
+#include <string.h>
+
+static const char *TAG = "kernel_warm";
+
+#define WARM_MAGIC 0x4B57524D  // "KWRM"
+#define WARM_APP_ID_LEN 8
+#define WARM_MAX_CRASH_BOOTS 3  // Restored state that keeps crashing is dropped
+#define WARM_ALIGN(n) (((n) + 3) & ~3u)
+
+// One record in the data area; the payload follows, padded to 4 bytes
+typedef struct {
+    char key[KRAKEN_WARM_KEY_MAX_LEN];
+    uint16_t len;
+    uint16_t reserved;
+} warm_record_t;
+
+// RTC slow memory is not cleared by deep sleep, software, panic or watchdog
+// resets. The CRC covers everything after the crc field, up to 'used'.
+typedef struct {
+    uint32_t magic;
+    uint32_t crc;
+    uint8_t app_id[WARM_APP_ID_LEN];   // Firmware identity; a new image starts cold
+    uint32_t crash_boots;              // Consecutive warm boots after a panic or watchdog
+    uint32_t used;
+    uint8_t data[CONFIG_KRAKEN_WARM_STATE_SIZE];
+} warm_snapshot_t;
+
+#if CONFIG_IDF_TARGET_LINUX
+// Host builds have no RTC memory: the snapshot starts zeroed, so every run is cold
+static warm_snapshot_t s_snapshot;
+#else
+static RTC_NOINIT_ATTR warm_snapshot_t s_snapshot;
+#endif
+
+static struct {
+    portMUX_TYPE lock;
+    bool warm;
+} s_warm = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t warm_crc(void)
+{
+    size_t len = offsetof(warm_snapshot_t, data) - offsetof(warm_snapshot_t, app_id) + s_snapshot.used;
+    return esp_rom_crc32_le(0, s_snapshot.app_id, len);
+}
+
+static void warm_app_id(uint8_t *app_id)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    memset(app_id, 0, WARM_APP_ID_LEN);
+#else
+    memcpy(app_id, esp_app_get_description()->app_elf_sha256, WARM_APP_ID_LEN);
+#endif
+}
+
+static bool warm_reset_is_crash(esp_reset_reason_t reason)
+{
+    return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+           reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT;
+}
+
+static bool warm_reset_keeps_rtc(esp_reset_reason_t reason)
+{
+    switch (reason) {
+        case ESP_RST_DEEPSLEEP:
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void warm_reset_snapshot(void)
+{
+    s_snapshot.magic = WARM_MAGIC;
+    warm_app_id(s_snapshot.app_id);
+    s_snapshot.crash_boots = 0;
+    s_snapshot.used = 0;
+    s_snapshot.crc = warm_crc();
+}
+
+// Caller holds s_warm.lock
+static warm_record_t *warm_find(const char *key)
+{
+    uint32_t off = 0;
+    while (off + sizeof(warm_record_t) <= s_snapshot.used) {
+        warm_record_t *rec = (warm_record_t *)&s_snapshot.data[off];
+        if (strncmp(rec->key, key, KRAKEN_WARM_KEY_MAX_LEN) == 0) {
+            return rec;
+        }
+        off += sizeof(warm_record_t) + WARM_ALIGN(rec->len);
+    }
+    return NULL;
+}
+
+// Caller holds s_warm.lock
+static void warm_remove(warm_record_t *rec)
+{
+    uint8_t *start = (uint8_t *)rec;
+    uint32_t size = sizeof(warm_record_t) + WARM_ALIGN(rec->len);
+    uint8_t *end = start + size;
+    memmove(start, end, &s_snapshot.data[s_snapshot.used] - end);
+    s_snapshot.used -= size;
+}
+
+esp_err_t kernel_warm_init(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    esp_reset_reason_t reason = ESP_RST_POWERON;
+#else
+    esp_reset_reason_t reason = esp_reset_reason();
+#endif
+    uint8_t app_id[WARM_APP_ID_LEN];
+    warm_app_id(app_id);
+
+    s_warm.warm = warm_reset_keeps_rtc(reason) &&
+                  s_snapshot.magic == WARM_MAGIC &&
+                  s_snapshot.used <= sizeof(s_snapshot.data) &&
+                  memcmp(s_snapshot.app_id, app_id, WARM_APP_ID_LEN) == 0 &&
+                  s_snapshot.crc == warm_crc();
+
+    if (s_warm.warm) {
+        s_snapshot.crash_boots = warm_reset_is_crash(reason) ? s_snapshot.crash_boots + 1 : 0;
+        s_snapshot.crc = warm_crc();
+        if (s_snapshot.crash_boots >= WARM_MAX_CRASH_BOOTS) {
+            ESP_LOGW(TAG, "%lu crash resets in a row, discarding warm state",
+                     (unsigned long)s_snapshot.crash_boots);
+            s_warm.warm = false;
+        }
+    }
+
+    if (s_warm.warm) {
+        ESP_LOGI(TAG, "Warm boot (reset reason %d), %lu bytes of saved state",
+                 reason, (unsigned long)s_snapshot.used);
+    } else {
+        warm_reset_snapshot();
+        ESP_LOGI(TAG, "Cold boot (reset reason %d)", reason);
+    }
+    return ESP_OK;
+}
+
+bool kraken_warm_boot(void)
+{
+    return s_warm.warm;
+}
+
+esp_err_t kraken_warm_save(const char *key, const void *data, size_t len)
+{
+    if (!key || (!data && len > 0) || strlen(key) >= KRAKEN_WARM_KEY_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_warm.lock);
+
+    warm_record_t *rec = warm_find(key);
+    if (rec && rec->len == len) {
+        memcpy(rec + 1, data, len);
+    } else {
+        if (rec) {
+            warm_remove(rec);
+        }
+        uint32_t size = sizeof(warm_record_t) + WARM_ALIGN(len);
+        if (s_snapshot.used + size > sizeof(s_snapshot.data)) {
+            ret = ESP_ERR_NO_MEM;
+        } else {
+            rec = (warm_record_t *)&s_snapshot.data[s_snapshot.used];
+            memset(rec, 0, size);
+            strncpy(rec->key, key, KRAKEN_WARM_KEY_MAX_LEN);
+            rec->len = len;
+            memcpy(rec + 1, data, len);
+            s_snapshot.used += size;
+        }
+    }
+    s_snapshot.crc = warm_crc();
+
+    portEXIT_CRITICAL(&s_warm.lock);
+
+    if (ret == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "No room for '%s' (%u bytes), raise CONFIG_KRAKEN_WARM_STATE_SIZE",
+                 key, (unsigned)len);
+    }
+    return ret;
+}
+
+esp_err_t kraken_warm_load(const char *key, void *data, size_t len)
+{
+    if (!key || !data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_warm.lock);
+    warm_record_t *rec = warm_find(key);
+    if (!rec) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (rec->len != len) {
+        // The record layout changed; treat it as missing rather than guess
+        ret = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(data, rec + 1, len);
+    }
+    portEXIT_CRITICAL(&s_warm.lock);
+    return ret;
+}
+
+esp_err_t kraken_warm_erase(const char *key)
+{
+    if (!key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_warm.lock);
+    warm_record_t *rec = warm_find(key);
+    if (rec) {
+        warm_remove(rec);
+        s_snapshot.crc = warm_crc();
+    } else {
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    portEXIT_CRITICAL(&s_warm.lock);
+    return ret;
+}
+
+void kraken_warm_clear(void)
+{
+    portENTER_CRITICAL(&s_warm.lock);
+    warm_reset_snapshot();
+    portEXIT_CRITICAL(&s_warm.lock);
+}
@@ -0,0 +1,252 @@
+#include "kernel_internal.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "kernel_work";
+
+#define WORK_CORES portNUM_PROCESSORS
+#define WORK_WORKERS (WORK_CORES * CONFIG_KRAKEN_WORK_WORKERS_PER_CORE)
+#define WORK_QUEUE_LEN CONFIG_KRAKEN_WORK_QUEUE_LEN
+
+typedef struct {
+    void (*fn)(void *);
+    void *arg;
+} work_item_t;
+
+typedef struct {
+    work_item_t items[WORK_QUEUE_LEN];
+    uint16_t head;
+    uint16_t count;
+} work_ring_t;
+
+typedef struct {
+    TaskHandle_t task;
+    int core;
+    bool idle;
+} work_worker_t;
+
+// Per core and priority: 'pinned' jobs only run on that core, 'shared' jobs
+// prefer it (submitter's core) but idle workers on the other core steal them
+static struct {
+    portMUX_TYPE lock;
+    bool running;
+    work_ring_t pinned[WORK_CORES][KRAKEN_WORK_PRIO_COUNT];
+    work_ring_t shared[WORK_CORES][KRAKEN_WORK_PRIO_COUNT];
+    work_worker_t workers[WORK_WORKERS];
+    kraken_work_stats_t stats;
+} s_work = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static StaticTask_t s_worker_tcb[WORK_WORKERS];
+#if CONFIG_KRAKEN_WORK_STACK_IN_PSRAM
+static EXT_RAM_BSS_ATTR StackType_t s_worker_stack[WORK_WORKERS][CONFIG_KRAKEN_WORK_STACK_SIZE];
+#else
+static StackType_t s_worker_stack[WORK_WORKERS][CONFIG_KRAKEN_WORK_STACK_SIZE];
+#endif
+
+static bool ring_push(work_ring_t *ring, void (*fn)(void *), void *arg)
+{
+    if (ring->count == WORK_QUEUE_LEN) {
+        return false;
+    }
+    uint16_t tail = (ring->head + ring->count) % WORK_QUEUE_LEN;
+    ring->items[tail] = (work_item_t){ .fn = fn, .arg = arg };
+    ring->count++;
+    return true;
+}
+
+static bool ring_pop(work_ring_t *ring, work_item_t *item)
+{
+    if (ring->count == 0) {
+        return false;
+    }
+    *item = ring->items[ring->head];
+    ring->head = (ring->head + 1) % WORK_QUEUE_LEN;
+    ring->count--;
+    return true;
+}
+
+// Must be called with the lock held. Highest priority first; within a
+// priority, own pinned work, then own shared work, then steal.
+static bool work_take(int core, work_item_t *item)
+{
+    for (int prio = KRAKEN_WORK_PRIO_COUNT - 1; prio >= 0; prio--) {
+        if (ring_pop(&s_work.pinned[core][prio], item) ||
+            ring_pop(&s_work.shared[core][prio], item)) {
+            return true;
+        }
+        for (int other = 0; other < WORK_CORES; other++) {
+            if (other != core && ring_pop(&s_work.shared[other][prio], item)) {
+                s_work.stats.stolen++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Must be called with the lock held; returns the worker to notify, if any
+static TaskHandle_t work_pick_idle(int core, bool any_core)
+{
+    for (int i = 0; i < WORK_WORKERS; i++) {
+        if (s_work.workers[i].idle && s_work.workers[i].core == core) {
+            s_work.workers[i].idle = false;
+            return s_work.workers[i].task;
+        }
+    }
+    if (any_core) {
+        for (int i = 0; i < WORK_WORKERS; i++) {
+            if (s_work.workers[i].idle) {
+                s_work.workers[i].idle = false;
+                return s_work.workers[i].task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void work_worker_task(void *arg)
+{
+    work_worker_t *self = arg;
+
+    while (1) {
+        work_item_t item;
+
+        portENTER_CRITICAL(&s_work.lock);
+        bool got = s_work.running && work_take(self->core, &item);
+        if (!got) {
+            // Marked under the lock so a concurrent submit cannot miss us
+            self->idle = true;
+        }
+        portEXIT_CRITICAL(&s_work.lock);
+
+        if (!got) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        item.fn(item.arg);
+
+        portENTER_CRITICAL(&s_work.lock);
+        s_work.stats.completed++;
+        portEXIT_CRITICAL(&s_work.lock);
+    }
+}
+
+esp_err_t kernel_work_init(void)
+{
+    memset(s_work.pinned, 0, sizeof(s_work.pinned));
+    memset(s_work.shared, 0, sizeof(s_work.shared));
+    memset(&s_work.stats, 0, sizeof(s_work.stats));
+    s_work.running = true;
+
+    for (int i = 0; i < WORK_WORKERS; i++) {
+        work_worker_t *w = &s_work.workers[i];
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "kraken_wrk%d", i);
+
+        w->core = i % WORK_CORES;
+        w->idle = false;
+        w->task = xTaskCreateStaticPinnedToCore(work_worker_task, name,
+                                                CONFIG_KRAKEN_WORK_STACK_SIZE, w,
+                                                CONFIG_KRAKEN_WORK_TASK_PRIORITY,
+                                                s_worker_stack[i], &s_worker_tcb[i], w->core);
+        kraken_task_register(w->task, CONFIG_KRAKEN_WORK_STACK_SIZE, "CONFIG_KRAKEN_WORK_STACK_SIZE");
+    }
+
+    ESP_LOGI(TAG, "Worker pool started: %d workers, %d bytes stack each",
+             WORK_WORKERS, CONFIG_KRAKEN_WORK_STACK_SIZE);
+    return ESP_OK;
+}
+
+void kernel_work_cleanup(void)
+{
+    portENTER_CRITICAL(&s_work.lock);
+    s_work.running = false;
+    portEXIT_CRITICAL(&s_work.lock);
+
+    // Queued jobs are dropped; callers own their arguments
+    for (int i = 0; i < WORK_WORKERS; i++) {
+        if (s_work.workers[i].task) {
+            kraken_task_delete(s_work.workers[i].task);
+            s_work.workers[i].task = NULL;
+        }
+    }
+}
+
+esp_err_t kraken_work_submit(void (*fn)(void *), void *arg,
+                              kraken_work_priority_t priority, int core)
+{
+    if (!fn || priority >= KRAKEN_WORK_PRIO_COUNT ||
+        core < KRAKEN_WORK_CORE_ANY || core >= WORK_CORES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool any_core = core == KRAKEN_WORK_CORE_ANY;
+    int home = any_core ? (int)xPortGetCoreID() : core;
+
+    portENTER_CRITICAL(&s_work.lock);
+    if (!s_work.running) {
+        portEXIT_CRITICAL(&s_work.lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    work_ring_t *ring = any_core ? &s_work.shared[home][priority] : &s_work.pinned[home][priority];
+    if (!ring_push(ring, fn, arg)) {
+        s_work.stats.rejected++;
+        portEXIT_CRITICAL(&s_work.lock);
+        return ESP_ERR_NO_MEM;
+    }
+    s_work.stats.submitted++;
+    TaskHandle_t wake = work_pick_idle(home, any_core);
+    portEXIT_CRITICAL(&s_work.lock);
+
+    if (wake) {
+        xTaskNotifyGive(wake);
+    }
+    return ESP_OK;
+}
+
+esp_err_t kraken_work_get_stats(kraken_work_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_work.lock);
+    *stats = s_work.stats;
+    portEXIT_CRITICAL(&s_work.lock);
+    return ESP_OK;
+}
+
+// Executors for kraken_timer_config_t.executor: ctx encodes priority and core
+static esp_err_t work_executor_submit(void (*fn)(void *), void *arg, void *ctx)
+{
+    uintptr_t packed = (uintptr_t)ctx;
+    return kraken_work_submit(fn, arg, (kraken_work_priority_t)(packed & 0xFF),
+                              (int)(packed >> 8) - 1);
+}
+
+#define WORK_EXECUTOR(prio, core) \
+    { .submit = work_executor_submit, .ctx = (void *)(uintptr_t)(((core) + 1) << 8 | (prio)) }
+
+#define WORK_EXECUTOR_ROW(prio) \
+    { WORK_EXECUTOR(prio, -1), WORK_EXECUTOR(prio, 0), WORK_EXECUTOR(prio, 1) }
+
+static const kraken_executor_t s_work_executors[KRAKEN_WORK_PRIO_COUNT][3] = {
+    WORK_EXECUTOR_ROW(KRAKEN_WORK_PRIO_LOW),
+    WORK_EXECUTOR_ROW(KRAKEN_WORK_PRIO_NORMAL),
+    WORK_EXECUTOR_ROW(KRAKEN_WORK_PRIO_HIGH),
+};
+
+const kraken_executor_t *kraken_work_executor(kraken_work_priority_t priority, int core)
+{
+    if (priority >= KRAKEN_WORK_PRIO_COUNT || core < KRAKEN_WORK_CORE_ANY || core >= WORK_CORES) {
+        return NULL;
+    }
+    return &s_work_executors[priority][core + 1];
+}
@@ -0,0 +1,79 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include <string.h>
+
+#define RESULTS_BYTES 1500  // About a wifi_scan_result_t
+
+// LARGE-class arenas, so the heap stats seen here are not moved by other
+// kernel tasks allocating from the default class meanwhile
+static kraken_mem_stats_t large_stats(void)
+{
+    kraken_mem_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_mem_get_stats(KRAKEN_MEM_CLASS_LARGE, &stats));
+    return stats;
+}
+
+TEST_CASE("arena screen session is released in one step", "[arena]")
+{
+    kraken_mem_stats_t before = large_stats();
+
+    // Show: the screen's arena, and its scan results taken once per session
+    kraken_arena_t *arena;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_arena_create("screen", 2048, KRAKEN_MEM_LARGE, &arena));
+    uint8_t *results = kraken_arena_alloc(arena, RESULTS_BYTES);
+    TEST_ASSERT_NOT_NULL(results);
+    memset(results, 0xA5, RESULTS_BYTES);
+
+    // Scoped allocations come from the arena too; freeing them is a no-op
+    kraken_mem_stats_t shown = large_stats();
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_arena_enter(arena));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, kraken_arena_enter(arena));  // No nesting
+    char *labels[8];
+    for (int i = 0; i < 8; i++) {
+        labels[i] = kraken_malloc(200);
+        TEST_ASSERT_NOT_NULL(labels[i]);
+        memset(labels[i], i, 200);
+    }
+    kraken_free(labels[0]);
+    kraken_arena_leave();
+    kraken_mem_stats_t scoped = large_stats();
+    TEST_ASSERT_EQUAL_UINT32(shown.free_count, scoped.free_count);
+    TEST_ASSERT_GREATER_OR_EQUAL(RESULTS_BYTES + 8 * 200, kraken_arena_get_used(arena));
+
+    // Outside the scope the heap serves as usual
+    void *heap = kraken_malloc_ex(64, KRAKEN_MEM_LARGE);
+    TEST_ASSERT_NOT_NULL(heap);
+    TEST_ASSERT_EQUAL_UINT32(scoped.alloc_count + 1, large_stats().alloc_count);
+    kraken_free(heap);
+
+    // Hide: every block goes back to the heap at once
+    kraken_arena_destroy(arena);
+    kraken_mem_stats_t after = large_stats();
+    TEST_ASSERT_EQUAL(before.bytes_in_use, after.bytes_in_use);
+    TEST_ASSERT_EQUAL_UINT32(after.alloc_count - before.alloc_count,
+                             after.free_count - before.free_count);
+}
+
+TEST_CASE("arena reset rewinds without going back to the heap", "[arena]")
+{
+    kraken_arena_t *arena;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_arena_create("rewind", 1024, KRAKEN_MEM_LARGE, &arena));
+
+    // Past the first block, so overflow blocks are kept across the reset
+    for (int i = 0; i < 12; i++) {
+        TEST_ASSERT_NOT_NULL(kraken_arena_alloc(arena, 300));
+    }
+    size_t used = kraken_arena_get_used(arena);
+    kraken_mem_stats_t grown = large_stats();
+
+    for (int session = 0; session < 5; session++) {
+        kraken_arena_reset(arena);
+        TEST_ASSERT_EQUAL(0, kraken_arena_get_used(arena));
+        for (int i = 0; i < 12; i++) {
+            TEST_ASSERT_NOT_NULL(kraken_arena_alloc(arena, 300));
+        }
+        TEST_ASSERT_EQUAL(used, kraken_arena_get_used(arena));
+    }
+    TEST_ASSERT_EQUAL_UINT32(grown.alloc_count, large_stats().alloc_count);
+    kraken_arena_destroy(arena);
+}
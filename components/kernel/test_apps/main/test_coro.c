@@ -0,0 +1,163 @@
+#include "kraken/coro.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define TEST_EVENT (KRAKEN_EVENT_USER_CUSTOM + 34)
+
+typedef struct {
+    SemaphoreHandle_t done;
+    uint32_t timeout_ms;
+    kraken_coro_wake_t reason;
+    int value;
+    int64_t waited_us;
+} event_ctx_t;
+
+static kraken_coro_status_t await_event_coro(kraken_coro_t *co)
+{
+    event_ctx_t *ctx = co->ctx;
+
+    KRAKEN_CORO_BEGIN(co);
+    ctx->waited_us = kraken_time_us();
+    KRAKEN_AWAIT_EVENT(co, TEST_EVENT, ctx->timeout_ms);
+    ctx->waited_us = kraken_time_us() - ctx->waited_us;
+    ctx->reason = co->wake_reason;
+    if (co->wake_reason == KRAKEN_CORO_WAKE_EVENT) {
+        ctx->value = *(const int *)co->event.data;
+    }
+    xSemaphoreGive(ctx->done);
+    KRAKEN_CORO_END(co);
+}
+
+TEST_CASE("coroutine resumes on the awaited event", "[coro]")
+{
+    static kraken_coro_t co;
+    static int payload = 42;
+    event_ctx_t ctx = { .done = xSemaphoreCreateBinary(), .timeout_ms = 1000 };
+
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_coro_start(&co, "event", await_event_coro, &ctx));
+    vTaskDelay(pdMS_TO_TICKS(20));  // Let it reach the await
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_event_post(TEST_EVENT, &payload, sizeof(payload)));
+
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.done, pdMS_TO_TICKS(500)));
+    TEST_ASSERT_EQUAL(KRAKEN_CORO_WAKE_EVENT, ctx.reason);
+    TEST_ASSERT_EQUAL(42, ctx.value);
+    vSemaphoreDelete(ctx.done);
+}
+
+TEST_CASE("coroutine event await times out", "[coro]")
+{
+    static kraken_coro_t co;
+    event_ctx_t ctx = { .done = xSemaphoreCreateBinary(), .timeout_ms = 50 };
+
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_coro_start(&co, "timeout", await_event_coro, &ctx));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.done, pdMS_TO_TICKS(500)));
+    TEST_ASSERT_EQUAL(KRAKEN_CORO_WAKE_TIMEOUT, ctx.reason);
+    TEST_ASSERT_GREATER_OR_EQUAL(50000, ctx.waited_us);
+    TEST_ASSERT_LESS_THAN(150000, ctx.waited_us);
+    vSemaphoreDelete(ctx.done);
+}
+
+typedef struct {
+    SemaphoreHandle_t done;
+    volatile bool ready;
+    volatile int polls;
+    SemaphoreHandle_t in_poll;   // Given from the runner's first poll, if set
+    SemaphoreHandle_t release;   // That poll blocks until this is given
+    kraken_coro_wake_t reason;
+} io_ctx_t;
+
+static bool io_ready(void *arg)
+{
+    io_ctx_t *ctx = arg;
+    // Call 1 is the await's own check inside the coroutine; call 2 is the runner's poll
+    int call = ctx->polls + 1;
+    if (call == 2 && ctx->in_poll) {
+        xSemaphoreGive(ctx->in_poll);
+        xSemaphoreTake(ctx->release, portMAX_DELAY);
+    }
+    // Counted after the read, so a test that sees the count knows the answer given
+    bool ready = ctx->ready;
+    ctx->polls = call;
+    return ready;
+}
+
+static kraken_coro_status_t await_io_coro(kraken_coro_t *co)
+{
+    io_ctx_t *ctx = co->ctx;
+
+    KRAKEN_CORO_BEGIN(co);
+    KRAKEN_AWAIT_IO(co, io_ready, ctx, 1000);
+    ctx->reason = co->wake_reason;
+    xSemaphoreGive(ctx->done);
+    KRAKEN_CORO_END(co);
+}
+
+// Until io_ready has been called n times
+static bool wait_polls(io_ctx_t *ctx, int n)
+{
+    for (int i = 0; i < 500 && ctx->polls < n; i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return ctx->polls >= n;
+}
+
+TEST_CASE("coroutine I/O await resumes on kraken_coro_wake", "[coro]")
+{
+    static kraken_coro_t co;
+    io_ctx_t ctx = { .done = xSemaphoreCreateBinary() };
+
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_coro_start(&co, "io", await_io_coro, &ctx));
+    TEST_ASSERT_TRUE(wait_polls(&ctx, 2));  // The await's check and the runner's, not ready
+    TEST_ASSERT_EQUAL(pdFALSE, xSemaphoreTake(ctx.done, 0));
+
+    ctx.ready = true;
+    kraken_coro_wake(&co);
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.done, pdMS_TO_TICKS(500)));
+    TEST_ASSERT_EQUAL(KRAKEN_CORO_WAKE_IO, ctx.reason);
+    // The runner's poll on the wake and the await's re-check; the test app's
+    // fallback poll is a second away, so the wake did it
+    TEST_ASSERT_EQUAL(4, ctx.polls);
+    vSemaphoreDelete(ctx.done);
+}
+
+TEST_CASE("coroutine cancelled while its ready_fn is polled", "[coro]")
+{
+    static kraken_coro_t co;
+    io_ctx_t ctx = {
+        .done = xSemaphoreCreateBinary(),
+        .in_poll = xSemaphoreCreateBinary(),
+        .release = xSemaphoreCreateBinary(),
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_coro_start(&co, "io_cancel", await_io_coro, &ctx));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.in_poll, pdMS_TO_TICKS(CONFIG_KRAKEN_CORO_IO_POLL_MS * 2)));
+
+    // The runner is inside ready_fn: the storage is still in use and must not be reused
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, kraken_coro_cancel(&co));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, kraken_coro_start(&co, "io_cancel", await_io_coro, &ctx));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, kraken_coro_cancel(&co));
+
+    ctx.ready = true;
+    xSemaphoreGive(ctx.release);
+    esp_err_t ret = ESP_ERR_NOT_FINISHED;
+    for (int i = 0; i < 500 && ret == ESP_ERR_NOT_FINISHED; i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+        ret = kraken_coro_cancel(&co);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, ret);
+
+    // Ready was reported after the cancel; the coroutine must not resume
+    TEST_ASSERT_EQUAL(pdFALSE, xSemaphoreTake(ctx.done, 0));
+    TEST_ASSERT_EQUAL(2, ctx.polls);
+
+    // Once the poll has returned the storage is free again
+    vSemaphoreDelete(ctx.in_poll);
+    ctx.in_poll = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_coro_start(&co, "io_cancel", await_io_coro, &ctx));
+    TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(ctx.done, pdMS_TO_TICKS(500)));
+
+    vSemaphoreDelete(ctx.done);
+    vSemaphoreDelete(ctx.release);
+}
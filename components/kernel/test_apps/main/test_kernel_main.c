@@ -0,0 +1,24 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "unity_test_runner.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <stdlib.h>
+
+static const char *TAG = "kernel_test";
+
+void app_main(void)
+{
+    // Tests share one kernel instance, as the firmware does
+    ESP_ERROR_CHECK(kraken_kernel_init());
+
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    int failures = UNITY_END();
+
+    ESP_LOGI(TAG, "%d failure(s)", failures);
+#if CONFIG_IDF_TARGET_LINUX
+    // Exit status for CI
+    exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+#endif
+}
@@ -0,0 +1,81 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+
+// Asserts that nothing allocated since 'from' is still alive
+static void assert_no_leaks(kraken_mem_checkpoint_t from)
+{
+    kraken_mem_leak_report_t report;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_mem_leak_check(from, kraken_mem_checkpoint(), &report));
+    TEST_ASSERT_EQUAL_UINT32(0, report.dropped_count);
+    TEST_ASSERT_EQUAL_UINT32(0, report.leaked_count);
+    TEST_ASSERT_EQUAL(0, report.leaked_bytes);
+}
+
+static void timer_noop(void *arg)
+{
+    (void)arg;
+}
+
+TEST_CASE("leak check reports an allocation that is still alive", "[mem_profiler]")
+{
+    kraken_mem_checkpoint_t from = kraken_mem_checkpoint();
+    void *kept = kraken_malloc(100);
+    void *freed = kraken_malloc(50);
+    TEST_ASSERT_NOT_NULL(kept);
+    TEST_ASSERT_NOT_NULL(freed);
+    kraken_free(freed);
+    kraken_mem_checkpoint_t to = kraken_mem_checkpoint();
+
+    kraken_mem_leak_report_t report;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_mem_leak_check(from, to, &report));
+    TEST_ASSERT_EQUAL_UINT32(1, report.leaked_count);
+    TEST_ASSERT_EQUAL(100, report.leaked_bytes);
+
+    // Allocations before 'from' or after 'to' are not counted
+    kraken_free(kept);
+    void *later = kraken_malloc(10);
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_mem_leak_check(from, to, &report));
+    TEST_ASSERT_EQUAL_UINT32(0, report.leaked_count);
+    kraken_free(later);
+}
+
+TEST_CASE("malloc, calloc and realloc leave no leaks", "[mem_profiler]")
+{
+    kraken_mem_checkpoint_t from = kraken_mem_checkpoint();
+
+    void *blocks[64];
+    for (int i = 0; i < 64; i++) {
+        blocks[i] = (i & 1) ? kraken_calloc(i + 1, 8) : kraken_malloc_ex(i * 16 + 1, KRAKEN_MEM_FAST);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+    for (int i = 0; i < 64; i += 2) {
+        blocks[i] = kraken_realloc(blocks[i], 512);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+    // Free out of order so the table's backward-shift deletion is exercised
+    for (int i = 63; i >= 0; i -= 2) {
+        kraken_free(blocks[i]);
+    }
+    for (int i = 0; i < 64; i += 2) {
+        kraken_free(blocks[i]);
+    }
+
+    assert_no_leaks(from);
+}
+
+TEST_CASE("timer create and delete leave no leaks", "[mem_profiler]")
+{
+    kraken_mem_checkpoint_t from = kraken_mem_checkpoint();
+
+    void *timers[16];
+    for (int i = 0; i < 16; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_timer_create("leak", 1000 + i, true, timer_noop, NULL,
+                                                      &timers[i]));
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_timer_start(timers[i]));
+    }
+    for (int i = 0; i < 16; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_timer_delete(timers[i]));
+    }
+
+    assert_no_leaks(from);
+}
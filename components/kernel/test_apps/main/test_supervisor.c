@@ -0,0 +1,122 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+#define HUNG_SERVICE "sup_hung"
+#define HOLD_SERVICE "sup_hold"
+#define WATCH_TIMEOUT_MS 200
+
+static volatile int s_inits;
+static volatile int s_deinits;
+static SemaphoreHandle_t s_holding;   // Given once sup_hold's init has the service table
+static SemaphoreHandle_t s_release;
+static QueueHandle_t s_events;
+
+static esp_err_t hung_init(void)
+{
+    s_inits++;
+    return ESP_OK;
+}
+
+static esp_err_t hung_deinit(void)
+{
+    s_deinits++;
+    return ESP_OK;
+}
+
+// Runs inside kraken_service_start, so every other start and stop waits on it
+static esp_err_t hold_init(void)
+{
+    xSemaphoreGive(s_holding);
+    xSemaphoreTake(s_release, portMAX_DELAY);
+    return ESP_OK;
+}
+
+static void hold_task(void *arg)
+{
+    kraken_service_start(HOLD_SERVICE);
+    vTaskDelete(NULL);
+}
+
+static void watchdog_handler(const kraken_event_t *event, void *user_data)
+{
+    const kraken_watchdog_event_t *wd = event->data;
+    if (strcmp(wd->service, HUNG_SERVICE) == 0) {
+        xQueueSend(s_events, wd, 0);
+    }
+}
+
+// Next watchdog event for the hung service that is not a MISSED
+static bool wait_action(kraken_watchdog_event_t *out, uint32_t timeout_ms)
+{
+    TickType_t end = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    while ((int32_t)(end - xTaskGetTickCount()) > 0) {
+        if (xQueueReceive(s_events, out, end - xTaskGetTickCount()) == pdTRUE &&
+            out->action != KRAKEN_WATCHDOG_MISSED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST_CASE("supervisor counts a stop that times out as a failed restart", "[supervisor]")
+{
+    s_inits = s_deinits = 0;
+    s_holding = xSemaphoreCreateBinary();
+    s_release = xSemaphoreCreateBinary();
+    s_events = xQueueCreate(8, sizeof(kraken_watchdog_event_t));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_event_subscribe(KRAKEN_EVENT_SYSTEM_WATCHDOG, watchdog_handler, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_register(HUNG_SERVICE, 0, hung_init, hung_deinit));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_register(HOLD_SERVICE, 0, hold_init, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_start(HUNG_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_watch(HUNG_SERVICE, WATCH_TIMEOUT_MS, NULL));
+
+    // Another start holds the service table from before the miss
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(hold_task, "sup_hold", 4096, NULL, 5, NULL));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_holding, pdMS_TO_TICKS(1000)));
+
+    kraken_watchdog_event_t wd;
+    TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(s_events, &wd, pdMS_TO_TICKS(WATCH_TIMEOUT_MS +
+                                                                          3 * CONFIG_KRAKEN_SUPERVISOR_CHECK_MS)));
+    TEST_ASSERT_EQUAL(KRAKEN_WATCHDOG_MISSED, wd.action);
+
+    // The restart job starts on the next check; its stop gives up after its 1 s
+    // wait. Freeing the table halfway through the 1 s a start would then wait
+    // lets that start through, so only the stop's result tells the two apart.
+    int64_t release_us = kraken_time_us() + (CONFIG_KRAKEN_SUPERVISOR_CHECK_MS + 1500) * 1000LL;
+    int64_t wait_us = release_us - kraken_time_us();
+    bool early = wait_action(&wd, wait_us > 0 ? (uint32_t)(wait_us / 1000) : 0);
+    xSemaphoreGive(s_release);
+    if (!early) {
+        TEST_ASSERT_TRUE(wait_action(&wd, 2000));
+    }
+    TEST_ASSERT_EQUAL(KRAKEN_WATCHDOG_RESTART_FAILED, wd.action);
+    TEST_ASSERT_EQUAL_UINT32(1, wd.restarts);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MIN_MS, wd.backoff_ms);
+    // Neither deinit nor a second init ran: the service was never restarted
+    TEST_ASSERT_EQUAL(0, s_deinits);
+    TEST_ASSERT_EQUAL(1, s_inits);
+
+    // With the table free again the retry after the backoff goes through
+    TEST_ASSERT_TRUE(wait_action(&wd, CONFIG_KRAKEN_SUPERVISOR_BACKOFF_MIN_MS +
+                                      2 * CONFIG_KRAKEN_SUPERVISOR_CHECK_MS + 2000));
+    TEST_ASSERT_EQUAL(KRAKEN_WATCHDOG_RESTARTED, wd.action);
+    TEST_ASSERT_EQUAL_UINT32(2, wd.restarts);
+    TEST_ASSERT_EQUAL(1, s_deinits);
+    TEST_ASSERT_EQUAL(2, s_inits);
+
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_unwatch(HUNG_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_stop(HUNG_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_stop(HOLD_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_unregister(HUNG_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_service_unregister(HOLD_SERVICE));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_event_unsubscribe(KRAKEN_EVENT_SYSTEM_WATCHDOG, watchdog_handler));
+    vQueueDelete(s_events);
+    vSemaphoreDelete(s_holding);
+    vSemaphoreDelete(s_release);
+}
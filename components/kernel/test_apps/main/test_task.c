@@ -0,0 +1,59 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+
+#define CHURN_TASKS 8
+#define CHURN_MS (6 * CONFIG_KRAKEN_TASK_STACK_SAMPLE_MS)
+
+static void idle_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+TEST_CASE("tasks deleted while the stack sampler runs leave the registry clean", "[task]")
+{
+    void *keeper = NULL;
+    kraken_task_config_t cfg = {
+        .fn = idle_task,
+        .name = "keeper",
+        .stack_size = 4096,
+        .priority = 1,
+        .core = KRAKEN_TASK_CORE_ANY,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_task_create(&cfg, &keeper));
+
+    kraken_task_stack_info_t info;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_task_get_stack_info("keeper", &info));
+    uint32_t samples_before = info.samples;
+
+    // Each sample scans every registered stack; deleting one mid-scan must wait
+    // for the scan instead of freeing a TCB the sampler is reading
+    char names[CHURN_TASKS][configMAX_TASK_NAME_LEN];
+    void *tasks[CHURN_TASKS];
+    uint32_t rounds = 0;
+    int64_t end = kraken_time_us() + CHURN_MS * 1000LL;
+    while (kraken_time_us() < end) {
+        for (int i = 0; i < CHURN_TASKS; i++) {
+            snprintf(names[i], sizeof(names[i]), "churn%d", i);
+            cfg.name = names[i];
+            TEST_ASSERT_EQUAL(ESP_OK, kraken_task_create(&cfg, &tasks[i]));
+        }
+        for (int i = 0; i < CHURN_TASKS; i++) {
+            TEST_ASSERT_EQUAL(ESP_OK, kraken_task_delete(tasks[i]));
+        }
+        rounds++;
+    }
+
+    for (int i = 0; i < CHURN_TASKS; i++) {
+        TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, kraken_task_get_stack_info(names[i], &info));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_task_get_stack_info("keeper", &info));
+    TEST_ASSERT_GREATER_THAN_UINT32(samples_before, info.samples);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, rounds);
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_task_delete(keeper));
+}
@@ -0,0 +1,125 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+
+static const char *TAG = "test_timer";
+
+#define BENCH_TIMERS 10000
+
+static void count_cb(void *arg)
+{
+    (*(volatile uint32_t *)arg)++;
+}
+
+// Waits until *count reaches 'target' or timeout_ms passes
+static void wait_count(volatile uint32_t *count, uint32_t target, uint32_t timeout_ms)
+{
+    int64_t deadline = kraken_time_us() + (int64_t)timeout_ms * 1000;
+    while (*count < target && kraken_time_us() < deadline) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+static int64_t s_fired_at_us[8];
+
+static void stamp_cb(void *arg)
+{
+    s_fired_at_us[(intptr_t)arg] = kraken_time_us();
+}
+
+TEST_CASE("timers due on a cascade tick fire on that tick", "[timer]")
+{
+    // Fire ticks on 64 ms boundaries sit in level 1 and are re-linked by the
+    // cascade at exactly their own tick. Placed one tick late they would be
+    // at least 1000 us late every time.
+    enum { COUNT = 8 };
+    void *timers[COUNT];
+    int64_t due_us[COUNT];
+
+    for (int i = 0; i < COUNT; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_timer_create("cascade", 1000, false, stamp_cb,
+                                                      (void *)(intptr_t)i, &timers[i]));
+        s_fired_at_us[i] = 0;
+    }
+
+    // All starts must share one tick, or the fire ticks miss the boundaries
+    uint32_t tick;
+    do {
+        tick = kraken_get_tick_count();
+        for (int i = 0; i < COUNT; i++) {
+            uint32_t period = 128 - tick % 64 + i * 64;
+            kraken_timer_set_period(timers[i], period);  // Also (re)starts it
+            due_us[i] = (int64_t)(tick + period) * 1000;
+        }
+    } while (kraken_get_tick_count() != tick);
+
+    vTaskDelay(pdMS_TO_TICKS(128 + COUNT * 64 + 50));
+
+    int64_t min_late_us = INT64_MAX;
+    for (int i = 0; i < COUNT; i++) {
+        TEST_ASSERT_NOT_EQUAL(0, s_fired_at_us[i]);
+        int64_t late_us = s_fired_at_us[i] - due_us[i];
+        TEST_ASSERT_GREATER_OR_EQUAL(0, late_us);
+        min_late_us = late_us < min_late_us ? late_us : min_late_us;
+        kraken_timer_delete(timers[i]);
+    }
+    ESP_LOGI(TAG, "Cascade-tick timers: least late %" PRId64 " us", min_late_us);
+    TEST_ASSERT_LESS_THAN(1000, min_late_us);
+}
+
+TEST_CASE("benchmark: 10k active timers", "[timer][bench]")
+{
+    static void *timers[BENCH_TIMERS];
+    static volatile uint32_t fired;
+    fired = 0;
+    kraken_mem_checkpoint_t cp = kraken_mem_checkpoint();
+
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        // Spread over 200..1199 ms: every level-0 and level-1 slot in range is used
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_timer_create("bench", 200 + (i * 7919) % 1000, false, count_cb,
+                                                      (void *)&fired, &timers[i]));
+    }
+
+    int64_t t0 = kraken_time_us();
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        kraken_timer_start(timers[i]);
+    }
+    int64_t start_us = kraken_time_us() - t0;
+
+    kraken_timer_stats_t before, after;
+    kraken_timer_get_stats(&before);
+    TEST_ASSERT_GREATER_OR_EQUAL(BENCH_TIMERS, before.active_timers);
+    wait_count(&fired, BENCH_TIMERS, 3000);
+    kraken_timer_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(BENCH_TIMERS, fired);
+
+    // Re-arm far out so stop removes them from upper levels
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        kraken_timer_set_period(timers[i], 60000 + i);
+    }
+    t0 = kraken_time_us();
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        kraken_timer_stop(timers[i]);
+    }
+    int64_t stop_us = kraken_time_us() - t0;
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        kraken_timer_delete(timers[i]);
+    }
+
+    uint32_t n = after.fired - before.fired;
+    uint32_t wakeups = after.wakeups - before.wakeups;
+    ESP_LOGI(TAG, "%d timers: start %" PRId64 " ns/op, stop %" PRId64 " ns/op", BENCH_TIMERS,
+             start_us * 1000 / BENCH_TIMERS, stop_us * 1000 / BENCH_TIMERS);
+    ESP_LOGI(TAG, "fired %" PRIu32 " in %" PRIu32 " wakeups, mean jitter %" PRIu64 " us, max %" PRIu32 " us",
+             n, wakeups, (after.total_jitter_us - before.total_jitter_us) / n, after.max_jitter_us);
+
+    // The wheel serves due timers in one wakeup per tick, not one per timer
+    TEST_ASSERT_LESS_OR_EQUAL(1100, wakeups);
+
+    kraken_mem_leak_report_t report;
+    kraken_mem_leak_check(cp, kraken_mem_checkpoint(), &report);
+    TEST_ASSERT_EQUAL_UINT32(0, report.leaked_count);
+}
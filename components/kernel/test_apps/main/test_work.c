@@ -0,0 +1,189 @@
+#include "kraken/kernel.h"
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#define BLOCKERS CONFIG_KRAKEN_WORK_WORKERS_PER_CORE
+#define WAIT_TICKS pdMS_TO_TICKS(2000)
+
+// A job that holds its worker until released
+typedef struct {
+    SemaphoreHandle_t started;
+    SemaphoreHandle_t release;
+} blocker_t;
+
+static portMUX_TYPE s_log_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_log[64];
+static int s_log_len;
+
+static void blocker_job(void *arg)
+{
+    blocker_t *b = arg;
+    xSemaphoreGive(b->started);
+    xSemaphoreTake(b->release, portMAX_DELAY);
+}
+
+// Appends its id to the log, so tests see what ran and in which order
+static void log_job(void *arg)
+{
+    portENTER_CRITICAL(&s_log_lock);
+    if (s_log_len < (int)(sizeof(s_log) / sizeof(s_log[0]))) {
+        s_log[s_log_len++] = (int)(intptr_t)arg;
+    }
+    portEXIT_CRITICAL(&s_log_lock);
+}
+
+static int log_len(void)
+{
+    portENTER_CRITICAL(&s_log_lock);
+    int len = s_log_len;
+    portEXIT_CRITICAL(&s_log_lock);
+    return len;
+}
+
+static void log_reset(void)
+{
+    portENTER_CRITICAL(&s_log_lock);
+    s_log_len = 0;
+    portEXIT_CRITICAL(&s_log_lock);
+}
+
+static bool wait_log_len(int len)
+{
+    for (int i = 0; i < 2000 && log_len() < len; i++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return log_len() >= len;
+}
+
+// Occupies every worker of core 0, so its pinned jobs queue up
+static void block_core0(blocker_t *blockers)
+{
+    for (int i = 0; i < BLOCKERS; i++) {
+        blockers[i].started = xSemaphoreCreateBinary();
+        blockers[i].release = xSemaphoreCreateBinary();
+        TEST_ASSERT_NOT_NULL(blockers[i].started);
+        TEST_ASSERT_NOT_NULL(blockers[i].release);
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(blocker_job, &blockers[i],
+                                                     KRAKEN_WORK_PRIO_HIGH, 0));
+        TEST_ASSERT_TRUE(xSemaphoreTake(blockers[i].started, WAIT_TICKS));
+    }
+}
+
+static void release_core0(blocker_t *blockers)
+{
+    for (int i = 0; i < BLOCKERS; i++) {
+        xSemaphoreGive(blockers[i].release);
+    }
+    // Let the blockers return before their semaphores go
+    vTaskDelay(pdMS_TO_TICKS(20));
+    for (int i = 0; i < BLOCKERS; i++) {
+        vSemaphoreDelete(blockers[i].started);
+        vSemaphoreDelete(blockers[i].release);
+    }
+}
+
+TEST_CASE("work submit runs the job and checks its arguments", "[work]")
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, kraken_work_submit(NULL, NULL, KRAKEN_WORK_PRIO_LOW,
+                                                              KRAKEN_WORK_CORE_ANY));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, kraken_work_submit(log_job, NULL, KRAKEN_WORK_PRIO_COUNT,
+                                                              KRAKEN_WORK_CORE_ANY));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, kraken_work_submit(log_job, NULL, KRAKEN_WORK_PRIO_LOW,
+                                                              portNUM_PROCESSORS));
+
+    kraken_work_stats_t before;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&before));
+    log_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)7, KRAKEN_WORK_PRIO_NORMAL,
+                                                 KRAKEN_WORK_CORE_ANY));
+    TEST_ASSERT_TRUE(wait_log_len(1));
+    TEST_ASSERT_EQUAL(7, s_log[0]);
+
+    kraken_work_stats_t after;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&after));
+    TEST_ASSERT_GREATER_THAN_UINT32(before.submitted, after.submitted);
+}
+
+TEST_CASE("work queued on a busy core runs by priority once it frees", "[work]")
+{
+    blocker_t blockers[BLOCKERS];
+    block_core0(blockers);
+
+    // Pinned jobs wait for core 0; high before normal before low
+    log_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)1, KRAKEN_WORK_PRIO_LOW, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)2, KRAKEN_WORK_PRIO_NORMAL, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)3, KRAKEN_WORK_PRIO_HIGH, 0));
+    vTaskDelay(pdMS_TO_TICKS(20));
+    TEST_ASSERT_EQUAL(0, log_len());
+
+    release_core0(blockers);
+    TEST_ASSERT_TRUE(wait_log_len(3));
+    TEST_ASSERT_EQUAL(3, s_log[0]);
+    TEST_ASSERT_EQUAL(2, s_log[1]);
+    TEST_ASSERT_EQUAL(1, s_log[2]);
+}
+
+#if portNUM_PROCESSORS > 1
+TEST_CASE("work queued on a busy core is stolen by the other core", "[work]")
+{
+    blocker_t blockers[BLOCKERS];
+    block_core0(blockers);
+
+    // Unpinned jobs queue on the submitter's core; when that is core 0, the
+    // idle core 1 worker takes them while core 0 is held
+    kraken_work_stats_t before;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&before));
+    log_reset();
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)(intptr_t)(10 + i),
+                                                     KRAKEN_WORK_PRIO_NORMAL,
+                                                     KRAKEN_WORK_CORE_ANY));
+    }
+    TEST_ASSERT_TRUE(wait_log_len(4));
+
+    kraken_work_stats_t after;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&after));
+    if (xPortGetCoreID() == 0) {
+        // Queued on core 0 while all its workers were held
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(before.stolen + 4, after.stolen);
+    }
+    release_core0(blockers);
+}
+#endif
+
+TEST_CASE("work submit to a full ring fails without blocking", "[work]")
+{
+    blocker_t blockers[BLOCKERS];
+    block_core0(blockers);
+
+    // Pinned LOW jobs for core 0 cannot be stolen, so the ring only fills
+    kraken_work_stats_t before;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&before));
+    log_reset();
+    for (int i = 0; i < CONFIG_KRAKEN_WORK_QUEUE_LEN; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)(intptr_t)i,
+                                                     KRAKEN_WORK_PRIO_LOW, 0));
+    }
+    int64_t start = kraken_time_us();
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, kraken_work_submit(log_job, (void *)-1,
+                                                         KRAKEN_WORK_PRIO_LOW, 0));
+    TEST_ASSERT_LESS_THAN_INT64(1000, kraken_time_us() - start);
+    // Other rings are separate
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_submit(log_job, (void *)100, KRAKEN_WORK_PRIO_NORMAL, 0));
+
+    kraken_work_stats_t after;
+    TEST_ASSERT_EQUAL(ESP_OK, kraken_work_get_stats(&after));
+    TEST_ASSERT_EQUAL_UINT32(before.rejected + 1, after.rejected);
+
+    // Everything that was accepted runs, in order within its ring
+    release_core0(blockers);
+    TEST_ASSERT_TRUE(wait_log_len(CONFIG_KRAKEN_WORK_QUEUE_LEN + 1));
+    TEST_ASSERT_EQUAL(100, s_log[0]);
+    for (int i = 0; i < CONFIG_KRAKEN_WORK_QUEUE_LEN; i++) {
+        TEST_ASSERT_EQUAL(i, s_log[i + 1]);
+    }
+}
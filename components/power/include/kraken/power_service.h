@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What a held lock keeps the chip from doing (maps to esp_pm_lock_type_t)
+typedef enum {
+    POWER_LOCK_CPU_MAX = 0,  // CPU at its maximum frequency (audio playback, display refresh)
+    POWER_LOCK_APB_MAX,      // APB at 80 MHz for peripheral clocks
+    POWER_LOCK_NO_SLEEP,     // No automatic light sleep, any frequency (radio links)
+    POWER_LOCK_TYPE_COUNT,
+} power_lock_type_t;
+
+// Power state, derived from the Kraken locks that are held
+typedef enum {
+    POWER_STATE_ACTIVE = 0,  // A CPU_MAX lock is held
+    POWER_STATE_APB,         // An APB_MAX lock is held, CPU may slow to 80 MHz
+    POWER_STATE_AWAKE,       // Only NO_SLEEP locks: idle frequency, no light sleep
+    POWER_STATE_IDLE,        // Nothing held: idle frequency, light sleep allowed
+    POWER_STATE_COUNT,
+} power_state_t;
+
+typedef struct power_lock power_lock_t;
+
+typedef struct {
+    uint64_t residency_us[POWER_STATE_COUNT];  // Time spent in each state since init
+    uint32_t transitions;
+    power_state_t state;
+} power_stats_t;
+
+// Configures esp_pm: DFS between the default CPU frequency and
+// CONFIG_KRAKEN_POWER_MIN_FREQ_MHZ, plus light sleep if enabled.
+esp_err_t power_service_init(void);
+esp_err_t power_service_deinit(void);
+
+// Locks work before power_service_init and when PM is disabled (then they only
+// count). Acquire/release nest; safe from ISRs.
+esp_err_t power_lock_create(power_lock_type_t type, const char *name, power_lock_t **lock);
+esp_err_t power_lock_acquire(power_lock_t *lock);
+esp_err_t power_lock_release(power_lock_t *lock);
+esp_err_t power_lock_delete(power_lock_t *lock);
+
+esp_err_t power_service_get_stats(power_stats_t *stats);
+void power_service_dump_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
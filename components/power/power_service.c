@@ -0,0 +1,319 @@
+#include "kraken/power_service.h"
+#include "kraken/kernel.h"
+#include "esp_pm.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "power_service";
+
+#if CONFIG_KRAKEN_POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP true
+#else
+#define POWER_LIGHT_SLEEP false
+#endif
+
+struct power_lock {
+    bool used;
+    power_lock_type_t type;
+    const char *name;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock;
+#endif
+    uint32_t depth;          // Nested acquires
+    uint32_t acquires;       // 0 -> 1 transitions
+    uint64_t held_us;
+    int64_t held_since_us;
+};
+
+static const char *s_state_names[POWER_STATE_COUNT] = {
+    "active", "apb", "awake", "idle",
+};
+
+static struct {
+    bool initialized;
+    portMUX_TYPE lock;
+    struct power_lock locks[CONFIG_KRAKEN_POWER_MAX_LOCKS];
+    uint32_t held[POWER_LOCK_TYPE_COUNT];  // Locks of each type with depth > 0
+    power_state_t state;
+    int64_t state_since_us;                // 0: boot
+    uint64_t residency_us[POWER_STATE_COUNT];
+    uint32_t transitions;
+} g_power = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .state = POWER_STATE_IDLE,
+};
+
+// Caller holds g_power.lock
+static power_state_t power_current_state(void)
+{
+    if (g_power.held[POWER_LOCK_CPU_MAX]) {
+        return POWER_STATE_ACTIVE;
+    }
+    if (g_power.held[POWER_LOCK_APB_MAX]) {
+        return POWER_STATE_APB;
+    }
+    if (g_power.held[POWER_LOCK_NO_SLEEP]) {
+        return POWER_STATE_AWAKE;
+    }
+    return POWER_STATE_IDLE;
+}
+
+// Caller holds g_power.lock
+static void power_update_state(int64_t now)
+{
+    power_state_t state = power_current_state();
+    if (state == g_power.state) {
+        return;
+    }
+    g_power.residency_us[g_power.state] += now - g_power.state_since_us;
+    g_power.state = state;
+    g_power.state_since_us = now;
+    g_power.transitions++;
+}
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_type_t power_pm_type(power_lock_type_t type)
+{
+    switch (type) {
+        case POWER_LOCK_CPU_MAX:
+            return ESP_PM_CPU_FREQ_MAX;
+        case POWER_LOCK_APB_MAX:
+            return ESP_PM_APB_FREQ_MAX;
+        default:
+            return ESP_PM_NO_LIGHT_SLEEP;
+    }
+}
+#endif
+
+esp_err_t power_service_init(void)
+{
+    if (g_power.initialized) {
+        return ESP_OK;
+    }
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_KRAKEN_POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = POWER_LIGHT_SLEEP,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep %s", CONFIG_KRAKEN_POWER_MIN_FREQ_MHZ,
+             CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, POWER_LIGHT_SLEEP ? "on" : "off");
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, running at a fixed frequency");
+#endif
+
+    g_power.initialized = true;
+    ESP_LOGI(TAG, "Power service initialized");
+    return ESP_OK;
+}
+
+esp_err_t power_service_deinit(void)
+{
+    if (!g_power.initialized) {
+        return ESP_OK;
+    }
+
+#if CONFIG_PM_ENABLE
+    // Back to a fixed maximum frequency
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = false,
+    };
+    esp_pm_configure(&pm_config);
+#endif
+
+    g_power.initialized = false;
+    ESP_LOGI(TAG, "Power service deinitialized");
+    return ESP_OK;
+}
+
+esp_err_t power_lock_create(power_lock_type_t type, const char *name, power_lock_t **lock)
+{
+    if (type >= POWER_LOCK_TYPE_COUNT || !name || !lock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+#if CONFIG_PM_ENABLE
+    // Allocates, so created before taking the spinlock
+    esp_pm_lock_handle_t pm_lock = NULL;
+    esp_err_t ret = esp_pm_lock_create(power_pm_type(type), 0, name, &pm_lock);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create PM lock %s: %s", name, esp_err_to_name(ret));
+        return ret;
+    }
+#endif
+
+    struct power_lock *slot = NULL;
+    portENTER_CRITICAL(&g_power.lock);
+    for (int i = 0; i < CONFIG_KRAKEN_POWER_MAX_LOCKS; i++) {
+        if (!g_power.locks[i].used) {
+            slot = &g_power.locks[i];
+            memset(slot, 0, sizeof(*slot));
+            slot->used = true;
+            slot->type = type;
+            slot->name = name;
+#if CONFIG_PM_ENABLE
+            slot->pm_lock = pm_lock;
+#endif
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&g_power.lock);
+
+    if (!slot) {
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_delete(pm_lock);
+#endif
+        ESP_LOGE(TAG, "No free power lock for %s, raise CONFIG_KRAKEN_POWER_MAX_LOCKS", name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *lock = slot;
+    return ESP_OK;
+}
+
+esp_err_t power_lock_acquire(power_lock_t *lock)
+{
+    if (!lock || !lock->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+#if CONFIG_PM_ENABLE
+    // Raise the frequency before the caller starts the work that needs it
+    esp_err_t ret = esp_pm_lock_acquire(lock->pm_lock);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+#endif
+
+    int64_t now = kraken_time_us();
+    portENTER_CRITICAL_SAFE(&g_power.lock);
+    if (lock->depth++ == 0) {
+        lock->acquires++;
+        lock->held_since_us = now;
+        g_power.held[lock->type]++;
+        power_update_state(now);
+    }
+    portEXIT_CRITICAL_SAFE(&g_power.lock);
+    return ESP_OK;
+}
+
+esp_err_t power_lock_release(power_lock_t *lock)
+{
+    if (!lock || !lock->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = kraken_time_us();
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL_SAFE(&g_power.lock);
+    if (lock->depth == 0) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (--lock->depth == 0) {
+        lock->held_us += now - lock->held_since_us;
+        g_power.held[lock->type]--;
+        power_update_state(now);
+    }
+    portEXIT_CRITICAL_SAFE(&g_power.lock);
+
+#if CONFIG_PM_ENABLE
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_release(lock->pm_lock);
+    }
+#endif
+    return ret;
+}
+
+esp_err_t power_lock_delete(power_lock_t *lock)
+{
+    if (!lock || !lock->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&g_power.lock);
+    bool held = lock->depth > 0;
+    if (!held) {
+        lock->used = false;
+    }
+    portEXIT_CRITICAL(&g_power.lock);
+
+    if (held) {
+        ESP_LOGE(TAG, "Power lock %s deleted while held", lock->name);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_delete(lock->pm_lock);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t power_service_get_stats(power_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t now = kraken_time_us();
+    portENTER_CRITICAL(&g_power.lock);
+    memcpy(stats->residency_us, g_power.residency_us, sizeof(stats->residency_us));
+    // Include the time spent so far in the current state
+    stats->residency_us[g_power.state] += now - g_power.state_since_us;
+    stats->transitions = g_power.transitions;
+    stats->state = g_power.state;
+    portEXIT_CRITICAL(&g_power.lock);
+    return ESP_OK;
+}
+
+void power_service_dump_stats(void)
+{
+    power_stats_t stats;
+    power_service_get_stats(&stats);
+
+    uint64_t total_us = 0;
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        total_us += stats.residency_us[i];
+    }
+    if (total_us == 0) {
+        total_us = 1;
+    }
+
+    ESP_LOGI(TAG, "Power states (now %s, %lu transitions):", s_state_names[stats.state],
+             (unsigned long)stats.transitions);
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        ESP_LOGI(TAG, "  %-8s %10llu ms %5.1f%%", s_state_names[i],
+                 stats.residency_us[i] / 1000, stats.residency_us[i] * 100.0 / total_us);
+    }
+
+    ESP_LOGI(TAG, "Locks:");
+    int64_t now = kraken_time_us();
+    for (int i = 0; i < CONFIG_KRAKEN_POWER_MAX_LOCKS; i++) {
+        portENTER_CRITICAL(&g_power.lock);
+        struct power_lock snap = g_power.locks[i];
+        portEXIT_CRITICAL(&g_power.lock);
+
+        if (!snap.used) {
+            continue;
+        }
+        uint64_t held_us = snap.held_us + (snap.depth ? now - snap.held_since_us : 0);
+        ESP_LOGI(TAG, "  %-14s %-8s %s acquires=%lu held=%llu ms", snap.name,
+                 snap.type == POWER_LOCK_CPU_MAX ? "cpu_max" :
+                 snap.type == POWER_LOCK_APB_MAX ? "apb_max" : "no_sleep",
+                 snap.depth ? "HELD" : "    ", (unsigned long)snap.acquires, held_us / 1000);
+    }
+
+#if CONFIG_PM_PROFILING
+    // Driver locks and real light-sleep time, as seen by esp_pm
+    esp_pm_dump_locks(stdout);
+#endif
+}
@@ -4,19 +4,31 @@
 #include "esp_sntp.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include <string.h>
 #include <time.h>
 #include <sys/time.h>
 
 static const char *TAG = "system_service";
 
+#define INPUT_POLL_PERIOD_MS 50
+#define INPUT_POLL_SLACK_MS 5
+#define SYSTEM_WARM_KEY "time"
+#define SYSTEM_TZ_MAX_LEN 32
+
+// The RTC keeps the clock across deep sleep and resets, but TZ lives in the
+// environment and is lost; restored on a warm boot.
+typedef struct {
+    char timezone[SYSTEM_TZ_MAX_LEN];
+    bool synced;
+} system_warm_state_t;
+
 static struct {
     bool initialized;
     bool time_synced;
     bool input_monitor_running;
-    TaskHandle_t input_task_handle;
+    char timezone[SYSTEM_TZ_MAX_LEN];
+    void *input_timer;
+    uint32_t input_prev_state;
     const board_input_config_t *input_cfg;
 } g_system = {0};
 
@@ -24,6 +36,11 @@ static void time_sync_notification_cb(struct timeval *tv)
 {
     ESP_LOGI(TAG, "Time synchronized");
     g_system.time_synced = true;
+
+    system_warm_state_t warm = { .synced = true };
+    strncpy(warm.timezone, g_system.timezone, sizeof(warm.timezone) - 1);
+    kraken_warm_save(SYSTEM_WARM_KEY, &warm, sizeof(warm));
+
     kraken_event_post(KRAKEN_EVENT_SYSTEM_TIME_SYNC, NULL, 0);
 }
 
@@ -35,59 +52,54 @@ static void wifi_event_handler(const kraken_event_t *event, void *user_data)
     }
 }
 
-static void input_monitor_task(void *arg)
+// Runs on the worker pool every INPUT_POLL_PERIOD_MS
+static void input_monitor_poll(void *arg)
 {
     const board_input_config_t *cfg = g_system.input_cfg;
-    uint32_t prev_state = 0;
+    uint32_t prev_state = g_system.input_prev_state;
+
+    uint32_t curr_state = 0;
     
-    while (g_system.input_monitor_running) {
-        uint32_t curr_state = 0;
-        
-        if (cfg->pin_up != GPIO_NUM_NC) {
-            curr_state |= (gpio_get_level(cfg->pin_up) == (cfg->active_low ? 0 : 1)) << 0;
+    if (cfg->pin_up != GPIO_NUM_NC) {
+        curr_state |= (gpio_get_level(cfg->pin_up) == (cfg->active_low ? 0 : 1)) << 0;
+    }
+    if (cfg->pin_down != GPIO_NUM_NC) {
+        curr_state |= (gpio_get_level(cfg->pin_down) == (cfg->active_low ? 0 : 1)) << 1;
+    }
+    if (cfg->pin_left != GPIO_NUM_NC) {
+        curr_state |= (gpio_get_level(cfg->pin_left) == (cfg->active_low ? 0 : 1)) << 2;
+    }
+    if (cfg->pin_right != GPIO_NUM_NC) {
+        curr_state |= (gpio_get_level(cfg->pin_right) == (cfg->active_low ? 0 : 1)) << 3;
+    }
+    if (cfg->pin_center != GPIO_NUM_NC) {
+        curr_state |= (gpio_get_level(cfg->pin_center) == (cfg->active_low ? 0 : 1)) << 4;
+    }
+    
+    if (curr_state != prev_state) {
+        if ((curr_state & (1 << 0)) && !(prev_state & (1 << 0))) {
+            ESP_LOGI(TAG, "Input: UP");
+            kraken_event_post(KRAKEN_EVENT_INPUT_UP, NULL, 0);
         }
-        if (cfg->pin_down != GPIO_NUM_NC) {
-            curr_state |= (gpio_get_level(cfg->pin_down) == (cfg->active_low ? 0 : 1)) << 1;
+        if ((curr_state & (1 << 1)) && !(prev_state & (1 << 1))) {
+            ESP_LOGI(TAG, "Input: DOWN");
+            kraken_event_post(KRAKEN_EVENT_INPUT_DOWN, NULL, 0);
         }
-        if (cfg->pin_left != GPIO_NUM_NC) {
-            curr_state |= (gpio_get_level(cfg->pin_left) == (cfg->active_low ? 0 : 1)) << 2;
+        if ((curr_state & (1 << 2)) && !(prev_state & (1 << 2))) {
+            ESP_LOGI(TAG, "Input: LEFT");
+            kraken_event_post(KRAKEN_EVENT_INPUT_LEFT, NULL, 0);
         }
-        if (cfg->pin_right != GPIO_NUM_NC) {
-            curr_state |= (gpio_get_level(cfg->pin_right) == (cfg->active_low ? 0 : 1)) << 3;
+        if ((curr_state & (1 << 3)) && !(prev_state & (1 << 3))) {
+            ESP_LOGI(TAG, "Input: RIGHT");
+            kraken_event_post(KRAKEN_EVENT_INPUT_RIGHT, NULL, 0);
         }
-        if (cfg->pin_center != GPIO_NUM_NC) {
-            curr_state |= (gpio_get_level(cfg->pin_center) == (cfg->active_low ? 0 : 1)) << 4;
+        if ((curr_state & (1 << 4)) && !(prev_state & (1 << 4))) {
+            ESP_LOGI(TAG, "Input: CENTER");
+            kraken_event_post(KRAKEN_EVENT_INPUT_CENTER, NULL, 0);
         }
         
-        if (curr_state != prev_state) {
-            if ((curr_state & (1 << 0)) && !(prev_state & (1 << 0))) {
-                ESP_LOGI(TAG, "Input: UP");
-                kraken_event_post(KRAKEN_EVENT_INPUT_UP, NULL, 0);
-            }
-            if ((curr_state & (1 << 1)) && !(prev_state & (1 << 1))) {
-                ESP_LOGI(TAG, "Input: DOWN");
-                kraken_event_post(KRAKEN_EVENT_INPUT_DOWN, NULL, 0);
-            }
-            if ((curr_state & (1 << 2)) && !(prev_state & (1 << 2))) {
-                ESP_LOGI(TAG, "Input: LEFT");
-                kraken_event_post(KRAKEN_EVENT_INPUT_LEFT, NULL, 0);
-            }
-            if ((curr_state & (1 << 3)) && !(prev_state & (1 << 3))) {
-                ESP_LOGI(TAG, "Input: RIGHT");
-                kraken_event_post(KRAKEN_EVENT_INPUT_RIGHT, NULL, 0);
-            }
-            if ((curr_state & (1 << 4)) && !(prev_state & (1 << 4))) {
-                ESP_LOGI(TAG, "Input: CENTER");
-                kraken_event_post(KRAKEN_EVENT_INPUT_CENTER, NULL, 0);
-            }
-            
-            prev_state = curr_state;
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(50));
+        g_system.input_prev_state = curr_state;
     }
-    
-    vTaskDelete(NULL);
 }
 
 esp_err_t system_service_init(void)
@@ -98,6 +110,23 @@ esp_err_t system_service_init(void)
 
     g_system.input_cfg = board_support_get_input_config();
 
+    // Warm boot: the clock is still valid, only the timezone needs restoring.
+    // SNTP still runs after the next GOT_IP to correct drift.
+    system_warm_state_t warm;
+    if (kraken_warm_load(SYSTEM_WARM_KEY, &warm, sizeof(warm)) == ESP_OK && warm.synced) {
+        warm.timezone[sizeof(warm.timezone) - 1] = '\0';
+        strncpy(g_system.timezone, warm.timezone, sizeof(g_system.timezone) - 1);
+        if (g_system.timezone[0]) {
+            setenv("TZ", g_system.timezone, 1);
+            tzset();
+        }
+        struct tm timeinfo;
+        time_t now = time(NULL);
+        localtime_r(&now, &timeinfo);
+        g_system.time_synced = (timeinfo.tm_year >= (2020 - 1900));
+        ESP_LOGI(TAG, "Warm boot: time %s", g_system.time_synced ? "kept" : "lost, waiting for SNTP");
+    }
+
     kraken_event_subscribe(KRAKEN_EVENT_WIFI_GOT_IP, wifi_event_handler, NULL);
 
     g_system.initialized = true;
@@ -114,6 +143,10 @@ esp_err_t system_service_deinit(void)
     if (g_system.input_monitor_running) {
         system_service_stop_input_monitor();
     }
+    if (g_system.input_timer) {
+        kraken_timer_delete(g_system.input_timer);
+        g_system.input_timer = NULL;
+    }
 
     kraken_event_unsubscribe(KRAKEN_EVENT_WIFI_GOT_IP, wifi_event_handler);
 
@@ -129,6 +162,7 @@ esp_err_t system_service_sync_time(const char *ntp_server, const char *timezone)
     }
 
     if (timezone) {
+        strncpy(g_system.timezone, timezone, sizeof(g_system.timezone) - 1);
         setenv("TZ", timezone, 1);
         tzset();
     }
@@ -169,15 +203,30 @@ esp_err_t system_service_start_input_monitor(void)
         return ESP_OK;
     }
 
-    g_system.input_monitor_running = true;
+    // Polling is a periodic job on the shared worker pool, not a dedicated task
+    if (!g_system.input_timer) {
+        kraken_timer_config_t timer_cfg = {
+            .name = "input_poll",
+            .period_ms = INPUT_POLL_PERIOD_MS,
+            .auto_reload = true,
+            .slack_ms = INPUT_POLL_SLACK_MS,
+            .callback = input_monitor_poll,
+            .executor = kraken_work_executor(KRAKEN_WORK_PRIO_HIGH, KRAKEN_WORK_CORE_ANY),
+        };
+        esp_err_t ret = kraken_timer_create_ex(&timer_cfg, &g_system.input_timer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create input poll timer");
+            return ret;
+        }
+    }
 
-    BaseType_t ret = xTaskCreate(input_monitor_task, "input_mon", 2048, NULL,
-                                   5, &g_system.input_task_handle);
-    if (ret != pdPASS) {
-        g_system.input_monitor_running = false;
-        ESP_LOGE(TAG, "Failed to create input monitor task");
-        return ESP_ERR_NO_MEM;
+    g_system.input_prev_state = 0;
+    esp_err_t ret = kraken_timer_start(g_system.input_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start input poll timer");
+        return ret;
     }
+    g_system.input_monitor_running = true;
 
     ESP_LOGI(TAG, "Input monitor started");
     return ESP_OK;
@@ -190,11 +239,7 @@ esp_err_t system_service_stop_input_monitor(void)
     }
 
     g_system.input_monitor_running = false;
-
-    if (g_system.input_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        g_system.input_task_handle = NULL;
-    }
+    kraken_timer_stop(g_system.input_timer);
 
     ESP_LOGI(TAG, "Input monitor stopped");
     return ESP_OK;
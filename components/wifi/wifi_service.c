@@ -9,14 +9,94 @@
 
 static const char *TAG = "wifi_service";
 
+#define WIFI_WARM_KEY "wifi"
+
+// Last good association, restored on a warm boot. Only where the AP was: the
+// credentials stay in the driver's NVS copy, not in RTC memory.
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} wifi_warm_state_t;
+
 static struct {
     bool initialized;
     bool enabled;
     bool connected;
+    bool fast_reconnect;   // Connecting to the saved BSSID/channel without a full scan
     esp_netif_t *netif;
     wifi_scan_result_t scan_results;
+    char ssid[WIFI_SSID_MAX_LEN + 1];
+    char password[WIFI_PASSWORD_MAX_LEN + 1];
 } g_wifi = {0};
 
+// bssid NULL: let the driver scan all channels for the SSID
+static esp_err_t wifi_start_connect(const uint8_t *bssid, uint8_t channel)
+{
+    wifi_config_t wifi_config = {0};
+    strncpy((char *)wifi_config.sta.ssid, g_wifi.ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, g_wifi.password, sizeof(wifi_config.sta.password) - 1);
+    if (bssid) {
+        memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.bssid_set = true;
+        wifi_config.sta.channel = channel;
+    }
+
+    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_connect();
+    }
+    return ret;
+}
+
+static void wifi_save_warm_state(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+
+    wifi_warm_state_t warm = {0};
+    memcpy(warm.bssid, ap.bssid, sizeof(warm.bssid));
+    warm.channel = ap.primary;
+    kraken_warm_save(WIFI_WARM_KEY, &warm, sizeof(warm));
+}
+
+// Left by the user: no rejoin after the next wake, and the saved credentials go
+static void wifi_forget_network(void)
+{
+    kraken_warm_erase(WIFI_WARM_KEY);
+    wifi_config_t empty = {0};
+    esp_wifi_set_config(WIFI_IF_STA, &empty);
+}
+
+// After a deep sleep or reset, rejoin the last AP on its channel: no full scan
+static void wifi_warm_reconnect(void)
+{
+    wifi_warm_state_t warm;
+    if (kraken_warm_load(WIFI_WARM_KEY, &warm, sizeof(warm)) != ESP_OK) {
+        return;
+    }
+
+    // The driver kept the last wifi_start_connect() config in NVS
+    wifi_config_t saved = {0};
+    if (esp_wifi_get_config(WIFI_IF_STA, &saved) != ESP_OK || saved.sta.ssid[0] == '\0') {
+        kraken_warm_erase(WIFI_WARM_KEY);
+        return;
+    }
+    strncpy(g_wifi.ssid, (const char *)saved.sta.ssid, sizeof(g_wifi.ssid) - 1);
+    strncpy(g_wifi.password, (const char *)saved.sta.password, sizeof(g_wifi.password) - 1);
+
+    if (wifi_service_enable() != ESP_OK) {
+        return;
+    }
+    ESP_LOGI(TAG, "Warm boot: rejoining %s on channel %d", g_wifi.ssid, warm.channel);
+    g_wifi.fast_reconnect = true;
+    if (wifi_start_connect(warm.bssid, warm.channel) != ESP_OK) {
+        g_wifi.fast_reconnect = false;
+        ESP_LOGW(TAG, "Warm reconnect failed to start");
+    }
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                 int32_t event_id, void *event_data)
 {
@@ -36,6 +116,12 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
             case WIFI_EVENT_STA_DISCONNECTED:
                 ESP_LOGI(TAG, "WiFi disconnected");
                 g_wifi.connected = false;
+                if (g_wifi.fast_reconnect) {
+                    // The saved AP moved or is gone; fall back to a normal connect once
+                    g_wifi.fast_reconnect = false;
+                    ESP_LOGW(TAG, "Saved AP not reachable, scanning for %s", g_wifi.ssid);
+                    wifi_start_connect(NULL, 0);
+                }
                 kraken_event_post(KRAKEN_EVENT_WIFI_DISCONNECTED, NULL, 0);
                 break;
             case WIFI_EVENT_SCAN_DONE:
@@ -48,6 +134,8 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
             ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
             ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
             g_wifi.connected = true;
+            g_wifi.fast_reconnect = false;
+            wifi_save_warm_state();
             kraken_event_post(KRAKEN_EVENT_WIFI_CONNECTED, NULL, 0);
             kraken_event_post(KRAKEN_EVENT_WIFI_GOT_IP, &event->ip_info, sizeof(event->ip_info));
         }
@@ -79,10 +167,13 @@ esp_err_t wifi_service_init(void)
                                                  &wifi_event_handler, NULL));
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    // Flash storage: the credentials for a warm rejoin live in NVS, not RTC memory
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_FLASH));
 
     g_wifi.initialized = true;
     ESP_LOGI(TAG, "WiFi service initialized");
+
+    wifi_warm_reconnect();
     return ESP_OK;
 }
 
@@ -92,8 +183,12 @@ esp_err_t wifi_service_deinit(void)
         return ESP_OK;
     }
 
+    // Not wifi_service_disable(): a service restart keeps the warm-boot record
     if (g_wifi.enabled) {
-        wifi_service_disable();
+        esp_wifi_stop();
+        g_wifi.enabled = false;
+        g_wifi.connected = false;
+        g_wifi.fast_reconnect = false;
     }
 
     esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler);
@@ -132,6 +227,8 @@ esp_err_t wifi_service_disable(void)
     ESP_ERROR_CHECK(esp_wifi_stop());
     g_wifi.enabled = false;
     g_wifi.connected = false;
+    g_wifi.fast_reconnect = false;
+    wifi_forget_network();
     ESP_LOGI(TAG, "WiFi disabled");
     return ESP_OK;
 }
@@ -168,9 +265,18 @@ esp_err_t wifi_service_get_scan_results(wifi_scan_result_t *results)
     }
 
     uint16_t ap_count = WIFI_MAX_SCAN_RESULTS;
-    wifi_ap_record_t ap_records[WIFI_MAX_SCAN_RESULTS];
+    // Cold, short-lived data - keep it out of the caller's stack and internal RAM
+    wifi_ap_record_t *ap_records = kraken_malloc_ex(WIFI_MAX_SCAN_RESULTS * sizeof(wifi_ap_record_t),
+                                                    KRAKEN_MEM_LARGE);
+    if (!ap_records) {
+        return ESP_ERR_NO_MEM;
+    }
 
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&ap_count, ap_records));
+    esp_err_t ret = esp_wifi_scan_get_ap_records(&ap_count, ap_records);
+    if (ret != ESP_OK) {
+        kraken_free(ap_records);
+        return ret;
+    }
 
     results->count = ap_count;
     for (uint16_t i = 0; i < ap_count; i++) {
@@ -179,6 +285,7 @@ esp_err_t wifi_service_get_scan_results(wifi_scan_result_t *results)
         results->aps[i].auth_mode = ap_records[i].authmode;
         results->aps[i].channel = ap_records[i].primary;
     }
+    kraken_free(ap_records);
 
     ESP_LOGI(TAG, "Found %d APs", ap_count);
     return ESP_OK;
@@ -190,14 +297,18 @@ esp_err_t wifi_service_connect(const char *ssid, const char *password)
         return ESP_ERR_INVALID_ARG;
     }
 
-    wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
+    // esp_wifi_set_config persists to NVS, which runs with the flash cache disabled
+    KRAKEN_REQUIRE_INTERNAL_STACK();
+
+    memset(g_wifi.ssid, 0, sizeof(g_wifi.ssid));
+    memset(g_wifi.password, 0, sizeof(g_wifi.password));
+    strncpy(g_wifi.ssid, ssid, sizeof(g_wifi.ssid) - 1);
     if (password) {
-        strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+        strncpy(g_wifi.password, password, sizeof(g_wifi.password) - 1);
     }
 
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_connect());
+    g_wifi.fast_reconnect = false;
+    ESP_ERROR_CHECK(wifi_start_connect(NULL, 0));
 
     ESP_LOGI(TAG, "Connecting to %s...", ssid);
     return ESP_OK;
@@ -209,8 +320,10 @@ esp_err_t wifi_service_disconnect(void)
         return ESP_OK;
     }
 
+    g_wifi.fast_reconnect = false;
     ESP_ERROR_CHECK(esp_wifi_disconnect());
     g_wifi.connected = false;
+    wifi_forget_network();
     ESP_LOGI(TAG, "Disconnected");
     return ESP_OK;
 }
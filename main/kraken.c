@@ -6,6 +6,7 @@
 #include "kraken/display_service.h"
 #include "kraken/system_service.h"
 #include "kraken/audio_service.h"
+#include "kraken/power_service.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 
@@ -26,6 +27,11 @@ void app_main(void)
 
     ESP_ERROR_CHECK(kraken_kernel_init());
 
+    ESP_ERROR_CHECK(kraken_service_register("power",
+                                             KRAKEN_PERM_SYSTEM,
+                                             power_service_init,
+                                             power_service_deinit));
+
     ESP_ERROR_CHECK(kraken_service_register("wifi", 
                                              KRAKEN_PERM_WIFI | KRAKEN_PERM_NETWORK,
                                              wifi_service_init,
@@ -51,6 +57,8 @@ void app_main(void)
                                              system_service_init,
                                              system_service_deinit));
 
+    // First, so DFS is active before the other services take their locks
+    ESP_ERROR_CHECK(kraken_service_start("power"));
     ESP_ERROR_CHECK(kraken_service_start("system"));
     ESP_ERROR_CHECK(kraken_service_start("audio"));
     ESP_ERROR_CHECK(kraken_service_start("display"));